@@ -5,11 +5,14 @@
 
 #include "GrowTowerBLE.h"
 
+#include <stdarg.h>
+
 // ESP-IDF BLE Includes
 #include <esp_bt.h>
 #include <esp_bt_defs.h>
 #include <esp_bt_main.h>
 #include <esp_gap_ble_api.h>
+#include <esp_gatt_common_api.h>
 #include <esp_gatts_api.h>
 
 // Service UUID (128-bit): 4fafc201-1fb5-459e-8fcc-c5c9c331914b
@@ -25,19 +28,50 @@ static uint8_t service_uuid128[16] = {
 #define CHAR_FAN_MAX_UUID 0xABC4
 #define CHAR_LIGHT_ON_UUID 0xABC5
 #define CHAR_LIGHT_OFF_UUID 0xABC6
+#define CHAR_STATUS_UUID 0xABC7
+#define CHAR_COMMAND_UUID 0xABC8
+
+// MTU offered to the client. The packed status needs 3 bytes more than its
+// length to fit one notification; iOS asks for 185 by itself, Android apps
+// have to call requestMtu().
+#define LOCAL_MTU 185
+
+#define STATUS_MAX_LEN 64
+#define COMMAND_MAX_LEN 32
 
 // GATT Interface
 static esp_gatt_if_t g_gatts_if = 0;
 static uint16_t g_conn_id = 0;
 static bool g_connected = false;
 static uint8_t g_connection_count = 0;
+static uint16_t g_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
 
 // Service Handle
 static uint16_t g_service_handle = 0;
 
+#define CHAR_COUNT 8
+#define CHAR_VALUE_COUNT 6 // the 1-byte characteristics come first
+
 // Characteristic Handles
-static uint16_t g_char_handles[6] = {0};
-static uint16_t g_char_val_handles[6] = {0};
+static uint16_t g_char_handles[CHAR_COUNT] = {0};
+static uint16_t g_char_val_handles[CHAR_COUNT] = {0};
+
+// Client Characteristic Configuration descriptor of each characteristic.
+// Bit i of g_notify_mask is set while the client has notifications on for
+// characteristic i; bit i of g_dirty_mask while its value changed since the
+// last growtower_ble_notify_changes().
+static uint16_t g_cccd_handles[CHAR_COUNT] = {0};
+static uint8_t g_notify_mask = 0;
+static uint8_t g_dirty_mask = 0;
+
+// Guards g_values, g_status, g_dirty_mask and g_notify_mask: the firmware
+// stages values from its control task while the Bluedroid task handles
+// writes. Only plain copies are made under it, never stack calls.
+static portMUX_TYPE g_values_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Service declaration plus declaration, value and CCCD per characteristic;
+// the command characteristic has no CCCD
+#define SERVICE_NUM_HANDLES (1 + CHAR_COUNT * 3 - 1)
 
 #define CHAR_IDX_LIGHT 0
 #define CHAR_IDX_FAN 1
@@ -45,19 +79,48 @@ static uint16_t g_char_val_handles[6] = {0};
 #define CHAR_IDX_FAN_MAX 3
 #define CHAR_IDX_LIGHT_ON 4
 #define CHAR_IDX_LIGHT_OFF 5
+#define CHAR_IDX_STATUS 6
+#define CHAR_IDX_COMMAND 7
 
 // Characteristic UUIDs array
-static uint16_t char_uuids[6] = {CHAR_LIGHT_UUID,    CHAR_FAN_UUID,
-                                 CHAR_FAN_MIN_UUID,  CHAR_FAN_MAX_UUID,
-                                 CHAR_LIGHT_ON_UUID, CHAR_LIGHT_OFF_UUID};
+static uint16_t char_uuids[CHAR_COUNT] = {
+    CHAR_LIGHT_UUID,    CHAR_FAN_UUID,       CHAR_FAN_MIN_UUID,
+    CHAR_FAN_MAX_UUID,  CHAR_LIGHT_ON_UUID,  CHAR_LIGHT_OFF_UUID,
+    CHAR_STATUS_UUID,   CHAR_COMMAND_UUID};
+
+// Command each characteristic maps to
+static const char *char_commands[6] = {"LIGHT",  "FAN",     "FANMIN",
+                                       "FANMAX", "LIGHTON", "LIGHTOFF"};
 
 // Aktuelle Werte
 static uint8_t g_values[6] = {0, 15, 0, 100, 18, 14};
 
-// Callbacks
-static LightCallback g_light_cb = NULL;
-static FanCallback g_fan_cb = NULL;
-static ConfigCallback g_config_cbs[4] = {NULL, NULL, NULL, NULL};
+// Packed status, set by growtower_ble_update_status(); a single 0 (format
+// version 0) until the firmware provides one
+static uint8_t g_status[STATUS_MAX_LEN] = {0};
+static uint16_t g_status_len = 1;
+
+// Callback
+static CommandCallback g_command_cb = NULL;
+static BatchCallback g_batch_cb = NULL;
+static LogCallback g_log_cb = NULL;
+
+// Most messages come from the Bluedroid task, which must not wait on Serial:
+// they go to the firmware's log hook, or nowhere.
+static void ble_log(bool warning, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void ble_log(bool warning, const char *fmt, ...) {
+  if (g_log_cb == NULL) {
+    return;
+  }
+  char message[96];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  g_log_cb(warning, message);
+}
 
 // Current characteristic being added
 static int g_current_char_idx = 0;
@@ -109,23 +172,22 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event,
                               esp_ble_gap_cb_param_t *param) {
   switch (event) {
   case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-    Serial.println("[BLE] Advertising data set");
+    ble_log(false, "Advertising data set");
     // Setze den Gerätenamen EXPLIZIT
     esp_ble_gap_set_device_name("TOWER");
     esp_ble_gap_config_adv_data(&scan_rsp_data);
     break;
 
   case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-    Serial.println("[BLE] Scan response set");
+    ble_log(false, "Scan response set");
     esp_ble_gap_start_advertising(&adv_params);
     break;
 
   case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
     if (param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS) {
-      Serial.println("[BLE] Advertising started! Device 'TOWER' is visible.");
+      ble_log(false, "Advertising started! Device 'TOWER' is visible.");
     } else {
-      Serial.printf("[BLE] Advertising failed: %d\n",
-                    param->adv_start_cmpl.status);
+      ble_log(true, "Advertising failed: %d", param->adv_start_cmpl.status);
     }
     break;
 
@@ -136,13 +198,18 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event,
 
 // Add next characteristic
 static void add_next_characteristic() {
-  if (g_current_char_idx >= 6) {
-    Serial.println("[BLE] All characteristics created");
+  if (g_current_char_idx >= CHAR_COUNT) {
+    ble_log(false, "All characteristics created");
     return;
   }
 
   uint16_t uuid = char_uuids[g_current_char_idx];
-  uint8_t val = g_values[g_current_char_idx];
+  uint8_t val = 0;
+  if (g_current_char_idx < CHAR_VALUE_COUNT) {
+    portENTER_CRITICAL(&g_values_mux);
+    val = g_values[g_current_char_idx];
+    portEXIT_CRITICAL(&g_values_mux);
+  }
 
   esp_bt_uuid_t char_uuid = {
       .len = ESP_UUID_LEN_16,
@@ -154,16 +221,85 @@ static void add_next_characteristic() {
       .attr_len = 1,
       .attr_value = &val,
   };
+  esp_gatt_perm_t perm = ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE;
+  esp_gatt_char_prop_t prop = ESP_GATT_CHAR_PROP_BIT_READ |
+                              ESP_GATT_CHAR_PROP_BIT_WRITE |
+                              ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+  esp_attr_control_t control = {.auto_rsp = ESP_GATT_AUTO_RSP};
+  esp_attr_control_t *p_control = NULL;
+
+  if (g_current_char_idx == CHAR_IDX_STATUS) {
+    // Read-only; the stack serves (long) reads from the attribute table
+    attr_val.attr_max_len = STATUS_MAX_LEN;
+    attr_val.attr_len = g_status_len;
+    attr_val.attr_value = g_status;
+    perm = ESP_GATT_PERM_READ;
+    prop = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+    p_control = &control;
+  } else if (g_current_char_idx == CHAR_IDX_COMMAND) {
+    // Write-only, answered by the write handler with the batch result;
+    // the max length caps a batch at COMMAND_MAX_LEN / 2 pairs
+    attr_val.attr_max_len = COMMAND_MAX_LEN;
+    perm = ESP_GATT_PERM_WRITE;
+    prop = ESP_GATT_CHAR_PROP_BIT_WRITE;
+    control.auto_rsp = ESP_GATT_RSP_BY_APP;
+    p_control = &control;
+  }
 
-  esp_err_t ret = esp_ble_gatts_add_char(
-      g_service_handle, &char_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-      ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE, &attr_val,
-      NULL);
+  esp_err_t ret = esp_ble_gatts_add_char(g_service_handle, &char_uuid, perm,
+                                         prop, &attr_val, p_control);
 
   if (ret == ESP_OK) {
-    Serial.printf("[BLE] Adding characteristic 0x%04X...\n", uuid);
+    ble_log(false, "Adding characteristic 0x%04X...", uuid);
   } else {
-    Serial.printf("[BLE] Error adding characteristic: %d\n", ret);
+    ble_log(true, "Error adding characteristic: %d", ret);
+  }
+}
+
+// CCCD of the characteristic just added, notifications off
+static void add_cccd() {
+  static uint8_t cccd_off[2] = {0x00, 0x00};
+  esp_bt_uuid_t descr_uuid = {
+      .len = ESP_UUID_LEN_16,
+      .uuid = {.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG},
+  };
+  esp_attr_value_t descr_val = {
+      .attr_max_len = 2,
+      .attr_len = 2,
+      .attr_value = cccd_off,
+  };
+  esp_attr_control_t control = {.auto_rsp = ESP_GATT_AUTO_RSP};
+  esp_err_t ret = esp_ble_gatts_add_char_descr(
+      g_service_handle, &descr_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      &descr_val, &control);
+  if (ret != ESP_OK) {
+    ble_log(true, "Error adding CCCD: %d", ret);
+  }
+}
+
+// Subscriptions end with the connection; the CCCDs read 0 again for the
+// next client.
+static void clear_subscriptions() {
+  static uint8_t cccd_off[2] = {0x00, 0x00};
+  portENTER_CRITICAL(&g_values_mux);
+  g_notify_mask = 0;
+  portEXIT_CRITICAL(&g_values_mux);
+  for (int i = 0; i < CHAR_COUNT; i++) {
+    if (g_cccd_handles[i] != 0) {
+      esp_ble_gatts_set_attr_value(g_cccd_handles[i], 2, cccd_off);
+    }
+  }
+}
+
+// ATT status a write is answered with
+static esp_gatt_status_t att_status(growtower_ble_result_t result) {
+  switch (result) {
+  case GROWTOWER_BLE_OK:
+    return ESP_GATT_OK;
+  case GROWTOWER_BLE_BUSY:
+    return ESP_GATT_BUSY;
+  default:
+    return ESP_GATT_OUT_OF_RANGE;
   }
 }
 
@@ -177,11 +313,14 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
   uint16_t handle;
   uint8_t *data;
   uint16_t len;
+  esp_gatt_status_t status;
+  growtower_ble_result_t result;
+  uint8_t value;
   int i;
 
   switch (event) {
   case ESP_GATTS_REG_EVT:
-    Serial.println("[BLE] GATT Server registered");
+    ble_log(false, "GATT Server registered");
     g_gatts_if = gatts_if;
 
     // Create service with proper ID structure
@@ -191,7 +330,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
     service_id.id.uuid.len = ESP_UUID_LEN_128;
     memcpy(service_id.id.uuid.uuid.uuid128, service_uuid128, 16);
 
-    esp_ble_gatts_create_service(gatts_if, &service_id, 20);
+    esp_ble_gatts_create_service(gatts_if, &service_id, SERVICE_NUM_HANDLES);
 
     // Add advertising configuration here
     esp_ble_gap_set_device_name("TOWER");
@@ -199,7 +338,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
     break;
 
   case ESP_GATTS_CREATE_EVT:
-    Serial.println("[BLE] Service created");
+    ble_log(false, "Service created");
     g_service_handle = param->create.service_handle;
     esp_ble_gatts_start_service(g_service_handle);
 
@@ -209,7 +348,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
     break;
 
   case ESP_GATTS_START_EVT:
-    Serial.println("[BLE] Service started");
+    ble_log(false, "Service started");
     break;
 
   case ESP_GATTS_ADD_CHAR_EVT:
@@ -217,22 +356,35 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
       g_char_handles[g_current_char_idx] = param->add_char.attr_handle;
       g_char_val_handles[g_current_char_idx] = param->add_char.attr_handle;
 
-      Serial.printf("[BLE] Characteristic 0x%04X added (handle=%d)\n",
-                    char_uuids[g_current_char_idx],
-                    param->add_char.attr_handle);
+      ble_log(false, "Characteristic 0x%04X added (handle=%d)",
+              char_uuids[g_current_char_idx], param->add_char.attr_handle);
+
+      if (g_current_char_idx == CHAR_IDX_COMMAND) {
+        g_current_char_idx++;
+        add_next_characteristic();
+      } else {
+        add_cccd();
+      }
+    } else {
+      ble_log(true, "Failed to add characteristic: %d",
+              param->add_char.status);
+    }
+    break;
+
+  case ESP_GATTS_ADD_CHAR_DESCR_EVT:
+    if (param->add_char_descr.status == ESP_GATT_OK) {
+      g_cccd_handles[g_current_char_idx] = param->add_char_descr.attr_handle;
 
       // Move to next characteristic
       g_current_char_idx++;
       add_next_characteristic();
     } else {
-      Serial.printf("[BLE] Failed to add characteristic: %d\n",
-                    param->add_char.status);
+      ble_log(true, "Failed to add CCCD: %d", param->add_char_descr.status);
     }
     break;
 
   case ESP_GATTS_CONNECT_EVT:
-    Serial.printf("[BLE] Client connected (conn_id=%d)\n",
-                  param->connect.conn_id);
+    ble_log(false, "Client connected (conn_id=%d)", param->connect.conn_id);
     g_conn_id = param->connect.conn_id;
     g_connected = true;
     g_connection_count++;
@@ -248,60 +400,81 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
     break;
 
   case ESP_GATTS_DISCONNECT_EVT:
-    Serial.println("[BLE] Client disconnected");
+    ble_log(false, "Client disconnected");
     g_connected = false;
     g_connection_count--;
     g_conn_id = 0;
+    g_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+    clear_subscriptions();
 
     // Restart advertising
     delay(100);
     esp_ble_gap_start_advertising(&adv_params);
     break;
 
+  case ESP_GATTS_MTU_EVT:
+    ble_log(false, "MTU %d", param->mtu.mtu);
+    g_mtu = param->mtu.mtu;
+    break;
+
   case ESP_GATTS_WRITE_EVT:
-    if (!param->write.is_prep) {
+    if (param->write.is_prep) {
+      // Long writes only reach the command characteristic, whose batch
+      // has to fit one write
+      if (param->write.need_rsp) {
+        esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
+                                    param->write.trans_id,
+                                    ESP_GATT_REQ_NOT_SUPPORTED, NULL);
+      }
+    } else {
       handle = param->write.handle;
       data = param->write.value;
       len = param->write.len;
+      status = ESP_GATT_OK;
+
+      for (i = 0; i < CHAR_COUNT && len == 2; i++) {
+        if (handle == g_cccd_handles[i]) {
+          // Notify bit of the CCCD; indications are not offered
+          portENTER_CRITICAL(&g_values_mux);
+          if (data[0] & 0x01) {
+            g_notify_mask |= (1 << i);
+          } else {
+            g_notify_mask &= ~(1 << i);
+          }
+          portEXIT_CRITICAL(&g_values_mux);
+          len = 0; // not a value write
+          break;
+        }
+      }
+
+      if (len > 0 && handle == g_char_val_handles[CHAR_IDX_COMMAND]) {
+        if (len % 2 != 0) {
+          status = ESP_GATT_INVALID_ATTR_LEN;
+        } else if (g_batch_cb) {
+          status = att_status(g_batch_cb(data, len / 2));
+        }
+        len = 0;
+      }
 
       if (len > 0) {
         // Find which characteristic was written
-        for (i = 0; i < 6; i++) {
+        for (i = 0; i < CHAR_VALUE_COUNT; i++) {
           if (handle == g_char_val_handles[i]) {
-            uint8_t value = data[0];
-            g_values[i] = value;
-
-            switch (i) {
-            case CHAR_IDX_LIGHT:
-              Serial.printf("[BLE] WRITE Light: %s\n", value ? "ON" : "OFF");
-              if (g_light_cb)
-                g_light_cb(value != 0);
-              break;
-            case CHAR_IDX_FAN:
-              Serial.printf("[BLE] WRITE Fan: %d%%\n", value);
-              if (g_fan_cb)
-                g_fan_cb(value);
-              break;
-            case CHAR_IDX_FAN_MIN:
-              Serial.printf("[BLE] WRITE FanMin: %d%%\n", value);
-              if (g_config_cbs[0])
-                g_config_cbs[0](value);
-              break;
-            case CHAR_IDX_FAN_MAX:
-              Serial.printf("[BLE] WRITE FanMax: %d%%\n", value);
-              if (g_config_cbs[1])
-                g_config_cbs[1](value);
-              break;
-            case CHAR_IDX_LIGHT_ON:
-              Serial.printf("[BLE] WRITE LightOn: %d:00\n", value);
-              if (g_config_cbs[2])
-                g_config_cbs[2](value);
-              break;
-            case CHAR_IDX_LIGHT_OFF:
-              Serial.printf("[BLE] WRITE LightOff: %d:00\n", value);
-              if (g_config_cbs[3])
-                g_config_cbs[3](value);
-              break;
+            // The callback logs the write itself
+            value = data[0];
+            result = g_command_cb ? g_command_cb(char_commands[i], value)
+                                  : GROWTOWER_BLE_OK;
+            status = att_status(result);
+            portENTER_CRITICAL(&g_values_mux);
+            if (result == GROWTOWER_BLE_OK) {
+              g_values[i] = value;
+            } else {
+              value = g_values[i];
+            }
+            portEXIT_CRITICAL(&g_values_mux);
+            if (result != GROWTOWER_BLE_OK) {
+              // Not taken: restore the attribute to the last good value
+              esp_ble_gatts_set_attr_value(handle, 1, &value);
             }
             break;
           }
@@ -310,7 +483,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
 
       if (param->write.need_rsp) {
         esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
-                                    param->write.trans_id, ESP_GATT_OK, NULL);
+                                    param->write.trans_id, status, NULL);
       }
     }
     break;
@@ -324,21 +497,18 @@ static void gatts_event_handler(esp_gatts_cb_event_t event,
   }
 }
 
+void growtower_ble_set_log_callback(LogCallback log_cb) { g_log_cb = log_cb; }
+
 // Initialisierung
-void growtower_ble_init(LightCallback light_cb, FanCallback fan_cb,
-                        ConfigCallback fan_min_cb, ConfigCallback fan_max_cb,
-                        ConfigCallback light_on_cb, ConfigCallback light_off_cb,
-                        bool initial_light_on, int initial_fan_speed,
-                        int initial_fan_min, int initial_fan_max,
-                        int initial_light_on_hour, int initial_light_off_hour) {
-
-  // Callbacks speichern
-  g_light_cb = light_cb;
-  g_fan_cb = fan_cb;
-  g_config_cbs[0] = fan_min_cb;
-  g_config_cbs[1] = fan_max_cb;
-  g_config_cbs[2] = light_on_cb;
-  g_config_cbs[3] = light_off_cb;
+void growtower_ble_init(CommandCallback command_cb, BatchCallback batch_cb,
+                        bool initial_light_on,
+                        int initial_fan_speed, int initial_fan_min,
+                        int initial_fan_max, int initial_light_on_hour,
+                        int initial_light_off_hour) {
+
+  // Callback speichern
+  g_command_cb = command_cb;
+  g_batch_cb = batch_cb;
 
   // Initialwerte setzen
   g_values[CHAR_IDX_LIGHT] = initial_light_on ? 1 : 0;
@@ -348,34 +518,34 @@ void growtower_ble_init(LightCallback light_cb, FanCallback fan_cb,
   g_values[CHAR_IDX_LIGHT_ON] = (uint8_t)initial_light_on_hour;
   g_values[CHAR_IDX_LIGHT_OFF] = (uint8_t)initial_light_off_hour;
 
-  Serial.println("[BLE] Initializing ESP32 Bluetooth...");
+  ble_log(false, "Initializing ESP32 Bluetooth...");
 
   // Bluetooth Controller initialisieren
   esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
   esp_err_t ret = esp_bt_controller_init(&bt_cfg);
   if (ret != ESP_OK) {
-    Serial.printf("[BLE] Controller init failed: %d\n", ret);
+    ble_log(true, "Controller init failed: %d", ret);
     return;
   }
 
   // Bluetooth Controller aktivieren (BLE Mode)
   ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
   if (ret != ESP_OK) {
-    Serial.printf("[BLE] Controller enable failed: %d\n", ret);
+    ble_log(true, "Controller enable failed: %d", ret);
     return;
   }
 
   // Bluedroid Stack initialisieren
   ret = esp_bluedroid_init();
   if (ret != ESP_OK) {
-    Serial.printf("[BLE] Bluedroid init failed: %d\n", ret);
+    ble_log(true, "Bluedroid init failed: %d", ret);
     return;
   }
 
   // Bluedroid aktivieren
   ret = esp_bluedroid_enable();
   if (ret != ESP_OK) {
-    Serial.printf("[BLE] Bluedroid enable failed: %d\n", ret);
+    ble_log(true, "Bluedroid enable failed: %d", ret);
     return;
   }
 
@@ -391,61 +561,116 @@ void growtower_ble_init(LightCallback light_cb, FanCallback fan_cb,
   // GATT App registrieren (Profile ID 0)
   esp_ble_gatts_app_register(0);
 
+  // Larger MTU, so the packed status fits one notification
+  ret = esp_ble_gatt_set_local_mtu(LOCAL_MTU);
+  if (ret != ESP_OK) {
+    ble_log(true, "Setting local MTU failed: %d", ret);
+  }
+
   // TX Power auf Maximum setzen
   esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_DEFAULT, ESP_PWR_LVL_P9);
 
-  Serial.println("[BLE] Initialization complete");
+  ble_log(false, "Initialization complete");
 }
 
-// Update Funktionen
-void growtower_ble_update_light(bool on) {
-  g_values[CHAR_IDX_LIGHT] = on ? 1 : 0;
-  if (g_char_val_handles[CHAR_IDX_LIGHT] != 0) {
-    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_LIGHT], 1,
-                                 &g_values[CHAR_IDX_LIGHT]);
+// Update Funktionen: only stage the value, growtower_ble_notify_changes()
+// sends it
+static void stage_value(int idx, int value) {
+  uint8_t v = (uint8_t)value;
+  portENTER_CRITICAL(&g_values_mux);
+  bool changed = g_values[idx] != v;
+  if (changed) {
+    g_values[idx] = v;
+    g_dirty_mask |= (1 << idx);
+  }
+  portEXIT_CRITICAL(&g_values_mux);
+  if (changed && g_char_val_handles[idx] != 0) {
+    esp_ble_gatts_set_attr_value(g_char_val_handles[idx], 1, &v);
   }
 }
 
-void growtower_ble_update_fan(int speed) {
-  g_values[CHAR_IDX_FAN] = (uint8_t)speed;
-  if (g_char_val_handles[CHAR_IDX_FAN] != 0) {
-    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_FAN], 1,
-                                 &g_values[CHAR_IDX_FAN]);
-  }
+void growtower_ble_update_light(bool on) {
+  stage_value(CHAR_IDX_LIGHT, on ? 1 : 0);
 }
 
+void growtower_ble_update_fan(int speed) { stage_value(CHAR_IDX_FAN, speed); }
+
 void growtower_ble_update_fan_min(int min) {
-  g_values[CHAR_IDX_FAN_MIN] = (uint8_t)min;
-  if (g_char_val_handles[CHAR_IDX_FAN_MIN] != 0) {
-    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_FAN_MIN], 1,
-                                 &g_values[CHAR_IDX_FAN_MIN]);
-  }
+  stage_value(CHAR_IDX_FAN_MIN, min);
 }
 
 void growtower_ble_update_fan_max(int max_val) {
-  g_values[CHAR_IDX_FAN_MAX] = (uint8_t)max_val;
-  if (g_char_val_handles[CHAR_IDX_FAN_MAX] != 0) {
-    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_FAN_MAX], 1,
-                                 &g_values[CHAR_IDX_FAN_MAX]);
-  }
+  stage_value(CHAR_IDX_FAN_MAX, max_val);
 }
 
 void growtower_ble_update_light_on_hour(int hour) {
-  g_values[CHAR_IDX_LIGHT_ON] = (uint8_t)hour;
-  if (g_char_val_handles[CHAR_IDX_LIGHT_ON] != 0) {
-    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_LIGHT_ON], 1,
-                                 &g_values[CHAR_IDX_LIGHT_ON]);
-  }
+  stage_value(CHAR_IDX_LIGHT_ON, hour);
 }
 
 void growtower_ble_update_light_off_hour(int hour) {
-  g_values[CHAR_IDX_LIGHT_OFF] = (uint8_t)hour;
-  if (g_char_val_handles[CHAR_IDX_LIGHT_OFF] != 0) {
-    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_LIGHT_OFF], 1,
-                                 &g_values[CHAR_IDX_LIGHT_OFF]);
+  stage_value(CHAR_IDX_LIGHT_OFF, hour);
+}
+
+void growtower_ble_update_status(const uint8_t *data, size_t len) {
+  if (len > STATUS_MAX_LEN) {
+    len = STATUS_MAX_LEN;
+  }
+  // Only the control task writes g_status, so it can pass it to the stack
+  // outside the lock
+  if (len == g_status_len && memcmp(g_status, data, len) == 0) {
+    return;
+  }
+  portENTER_CRITICAL(&g_values_mux);
+  memcpy(g_status, data, len);
+  g_status_len = len;
+  g_dirty_mask |= (1 << CHAR_IDX_STATUS);
+  portEXIT_CRITICAL(&g_values_mux);
+  if (g_char_val_handles[CHAR_IDX_STATUS] != 0) {
+    esp_ble_gatts_set_attr_value(g_char_val_handles[CHAR_IDX_STATUS],
+                                 g_status_len, g_status);
   }
 }
 
+int growtower_ble_notify_changes(void) {
+  // Snapshot under the lock, send outside it
+  uint8_t values[CHAR_VALUE_COUNT];
+  portENTER_CRITICAL(&g_values_mux);
+  uint8_t pending = g_dirty_mask & g_notify_mask;
+  g_dirty_mask = 0;
+  memcpy(values, g_values, sizeof(values));
+  portEXIT_CRITICAL(&g_values_mux);
+  if (!g_connected) {
+    return 0;
+  }
+  int sent = 0;
+  for (int i = 0; i < CHAR_VALUE_COUNT; i++) {
+    if ((pending & (1 << i)) == 0) {
+      continue;
+    }
+    if (esp_ble_gatts_send_indicate(g_gatts_if, g_conn_id,
+                                    g_char_val_handles[i], 1, &values[i],
+                                    false) == ESP_OK) {
+      sent++;
+    }
+  }
+  if (pending & (1 << CHAR_IDX_STATUS)) {
+    // A notification carries at most MTU - 3 bytes. If the client did not
+    // negotiate enough, it gets the head and reads the rest.
+    uint16_t len = g_status_len;
+    if (len > g_mtu - 3) {
+      len = g_mtu - 3;
+    }
+    if (esp_ble_gatts_send_indicate(g_gatts_if, g_conn_id,
+                                    g_char_val_handles[CHAR_IDX_STATUS], len,
+                                    g_status, false) == ESP_OK) {
+      sent++;
+    }
+  }
+  return sent;
+}
+
+int growtower_ble_get_mtu(void) { return g_mtu; }
+
 // Status Funktionen
 bool growtower_ble_is_connected(void) { return g_connected; }
 
@@ -453,7 +678,7 @@ int growtower_ble_get_connected_count(void) { return g_connection_count; }
 
 void growtower_ble_restart_advertising(void) {
   if (!g_connected) {
-    Serial.println("[BLE] Restarting advertising...");
+    ble_log(false, "Restarting advertising...");
     esp_ble_gap_start_advertising(&adv_params);
   }
 }
\ No newline at end of file
@@ -3,19 +3,36 @@
 
 #include <Arduino.h>
 
-// Callback function types
-typedef void (*LightCallback)(bool on);
-typedef void (*FanCallback)(int percent);
-typedef void (*ConfigCallback)(int value);
+// Result of a write callback. The callbacks run in the Bluedroid task and
+// must not block; the write is answered with the matching ATT status.
+typedef enum {
+    GROWTOWER_BLE_OK,       // accepted
+    GROWTOWER_BLE_REJECTED, // invalid value: "out of range"
+    GROWTOWER_BLE_BUSY      // not taken now, the client may retry: "busy"
+} growtower_ble_result_t;
+
+// Called for every characteristic write with the command name the
+// characteristic maps to ("LIGHT", "FAN", "FANMIN", "FANMAX", "LIGHTON",
+// "LIGHTOFF") and the written byte.
+typedef growtower_ble_result_t (*CommandCallback)(const char *command,
+                                                  int value);
+
+// Called for every write to the command characteristic with its `count`
+// opcode/value byte pairs (opcodes are defined by the firmware). Anything
+// but GROWTOWER_BLE_OK rejects the whole batch.
+typedef growtower_ble_result_t (*BatchCallback)(const uint8_t *pairs,
+                                                int count);
+
+// Receives the library's own messages (setup, connections, MTU), most of
+// them from the Bluedroid task, so it must not block. `warning` is set for
+// failures. Set it before growtower_ble_init(); without it they are dropped.
+typedef void (*LogCallback)(bool warning, const char *message);
+void growtower_ble_set_log_callback(LogCallback log_cb);
 
 // Initialize BLE
 void growtower_ble_init(
-    LightCallback light_cb,
-    FanCallback fan_cb,
-    ConfigCallback fan_min_cb,
-    ConfigCallback fan_max_cb,
-    ConfigCallback light_on_cb,
-    ConfigCallback light_off_cb,
+    CommandCallback command_cb,
+    BatchCallback batch_cb,
     bool initial_light_on,
     int initial_fan_speed,
     int initial_fan_min,
@@ -24,7 +41,9 @@ void growtower_ble_init(
     int initial_light_off_hour
 );
 
-// Update characteristic values (for when hardware state changes)
+// Update characteristic values (for when hardware state changes). Reads
+// see the new value at once; subscribed clients only get it from the next
+// growtower_ble_notify_changes(), so changes in between are coalesced.
 void growtower_ble_update_light(bool on);
 void growtower_ble_update_fan(int speed);
 void growtower_ble_update_fan_min(int min);
@@ -32,10 +51,22 @@ void growtower_ble_update_fan_max(int max);
 void growtower_ble_update_light_on_hour(int hour);
 void growtower_ble_update_light_off_hour(int hour);
 
+// Packed status characteristic (firmware-defined layout, up to 64 bytes).
+// Staged and coalesced like the single values.
+void growtower_ble_update_status(const uint8_t *data, size_t len);
+
+// Notify the connected client of every characteristic that changed since
+// the last call and that it subscribed to (CCCD). Returns the number of
+// notifications sent.
+int growtower_ble_notify_changes(void);
+
 // Check connection status
 bool growtower_ble_is_connected(void);
 int growtower_ble_get_connected_count(void);
 
+// ATT MTU of the current connection (23 until the client negotiates)
+int growtower_ble_get_mtu(void);
+
 // Restart advertising (useful after disconnect)
 void growtower_ble_restart_advertising(void);
 
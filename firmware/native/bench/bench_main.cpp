@@ -0,0 +1,94 @@
+// Host microbenchmarks of the control logic, built by `pio run -e native`.
+//
+//   .pio/build/native/program [iterations]
+//
+// Times are host CPU times and only meaningful relative to each other (and
+// to earlier runs on the same machine); the ESP32-C3 at 160 MHz is roughly
+// 20-50x slower.
+//
+// `pio test -e native` builds this directory too (test_build_src); the unit
+// tests in test/ bring their own main() and include the modules themselves.
+
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "commands.h"
+#include "control.h"
+#include "diag.h"
+#include "hal_native.h"
+
+typedef void (*BenchFn)(long i);
+
+static void bench(const char *name, long iterations, BenchFn fn) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++)
+    fn(i);
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  logDrain();
+  printf("%-24s %10ld %12.1f ns/op\n", name, iterations, ns / iterations);
+}
+
+static void benchSetFan(long i) { setFan((int)(i % 101)); }
+
+static void benchCheckTimer(long i) {
+  halAdvanceMs(1000);
+  checkTimer();
+}
+
+static void benchValidateCommand(long i) {
+  validateCommand(CMD_SRC_HTTP, "fanmin", "42");
+}
+
+static void benchLogWrite(long i) { LOGI("BENCH", "iteration %ld", i); }
+
+static void benchPhaseJSON(long i) {
+  String json = getPhaseJSON();
+  if (json.length() == 0)
+    abort();
+}
+
+static void benchLogbookJSON(long i) {
+  String json = getLogbookJSON();
+  if (json.length() == 0)
+    abort();
+}
+
+static void benchLoadLogbook(long i) { loadLogbook(); }
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 100000;
+
+  halSerialQuiet(true);
+  halSetEpoch(1767225600); // 2026-01-01 00:00 UTC
+  initLogger();
+  loadSettings();
+  loadUsage();
+  initPWM();
+  applyTimezone();
+  setPhase(PHASE_VEG);
+  for (int i = 0; i < MAX_LOG_ENTRIES; i++)
+    addLogEntry("Watered 1.5 l, pH 6.2, EC 1.4 -- leaves look healthy");
+  persistFlush();
+  logDrain();
+
+  printf("%-24s %10s %15s\n", "benchmark", "iterations", "time");
+  bench("setFan", iterations, benchSetFan);
+  bench("checkTimer", iterations, benchCheckTimer);
+  bench("validateCommand", iterations, benchValidateCommand);
+  bench("LOGI", iterations, benchLogWrite);
+  bench("getPhaseJSON", iterations / 10, benchPhaseJSON);
+  bench("getLogbookJSON", iterations / 100, benchLogbookJSON);
+  bench("loadLogbook", iterations / 100, benchLoadLogbook);
+  printf("NVS: %lu commits, %lu puts, %lu writes\n",
+         (unsigned long)halNvs.commits, (unsigned long)halNvs.puts,
+         (unsigned long)halNvs.writes);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,24 @@
+// Host versions of the console functions that live in main.cpp on the
+// device, where they depend on WiFi. diag.h builds as is against the
+// FreeRTOS shims, with an empty task list.
+
+#include <Arduino.h>
+
+#include "state.h"
+
+void printLocalTime() {
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo, 0)) {
+    Serial.println("[TIME] Failed to get time from NTP");
+    return;
+  }
+  char timeString[50];
+  strftime(timeString, sizeof(timeString), "%A, %B %d %Y %H:%M:%S", &timeinfo);
+  Serial.printf("[TIME] Current: %s\n", timeString);
+}
+
+void printStatus() {
+  Serial.printf("[HOST] light=%d fan=%d%% range=%d-%d%% timer=%02d:00+%dh\n",
+                isLightOn ? 1 : 0, currentFanSpeed, fanMinPercent,
+                fanMaxPercent, lightOnHour, lightDuration);
+}
@@ -0,0 +1,114 @@
+// In-memory LittleFS for native/include/LittleFS.h.
+
+#include <LittleFS.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "hal_native.h"
+
+LittleFSFS LittleFS;
+
+static std::map<std::string, std::vector<uint8_t>> files;
+static std::set<std::string> dirs;
+
+bool LittleFSFS::exists(const char *path) {
+  return files.count(path) > 0 || dirs.count(path) > 0;
+}
+
+File LittleFSFS::open(const char *path, const char *mode) {
+  HalUntracked untracked;
+  if (dirs.count(path))
+    return File(path, "r", true);
+  if (mode[0] == 'r' && files.count(path) == 0)
+    return File();
+  files[path];
+  return File(path, mode, false);
+}
+
+bool LittleFSFS::remove(const char *path) {
+  HalUntracked untracked;
+  return files.erase(path) > 0;
+}
+
+bool LittleFSFS::mkdir(const char *path) {
+  HalUntracked untracked;
+  dirs.insert(path);
+  return true;
+}
+
+size_t LittleFSFS::usedBytes() {
+  size_t used = 0;
+  for (const std::pair<const std::string, std::vector<uint8_t>> &f : files)
+    used += (f.second.size() + 4095) / 4096 * 4096;
+  return used;
+}
+
+const char *File::name() const {
+  const char *slash = strrchr(path_.c_str(), '/');
+  return slash ? slash + 1 : path_.c_str();
+}
+
+size_t File::size() const {
+  std::map<std::string, std::vector<uint8_t>>::const_iterator it =
+      files.find(path_.c_str());
+  return it == files.end() ? 0 : it->second.size();
+}
+
+bool File::seek(uint32_t pos) {
+  if (!open_ || pos > size())
+    return false;
+  pos_ = pos;
+  return true;
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  if (!open_ || directory_)
+    return 0;
+  const std::vector<uint8_t> &data = files[path_.c_str()];
+  if (pos_ >= data.size())
+    return 0;
+  if (len > data.size() - pos_)
+    len = data.size() - pos_;
+  memcpy(buf, data.data() + pos_, len);
+  pos_ += len;
+  return len;
+}
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  if (!open_ || directory_)
+    return 0;
+  HalUntracked untracked;
+  len = halFlashWritable(len);
+  std::vector<uint8_t> &data = files[path_.c_str()];
+  if (append_)
+    pos_ = data.size();
+  if (pos_ + len > data.size())
+    data.resize(pos_ + len);
+  memcpy(data.data() + pos_, buf, len);
+  pos_ += len;
+  return len;
+}
+
+void File::truncate() {
+  HalUntracked untracked;
+  files[path_.c_str()].clear();
+}
+
+File File::openNextFile() {
+  if (!directory_)
+    return File();
+  std::string prefix = std::string(path_.c_str()) + "/";
+  size_t index = 0;
+  for (const std::pair<const std::string, std::vector<uint8_t>> &f : files) {
+    if (f.first.compare(0, prefix.size(), prefix) != 0 ||
+        f.first.find('/', prefix.size()) != std::string::npos)
+      continue;
+    if (index++ == next_) {
+      next_++;
+      return File(f.first.c_str(), "r", false);
+    }
+  }
+  return File();
+}
@@ -0,0 +1,393 @@
+// Native implementations of the Arduino/ESP-IDF calls declared in
+// native/include. Single-threaded, virtual time.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hal_native.h"
+
+// ---- clock -----------------------------------------------------------------
+
+static uint64_t clockMicros = 0;
+static uint64_t bootMicros = 0;  // clockMicros at the last halReboot()
+static int64_t epochAtZero = 0; // wall time (s) when clockMicros was 0
+static int64_t flashBudget = -1;  // bytes that still reach flash, -1: no limit
+
+void halAdvanceUs(uint64_t us) { clockMicros += us; }
+void halAdvanceMs(uint64_t ms) { clockMicros += ms * 1000; }
+uint64_t halMicros() { return clockMicros; }
+
+void halSetEpoch(time_t epoch) {
+  epochAtZero = (int64_t)epoch - (int64_t)(clockMicros / 1000000);
+}
+
+// Uptime restarts at 0. After a power loss the wall clock does too, like the
+// ESP32 RTC; a soft reset keeps it.
+void halReboot(bool powerLoss) {
+  bootMicros = clockMicros;
+  flashBudget = -1;
+  if (powerLoss)
+    halSetEpoch(0);
+}
+
+unsigned long millis() {
+  return (unsigned long)((clockMicros - bootMicros) / 1000);
+}
+unsigned long micros() { return (unsigned long)(clockMicros - bootMicros); }
+int64_t esp_timer_get_time() { return (int64_t)(clockMicros - bootMicros); }
+void delay(unsigned long ms) { halAdvanceMs(ms); }
+void yield() {}
+
+// These replace the libc versions for the whole program, so code that calls
+// time() or settimeofday() directly also sees the virtual clock.
+extern "C" time_t time(time_t *out) noexcept {
+  time_t now = (time_t)(epochAtZero + (int64_t)(clockMicros / 1000000));
+  if (out)
+    *out = now;
+  return now;
+}
+
+extern "C" int gettimeofday(struct timeval *tv, void *tz) noexcept {
+  tv->tv_sec = time(nullptr);
+  tv->tv_usec = clockMicros % 1000000;
+  return 0;
+}
+
+extern "C" int settimeofday(const struct timeval *tv,
+                            const struct timezone *tz) noexcept {
+  if (tv)
+    halSetEpoch(tv->tv_sec);
+  return 0;
+}
+
+// Same contract as the ESP32 core: retries for up to `ms` until the year is
+// past 2016, so a call without time costs `ms` of virtual time.
+bool getLocalTime(struct tm *info, uint32_t ms) {
+  uint32_t start = millis();
+  for (;;) {
+    time_t now = time(nullptr);
+    localtime_r(&now, info);
+    if (info->tm_year > (2016 - 1900))
+      return true;
+    if (millis() - start > ms)
+      return false;
+    delay(10);
+  }
+}
+
+void configTzTime(const char *tz, const char *server1, const char *server2,
+                  const char *server3) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+static sntp_sync_time_cb_t ntpCallback = nullptr;
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {
+  ntpCallback = callback;
+}
+
+void halNtpSync(time_t epoch) {
+  struct timeval tv;
+  tv.tv_sec = epoch;
+  tv.tv_usec = 0;
+  settimeofday(&tv, nullptr);
+  if (ntpCallback)
+    ntpCallback(&tv);
+}
+
+// ---- FreeRTOS --------------------------------------------------------------
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle) {
+  if (handle)
+    *handle = (TaskHandle_t)fn;
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { halAdvanceMs(ticks); }
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+
+// ---- GPIO / PWM ------------------------------------------------------------
+
+static uint8_t pinLevels[64];
+static uint32_t pinWrites[64];
+static uint32_t ledcDuty[16];
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin >= 64)
+    return;
+  pinLevels[pin] = level ? HIGH : LOW;
+  pinWrites[pin]++;
+}
+
+int digitalRead(uint8_t pin) { return pin < 64 ? pinLevels[pin] : LOW; }
+int halPinLevel(uint8_t pin) { return digitalRead(pin); }
+uint32_t halPinWrites(uint8_t pin) { return pin < 64 ? pinWrites[pin] : 0; }
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution) {
+  return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+  if (channel < 16)
+    ledcDuty[channel] = duty;
+}
+
+uint32_t halLedcDuty(uint8_t channel) {
+  return channel < 16 ? ledcDuty[channel] : 0;
+}
+
+// Arduino-ESP32 2.x semantics, including the integer rounding.
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  long run = inMax - inMin;
+  if (run == 0)
+    return -1;
+  return (x - inMin) * (outMax - outMin) / run + outMin;
+}
+
+uint32_t getCpuFrequencyMhz() { return 160; }
+
+uint32_t esp_random() {
+  static uint32_t state = 0x12345678;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// ---- Flash ---------------------------------------------------------------
+
+void halFlashPowerFail(size_t bytes) { flashBudget = (int64_t)bytes; }
+
+size_t halFlashWritable(size_t len) {
+  if (flashBudget < 0)
+    return len;
+  size_t n = len < (uint64_t)flashBudget ? len : (size_t)flashBudget;
+  flashBudget -= n;
+  return n;
+}
+
+// ---- Serial / ESP ----------------------------------------------------------
+
+HardwareSerial Serial;
+EspClass ESP;
+uint32_t halRestarts = 0;
+
+static bool serialQuiet = false;
+static std::string serialInput;
+
+void halSerialQuiet(bool quiet) { serialQuiet = quiet; }
+void halSerialInput(const char *text) { serialInput += text; }
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+  if (!serialQuiet)
+    fwrite(buf, 1, len, stdout);
+  return len;
+}
+
+int HardwareSerial::available() { return (int)serialInput.size(); }
+
+int HardwareSerial::read() {
+  if (serialInput.empty())
+    return -1;
+  int c = (uint8_t)serialInput[0];
+  serialInput.erase(0, 1);
+  return c;
+}
+
+void EspClass::restart() { halRestarts++; }
+
+uint32_t EspClass::getHeapSize() { return HAL_HEAP_SIZE; }
+uint32_t EspClass::getFreeHeap() {
+  return halHeap.current < HAL_HEAP_SIZE ? HAL_HEAP_SIZE - halHeap.current : 0;
+}
+uint32_t EspClass::getMinFreeHeap() {
+  return halHeap.highest < HAL_HEAP_SIZE ? HAL_HEAP_SIZE - halHeap.highest : 0;
+}
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+
+// ---- WiFi ------------------------------------------------------------------
+
+WiFiClass WiFi;
+static bool wifiConnected = true;
+
+void halWiFiConnected(bool connected) { wifiConnected = connected; }
+wl_status_t WiFiClass::status() {
+  return wifiConnected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+// ---- Preferences -----------------------------------------------------------
+
+typedef std::map<std::string, std::vector<uint8_t>> NvsNamespace;
+static std::map<std::string, NvsNamespace> nvs;
+static std::map<std::string, HalNvsKeyStats> nvsKeys;
+HalNvsStats halNvs;
+
+void halNvsErase() { nvs.clear(); }
+
+void halNvsForEachKey(void (*fn)(const char *key, const HalNvsKeyStats &stats)) {
+  for (const std::pair<const std::string, HalNvsKeyStats> &entry : nvsKeys)
+    fn(entry.first.c_str(), entry.second);
+}
+
+bool Preferences::begin(const char *name, bool readOnly) {
+  strncpy(name_, name, sizeof(name_) - 1);
+  open_ = true;
+  readOnly_ = readOnly;
+  dirty_ = false;
+  return true;
+}
+
+void Preferences::end() {
+  if (open_ && dirty_)
+    halNvs.commits++;
+  open_ = false;
+  dirty_ = false;
+}
+
+bool Preferences::clear() {
+  HalUntracked untracked;
+  if (!open_ || readOnly_)
+    return false;
+  nvs[name_].clear();
+  dirty_ = true;
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  HalUntracked untracked;
+  if (!open_ || readOnly_)
+    return false;
+  dirty_ = true;
+  return nvs[name_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+  HalUntracked untracked;
+  return open_ && nvs[name_].count(key) > 0;
+}
+
+size_t Preferences::put(const char *key, const void *value, size_t len) {
+  HalUntracked untracked;
+  if (!open_ || readOnly_ || halFlashWritable(len) < len)
+    return 0;
+  halNvs.puts++;
+  dirty_ = true;
+  HalNvsKeyStats &keyStats = nvsKeys[std::string(name_) + "/" + key];
+  keyStats.puts++;
+  std::vector<uint8_t> data((const uint8_t *)value,
+                            (const uint8_t *)value + len);
+  std::vector<uint8_t> &slot = nvs[name_][key];
+  if (slot != data) {
+    slot = data;
+    halNvs.writes++;
+    halNvs.bytes += len;
+    keyStats.writes++;
+    keyStats.bytes += len;
+  }
+  return len;
+}
+
+bool Preferences::get(const char *key, void *value, size_t len) {
+  HalUntracked untracked;
+  if (!open_)
+    return false;
+  NvsNamespace &ns = nvs[name_];
+  NvsNamespace::iterator it = ns.find(key);
+  if (it == ns.end() || it->second.size() != len)
+    return false;
+  memcpy(value, it->second.data(), len);
+  return true;
+}
+
+size_t Preferences::putInt(const char *key, int32_t value) {
+  return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putLong(const char *key, int32_t value) {
+  return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putBool(const char *key, bool value) {
+  uint8_t v = value ? 1 : 0;
+  return put(key, &v, 1);
+}
+
+size_t Preferences::putString(const char *key, const char *value) {
+  return put(key, value, strlen(value) + 1);
+}
+
+size_t Preferences::putString(const char *key, const String &value) {
+  return putString(key, value.c_str());
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  return put(key, value, len);
+}
+
+int32_t Preferences::getInt(const char *key, int32_t defaultValue) {
+  int32_t v;
+  return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+int32_t Preferences::getLong(const char *key, int32_t defaultValue) {
+  return getInt(key, defaultValue);
+}
+
+bool Preferences::getBool(const char *key, bool defaultValue) {
+  uint8_t v;
+  return get(key, &v, 1) ? v != 0 : defaultValue;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+  const char *value = nullptr;
+  {
+    HalUntracked untracked;
+    if (open_) {
+      NvsNamespace &ns = nvs[name_];
+      NvsNamespace::iterator it = ns.find(key);
+      if (it != ns.end() && !it->second.empty())
+        value = (const char *)it->second.data();
+    }
+  }
+  return value ? String(value) : defaultValue;
+}
+
+// Like the ESP32 library: 0 if the key is missing or the value (with its
+// terminator) does not fit.
+size_t Preferences::getString(const char *key, char *value, size_t maxLen) {
+  return getBytes(key, value, maxLen);
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  HalUntracked untracked;
+  if (!open_)
+    return 0;
+  NvsNamespace &ns = nvs[name_];
+  NvsNamespace::iterator it = ns.find(key);
+  return it == ns.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  HalUntracked untracked;
+  size_t len = getBytesLength(key);
+  if (len == 0 || len > maxLen)
+    return 0;
+  memcpy(buf, nvs[name_][key].data(), len);
+  return len;
+}
@@ -0,0 +1,70 @@
+// Counting replacements of the global operator new/delete for halHeap. In
+// their own translation unit so nothing else here is inlined against them.
+
+#include <stdlib.h>
+
+#include <new>
+
+#include "hal_native.h"
+
+HalHeapStats halHeap;
+static bool heapTracking = true;
+
+// Each block carries its size and whether it was counted.
+struct HeapHeader {
+  size_t size;
+  size_t tracked;
+};
+
+void halHeapResetPeak() { halHeap.peak = halHeap.current; }
+bool halHeapTrack(bool on) {
+  bool was = heapTracking;
+  heapTracking = on;
+  return was;
+}
+
+static void *heapAlloc(size_t size) {
+  HeapHeader *h = (HeapHeader *)malloc(sizeof(HeapHeader) + size);
+  if (h == nullptr)
+    return nullptr;
+  h->size = size;
+  h->tracked = heapTracking;
+  if (heapTracking) {
+    halHeap.allocs++;
+    halHeap.current += size;
+    if (halHeap.current > halHeap.peak)
+      halHeap.peak = halHeap.current;
+    if (halHeap.current > halHeap.highest)
+      halHeap.highest = halHeap.current;
+  }
+  return h + 1;
+}
+
+static void heapFree(void *p) {
+  if (p == nullptr)
+    return;
+  HeapHeader *h = (HeapHeader *)p - 1;
+  if (h->tracked) {
+    halHeap.frees++;
+    halHeap.current -= h->size;
+  }
+  free(h);
+}
+
+void *operator new(size_t size) {
+  void *p = heapAlloc(size);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return heapAlloc(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return heapAlloc(size);
+}
+void operator delete(void *p) noexcept { heapFree(p); }
+void operator delete[](void *p) noexcept { heapFree(p); }
+void operator delete(void *p, size_t) noexcept { heapFree(p); }
+void operator delete[](void *p, size_t) noexcept { heapFree(p); }
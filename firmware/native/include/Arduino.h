@@ -0,0 +1,264 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino-ESP32 core the control logic
+// uses. Time, pins and PWM are simulated in native/hal/hal.cpp and can be
+// inspected and driven through hal_native.h.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define PROGMEM
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+// XIAO ESP32C3 pin numbers
+#define D0 2
+#define D1 3
+#define D2 4
+#define D3 5
+#define D10 10
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Arduino String on top of std::string. Only the members the firmware uses.
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned int v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(long long v) : s_(std::to_string(v)) {}
+  String(unsigned long long v) : s_(std::to_string(v)) {}
+  String(float v, unsigned int decimals = 2) { setFloat(v, decimals); }
+  String(double v, unsigned int decimals = 2) { setFloat(v, decimals); }
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned int length() const { return s_.size(); }
+  bool reserve(unsigned int size) {
+    s_.reserve(size);
+    return true;
+  }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char &operator[](unsigned int i) { return s_[i]; }
+
+  String &operator+=(const String &o) {
+    s_ += o.s_;
+    return *this;
+  }
+  String &operator+=(const char *o) {
+    s_ += o;
+    return *this;
+  }
+  String &operator+=(char c) {
+    s_ += c;
+    return *this;
+  }
+  bool concat(const char *s, unsigned int len) {
+    s_.append(s, len);
+    return true;
+  }
+
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char *o) const { return s_ == o; }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator!=(const char *o) const { return s_ != o; }
+  bool operator<(const String &o) const { return s_ < o.s_; }
+  bool equalsIgnoreCase(const String &o) const {
+    return strcasecmp(s_.c_str(), o.s_.c_str()) == 0;
+  }
+  bool startsWith(const String &o) const { return s_.rfind(o.s_, 0) == 0; }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t p = s_.find(c, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int indexOf(const String &o, unsigned int from = 0) const {
+    size_t p = s_.find(o.s_, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  String substring(unsigned int from) const {
+    return from >= s_.size() ? String() : String(s_.substr(from));
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to)
+      std::swap(from, to);
+    return from >= s_.size() ? String() : String(s_.substr(from, to - from));
+  }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos) {
+      s_.clear();
+      return;
+    }
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = s_.substr(a, b - a + 1);
+  }
+  void toLowerCase() {
+    for (size_t i = 0; i < s_.size(); i++)
+      s_[i] = tolower((unsigned char)s_[i]);
+  }
+  void toUpperCase() {
+    for (size_t i = 0; i < s_.size(); i++)
+      s_[i] = toupper((unsigned char)s_[i]);
+  }
+  void replace(const String &from, const String &to) {
+    if (from.s_.empty())
+      return;
+    size_t p = 0;
+    while ((p = s_.find(from.s_, p)) != std::string::npos) {
+      s_.replace(p, from.s_.size(), to.s_);
+      p += to.s_.size();
+    }
+  }
+  long toInt() const { return atol(s_.c_str()); }
+  float toFloat() const { return atof(s_.c_str()); }
+
+  friend String operator+(const String &a, const String &b) {
+    return String(a.s_ + b.s_);
+  }
+  friend String operator+(const String &a, const char *b) {
+    return String(a.s_ + b);
+  }
+  friend String operator+(const char *a, const String &b) {
+    return String(a + b.s_);
+  }
+
+private:
+  void setFloat(double v, unsigned int decimals) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    s_ = buf;
+  }
+
+  std::string s_;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len--)
+      n += write(*buf++);
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+
+  // As on the ESP32 core: a 64-byte stack buffer, the heap for longer
+  // output.
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char local[64];
+    char *buf = local;
+    va_list args;
+    va_start(args, fmt);
+    va_list copy;
+    va_copy(copy, args);
+    int n = vsnprintf(local, sizeof(local), fmt, copy);
+    va_end(copy);
+    if (n < 0) {
+      va_end(args);
+      return 0;
+    }
+    if ((size_t)n >= sizeof(local)) {
+      buf = new char[n + 1];
+      vsnprintf(buf, n + 1, fmt, args);
+    }
+    va_end(args);
+    size_t written = write((const uint8_t *)buf, n);
+    if (buf != local)
+      delete[] buf;
+    return written;
+  }
+};
+
+// Writes to stdout (unless muted with halSerialQuiet) and reads from the
+// buffer filled by halSerialInput.
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t len) override;
+  using Print::write;
+  int available();
+  int read();
+  void flush() {}
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  void restart();
+  // Derived from the tracked operator new/delete (hal_native.h, halHeap).
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getHeapSize();
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+void configTzTime(const char *tz, const char *server1,
+                  const char *server2 = nullptr,
+                  const char *server3 = nullptr);
+
+uint32_t esp_random();
+uint32_t getCpuFrequencyMhz(); // always 160
+
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef NATIVE_ESPASYNCWEBSERVER_H
+#define NATIVE_ESPASYNCWEBSERVER_H
+
+// Host stand-in for ESPAsyncWebServer. Requests are built by the host
+// program and dispatched synchronously with AsyncWebServer::handle(); the
+// response is captured in the request instead of going to a socket.
+// Chunked fillers run until they finish or return RESPONSE_TRY_AGAIN; a
+// request left pending that way (e.g. a held long-poll) continues with
+// poll(), like AsyncTCP's poll callback. The captured body is host
+// bookkeeping and not counted in halHeap.
+
+#include <Arduino.h>
+
+#include <functional>
+
+#include "hal_native.h"
+#include <vector>
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+typedef std::function<size_t(uint8_t *, size_t, size_t)> AwsResponseFiller;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value, bool post)
+      : name_(name), value_(value), post_(post) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+  bool isPost() const { return post_; }
+
+private:
+  String name_;
+  String value_;
+  bool post_;
+};
+
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String &name, const String &value)
+      : name_(name), value_(value) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+
+private:
+  String name_;
+  String value_;
+};
+
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String &contentType,
+                         const String &body)
+      : code(code), contentType(contentType), body(body) {}
+  AsyncWebServerResponse(const String &contentType, AwsResponseFiller filler)
+      : code(200), contentType(contentType), filler(filler) {}
+
+  void addHeader(const String &name, const String &value) {
+    headers.push_back(AsyncWebHeader(name, value));
+  }
+
+  int code;
+  String contentType;
+  String body;
+  std::vector<AsyncWebHeader> headers;
+  AwsResponseFiller filler;
+};
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const String &url)
+      : method_(method), url_(url) {}
+  ~AsyncWebServerRequest() {
+    if (disconnect_)
+      disconnect_();
+    delete response_;
+  }
+
+  // Host side: build the request.
+  void addParam(const String &name, const String &value, bool post = false) {
+    params_.push_back(AsyncWebParameter(name, value, post));
+  }
+  void addHeader(const String &name, const String &value) {
+    headers_.push_back(AsyncWebHeader(name, value));
+  }
+
+  WebRequestMethodComposite method() const { return method_; }
+  const String &url() const { return url_; }
+
+  bool hasParam(const String &name, bool post = false,
+                bool file = false) const {
+    return getParam(name, post, file) != nullptr;
+  }
+  AsyncWebParameter *getParam(const String &name, bool post = false,
+                              bool file = false) const {
+    for (const AsyncWebParameter &p : params_) {
+      if (p.name() == name && p.isPost() == post)
+        return const_cast<AsyncWebParameter *>(&p);
+    }
+    return nullptr;
+  }
+  bool hasHeader(const String &name) const { return getHeader(name) != nullptr; }
+  AsyncWebHeader *getHeader(const String &name) const {
+    for (const AsyncWebHeader &h : headers_) {
+      if (h.name().equalsIgnoreCase(name))
+        return const_cast<AsyncWebHeader *>(&h);
+    }
+    return nullptr;
+  }
+
+  AsyncWebServerResponse *beginResponse(int code,
+                                        const String &contentType = String(),
+                                        const String &body = String()) {
+    return new AsyncWebServerResponse(code, contentType, body);
+  }
+  AsyncWebServerResponse *beginChunkedResponse(const String &contentType,
+                                               AwsResponseFiller filler) {
+    return new AsyncWebServerResponse(contentType, filler);
+  }
+  AsyncWebServerResponse *beginResponse(const String &contentType, size_t len,
+                                        AwsResponseFiller filler) {
+    return new AsyncWebServerResponse(contentType, filler);
+  }
+  void send(int code, const String &contentType = String(),
+            const String &body = String()) {
+    send(beginResponse(code, contentType, body));
+  }
+  void send_P(int code, const String &contentType, const char *body) {
+    send(code, contentType, String(body));
+  }
+  void send(AsyncWebServerResponse *response);
+
+  void onDisconnect(std::function<void()> fn) { disconnect_ = fn; }
+
+  // Host side: the captured response, or null if the handler has not sent
+  // one. pending() is true while a chunked filler waits; poll() retries it
+  // and returns true once the response is complete.
+  AsyncWebServerResponse *response() const { return response_; }
+  bool pending() const { return response_ && response_->filler; }
+  bool poll();
+
+  void *_tempObject = nullptr;
+
+private:
+  WebRequestMethodComposite method_;
+  String url_;
+  std::vector<AsyncWebParameter> params_;
+  std::vector<AsyncWebHeader> headers_;
+  AsyncWebServerResponse *response_ = nullptr;
+  std::function<void()> disconnect_;
+};
+
+inline void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+  delete response_;
+  response_ = response;
+  poll();
+}
+
+// Feeds the filler TCP-sized buffers until it is done or asks to wait.
+inline bool AsyncWebServerRequest::poll() {
+  AsyncWebServerResponse *response = response_;
+  if (response == nullptr || !response->filler)
+    return response != nullptr;
+  uint8_t buf[1436];
+  for (;;) {
+    size_t len = response->filler(buf, sizeof(buf), response->body.length());
+    if (len == RESPONSE_TRY_AGAIN)
+      return false;
+    if (len == 0)
+      break;
+    bool was = halHeapTrack(false);
+    response->body.concat((const char *)buf, len);
+    halHeapTrack(was);
+  }
+  response->filler = nullptr;
+  return true;
+}
+
+typedef std::function<void(AsyncWebServerRequest *)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, const String &, size_t,
+                           uint8_t *, size_t, bool)>
+    ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, uint8_t *, size_t, size_t,
+                           size_t)>
+    ArBodyHandlerFunction;
+
+class AsyncCallbackWebHandler {
+public:
+  String uri;
+  WebRequestMethodComposite method;
+  ArRequestHandlerFunction onRequest;
+};
+
+class AsyncWebServer {
+public:
+  AsyncWebServer(uint16_t port) {}
+  void begin() {}
+
+  AsyncCallbackWebHandler &on(const char *uri,
+                              WebRequestMethodComposite method,
+                              ArRequestHandlerFunction onRequest) {
+    AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler();
+    handler->uri = uri;
+    handler->method = method;
+    handler->onRequest = onRequest;
+    handlers_.push_back(handler);
+    return *handler;
+  }
+  AsyncCallbackWebHandler &on(const char *uri,
+                              WebRequestMethodComposite method,
+                              ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload,
+                              ArBodyHandlerFunction onBody = nullptr) {
+    return on(uri, method, onRequest);
+  }
+  void onNotFound(ArRequestHandlerFunction fn) { notFound_ = fn; }
+
+  // Host side: dispatches by exact path and method like the library does.
+  void handle(AsyncWebServerRequest *request) {
+    for (AsyncCallbackWebHandler *h : handlers_) {
+      if ((h->method & request->method()) && h->uri == request->url()) {
+        h->onRequest(request);
+        return;
+      }
+    }
+    if (notFound_)
+      notFound_(request);
+    else
+      request->send(404);
+  }
+
+private:
+  std::vector<AsyncCallbackWebHandler *> handlers_;
+  ArRequestHandlerFunction notFound_;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+// In-memory LittleFS: flat files keyed by path, directories only as
+// prefixes. Enough for telemetry.h; file contents are host bookkeeping and
+// not counted as device heap.
+
+#include <Arduino.h>
+
+#include <vector>
+
+class File {
+public:
+  File() {}
+  File(const String &path, const char *mode, bool directory)
+      : path_(path), open_(true), directory_(directory) {
+    append_ = mode[0] == 'a';
+    if (mode[0] == 'w')
+      truncate();
+  }
+
+  explicit operator bool() const { return open_; }
+  bool isDirectory() const { return directory_; }
+  const char *name() const;
+  size_t size() const;
+  bool seek(uint32_t pos);
+  size_t read(uint8_t *buf, size_t len);
+  size_t write(const uint8_t *buf, size_t len);
+  File openNextFile();
+  void close() { open_ = false; }
+
+private:
+  void truncate();
+
+  String path_;
+  bool open_ = false;
+  bool directory_ = false;
+  bool append_ = false;
+  size_t pos_ = 0;
+  size_t next_ = 0; // directory iteration
+};
+
+class LittleFSFS {
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  File open(const char *path, const char *mode = "r");
+  File open(const String &path, const char *mode = "r") {
+    return open(path.c_str(), mode);
+  }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+  size_t totalBytes() { return 1408 * 1024; }
+  size_t usedBytes();
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <Arduino.h>
+
+// In-memory NVS. Namespaces survive end()/begin() like on the device, and
+// every put and commit is counted in halNvs (hal_native.h). As in ESP-IDF,
+// a put that stores the value already present does not touch flash.
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false);
+  void end();
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putInt(const char *key, int32_t value);
+  size_t putLong(const char *key, int32_t value);
+  size_t putBool(const char *key, bool value);
+  size_t putString(const char *key, const char *value);
+  size_t putString(const char *key, const String &value);
+  size_t putBytes(const char *key, const void *value, size_t len);
+
+  int32_t getInt(const char *key, int32_t defaultValue = 0);
+  int32_t getLong(const char *key, int32_t defaultValue = 0);
+  bool getBool(const char *key, bool defaultValue = false);
+  String getString(const char *key, const String &defaultValue = String());
+  size_t getString(const char *key, char *value, size_t maxLen);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  size_t put(const char *key, const void *value, size_t len);
+  bool get(const char *key, void *value, size_t len);
+
+  char name_[16] = "";
+  bool open_ = false;
+  bool readOnly_ = true;
+  bool dirty_ = false;
+};
+
+#endif
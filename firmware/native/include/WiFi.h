@@ -0,0 +1,49 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// Always "connected" with a fixed address unless halWiFiConnected(false).
+
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0)
+      : bytes_{a, b, c, d} {}
+  uint8_t operator[](int i) const { return bytes_[i]; }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes_[0], bytes_[1], bytes_[2],
+             bytes_[3]);
+    return String(buf);
+  }
+
+private:
+  uint8_t bytes_[4];
+};
+
+class WiFiClass {
+public:
+  wl_status_t status();
+  bool mode(wifi_mode_t mode) { return true; }
+  wl_status_t begin(const char *ssid, const char *pass = nullptr) {
+    return status();
+  }
+  bool softAP(const char *ssid, const char *pass = nullptr) { return true; }
+  IPAddress localIP() { return IPAddress(192, 168, 1, 50); }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  int8_t RSSI() { return -61; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef NATIVE_ESP_ATTR_H
+#define NATIVE_ESP_ATTR_H
+
+// Placement attributes have no meaning on the host; RTC_NOINIT variables
+// survive a simulated reboot simply because the process keeps running.
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#ifndef RTC_NOINIT_ATTR
+#define RTC_NOINIT_ATTR
+#endif
+#ifndef RTC_DATA_ATTR
+#define RTC_DATA_ATTR
+#endif
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef NATIVE_ESP_SNTP_H
+#define NATIVE_ESP_SNTP_H
+
+// Only the sync notification is modelled; halNtpSync() fires it.
+
+#include <sys/time.h>
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+
+#endif
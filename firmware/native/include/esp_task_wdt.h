@@ -0,0 +1,14 @@
+#ifndef NATIVE_ESP_TASK_WDT_H
+#define NATIVE_ESP_TASK_WDT_H
+
+#include <stdint.h>
+
+// Tasks never run on the host, so there is nothing to watch.
+
+typedef int esp_err_t;
+
+inline esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic) { return 0; }
+inline esp_err_t esp_task_wdt_add(void *task) { return 0; }
+inline esp_err_t esp_task_wdt_reset() { return 0; }
+
+#endif
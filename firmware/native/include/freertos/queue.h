@@ -0,0 +1,23 @@
+#ifndef NATIVE_FREERTOS_QUEUE_H
+#define NATIVE_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+// Queues connect tasks, and tasks never run on the host, so nothing is ever
+// queued: host programs call the work functions directly.
+
+typedef void *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return nullptr;
+}
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                             TickType_t ticks) {
+  return pdFALSE;
+}
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item,
+                                TickType_t ticks) {
+  return pdFALSE;
+}
+
+#endif
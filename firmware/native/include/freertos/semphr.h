@@ -0,0 +1,28 @@
+#ifndef NATIVE_FREERTOS_SEMPHR_H
+#define NATIVE_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+// Single-threaded host: a mutex is a token that is always free.
+
+typedef void *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  static int token;
+  return &token;
+}
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  return pdTRUE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { return pdTRUE; }
+
+typedef struct {
+  int unused;
+} StaticSemaphore_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf) {
+  return buf;
+}
+inline void vSemaphoreDelete(SemaphoreHandle_t sem) {}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef NATIVE_FREERTOS_TASK_H
+#define NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+
+typedef struct {
+  TaskHandle_t xHandle;
+  const char *pcTaskName;
+  UBaseType_t xTaskNumber;
+  eTaskState eCurrentState;
+  UBaseType_t uxCurrentPriority;
+  UBaseType_t uxBasePriority;
+  uint32_t ulRunTimeCounter;
+  uint16_t usStackHighWaterMark;
+} TaskStatus_t;
+
+// Records the task but never runs it; host programs call the task's work
+// function (e.g. logDrain()) themselves.
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle);
+
+// Advances the virtual clock.
+void vTaskDelay(TickType_t ticks);
+
+TickType_t xTaskGetTickCount();
+
+// The host program's thread; never equal to a created task.
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+// Created tasks never run, so their stacks stay untouched.
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 0xFFFF;
+}
+inline const char *pcTaskGetName(TaskHandle_t task) { return "task"; }
+
+#endif
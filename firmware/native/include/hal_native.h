@@ -0,0 +1,90 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+// Controls and probes of the native shims, for host programs. Nothing here
+// exists on the device.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Virtual clock. millis(), micros(), esp_timer_get_time() and time() all
+// derive from it; it only moves when advanced here or by delay() /
+// vTaskDelay(). Wall time is unset (time() counts from 0 like an unsynced
+// ESP32) until halSetEpoch() or settimeofday().
+void halAdvanceMs(uint64_t ms);
+void halAdvanceUs(uint64_t us);
+uint64_t halMicros();
+void halSetEpoch(time_t epoch);
+
+// Simulated reset: millis()/micros() restart at 0, and with powerLoss the
+// wall clock too. RAM state is the host program's business.
+void halReboot(bool powerLoss);
+
+// Power failing during a flash write: only `bytes` more bytes reach flash
+// until the next halReboot(). A Preferences put that does not fit is lost
+// whole (NVS never marks a torn entry valid); a LittleFS write is cut short.
+void halFlashPowerFail(size_t bytes);
+size_t halFlashWritable(size_t len); // for the shims: how much of a write lands
+
+// Sets the wall clock and runs the SNTP sync callback, like an NTP reply.
+void halNtpSync(time_t epoch);
+
+// Pins and PWM
+int halPinLevel(uint8_t pin);
+uint32_t halPinWrites(uint8_t pin);
+uint32_t halLedcDuty(uint8_t channel);
+
+// NVS accounting (Preferences shim)
+struct HalNvsStats {
+  uint32_t commits; // end() of a read-write session with at least one put
+  uint32_t puts;    // put* calls
+  uint32_t writes;  // puts that changed the stored value
+  uint64_t bytes;   // bytes of changed values
+};
+extern HalNvsStats halNvs;
+void halNvsErase();
+
+// The same per "namespace/key", in key order.
+struct HalNvsKeyStats {
+  uint32_t puts;
+  uint32_t writes;
+  uint64_t bytes;
+};
+void halNvsForEachKey(void (*fn)(const char *key, const HalNvsKeyStats &stats));
+
+// Heap: every operator new/delete in the program is counted. ESP.getFreeHeap()
+// reports HAL_HEAP_SIZE minus the tracked bytes, so heap deltas measured by
+// the firmware (routestats.h) work as on the device. Allocations made while
+// tracking is off (host-side bookkeeping) are left out.
+#define HAL_HEAP_SIZE 200000
+struct HalHeapStats {
+  uint64_t allocs;
+  uint64_t frees;
+  size_t current; // bytes
+  size_t peak;    // since the last halHeapResetPeak()
+  size_t highest; // since start, for ESP.getMinFreeHeap()
+};
+extern HalHeapStats halHeap;
+void halHeapResetPeak();
+bool halHeapTrack(bool on); // returns the previous setting
+
+// Tracking off for a scope: shim containers are host bookkeeping, not
+// device heap.
+struct HalUntracked {
+  HalUntracked() : was(halHeapTrack(false)) {}
+  ~HalUntracked() { halHeapTrack(was); }
+  bool was;
+};
+
+// WiFi.status() (default WL_CONNECTED)
+void halWiFiConnected(bool connected);
+
+// Serial: mute stdout, queue console input for Serial.read().
+void halSerialQuiet(bool quiet);
+void halSerialInput(const char *text);
+
+// ESP.restart() calls, which return on the host.
+extern uint32_t halRestarts;
+
+#endif
@@ -0,0 +1,426 @@
+// HTTP load harness, built by `pio run -e native_loadtest`.
+//
+//   .pio/build/native_loadtest/program [--mix=all|dashboard|poller|script]
+//       [--duration=600] [--dashboards=3] [--seed=1]
+//
+// Serves the real initWebServer() routes from the ESPAsyncWebServer stand-in
+// and replays a deterministic mix of clients on the virtual clock:
+//
+//   dashboard  the web UI: /api/status every 2 s with If-None-Match,
+//              /api/logbook every 30 s; plus one client long-polling
+//              /api/status?since=
+//   poller     Home Assistant: /api/status every 10 s, /metrics every 30 s
+//   script     /api/fan every 5 s, /api/command every 15 s, /api/light
+//              every 60 s, POST /api/config every 2 min, POST
+//              /api/logbook/add every 5 min
+//
+// The control and persistence task cycles (controlTick(), persistTaskTick()
+// from tasks.h) run every CONTROL_INTERVAL in between, and held requests are
+// polled then. The request
+// sequence is the same on every run; times are host CPU times, so compare
+// runs on the same machine (the ESP32-C3 is roughly 20-50x slower).
+//
+// Per route: request count, status classes, throughput (requests per
+// second of handler time), p50/p99/max service time, peak heap above the
+// pre-request level and response size.
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include "commands.h"
+#include "control.h"
+#include "hal_native.h"
+#include "history.h"
+#include "logbook.h"
+#include "power.h"
+#include "status.h"
+#include "tasks.h"
+#include "timecache.h"
+#include "webserver.h"
+
+AsyncWebServer server(80);
+bool isAPMode = false;
+
+struct LoadOptions {
+  const char *mix = "all";
+  unsigned long durationS = 600;
+  int dashboards = 3;
+  uint32_t seed = 1;
+};
+
+struct RouteResult {
+  std::vector<uint32_t> serviceUs;
+  std::vector<uint32_t> peakHeap;
+  uint64_t responseBytes = 0;
+  uint32_t ok = 0;
+  uint32_t notModified = 0;
+  uint32_t clientError = 0;
+  uint32_t other = 0;
+};
+
+// One in-flight request with its accumulated service time and heap peak.
+struct InFlight {
+  AsyncWebServerRequest *request;
+  String route;
+  size_t heapBase;
+  uint32_t peak;
+  double serviceUs;
+  struct Flow *flow;
+};
+
+typedef AsyncWebServerRequest *(*RequestBuilder)(struct Flow &flow);
+
+struct Flow {
+  const char *mix;
+  unsigned long periodMs;   // 0: re-issue as soon as the last one completes
+  RequestBuilder build;
+  uint64_t nextAt;          // virtual ms; UINT64_MAX while waiting
+  String etag;              // last ETag seen, for If-None-Match
+  uint32_t counter;
+};
+
+static LoadOptions opt;
+static std::map<String, RouteResult> results;
+static std::vector<InFlight> pending;
+static uint32_t rng = 1;
+
+static uint32_t nextRandom() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static uint64_t nowMs() { return halMicros() / 1000; }
+
+static AsyncWebServerRequest *getRequest(const char *url) {
+  return new AsyncWebServerRequest(HTTP_GET, url);
+}
+
+static AsyncWebServerRequest *postRequest(const char *url) {
+  return new AsyncWebServerRequest(HTTP_POST, url);
+}
+
+static AsyncWebServerRequest *buildDashboardStatus(Flow &flow) {
+  AsyncWebServerRequest *request = getRequest("/api/status");
+  if (flow.etag.length() > 0)
+    request->addHeader("If-None-Match", flow.etag);
+  return request;
+}
+
+static AsyncWebServerRequest *buildLogbook(Flow &flow) {
+  return getRequest("/api/logbook");
+}
+
+static AsyncWebServerRequest *buildLongPoll(Flow &flow) {
+  AsyncWebServerRequest *request = getRequest("/api/status");
+  request->addParam("since", String((unsigned long)stateVersion));
+  return request;
+}
+
+static AsyncWebServerRequest *buildStatus(Flow &flow) {
+  return getRequest("/api/status");
+}
+
+static AsyncWebServerRequest *buildMetrics(Flow &flow) {
+  return getRequest("/metrics");
+}
+
+static AsyncWebServerRequest *buildFan(Flow &flow) {
+  AsyncWebServerRequest *request = getRequest("/api/fan");
+  request->addParam("speed", String((int)(nextRandom() % 101)));
+  return request;
+}
+
+static AsyncWebServerRequest *buildCommand(Flow &flow) {
+  AsyncWebServerRequest *request = getRequest("/api/command");
+  request->addParam("name", "FANMIN");
+  request->addParam("value", String((int)(nextRandom() % 30)));
+  return request;
+}
+
+static AsyncWebServerRequest *buildLight(Flow &flow) {
+  AsyncWebServerRequest *request = getRequest("/api/light");
+  request->addParam("state", String((int)(flow.counter % 2)));
+  return request;
+}
+
+static AsyncWebServerRequest *buildConfig(Flow &flow) {
+  AsyncWebServerRequest *request = postRequest("/api/config");
+  request->addParam("fanMin", String((int)(nextRandom() % 30)), true);
+  request->addParam("fanMax", String(70 + (int)(nextRandom() % 31)), true);
+  request->addParam("lightOn", "6", true);
+  request->addParam("lightDuration", "18", true);
+  return request;
+}
+
+static AsyncWebServerRequest *buildLogbookAdd(Flow &flow) {
+  AsyncWebServerRequest *request = postRequest("/api/logbook/add");
+  request->addParam("text",
+                    "Watered 1.5 l, pH 6.1, EC 1.3 (entry " +
+                        String((unsigned long)flow.counter) + ")",
+                    true);
+  return request;
+}
+
+static String routeKey(AsyncWebServerRequest *request) {
+  String key = request->method() == HTTP_POST ? "POST " : "GET ";
+  key += request->url();
+  if (request->hasParam("since"))
+    key += "?since";
+  return key;
+}
+
+static void finish(InFlight &f) {
+  bool was = halHeapTrack(false);
+  RouteResult &r = results[f.route];
+  AsyncWebServerResponse *response = f.request->response();
+  int code = response ? response->code : 0;
+  if (code >= 200 && code < 300)
+    r.ok++;
+  else if (code == 304)
+    r.notModified++;
+  else if (code >= 400 && code < 500)
+    r.clientError++;
+  else
+    r.other++;
+  r.serviceUs.push_back((uint32_t)f.serviceUs);
+  r.peakHeap.push_back(f.peak);
+  if (response) {
+    r.responseBytes += response->body.length();
+    for (const AsyncWebHeader &h : response->headers) {
+      if (h.name() == "ETag")
+        f.flow->etag = h.value();
+    }
+  }
+  halHeapTrack(was);
+
+  delete f.request;
+  if (f.flow->periodMs == 0)
+    f.flow->nextAt = nowMs();
+}
+
+// Runs `step` (dispatch or poll) under measurement. Returns true if the
+// request completed.
+template <typename Step> static bool measure(InFlight &f, Step step) {
+  size_t base = halHeap.current;
+  halHeapResetPeak();
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  bool done = step();
+  f.serviceUs += std::chrono::duration<double, std::micro>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  uint32_t peak = (uint32_t)(halHeap.peak - f.heapBase);
+  if (base < f.heapBase)
+    peak = (uint32_t)(halHeap.peak - base);
+  if (peak > f.peak)
+    f.peak = peak;
+  return done;
+}
+
+static void issue(Flow &flow) {
+  flow.counter++;
+  AsyncWebServerRequest *request = flow.build(flow);
+  InFlight f = {request, String(), 0, 0, 0.0, &flow};
+  bool was = halHeapTrack(false);
+  f.route = routeKey(request);
+  halHeapTrack(was);
+  f.heapBase = halHeap.current;
+
+  bool done = measure(f, [&]() {
+    server.handle(request);
+    return !request->pending();
+  });
+  if (done) {
+    finish(f);
+  } else {
+    flow.nextAt = UINT64_MAX;
+    pending.push_back(f);
+  }
+}
+
+static void pollPending() {
+  for (size_t i = 0; i < pending.size();) {
+    InFlight &f = pending[i];
+    if (measure(f, [&]() { return f.request->poll(); })) {
+      finish(f);
+      pending.erase(pending.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+// No network on the host; netTaskMain() in tasks.h is never started.
+void networkTick() {}
+
+// One cycle of the control and persistence tasks, from tasks.h.
+static void tick() {
+  controlTick();
+  persistTaskTick();
+  powerTick(0);
+  logDrain();
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, int percent) {
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  size_t rank = (v.size() * percent + 99) / 100;
+  return v[rank > 0 ? rank - 1 : 0];
+}
+
+static void parseArgs(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    if (strncmp(a, "--mix=", 6) == 0) {
+      opt.mix = a + 6;
+      continue;
+    }
+    if (sscanf(a, "--duration=%lu", &opt.durationS) == 1 ||
+        sscanf(a, "--dashboards=%d", &opt.dashboards) == 1 ||
+        sscanf(a, "--seed=%u", &opt.seed) == 1)
+      continue;
+    printf("unknown option %s\n", a);
+    exit(2);
+  }
+}
+
+int main(int argc, char **argv) {
+  parseArgs(argc, argv);
+  rng = opt.seed ? opt.seed : 1;
+
+  halSerialQuiet(true);
+  halSetEpoch(1777629600); // 2026-05-01 10:00 UTC
+  initLogger();
+  loadSettings();
+  loadUsage();
+  pinMode(LIGHT_PIN, OUTPUT);
+  initPWM();
+  setFan(currentFanSpeed);
+  initTelemetry();
+  restoreTimeCache();
+  markTimeSynced();
+  setPhase(PHASE_VEG);
+  for (int i = 0; i < 30; i++)
+    addLogEntry("Watered 1.5 l, pH 6.2, EC 1.4 -- leaves look healthy");
+  initWebServer();
+  tick();
+
+  std::vector<Flow> flows;
+  for (int d = 0; d < opt.dashboards; d++) {
+    flows.push_back({"dashboard", 2000, buildDashboardStatus, 0, String(), 0});
+    flows.push_back({"dashboard", 30000, buildLogbook, 0, String(), 0});
+  }
+  flows.push_back({"dashboard", 0, buildLongPoll, 0, String(), 0});
+  flows.push_back({"poller", 10000, buildStatus, 0, String(), 0});
+  flows.push_back({"poller", 30000, buildMetrics, 0, String(), 0});
+  flows.push_back({"script", 5000, buildFan, 0, String(), 0});
+  flows.push_back({"script", 15000, buildCommand, 0, String(), 0});
+  flows.push_back({"script", 60000, buildLight, 0, String(), 0});
+  flows.push_back({"script", 120000, buildConfig, 0, String(), 0});
+  flows.push_back({"script", 300000, buildLogbookAdd, 0, String(), 0});
+
+  std::vector<Flow *> active;
+  for (Flow &flow : flows) {
+    if (strcmp(opt.mix, "all") == 0 || strcmp(opt.mix, flow.mix) == 0) {
+      // Clients start spread over their first period.
+      flow.nextAt = flow.periodMs ? nextRandom() % flow.periodMs : 0;
+      active.push_back(&flow);
+    }
+  }
+  if (active.empty()) {
+    printf("unknown mix %s\n", opt.mix);
+    return 2;
+  }
+
+  size_t heapStart = halHeap.current;
+  uint64_t start = nowMs();
+  uint64_t end = start + opt.durationS * 1000;
+  uint64_t nextTick = start;
+  for (;;) {
+    uint64_t next = nextTick;
+    for (Flow *flow : active) {
+      if (flow->nextAt != UINT64_MAX && start + flow->nextAt < next)
+        next = start + flow->nextAt;
+    }
+    if (next >= end)
+      break;
+    halAdvanceMs(next - nowMs());
+
+    if (next == nextTick) {
+      tick();
+      pollPending();
+      nextTick += CONTROL_INTERVAL;
+    }
+    for (Flow *flow : active) {
+      if (flow->nextAt == UINT64_MAX || start + flow->nextAt > next)
+        continue;
+      if (flow->periodMs == 0)
+        flow->nextAt = UINT64_MAX; // until this request completes
+      else
+        flow->nextAt += flow->periodMs + nextRandom() % 200;
+      issue(*flow);
+      if (flow->periodMs == 0 && flow->nextAt != UINT64_MAX)
+        flow->nextAt -= start;
+    }
+  }
+  size_t held = pending.size();
+  for (InFlight &f : pending)
+    delete f.request;
+  pending.clear();
+
+  printf("%-24s %6s %5s %5s %5s %9s %8s %8s %8s %9s %9s\n", "route", "count",
+         "2xx", "304", "4xx", "req/s", "p50 us", "p99 us", "max us",
+         "peak heap", "avg bytes");
+  uint32_t total = 0;
+  double totalUs = 0;
+  for (std::pair<const String, RouteResult> &entry : results) {
+    RouteResult &r = entry.second;
+    size_t count = r.serviceUs.size();
+    double sumUs = 0;
+    for (uint32_t us : r.serviceUs)
+      sumUs += us;
+    total += count;
+    totalUs += sumUs;
+    uint32_t maxHeap = *std::max_element(r.peakHeap.begin(), r.peakHeap.end());
+    uint32_t p50 = percentile(r.serviceUs, 50);
+    uint32_t p99 = percentile(r.serviceUs, 99);
+    printf("%-24s %6lu %5lu %5lu %5lu %9.0f %8lu %8lu %8lu %9lu %9lu\n",
+           entry.first.c_str(), (unsigned long)count, (unsigned long)r.ok,
+           (unsigned long)r.notModified, (unsigned long)r.clientError,
+           sumUs > 0 ? count / (sumUs / 1e6) : 0.0, (unsigned long)p50,
+           (unsigned long)p99, (unsigned long)r.serviceUs.back(),
+           (unsigned long)maxHeap,
+           (unsigned long)(r.responseBytes / (count ? count : 1)));
+  }
+  printf("\n%lu requests in %lu s simulated (%.1f/s offered), %.0f req/s "
+         "handler throughput\n",
+         (unsigned long)total, opt.durationS, (double)total / opt.durationS,
+         totalUs > 0 ? total / (totalUs / 1e6) : 0.0);
+  printf("Held at end: %lu, heap growth over the run: %ld bytes, "
+         "min free heap: %lu\n",
+         (unsigned long)held, (long)halHeap.current - (long)heapStart,
+         (unsigned long)ESP.getMinFreeHeap());
+  // Host CPU time says nothing about the ESP32-C3, so only the request rate
+  // feeds the model here.
+  float rate = (float)total / opt.durationS;
+  PowerMode normal = {false, false, POWER_RADIO_DTIM};
+  PowerMode saving = {true, true, POWER_RADIO_MAX};
+  PowerEstimate normalMa = powerEstimate(normal, 0.0f, rate);
+  PowerEstimate savingMa = powerEstimate(saving, 0.0f, rate);
+  printf("Power model at %.1f requests/min: %.1f mA normal (radio %.1f), "
+         "%.1f mA power-save (radio %.1f)\n",
+         rate * 60.0f, normalMa.totalMa, normalMa.radioMa, savingMa.totalMa,
+         savingMa.radioMa);
+  printf("NVS: %lu commits, ~%lu flash bytes written, %lu saves skipped over "
+         "the daily budget\n",
+         (unsigned long)nvsWear.commits, (unsigned long)nvsWear.bytes,
+         (unsigned long)nvsWear.throttled);
+  return 0;
+}
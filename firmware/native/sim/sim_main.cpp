@@ -0,0 +1,515 @@
+// Grow simulator, built by `pio run -e native_sim`.
+//
+//   .pio/build/native_sim/program [--days=150] [--start=2026-03-01]
+//       [--step=1000] [--on=6] [--veg=14] [--flower=42] [--reboot=10]
+//       [--verbose]
+//
+// Fast-forwards a whole grow on the virtual clock: seedling and veg at 18/6,
+// flower at 12/12, all set through the command registry like a user would.
+// Every step runs controlTick() and persistTaskTick() from tasks.h and
+// compares the light pin with the schedule evaluated on the true local time
+// (TZ_INFO, so both DST changes are crossed when the range covers them).
+// Every --reboot days the device is reset, alternating a soft reset and a
+// 10 minute power cut, and the persisted state is checked after setup()
+// reloads it. Each power cut hits
+// in the middle of a flush of phase data and logbook (a different prefix of
+// the writes reaches flash each time), so a torn record must fall back to
+// the previous slot.
+//
+// Reports light transitions, missed and spurious switches, light hours per
+// day, NVS writes per key and reboot effects. Exits 1 if a switch was
+// missed or duplicated on synced time, the persisted state did not survive
+// a reboot, or the loop allocated heap (counted by the operator new shim,
+// native/hal/heap.cpp) on any step but a reboot. The loop includes the
+// history and the telemetry store: blocks are sealed by the control tick and
+// appended to the LittleFS shim by the persistence tick.
+//
+// millis() is 64 bit on the host, so its 49.7-day wrap is not simulated.
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "commands.h"
+#include "control.h"
+#include "hal_native.h"
+#include "nvswear.h"
+#include "tasks.h"
+#include "timecache.h"
+
+struct SimOptions {
+  int days = 150;
+  int startYear = 2026, startMonth = 3, startDay = 1;
+  unsigned long stepMs = 1000;
+  int onHour = 6;
+  int vegDay = 14;
+  int flowerDay = 42;
+  int rebootDays = 10;
+  bool verbose = false;
+};
+
+// Light schedule the grower asked for, independent of the firmware state.
+struct Schedule {
+  int onHour;
+  int hours;
+};
+
+struct SimStats {
+  uint32_t onSwitches = 0;
+  uint32_t offSwitches = 0;
+  uint32_t missed = 0;
+  uint32_t spurious = 0;
+  uint32_t estimatedEdges = 0; // edges while running on estimated time
+  uint64_t mismatchMs = 0;
+  uint32_t badDays = 0; // days without exactly one on-switch
+  uint32_t softResets = 0;
+  uint32_t powerCuts = 0;
+  uint32_t relayDrops = 0;
+  uint32_t persistMismatches = 0;
+  uint32_t tornFlushes = 0; // power cuts that cut a record write short
+  long maxEstimateError = 0;
+  uint64_t maxUsageLostMs = 0;
+  uint32_t maxCommitsPerDay = 0;
+  uint64_t loopAllocs = 0; // heap allocations in simLoop() outside reboots
+  uint32_t allocSteps = 0;
+};
+
+static SimOptions opt;
+static SimStats stats;
+static Schedule plan = {10, 12}; // firmware defaults until the grow starts
+static time_t startEpoch = 0;
+static uint64_t startMicros = 0;
+static bool estimated = false; // wall clock restored from cache, no NTP yet
+
+static time_t trueEpoch() {
+  return startEpoch + (time_t)((halMicros() - startMicros) / 1000000);
+}
+
+static bool scheduleOn(const Schedule &s, int hour) {
+  int offHour = (s.onHour + s.hours) % 24;
+  if (s.onHour > offHour)
+    return hour >= s.onHour || hour < offHour;
+  return hour >= s.onHour && hour < offHour;
+}
+
+static void command(const char *name, const char *arg) {
+  CommandStatus status = runCommand(CMD_SRC_SERIAL, name, arg);
+  if (status != CMD_OK) {
+    printf("command %s %s failed: %s\n", name, arg, commandStatusText(status));
+    exit(2);
+  }
+}
+
+static void drainLog() {
+  halSerialQuiet(!opt.verbose);
+  logDrain();
+  halSerialQuiet(false);
+}
+
+// No network on the host: netTaskMain() in tasks.h is never started, and
+// nothing is served from the route table power.h registers with.
+void networkTick() {}
+AsyncWebServer server(80);
+
+// One cycle of the control and persistence tasks, from tasks.h.
+static void simLoop() {
+  controlTick();
+  persistTaskTick();
+  drainLog();
+}
+
+// RAM back to its power-on values, so only what NVS (and RTC memory on a
+// soft reset) holds survives.
+static void resetRam() {
+  fanMinPercent = 0;
+  fanMaxPercent = 100;
+  lightOnHour = 10;
+  lightDuration = 12;
+  timerEnabled = true;
+  isLightOn = false;
+  currentFanSpeed = 30;
+  currentFanDuty = 0;
+  lightSwitchCount = 0;
+  nvsCommitCount = 0;
+  lastStatusMinute = -1;
+  lastUsageSignature = -1;
+  lightOnAccumMillis = 0;
+  lightOnSince = 0;
+  currentTzMode = TZ_AUTO;
+  memset(phases, 0, sizeof(phases));
+  currentPhase = PHASE_NONE;
+  memset(phaseDays, 0, sizeof(phaseDays));
+  totalDays = 0;
+  phaseDaysComputedAt = 0;
+  phaseDaysValidUntil = 0;
+
+  timeSource = TIME_NONE;
+  timeDriftSeconds = 0;
+  restoredEpoch = 0;
+  restoredAtMillis = 0;
+  restoredFromNVS = false;
+  lastTimeCacheRTC = 0;
+  lastTimeCacheNVS = 0;
+  ntpSyncPending = false;
+
+  persistPending = 0;
+  persistLegacy = 0;
+  logEntryCount = 0;
+
+  for (int t = 0; t < HISTORY_TIERS; t++) {
+    historyTiers[t].head = 0;
+    historyTiers[t].count = 0;
+    historyTiers[t].headTime = 0;
+  }
+  memset(historyAccums, 0, sizeof(historyAccums));
+  historyLastTick = 0;
+  historyLastSwitchCount = 0;
+  telemetryBlock.count = 0;
+  telemetrySealState = TLM_SEAL_EMPTY;
+  memset(&telemetryStats, 0, sizeof(telemetryStats));
+}
+
+// The control part of setup().
+static void simSetup() {
+  halSerialQuiet(!opt.verbose);
+  initTelemetry();
+  loadSettings();
+  loadUsage();
+  pinMode(LIGHT_PIN, OUTPUT);
+  setLight(false);
+  initPWM();
+  setFan(currentFanSpeed);
+  restoreTimeCache();
+  checkTimer();
+  drainLog();
+}
+
+struct PersistedState {
+  int fanMin, fanMax, fanSpeed, onHour, duration;
+  bool timer;
+  PlantPhase phase;
+  PhaseData phases[4];
+  int logCount;
+  uint32_t logCrc;
+};
+
+static PersistedState capture() {
+  PersistedState s;
+  s.fanMin = fanMinPercent;
+  s.fanMax = fanMaxPercent;
+  s.fanSpeed = currentFanSpeed;
+  s.onHour = lightOnHour;
+  s.duration = lightDuration;
+  s.timer = timerEnabled;
+  s.phase = currentPhase;
+  memcpy(s.phases, phases, sizeof(s.phases));
+  PersistCrcOut logbook;
+  saveLogbookRecord(logbook);
+  s.logCount = logEntryCount;
+  s.logCrc = logbook.crc;
+  return s;
+}
+
+static bool samePersisted(const PersistedState &a, const PersistedState &b) {
+  if (a.fanMin != b.fanMin || a.fanMax != b.fanMax ||
+      a.fanSpeed != b.fanSpeed || a.onHour != b.onHour ||
+      a.duration != b.duration || a.timer != b.timer || a.phase != b.phase ||
+      a.logCount != b.logCount || a.logCrc != b.logCrc)
+    return false;
+  for (int p = PHASE_SEEDLING; p <= PHASE_FLOWER; p++) {
+    if (a.phases[p].startTime != b.phases[p].startTime ||
+        a.phases[p].active != b.phases[p].active)
+      return false;
+  }
+  return true;
+}
+
+static void reboot(bool powerLoss) {
+  PersistedState before = capture();
+  uint64_t usageBefore =
+      usageCurrent(usage.phase[currentPhase], true).lightMs;
+  bool wasOn = halPinLevel(LIGHT_PIN) == HIGH;
+
+  if (powerLoss) {
+    stats.powerCuts++;
+    uint32_t failuresBefore = persistStats.failures;
+    halFlashPowerFail((stats.powerCuts * 29) % 160);
+    persistMark(PERSIST_PHASES | PERSIST_LOGBOOK);
+    persistFlush();
+    if (persistStats.failures != failuresBefore)
+      stats.tornFlushes++;
+    digitalWrite(LIGHT_PIN, LOW);
+    memset(&rtcTimeCache, 0, sizeof(rtcTimeCache));
+    halAdvanceMs(10 * 60 * 1000UL);
+  } else {
+    stats.softResets++;
+  }
+  halReboot(powerLoss);
+  resetRam();
+  simSetup();
+
+  if (wasOn && !powerLoss)
+    stats.relayDrops++;
+  if (!samePersisted(before, capture())) {
+    stats.persistMismatches++;
+    printf("persisted state changed across reboot at %ld\n",
+           (long)trueEpoch());
+  }
+  uint64_t usageAfter = usage.phase[currentPhase].lightMs;
+  if (usageBefore > usageAfter &&
+      usageBefore - usageAfter > stats.maxUsageLostMs)
+    stats.maxUsageLostMs = usageBefore - usageAfter;
+  if (powerLoss) {
+    estimated = restoredFromNVS;
+    long error = labs((long)(restoredEpoch - trueEpoch()));
+    if (restoredEpoch > 0 && error > stats.maxEstimateError)
+      stats.maxEstimateError = error;
+  }
+}
+
+static void dayName(time_t t, char *out, size_t len) {
+  struct tm local;
+  localtime_r(&t, &local);
+  strftime(out, len, "%Y-%m-%d", &local);
+}
+
+static void printKey(const char *key, const HalNvsKeyStats &s) {
+  printf("  %-24s %8lu puts %8lu writes %10llu bytes\n", key,
+         (unsigned long)s.puts, (unsigned long)s.writes,
+         (unsigned long long)s.bytes);
+}
+
+static void parseArgs(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    if (sscanf(a, "--days=%d", &opt.days) == 1 ||
+        sscanf(a, "--start=%d-%d-%d", &opt.startYear, &opt.startMonth,
+               &opt.startDay) == 3 ||
+        sscanf(a, "--step=%lu", &opt.stepMs) == 1 ||
+        sscanf(a, "--on=%d", &opt.onHour) == 1 ||
+        sscanf(a, "--veg=%d", &opt.vegDay) == 1 ||
+        sscanf(a, "--flower=%d", &opt.flowerDay) == 1 ||
+        sscanf(a, "--reboot=%d", &opt.rebootDays) == 1)
+      continue;
+    if (strcmp(a, "--verbose") == 0) {
+      opt.verbose = true;
+      continue;
+    }
+    printf("unknown option %s\n", a);
+    exit(2);
+  }
+  if (opt.stepMs == 0 || opt.onHour < 0 || opt.onHour > 23) {
+    printf("invalid option value\n");
+    exit(2);
+  }
+}
+
+int main(int argc, char **argv) {
+  parseArgs(argc, argv);
+  std::chrono::steady_clock::time_point wallStart =
+      std::chrono::steady_clock::now();
+
+  setenv("TZ", TZ_INFO, 1);
+  tzset();
+  struct tm start = {};
+  start.tm_year = opt.startYear - 1900;
+  start.tm_mon = opt.startMonth - 1;
+  start.tm_mday = opt.startDay;
+  start.tm_isdst = -1;
+  startEpoch = mktime(&start);
+  startMicros = halMicros();
+
+  // First boot on empty flash and an unset clock; NTP answers 5 s later.
+  initLogger();
+  halReboot(true);
+  resetRam();
+  simSetup();
+  time_t ntpAt = trueEpoch() + 5;
+
+  char day[16];
+  dayName(startEpoch, day, sizeof(day));
+  printf("Simulating %d days from %s (%s), step %lu ms\n", opt.days, day,
+         TZ_INFO, opt.stepMs);
+
+  time_t endEpoch = startEpoch + (time_t)opt.days * 86400;
+  int dayIndex = 0;
+  int lastYday = start.tm_yday;
+  int lastIsDst = -1;
+  uint32_t onToday = 0;
+  uint64_t lightMsToday = 0;
+  uint32_t commitsAtDayStart = halNvs.commits;
+  int nextReboot = 1;
+  bool prevExpected = false;
+  int prevLevel = halPinLevel(LIGHT_PIN);
+  bool eventDone[3] = {false, false, false};
+
+  while (trueEpoch() < endEpoch) {
+    bool booted = false;
+    time_t now = trueEpoch();
+    struct tm local;
+    localtime_r(&now, &local);
+
+    if (local.tm_yday != lastYday) {
+      // Day boundary: one on-switch per day while the schedule has a dark
+      // period, light hours per day.
+      dayName(now - 1, day, sizeof(day));
+      uint32_t commits = halNvs.commits - commitsAtDayStart;
+      if (commits > stats.maxCommitsPerDay)
+        stats.maxCommitsPerDay = commits;
+      commitsAtDayStart = halNvs.commits;
+      if (dayIndex > 0 && plan.hours < 24 && onToday != 1) {
+        stats.badDays++;
+        printf("%s: %lu on-switches\n", day, (unsigned long)onToday);
+      }
+      float hours = lightMsToday / 3600000.0f;
+      if (dayIndex > 0 && fabsf(hours - plan.hours) > 0.05f)
+        printf("%s: light %.2f h (schedule %d h)\n", day, hours, plan.hours);
+      lastYday = local.tm_yday;
+      onToday = 0;
+      lightMsToday = 0;
+      dayIndex++;
+    }
+    if (lastIsDst != -1 && local.tm_isdst != lastIsDst) {
+      dayName(now, day, sizeof(day));
+      printf("%s: DST %s at local %02d:%02d\n", day,
+             local.tm_isdst ? "starts" : "ends", local.tm_hour, local.tm_min);
+    }
+    lastIsDst = local.tm_isdst;
+
+    // Grow plan, applied at noon.
+    int growDay = (int)((now - startEpoch) / 86400);
+    if (local.tm_hour >= 12) {
+      if (!eventDone[0]) {
+        eventDone[0] = true;
+        char on[4];
+        snprintf(on, sizeof(on), "%d", opt.onHour);
+        command("PHASE", "seedling");
+        addLogEntry("Seeds in, 18/6");
+        command("LIGHTON", on);
+        command("LIGHTTIME", "18");
+        plan = {opt.onHour, 18};
+      } else if (!eventDone[1] && growDay >= opt.vegDay) {
+        eventDone[1] = true;
+        command("PHASE", "veg");
+        addLogEntry("Veg: \"topped\" and transplanted");
+      } else if (!eventDone[2] && growDay >= opt.flowerDay) {
+        eventDone[2] = true;
+        command("PHASE", "flower");
+        command("LIGHTTIME", "12");
+        addLogEntry("Flip to 12/12");
+        plan.hours = 12;
+      }
+    }
+
+    if (opt.rebootDays > 0 && growDay >= nextReboot * opt.rebootDays &&
+        local.tm_hour == (nextReboot * 7 + 3) % 24) {
+      reboot(nextReboot % 2 == 0);
+      ntpAt = trueEpoch() + 60;
+      nextReboot++;
+      booted = true;
+    }
+    if (ntpAt != 0 && trueEpoch() >= ntpAt) {
+      halNtpSync(trueEpoch());
+      ntpAt = 0;
+      estimated = false;
+    }
+
+    uint64_t allocsBefore = halHeap.allocs;
+    simLoop();
+    if (!booted && halHeap.allocs != allocsBefore) {
+      if (stats.allocSteps++ < 5) {
+        dayName(trueEpoch(), day, sizeof(day));
+        printf("%s %02d:%02d: %llu heap allocations in the loop\n", day,
+               local.tm_hour, local.tm_min,
+               (unsigned long long)(halHeap.allocs - allocsBefore));
+      }
+      stats.loopAllocs += halHeap.allocs - allocsBefore;
+    }
+
+    now = trueEpoch();
+    localtime_r(&now, &local);
+    bool expected = scheduleOn(plan, local.tm_hour);
+    int level = halPinLevel(LIGHT_PIN);
+    if (!booted) {
+      bool expectedEdge = expected != prevExpected;
+      bool edge = level != prevLevel;
+      if (edge && estimated)
+        stats.estimatedEdges++;
+      else if (edge && !expectedEdge)
+        stats.spurious++;
+      else if (!edge && expectedEdge && !estimated)
+        stats.missed++;
+    }
+    if (level != prevLevel) {
+      if (level == HIGH) {
+        stats.onSwitches++;
+        onToday++;
+      } else {
+        stats.offSwitches++;
+      }
+    }
+    if ((level == HIGH) != expected)
+      stats.mismatchMs += opt.stepMs;
+    if (level == HIGH)
+      lightMsToday += opt.stepMs;
+    prevExpected = expected;
+    prevLevel = level;
+
+    halAdvanceMs(opt.stepMs);
+  }
+
+  double wallSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - wallStart)
+                           .count();
+  double days = opt.days;
+  printf("\nLight transitions:   %lu on, %lu off\n",
+         (unsigned long)stats.onSwitches, (unsigned long)stats.offSwitches);
+  printf("Missed switches:     %lu\n", (unsigned long)stats.missed);
+  printf("Spurious switches:   %lu\n", (unsigned long)stats.spurious);
+  printf("Bad days:            %lu (not exactly one on-switch)\n",
+         (unsigned long)stats.badDays);
+  printf("Off schedule:        %.1f min in total\n",
+         stats.mismatchMs / 60000.0);
+  printf("Reboots:             %lu soft, %lu power cuts\n",
+         (unsigned long)stats.softResets, (unsigned long)stats.powerCuts);
+  printf("  relay dropped:     %lu (soft reset with the light on)\n",
+         (unsigned long)stats.relayDrops);
+  printf("  edges on estimate: %lu\n", (unsigned long)stats.estimatedEdges);
+  printf("  estimate error:    %ld s max\n", stats.maxEstimateError);
+  printf("  usage lost:        %.2f h max\n",
+         stats.maxUsageLostMs / 3600000.0);
+  printf("  state mismatches:  %lu\n", (unsigned long)stats.persistMismatches);
+  printf("  torn flushes:      %lu (%lu bad slots skipped on load)\n",
+         (unsigned long)stats.tornFlushes,
+         (unsigned long)persistStats.badSlots);
+  printf("Loop allocations:    %llu in %lu steps\n",
+         (unsigned long long)stats.loopAllocs, (unsigned long)stats.allocSteps);
+  printf("Telemetry:           %lu samples in %lu blocks, %lu bytes, "
+         "%lu write errors\n",
+         (unsigned long)telemetryStats.samples,
+         (unsigned long)telemetryStats.blocks,
+         (unsigned long)telemetryStats.bytes,
+         (unsigned long)telemetryStats.writeErrors);
+  printf("NVS:                 %lu commits (%.1f/day, max %lu/day), %lu puts, "
+         "%lu writes, %llu bytes\n",
+         (unsigned long)halNvs.commits, halNvs.commits / days,
+         (unsigned long)stats.maxCommitsPerDay, (unsigned long)halNvs.puts,
+         (unsigned long)halNvs.writes, (unsigned long long)halNvs.bytes);
+  halNvsForEachKey(printKey);
+  char years[16] = "-";
+  if (nvsWearLifetimeDays(nvsWear) > 0)
+    snprintf(years, sizeof(years), "%lu",
+             (unsigned long)(nvsWearLifetimeDays(nvsWear) / 365));
+  printf("Wear accounting:     ~%llu flash bytes, %lu/day, %.4f erase cycles, "
+         "%s years left, %lu saves skipped\n",
+         (unsigned long long)nvsWear.bytes,
+         (unsigned long)nvsWearBytesPerDay(nvsWear),
+         (double)nvsWear.bytes / nvsWearBytesPerCycle(),
+         years,
+         (unsigned long)nvsWear.throttled);
+  printf("Simulated in %.2f s\n", wallSeconds);
+
+  bool failed = stats.missed > 0 || stats.spurious > 0 || stats.badDays > 0 ||
+                stats.persistMismatches > 0 || stats.loopAllocs > 0;
+  return failed ? 1 : 0;
+}
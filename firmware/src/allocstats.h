@@ -0,0 +1,252 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <Arduino.h>
+
+// Opt-in allocation tracker, built by env:main_alloc (-DALLOC_TRACKING plus
+// -Wl,--wrap for malloc/calloc/realloc/free). Every allocation and free in
+// the firmware, the Arduino core and the libraries is booked to the
+// innermost ALLOC_SCOPE() active in the calling task, or to "other". A
+// realloc counts as one free and one allocation, which is what String
+// growth costs the allocator.
+//
+// Frees are booked to the scope that frees, so a String built in one scope
+// and dropped in another shows up in both. Counters are plain increments
+// and can lose a count when two tasks allocate at once; this is a
+// diagnostic, not an accounting tool.
+//
+// allocTrendTick() samples free heap and the largest free block every
+// ALLOC_TREND_INTERVAL, so a shrinking largest block at constant free heap
+// shows fragmentation. Reported by DIAG on the console and under "alloc" in
+// /api/diag. Without ALLOC_TRACKING, ALLOC_SCOPE() compiles to nothing.
+
+#ifdef ALLOC_TRACKING
+
+#include <esp_heap_caps.h>
+
+#include "config.h"
+
+#define ALLOC_MAX_SITES 32
+#define ALLOC_TOP_SITES 10
+
+struct AllocSite {
+  const char *name;
+  uint32_t allocs;
+  uint32_t frees;
+  uint64_t allocBytes;
+  uint64_t freeBytes;
+  uint32_t maxSize;
+};
+
+struct AllocTrendSample {
+  uint32_t uptime; // seconds
+  uint32_t freeHeap;
+  uint32_t largestBlock;
+};
+
+AllocSite allocSites[ALLOC_MAX_SITES] = {{"other", 0, 0, 0, 0, 0}};
+int allocSiteCount = 1;
+portMUX_TYPE allocSiteMux = portMUX_INITIALIZER_UNLOCKED;
+static __thread uint8_t allocCurrentSite = 0;
+
+AllocTrendSample allocTrend[ALLOC_TREND_SLOTS];
+int allocTrendCount = 0;
+int allocTrendHead = 0;
+unsigned long lastAllocTrend = 0;
+uint32_t allocMinLargestBlock = UINT32_MAX;
+
+// Returns the site for `name` (compared by pointer), adding it if needed.
+// Sites past ALLOC_MAX_SITES are booked to "other".
+uint8_t allocSiteIndex(const char *name) {
+  portENTER_CRITICAL(&allocSiteMux);
+  uint8_t index = 0;
+  for (int i = 1; i < allocSiteCount; i++) {
+    if (allocSites[i].name == name) {
+      index = i;
+      break;
+    }
+  }
+  if (index == 0 && allocSiteCount < ALLOC_MAX_SITES) {
+    index = allocSiteCount++;
+    allocSites[index].name = name;
+  }
+  portEXIT_CRITICAL(&allocSiteMux);
+  return index;
+}
+
+struct AllocScope {
+  explicit AllocScope(uint8_t site) : previous(allocCurrentSite) {
+    allocCurrentSite = site;
+  }
+  ~AllocScope() { allocCurrentSite = previous; }
+  uint8_t previous;
+};
+
+#define ALLOC_SCOPE(name)                                                      \
+  static const uint8_t allocSite_ = allocSiteIndex(name);                      \
+  AllocScope allocScope_(allocSite_)
+
+// For scopes whose name is only known at run time (routes); `site` comes
+// from allocSiteIndex().
+#define ALLOC_SCOPE_SITE(site) AllocScope allocScope_(site)
+
+static inline void allocNoteAlloc(size_t size) {
+  AllocSite &s = allocSites[allocCurrentSite];
+  s.allocs++;
+  s.allocBytes += size;
+  if (size > s.maxSize)
+    s.maxSize = size;
+}
+
+static inline void allocNoteFree(size_t size) {
+  AllocSite &s = allocSites[allocCurrentSite];
+  s.frees++;
+  s.freeBytes += size;
+}
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+  void *ptr = __real_malloc(size);
+  if (ptr != NULL)
+    allocNoteAlloc(size);
+  return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  void *ptr = __real_calloc(n, size);
+  if (ptr != NULL)
+    allocNoteAlloc(n * size);
+  return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  size_t oldSize = ptr != NULL ? heap_caps_get_allocated_size(ptr) : 0;
+  void *out = __real_realloc(ptr, size);
+  if (ptr != NULL && (out != NULL || size == 0))
+    allocNoteFree(oldSize);
+  if (out != NULL)
+    allocNoteAlloc(size);
+  return out;
+}
+
+void __wrap_free(void *ptr) {
+  if (ptr != NULL)
+    allocNoteFree(heap_caps_get_allocated_size(ptr));
+  __real_free(ptr);
+}
+}
+
+void allocTrendTick() {
+  unsigned long now = millis();
+  if (allocTrendCount > 0 && now - lastAllocTrend < ALLOC_TREND_INTERVAL)
+    return;
+  lastAllocTrend = now;
+  AllocTrendSample &s = allocTrend[allocTrendHead];
+  s.uptime = now / 1000;
+  s.freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  s.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  if (s.largestBlock < allocMinLargestBlock)
+    allocMinLargestBlock = s.largestBlock;
+  allocTrendHead = (allocTrendHead + 1) % ALLOC_TREND_SLOTS;
+  if (allocTrendCount < ALLOC_TREND_SLOTS)
+    allocTrendCount++;
+}
+
+void allocReset() {
+  portENTER_CRITICAL(&allocSiteMux);
+  for (int i = 0; i < allocSiteCount; i++) {
+    const char *name = allocSites[i].name;
+    memset(&allocSites[i], 0, sizeof(AllocSite));
+    allocSites[i].name = name;
+  }
+  portEXIT_CRITICAL(&allocSiteMux);
+}
+
+// Indexes of the sites with the most allocations, busiest first.
+int allocTopSites(uint8_t *out, int max) {
+  int n = 0;
+  for (int i = 0; i < allocSiteCount; i++) {
+    uint32_t allocs = allocSites[i].allocs;
+    if (allocs == 0 && allocSites[i].frees == 0)
+      continue;
+    int pos;
+    if (n < max)
+      pos = n++;
+    else if (allocs > allocSites[out[max - 1]].allocs)
+      pos = max - 1;
+    else
+      continue;
+    while (pos > 0 && allocSites[out[pos - 1]].allocs < allocs) {
+      out[pos] = out[pos - 1];
+      pos--;
+    }
+    out[pos] = i;
+  }
+  return n;
+}
+
+String getAllocJSON() {
+  uint8_t top[ALLOC_TOP_SITES];
+  int n = allocTopSites(top, ALLOC_TOP_SITES);
+
+  String json = "\"alloc\":{\"sites\":[";
+  for (int i = 0; i < n; i++) {
+    const AllocSite &s = allocSites[top[i]];
+    if (i > 0)
+      json += ",";
+    json += "{\"name\":\"" + String(s.name) + "\"";
+    json += ",\"allocs\":" + String(s.allocs);
+    json += ",\"frees\":" + String(s.frees);
+    json += ",\"allocKB\":" + String((unsigned long)(s.allocBytes / 1024));
+    json += ",\"freeKB\":" + String((unsigned long)(s.freeBytes / 1024));
+    json += ",\"maxSize\":" + String(s.maxSize) + "}";
+  }
+  json += "],\"largestBlock\":" +
+          String((unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  json += ",\"minLargestBlock\":" +
+          String(allocTrendCount ? allocMinLargestBlock : 0);
+  json += ",\"trend\":[";
+  int first = (allocTrendHead - allocTrendCount + ALLOC_TREND_SLOTS) %
+              ALLOC_TREND_SLOTS;
+  for (int i = 0; i < allocTrendCount; i++) {
+    const AllocTrendSample &s = allocTrend[(first + i) % ALLOC_TREND_SLOTS];
+    if (i > 0)
+      json += ",";
+    json += "[" + String(s.uptime) + "," + String(s.freeHeap) + "," +
+            String(s.largestBlock) + "]";
+  }
+  json += "]}";
+  return json;
+}
+
+void printAllocStats() {
+  uint8_t top[ALLOC_TOP_SITES];
+  int n = allocTopSites(top, ALLOC_TOP_SITES);
+
+  Serial.printf("  Largest block: %lu (min %lu)\n",
+                (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                (unsigned long)(allocTrendCount ? allocMinLargestBlock : 0));
+  Serial.println("  Alloc site          Allocs    Frees    KB in   KB out  Max");
+  for (int i = 0; i < n; i++) {
+    const AllocSite &s = allocSites[top[i]];
+    Serial.printf("  %-18s %7lu  %7lu  %7lu  %7lu  %5lu\n", s.name,
+                  (unsigned long)s.allocs, (unsigned long)s.frees,
+                  (unsigned long)(s.allocBytes / 1024),
+                  (unsigned long)(s.freeBytes / 1024),
+                  (unsigned long)s.maxSize);
+  }
+}
+
+#else
+
+#define ALLOC_SCOPE(name)
+#define ALLOC_SCOPE_SITE(site)
+
+#endif
+
+#endif
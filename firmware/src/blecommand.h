@@ -0,0 +1,125 @@
+#ifndef BLECOMMAND_H
+#define BLECOMMAND_H
+
+#include <Arduino.h>
+
+#include "commands.h"
+#include "controlqueue.h"
+#include "state.h"
+
+// Batched writes to the BLE command characteristic (0xABC8). The payload is
+// a sequence of 2-byte opcode/value pairs; the whole write is validated
+// against the command registry first and then applied all-or-nothing in one
+// control-task call, like POST /api/config. The write runs in the Bluedroid
+// task, which does not wait for that call: the batch is queued once it
+// validates and the write is answered "busy" if the queue is full. A later pair for the same
+// opcode wins; LIGHT is applied after the settings, so it is not undone by
+// a TIMER or LIGHTON in the same batch. The state comes back as one
+// notification of the packed status characteristic (0xABC7, layout in
+// statusbin.h).
+//
+//  opcode command    value
+//    1    LIGHT      0-1
+//    2    FAN        0-100
+//    3    FANMIN     0-100
+//    4    FANMAX     0-100
+//    5    LIGHTON    0-23
+//    6    LIGHTTIME  1-24
+//    7    TIMER      0-1
+//    8    TZ         0-2
+
+struct BleOpcode {
+  const char *command;
+  uint8_t field; // ConfigUpdate field, 0 for LIGHT
+};
+
+static const BleOpcode bleOpcodes[] = {
+    {NULL, 0},
+    {"LIGHT", 0},
+    {"FAN", CFG_FAN_SPEED},
+    {"FANMIN", CFG_FAN_MIN},
+    {"FANMAX", CFG_FAN_MAX},
+    {"LIGHTON", CFG_LIGHT_ON},
+    {"LIGHTTIME", CFG_LIGHT_DURATION},
+    {"TIMER", CFG_TIMER_ENABLED},
+    {"TZ", CFG_TZ_MODE},
+};
+
+#define BLE_OPCODE_COUNT (sizeof(bleOpcodes) / sizeof(bleOpcodes[0]))
+
+struct BleBatch {
+  ConfigUpdate update;
+  int light; // -1: not in the batch
+};
+
+static_assert(sizeof(BleBatch) <= CONTROL_POST_MAX, "CONTROL_POST_MAX");
+
+static void applyBleBatch(void *arg) {
+  BleBatch *batch = (BleBatch *)arg;
+  if (batch->update.fields != 0)
+    applyConfig(batch->update);
+  if (batch->light >= 0)
+    setLight(batch->light != 0);
+}
+
+// `pairs` holds `count` opcode/value pairs. Nothing is applied unless every
+// pair is valid; CMD_OK means the batch was queued.
+CommandStatus runBleBatch(const uint8_t *pairs, int count) {
+  ALLOC_SCOPE("command");
+  unsigned long start = micros();
+  BleBatch batch = {};
+  batch.light = -1;
+  CommandStatus status = count > 0 ? CMD_OK : CMD_MISSING_ARG;
+
+  for (int i = 0; i < count && status == CMD_OK; i++) {
+    uint8_t opcode = pairs[2 * i];
+    if (opcode == 0 || opcode >= BLE_OPCODE_COUNT) {
+      status = CMD_UNKNOWN;
+      break;
+    }
+    char arg[4];
+    snprintf(arg, sizeof(arg), "%u", pairs[2 * i + 1]);
+    CommandArgs args;
+    status = commandParse(*findCommand(bleOpcodes[opcode].command), arg, args);
+    if (status != CMD_OK)
+      break;
+
+    ConfigUpdate &u = batch.update;
+    u.fields |= bleOpcodes[opcode].field;
+    switch (bleOpcodes[opcode].field) {
+    case 0:
+      batch.light = args.value;
+      break;
+    case CFG_FAN_SPEED:
+      u.fanSpeed = args.value;
+      break;
+    case CFG_FAN_MIN:
+      u.fanMin = args.value;
+      break;
+    case CFG_FAN_MAX:
+      u.fanMax = args.value;
+      break;
+    case CFG_LIGHT_ON:
+      u.lightOnHour = args.value;
+      break;
+    case CFG_LIGHT_DURATION:
+      u.lightDuration = args.value;
+      break;
+    case CFG_TIMER_ENABLED:
+      u.timerEnabled = args.value == 1;
+      break;
+    case CFG_TZ_MODE:
+      u.tzMode = (TimezoneMode)args.value;
+      break;
+    }
+  }
+  commandRecord(CMD_SRC_BLE, micros() - start, status == CMD_OK);
+  if (status != CMD_OK)
+    return status;
+
+  if (!controlPost(applyBleBatch, &batch, sizeof(batch)))
+    return CMD_BUSY;
+  return CMD_OK;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CHUNKWRITER_H
+#define CHUNKWRITER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <stdarg.h>
+
+// Resumable writer for chunked responses. Output is split into numbered
+// items (usually one line each) that are formatted straight into the chunk
+// buffer handed out by AsyncWebServer. When an item does not fit, the writer
+// stops and the next chunk re-runs the renderer from the first missing item,
+// so no intermediate String is built.
+
+#ifndef RESPONSE_TRY_AGAIN
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+#endif
+
+struct ChunkWriter {
+  char *buf;
+  size_t cap;
+  size_t len;
+  uint16_t item;
+  uint16_t resume;
+  bool full;
+};
+
+void chunkPrintf(ChunkWriter &w, const char *fmt, ...) {
+  uint16_t k = w.item++;
+  if (w.full || k < w.resume)
+    return;
+
+  size_t room = w.cap - w.len;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(w.buf + w.len, room, fmt, args);
+  va_end(args);
+
+  if (n < 0 || (size_t)n >= room) {
+    w.full = true;
+    w.resume = k;
+    return;
+  }
+  w.len += n;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <Arduino.h>
+
+#include "allocstats.h"
+#include "commands.h"
+
+// Serial console. cliPoll() drains at most CLI_POLL_BUDGET bytes from the
+// UART driver's RX ring per network task cycle into a fixed line buffer and
+// never waits, so a half-typed command cannot stall OTA or WiFi. Complete lines are
+// split in place and run through the command registry (commands.h).
+
+#define CLI_LINE_MAX 64
+#define CLI_POLL_BUDGET 64
+
+// Splits one line in place into command name and trimmed argument.
+void processCommand(char *line) {
+  ALLOC_SCOPE("cli");
+  while (*line == ' ' || *line == '\t')
+    line++;
+  char *end = line + strlen(line);
+  while (end > line && (end[-1] == ' ' || end[-1] == '\t'))
+    *--end = '\0';
+  if (*line == '\0')
+    return;
+
+  Serial.printf("[CMD] Received: '%s'\n", line);
+
+  char *args = line;
+  while (*args && *args != ' ' && *args != '\t')
+    args++;
+  if (*args) {
+    *args++ = '\0';
+    while (*args == ' ' || *args == '\t')
+      args++;
+  }
+
+  CommandStatus status = runCommand(CMD_SRC_SERIAL, line, args);
+  if (status == CMD_UNKNOWN) {
+    Serial.printf("[CMD] Unknown command: '%s'\n", line);
+    Serial.println("[CMD] Type 'HELP' for available commands");
+  } else if (status != CMD_OK) {
+    char usage[48];
+    commandUsage(*findCommand(line), usage, sizeof(usage));
+    Serial.printf("[CMD] %s (usage: %s)\n", commandStatusText(status), usage);
+  }
+}
+
+char cliLine[CLI_LINE_MAX];
+size_t cliLength = 0;
+bool cliOverflow = false;
+
+void cliPoll() {
+  for (int budget = CLI_POLL_BUDGET; budget > 0 && Serial.available() > 0;
+       budget--) {
+    int c = Serial.read();
+    if (c < 0)
+      break;
+    if (c == '\r' || c == '\n') {
+      if (cliOverflow) {
+        Serial.printf("[CMD] Line too long (max %d chars)\n", CLI_LINE_MAX - 1);
+      } else if (cliLength > 0) {
+        cliLine[cliLength] = '\0';
+        processCommand(cliLine);
+      }
+      cliLength = 0;
+      cliOverflow = false;
+    } else if (c == '\b' || c == 0x7F) {
+      if (cliLength > 0)
+        cliLength--;
+    } else if (cliLength < CLI_LINE_MAX - 1) {
+      cliLine[cliLength++] = (char)c;
+    } else {
+      cliOverflow = true;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,496 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+
+#include "allocstats.h"
+#include "config.h"
+#include "controlqueue.h"
+#include "persist.h"
+#include "state.h"
+
+// Command registry shared by the serial console, the HTTP API and BLE. Each
+// entry carries its argument schema (type and range), so parsing and
+// validation happen here once and the transports only map their input onto
+// a command name and argument. The save*/set* functions behind the handlers
+// assume validated input. Handlers run on the control task (controlqueue.h)
+// except console-only ones, which just print.
+//
+// Lookup uses a compile-time FNV-1a hash of the upper-case name with a
+// strcmp on a hash match. Parse/validate time is measured per transport and
+// reported by getCommandsJSON() (GET /api/commands).
+
+#define COMMAND_NAME_MAX 16
+
+enum CommandArgType : uint8_t {
+  CMD_ARG_NONE,
+  CMD_ARG_INT,    // decimal integer in [min, max]
+  CMD_ARG_CHOICE, // one of the '|'-separated words in `choices`, value = index
+  CMD_ARG_TEXT,   // free text, length in [min, max]
+};
+
+enum CommandSource : uint8_t {
+  CMD_SRC_SERIAL,
+  CMD_SRC_HTTP,
+  CMD_SRC_BLE,
+  CMD_SRC_COUNT
+};
+
+enum CommandStatus : uint8_t {
+  CMD_OK,
+  CMD_UNKNOWN,
+  CMD_NOT_ALLOWED,
+  CMD_MISSING_ARG,
+  CMD_BAD_ARG,
+  CMD_OUT_OF_RANGE,
+  CMD_BUSY,
+};
+
+// Console-only commands print to Serial and are rejected on other transports.
+#define CMD_FLAG_CONSOLE 0x01
+
+struct CommandArgs {
+  int value;
+  const char *text;
+};
+
+typedef void (*CommandHandler)(const CommandArgs &args);
+
+struct CommandSpec {
+  uint32_t hash;
+  const char *name;
+  CommandArgType arg;
+  int16_t min;
+  int16_t max;
+  const char *choices;
+  uint8_t flags;
+  const char *help;
+  CommandHandler handler;
+};
+
+struct CommandStats {
+  uint32_t count;
+  uint32_t errors;
+  uint64_t parseUs;
+  uint32_t maxParseUs;
+};
+
+CommandStats commandStats[CMD_SRC_COUNT];
+
+extern void saveFanSpeed(int percent);
+extern void printDiag();
+extern void diagReset();
+
+constexpr uint32_t commandHash(const char *s, uint32_t h = 2166136261u) {
+  return *s ? commandHash(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+// ---- handlers --------------------------------------------------------------
+
+static void cmdHelp(const CommandArgs &args);
+
+static void cmdOn(const CommandArgs &args) { setLight(true); }
+static void cmdOff(const CommandArgs &args) { setLight(false); }
+static void cmdLight(const CommandArgs &args) { setLight(args.value != 0); }
+static void cmdFan(const CommandArgs &args) { saveFanSpeed(args.value); }
+static void cmdFanMin(const CommandArgs &args) { saveFanMin(args.value); }
+static void cmdFanMax(const CommandArgs &args) { saveFanMax(args.value); }
+static void cmdLightOn(const CommandArgs &args) { saveLightOnHour(args.value); }
+static void cmdLightTime(const CommandArgs &args) { saveLightDuration(args.value); }
+static void cmdTimer(const CommandArgs &args) { saveTimerEnabled(args.value != 0); }
+static void cmdTz(const CommandArgs &args) { saveTzMode((TimezoneMode)args.value); }
+static void cmdTime(const CommandArgs &args) { printLocalTime(); }
+static void cmdStatus(const CommandArgs &args) { printStatus(); }
+static void cmdReset(const CommandArgs &args) {
+  persistRequestRestart(PERSIST_RESTART_RESET);
+}
+
+// The off hour is stored as a duration relative to the on hour.
+static void cmdLightOff(const CommandArgs &args) {
+  int duration = (args.value - lightOnHour + 24) % 24;
+  saveLightDuration(duration == 0 ? 24 : duration);
+}
+
+static void cmdHost(const CommandArgs &args) {
+  char name[32];
+  size_t len = strlen(args.text);
+  for (size_t i = 0; i <= len; i++) {
+    name[i] = tolower((unsigned char)args.text[i]);
+  }
+  saveHostname(name);
+}
+
+// Choices: none|seedling|veg|flower|reset, in PlantPhase order.
+static void cmdPhase(const CommandArgs &args) {
+  setPhase(args.value > PHASE_FLOWER ? PHASE_NONE : (PlantPhase)args.value);
+}
+
+// Choices: all|seedling|veg|flower, in PlantPhase order with "all" at 0.
+static void cmdPhaseReset(const CommandArgs &args) {
+  if (args.value == 0) {
+    resetPhase(PHASE_SEEDLING);
+    resetPhase(PHASE_VEG);
+    resetPhase(PHASE_FLOWER);
+  } else {
+    resetPhase((PlantPhase)args.value);
+  }
+}
+
+#ifdef DIAG_COMMANDS
+// Busy-waits the calling task (the network task for the console), to check
+// in DIAG that the control period holds while networking is stuck. Test
+// builds only (-DDIAG_COMMANDS, env:main_alloc).
+static void cmdStall(const CommandArgs &args) {
+  Serial.printf("[CMD] Stalling this task for %d ms\n", args.value);
+  unsigned long start = millis();
+  while (millis() - start < (unsigned long)args.value) {
+  }
+  Serial.println("[CMD] Stall over, see DIAG");
+}
+#endif
+
+static void cmdDiag(const CommandArgs &args) {
+  if (strcasecmp(args.text, "RESET") == 0) {
+    diagReset();
+    Serial.println("[CMD] Diagnostics reset");
+  } else {
+    printDiag();
+  }
+}
+
+// ---- registry --------------------------------------------------------------
+
+#define COMMAND(name, arg, min, max, choices, flags, help, handler)            \
+  { commandHash(name), name, arg, min, max, choices, flags, help, handler }
+
+static const CommandSpec commands[] = {
+    COMMAND("ON", CMD_ARG_NONE, 0, 0, NULL, 0, "Turn light ON", cmdOn),
+    COMMAND("OFF", CMD_ARG_NONE, 0, 0, NULL, 0, "Turn light OFF", cmdOff),
+    COMMAND("LIGHT", CMD_ARG_INT, 0, 1, NULL, 0, "Set light OFF/ON", cmdLight),
+    COMMAND("FAN", CMD_ARG_INT, 0, 100, NULL, 0, "Set fan speed (percent)", cmdFan),
+    COMMAND("FANMIN", CMD_ARG_INT, 0, 100, NULL, 0, "Set fan minimum speed", cmdFanMin),
+    COMMAND("FANMAX", CMD_ARG_INT, 0, 100, NULL, 0, "Set fan maximum speed", cmdFanMax),
+    COMMAND("LIGHTON", CMD_ARG_INT, 0, 23, NULL, 0, "Set light ON hour", cmdLightOn),
+    COMMAND("LIGHTOFF", CMD_ARG_INT, 0, 23, NULL, 0, "Set light OFF hour", cmdLightOff),
+    COMMAND("LIGHTTIME", CMD_ARG_INT, 1, 24, NULL, 0, "Set light duration (h)", cmdLightTime),
+    COMMAND("TIMER", CMD_ARG_INT, 0, 1, NULL, 0, "Disable/enable light timer", cmdTimer),
+    COMMAND("TZ", CMD_ARG_INT, TZ_AUTO, TZ_SUMMER, NULL, 0, "Timezone 0=auto 1=CET 2=CEST", cmdTz),
+    COMMAND("HOST", CMD_ARG_TEXT, 1, 31, NULL, 0, "Set hostname", cmdHost),
+    COMMAND("PHASE", CMD_ARG_CHOICE, 0, 0, "none|seedling|veg|flower|reset", 0,
+            "Start a grow phase", cmdPhase),
+    COMMAND("PHASERESET", CMD_ARG_CHOICE, 0, 0, "all|seedling|veg|flower", 0,
+            "Reset a phase's counters", cmdPhaseReset),
+    COMMAND("RESET", CMD_ARG_NONE, 0, 0, NULL, 0, "Reset all settings", cmdReset),
+    COMMAND("TIME", CMD_ARG_NONE, 0, 0, NULL, CMD_FLAG_CONSOLE, "Show current time", cmdTime),
+    COMMAND("STATUS", CMD_ARG_NONE, 0, 0, NULL, CMD_FLAG_CONSOLE, "Show system status", cmdStatus),
+    COMMAND("DIAG", CMD_ARG_TEXT, 0, 8, NULL, CMD_FLAG_CONSOLE, "Show diagnostics [RESET]", cmdDiag),
+#ifdef DIAG_COMMANDS
+    COMMAND("STALL", CMD_ARG_INT, 0, 5000, NULL, CMD_FLAG_CONSOLE, "Block network task (ms)", cmdStall),
+#endif
+    COMMAND("HELP", CMD_ARG_NONE, 0, 0, NULL, CMD_FLAG_CONSOLE, "Show this help", cmdHelp),
+    COMMAND("?", CMD_ARG_NONE, 0, 0, NULL, CMD_FLAG_CONSOLE, NULL, cmdHelp), // alias, not listed
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+const char *commandSourceName(CommandSource source) {
+  switch (source) {
+  case CMD_SRC_SERIAL:
+    return "serial";
+  case CMD_SRC_HTTP:
+    return "http";
+  case CMD_SRC_BLE:
+    return "ble";
+  default:
+    return "?";
+  }
+}
+
+const char *commandStatusText(CommandStatus status) {
+  switch (status) {
+  case CMD_OK:
+    return "ok";
+  case CMD_UNKNOWN:
+    return "unknown command";
+  case CMD_NOT_ALLOWED:
+    return "not available on this transport";
+  case CMD_MISSING_ARG:
+    return "missing argument";
+  case CMD_BAD_ARG:
+    return "invalid argument";
+  case CMD_OUT_OF_RANGE:
+    return "argument out of range";
+  case CMD_BUSY:
+    return "busy, try again";
+  default:
+    return "error";
+  }
+}
+
+// Case-insensitive lookup.
+const CommandSpec *findCommand(const char *name) {
+  char upper[COMMAND_NAME_MAX];
+  size_t len = strlen(name);
+  if (len == 0 || len >= sizeof(upper))
+    return NULL;
+  for (size_t i = 0; i <= len; i++) {
+    upper[i] = toupper((unsigned char)name[i]);
+  }
+  uint32_t hash = commandHash(upper);
+  for (size_t i = 0; i < COMMAND_COUNT; i++) {
+    if (commands[i].hash == hash && strcmp(commands[i].name, upper) == 0)
+      return &commands[i];
+  }
+  return NULL;
+}
+
+// Formats "<0-100>", "<auto|winter|summer>" or "<text>" for help output.
+void commandUsage(const CommandSpec &spec, char *out, size_t len) {
+  switch (spec.arg) {
+  case CMD_ARG_INT:
+    snprintf(out, len, "%s <%d-%d>", spec.name, spec.min, spec.max);
+    break;
+  case CMD_ARG_CHOICE:
+    snprintf(out, len, "%s <%s>", spec.name, spec.choices);
+    break;
+  case CMD_ARG_TEXT:
+    snprintf(out, len, spec.min > 0 ? "%s <text>" : "%s [text]", spec.name);
+    break;
+  default:
+    snprintf(out, len, "%s", spec.name);
+  }
+}
+
+static int commandChoiceIndex(const char *choices, const char *word) {
+  size_t wordLen = strlen(word);
+  int index = 0;
+  const char *p = choices;
+  while (*p) {
+    const char *end = strchr(p, '|');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    if (len == wordLen && strncasecmp(p, word, len) == 0)
+      return index;
+    if (!end)
+      break;
+    p = end + 1;
+    index++;
+  }
+  return -1;
+}
+
+static CommandStatus commandParse(const CommandSpec &spec, const char *arg,
+                                  CommandArgs &out) {
+  out.value = 0;
+  out.text = arg ? arg : "";
+  size_t len = strlen(out.text);
+
+  switch (spec.arg) {
+  case CMD_ARG_NONE:
+    return CMD_OK;
+  case CMD_ARG_INT: {
+    if (len == 0)
+      return CMD_MISSING_ARG;
+    char *end;
+    long value = strtol(out.text, &end, 10);
+    if (*end != '\0' || len > 7)
+      return CMD_BAD_ARG;
+    if (value < spec.min || value > spec.max)
+      return CMD_OUT_OF_RANGE;
+    out.value = (int)value;
+    return CMD_OK;
+  }
+  case CMD_ARG_CHOICE:
+    if (len == 0)
+      return CMD_MISSING_ARG;
+    out.value = commandChoiceIndex(spec.choices, out.text);
+    return out.value < 0 ? CMD_BAD_ARG : CMD_OK;
+  case CMD_ARG_TEXT:
+    if (len == 0 && spec.min > 0)
+      return CMD_MISSING_ARG;
+    return (int)len < spec.min || (int)len > spec.max ? CMD_OUT_OF_RANGE
+                                                      : CMD_OK;
+  }
+  return CMD_BAD_ARG;
+}
+
+static void commandRecord(CommandSource source, uint32_t us, bool ok) {
+  CommandStats &s = commandStats[source];
+  s.count++;
+  s.parseUs += us;
+  if (us > s.maxParseUs)
+    s.maxParseUs = us;
+  if (!ok)
+    s.errors++;
+}
+
+// Looks up, parses and validates without running, for transports that
+// apply several commands from one request all-or-nothing.
+CommandStatus validateCommand(CommandSource source, const char *name,
+                              const char *arg) {
+  const CommandSpec *spec = findCommand(name);
+  if (spec == NULL)
+    return CMD_UNKNOWN;
+  if ((spec->flags & CMD_FLAG_CONSOLE) && source != CMD_SRC_SERIAL)
+    return CMD_NOT_ALLOWED;
+  CommandArgs args;
+  return commandParse(*spec, arg, args);
+}
+
+struct CommandCall {
+  CommandHandler handler;
+  const CommandArgs *args;
+};
+
+static void runCommandCall(void *arg) {
+  CommandCall *call = (CommandCall *)arg;
+  call->handler(*call->args);
+}
+
+// Looks up, parses and validates `arg` for `source` and records the result.
+static CommandStatus commandPrepare(CommandSource source, const char *name,
+                                    const char *arg, const CommandSpec *&spec,
+                                    CommandArgs &args) {
+  unsigned long start = micros();
+  spec = findCommand(name);
+  CommandStatus status = CMD_UNKNOWN;
+  if (spec != NULL) {
+    if ((spec->flags & CMD_FLAG_CONSOLE) && source != CMD_SRC_SERIAL)
+      status = CMD_NOT_ALLOWED;
+    else
+      status = commandParse(*spec, arg, args);
+  }
+  commandRecord(source, micros() - start, status == CMD_OK);
+  return status;
+}
+
+// Looks up, parses, validates and runs a command. `arg` may be NULL.
+CommandStatus runCommand(CommandSource source, const char *name,
+                         const char *arg) {
+  ALLOC_SCOPE("command");
+  const CommandSpec *spec;
+  CommandArgs args;
+  CommandStatus status = commandPrepare(source, name, arg, spec, args);
+  if (status != CMD_OK)
+    return status;
+
+  if (spec->flags & CMD_FLAG_CONSOLE) {
+    spec->handler(args);
+  } else {
+    CommandCall call = {spec->handler, &args};
+    controlRun(runCommandCall, &call);
+  }
+  return status;
+}
+
+// A validated command queued by controlPost(); integer argument only.
+struct CommandPost {
+  CommandHandler handler;
+  int value;
+};
+
+static_assert(sizeof(CommandPost) <= CONTROL_POST_MAX, "CONTROL_POST_MAX");
+
+static void runCommandPost(void *arg) {
+  CommandPost *post = (CommandPost *)arg;
+  CommandArgs args = {post->value, ""};
+  post->handler(args);
+}
+
+// Same for transports that deliver a binary integer (BLE characteristics).
+// These call from a stack task that must not wait on the control task: the
+// command is validated here and queued, CMD_OK means it was accepted and
+// CMD_BUSY that the queue was full.
+CommandStatus runCommandValue(CommandSource source, const char *name,
+                              int value) {
+  ALLOC_SCOPE("command");
+  char arg[12];
+  const CommandSpec *spec = findCommand(name);
+  if (spec != NULL && spec->arg == CMD_ARG_TEXT) {
+    // The queued call has no room for the text
+    commandRecord(source, 0, false);
+    return CMD_NOT_ALLOWED;
+  }
+  if (spec != NULL && spec->arg == CMD_ARG_CHOICE) {
+    // Map the index back to its word so choices validate the same way.
+    const char *p = spec->choices;
+    for (int i = 0; i < value && p; i++) {
+      p = strchr(p, '|');
+      if (p)
+        p++;
+    }
+    if (p == NULL || value < 0) {
+      commandRecord(source, 0, false);
+      return CMD_OUT_OF_RANGE;
+    }
+    const char *end = strchr(p, '|');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    if (len >= sizeof(arg))
+      len = sizeof(arg) - 1;
+    memcpy(arg, p, len);
+    arg[len] = '\0';
+  } else {
+    snprintf(arg, sizeof(arg), "%d", value);
+  }
+
+  CommandArgs args;
+  CommandStatus status = commandPrepare(source, name, arg, spec, args);
+  if (status != CMD_OK)
+    return status;
+  CommandPost post = {spec->handler, args.value};
+  return controlPost(runCommandPost, &post, sizeof(post)) ? CMD_OK : CMD_BUSY;
+}
+
+static void cmdHelp(const CommandArgs &args) {
+  Serial.println("\n╔════════════════════════════════════════════════╗");
+  Serial.println("║              AVAILABLE COMMANDS                ║");
+  Serial.println("╠════════════════════════════════════════════════╣");
+  char usage[48];
+  for (size_t i = 0; i < COMMAND_COUNT; i++) {
+    if (commands[i].help == NULL)
+      continue;
+    commandUsage(commands[i], usage, sizeof(usage));
+    Serial.printf("║  %-20s- %-24s║\n", usage, commands[i].help);
+  }
+  Serial.println("╚════════════════════════════════════════════════╝\n");
+}
+
+// Registry schema and per-transport parse statistics.
+String getCommandsJSON() {
+  String json = "{\"commands\":[";
+  static const char *argTypes[] = {"none", "int", "choice", "text"};
+  bool first = true;
+  for (size_t i = 0; i < COMMAND_COUNT; i++) {
+    const CommandSpec &c = commands[i];
+    if (c.help == NULL)
+      continue;
+    if (!first)
+      json += ",";
+    first = false;
+    json += "{\"name\":\"" + String(c.name) + "\"";
+    json += ",\"arg\":\"" + String(argTypes[c.arg]) + "\"";
+    if (c.arg == CMD_ARG_INT || c.arg == CMD_ARG_TEXT) {
+      json += ",\"min\":" + String(c.min) + ",\"max\":" + String(c.max);
+    }
+    if (c.arg == CMD_ARG_CHOICE) {
+      json += ",\"choices\":\"" + String(c.choices) + "\"";
+    }
+    json += ",\"console\":" + String((c.flags & CMD_FLAG_CONSOLE) ? "true" : "false");
+    json += ",\"help\":\"" + String(c.help) + "\"}";
+  }
+  json += "],\"stats\":{";
+  for (int s = 0; s < CMD_SRC_COUNT; s++) {
+    const CommandStats &st = commandStats[s];
+    if (s > 0)
+      json += ",";
+    json += "\"" + String(commandSourceName((CommandSource)s)) + "\":{";
+    json += "\"count\":" + String(st.count);
+    json += ",\"errors\":" + String(st.errors);
+    json += ",\"avgParseUs\":" +
+            String(st.count ? (uint32_t)(st.parseUs / st.count) : 0);
+    json += ",\"maxParseUs\":" + String(st.maxParseUs) + "}";
+  }
+  json += "}}";
+  return json;
+}
+
+#endif
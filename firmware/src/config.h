@@ -12,11 +12,118 @@ const int HARDWARE_FAN_MIN_DUTY = 13;
 
 const uint16_t OTA_PORT = 3232;
 
-const char *DEFAULT_HOSTNAME = "growtower";
+const char *const DEFAULT_HOSTNAME = "growtower";
 
 const unsigned long WIFI_RECONNECT_INTERVAL = 30000; // 30 seconds
+#ifdef POWER_SAVE
+const unsigned long CONTROL_INTERVAL = 1000;         // 1 second
+const unsigned long NET_INTERVAL = 1000;             // 1 second
+#else
+const unsigned long CONTROL_INTERVAL = 100;          // 100 ms
+const unsigned long NET_INTERVAL = 100;              // 100 ms
+#endif
+
+// FreeRTOS tasks (tasks.h). Control sits above AsyncTCP (3) and below the
+// WiFi and lwIP tasks; all three are watched by the task watchdog.
+const int CONTROL_TASK_PRIORITY = 10;
+const int CONTROL_TASK_STACK = 4096;
+const int CONTROL_QUEUE_LENGTH = 8;
+const size_t CONTROL_POST_MAX = 40; // argument bytes copied by controlPost()
+const int NET_TASK_PRIORITY = 2;
+const int NET_TASK_STACK = 6144;
+const int PERSIST_TASK_PRIORITY = 1;
+const int PERSIST_TASK_STACK = 6144; // LittleFS appends, deletes, reset
+const int PERSIST_QUEUE_LENGTH = 8;
+const unsigned long PERSIST_TASK_INTERVAL = 2000; // 2 s, longest sleep
+const uint32_t TASK_WDT_TIMEOUT = 10;             // seconds
+const uint32_t TASK_STACK_WARN = 512; // bytes never used, below: log a warning
+
+// /api/status?since=<version> holds the request until the state changes.
+const unsigned long STATUS_LONGPOLL_TIMEOUT = 25000; // 25 seconds
+const int STATUS_LONGPOLL_MAX = 4;                   // concurrent held requests
+
+const char *const NTP_SERVER = "pool.ntp.org";
+const char *const TZ_INFO = "CET-1CEST,M3.5.0,M10.5.0/3"; // Europe/Berlin
+
+// Time cache: last known epoch is kept in RTC memory (every second) and
+// mirrored to NVS so the light timer can run right after a reboot.
+const unsigned long TIME_CACHE_RTC_INTERVAL = 1000;    // 1 second
+const unsigned long TIME_CACHE_NVS_INTERVAL = 1800000; // 30 minutes
+const unsigned long TIME_WARNING_INTERVAL = 60000;     // 60 seconds
+const time_t MIN_VALID_EPOCH = 1483228800;             // 2017-01-01
+const long MAX_TIME_DRIFT = 43200;                     // 12 hours
+
+// Actuator history ring sizes (4 bytes per slot, ~7.8 KB in total).
+const int HISTORY_MINUTE_SLOTS = 1440; // 24 hours of minutes
+const int HISTORY_HOUR_SLOTS = 336;    // 14 days of hours
+const int HISTORY_DAY_SLOTS = 180;     // ~6 months of days
+
+// Long-term telemetry on the LittleFS partition; oldest days are dropped
+// once the store grows past this.
+const unsigned long TELEMETRY_MAX_BYTES = 512UL * 1024; // 512 KB
+
+// Light/fan usage counters are saved at midnight, on phase changes and at
+// this interval.
+const unsigned long USAGE_SAVE_INTERVAL = 21600000; // 6 hours
+
+// BLE GATT control (lib/GrowTowerBLE). Writes are dispatched through the
+// command registry like serial and HTTP commands.
+// #define ENABLE_BLE
+
+// Async logger (logger.h): lines kept for the drain task and /api/logs
+// (~112 bytes each; must be a power of two) and the drain task period.
+const int LOG_RING_SIZE = 64;
+#ifdef POWER_SAVE
+const unsigned long LOG_DRAIN_INTERVAL = 200; // 200 ms
+#else
+const unsigned long LOG_DRAIN_INTERVAL = 20; // 20 ms
+#endif
+
+// NVS wear accounting (nvswear.h). The partition size matches the default
+// partition table; flash endurance is the datasheet minimum. Once a day's
+// writes pass the budget, time cache, periodic usage and fan speed saves are
+// skipped until the next local day.
+const uint32_t NVS_PARTITION_SIZE = 0x5000; // 20 KB
+const uint32_t NVS_FLASH_ENDURANCE = 100000; // erase cycles
+const uint32_t NVS_DAILY_BUDGET = 16384; // bytes per day
+const unsigned long NVS_WEAR_SAVE_INTERVAL = 21600000; // 6 hours, at most this often
+const uint32_t NVS_WEAR_SAVE_BYTES = 8192; // booked since the last save
+
+// Deferred persistence (persist.h): settings, phase data and logbook edits
+// are written this long after the first unsaved change.
+const unsigned long PERSIST_DELAY = 5000; // 5 seconds
+
+// Optional supply-sense input: a divider on the raw supply ahead of the
+// regulator, with enough bulk capacitance behind it to hold 3.3 V for a
+// flush (maxFlushMs in /api/persist). Its falling edge flushes pending
+// changes before the rail collapses.
+// #define POWER_FAIL_PIN D3
+
+// Power management (power.h). Power-save builds (env:main_lowpower) scale
+// the CPU clock within this range and light sleep when idle.
+const int POWER_CPU_MAX_MHZ = 160;
+const int POWER_CPU_MIN_MHZ = 40;
+const int POWER_LISTEN_INTERVAL = 3; // beacons between radio wake-ups
+
+// Current model behind /api/power: typical ESP32-C3 datasheet figures at
+// 3.3 V, sampled every POWER_SAMPLE_INTERVAL.
+const unsigned long POWER_SAMPLE_INTERVAL = 60000; // 1 minute
+const float POWER_MA_RUN = 24.0;          // CPU running at 160 MHz
+const float POWER_MA_IDLE_MAX = 16.0;     // CPU idle at 160 MHz
+const float POWER_MA_IDLE_MIN = 10.0;     // CPU idle at 40 MHz
+const float POWER_MA_LIGHT_SLEEP = 0.13;  // light sleep, RC clock on
+const float POWER_MA_RADIO = 84.0;        // receiver on (added to the CPU)
+const float POWER_BEACON_MS = 102.4;      // beacon interval of most APs
+const float POWER_RADIO_WAKE_MS = 5.0;    // receiver on per beacon listened to
+const float POWER_RADIO_MS_PER_REQUEST = 20.0; // receiver on per HTTP request
+
+// Allocation tracker (allocstats.h, env:main_alloc only): free heap and
+// largest free block sampled every 15 minutes, 24 hours kept.
+const unsigned long ALLOC_TREND_INTERVAL = 900000; // 15 minutes
+const int ALLOC_TREND_SLOTS = 96;
 
-const char *NTP_SERVER = "pool.ntp.org";
-const char *TZ_INFO = "CET-1CEST,M3.5.0,M10.5.0/3"; // Europe/Berlin
+// Optional status LED used instead of the grow light for "no time" indication.
+// The XIAO ESP32C3 has no user LED, so it is disabled by default.
+// #define STATUS_LED_PIN D10
 
 #endif
@@ -0,0 +1,696 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <time.h>
+
+#include "config.h"
+#include "logbook.h"
+#include "logger.h"
+#include "nvswear.h"
+#include "persist.h"
+#include "state.h"
+#include "timecache.h"
+#include "usage.h"
+
+// Light, fan, timer and grow-phase control plus the settings behind them.
+// Everything here talks to the hardware only through Arduino calls
+// (digitalWrite, ledc*, Preferences, getLocalTime), so the same code runs on
+// the device and in the native build against the shims in native/include.
+// Networking, OTA and the web server stay in main.cpp.
+
+WearPreferences preferences;
+FixedString<31> currentHostname("growtower");
+
+int fanMinPercent = 0;
+int fanMaxPercent = 100;
+int lightOnHour = 10;   // One Bud Method only Flower
+int lightDuration = 12; // One Bud Method only Flower
+bool timerEnabled = true;
+
+bool isLightOn = false;
+int currentFanSpeed = 30;
+int currentFanDuty = 0;
+uint32_t lightSwitchCount = 0;
+uint32_t nvsCommitCount = 0;
+volatile uint32_t stateVersion = 1;
+portMUX_TYPE stateVersionMux = portMUX_INITIALIZER_UNLOCKED;
+int lastStatusMinute = -1;
+int lastUsageSignature = -1;
+uint64_t lightOnAccumMillis = 0;
+unsigned long lightOnSince = 0;
+TimezoneMode currentTzMode = TZ_AUTO;
+
+FixedString<31> wifiSSID;
+FixedString<63> wifiPass;
+
+// Indexed by PlantPhase; [PHASE_NONE] is unused.
+PhaseData phases[4] = {{0, false}, {0, false}, {0, false}, {0, false}};
+PlantPhase currentPhase = PHASE_NONE;
+
+// Day counters are cached and only recomputed when one of them rolls over
+// (phaseDaysValidUntil) or a phase changes, so the status path does no time
+// conversion.
+int phaseDays[4] = {0, 0, 0, 0};
+int totalDays = 0;
+time_t phaseDaysComputedAt = 0;
+time_t phaseDaysValidUntil = 0;
+
+// Phase data record body; start times fit 32 bits like the NVS longs they
+// replaced.
+struct PhaseRecord {
+  int32_t startTime[3]; // seedling, veg, flower
+  uint8_t active[3];
+  uint8_t reserved;
+};
+
+static void savePhaseRecord(PersistOut &out) {
+  PhaseRecord record;
+  memset(&record, 0, sizeof(record));
+  for (int p = PHASE_SEEDLING; p <= PHASE_FLOWER; p++) {
+    record.startTime[p - 1] = (int32_t)phases[p].startTime;
+    record.active[p - 1] = phases[p].active ? 1 : 0;
+  }
+  out.write(&record, sizeof(record));
+}
+
+static bool loadPhaseRecord(PersistIn &in, size_t length) {
+  PhaseRecord record;
+  if (length != sizeof(record) || !in.read(&record, sizeof(record)))
+    return false;
+  for (int p = PHASE_SEEDLING; p <= PHASE_FLOWER; p++) {
+    phases[p].startTime = record.startTime[p - 1];
+    phases[p].active = record.active[p - 1] != 0;
+  }
+  return true;
+}
+
+PersistRecord phaseRecord = {{"phases0", "phases1"}, false, savePhaseRecord,
+                             loadPhaseRecord, 0, 1};
+
+// Keys of the phase data before the record format; migrated on first boot.
+const char *const legacyPhaseKeys[] = {"seedlingStart", "vegStart",
+                                       "flowerStart",   "seedlingActive",
+                                       "vegActive",     "flowerActive"};
+
+const char *getTimezoneString() {
+  switch (currentTzMode) {
+  case TZ_WINTER:
+    return "CET-1";
+  case TZ_SUMMER:
+    return "CEST-2";
+  case TZ_AUTO:
+  default:
+    return TZ_INFO;
+  }
+}
+
+void applyTimezone() {
+  switch (currentTzMode) {
+  case TZ_WINTER:
+    LOGI("TIME", "Mode: Winter (CET-1)");
+    break;
+  case TZ_SUMMER:
+    LOGI("TIME", "Mode: Summer (CEST-2)");
+    break;
+  case TZ_AUTO:
+  default:
+    LOGI("TIME", "Mode: Auto (Europe/Berlin)");
+    break;
+  }
+  configTzTime(getTimezoneString(), NTP_SERVER);
+}
+
+// The status ETag only tracks the state version, so refresh it when the
+// day or usage counters shown in the UI change.
+void checkDayRollover(const struct tm &timeinfo) {
+  time_t now = time(nullptr);
+  if (now >= phaseDaysValidUntil || now < phaseDaysComputedAt) {
+    refreshPhaseDays();
+  }
+
+  if (timeinfo.tm_min == lastStatusMinute)
+    return;
+  lastStatusMinute = timeinfo.tm_min;
+  nvsWearCheckDay(usageDayNumber(timeinfo));
+  checkUsage(timeinfo);
+
+  int signature = usageSignature();
+  if (signature != lastUsageSignature) {
+    lastUsageSignature = signature;
+    bumpStateVersion();
+  }
+}
+
+void bumpStateVersion() {
+  portENTER_CRITICAL(&stateVersionMux);
+  stateVersion++;
+  portEXIT_CRITICAL(&stateVersionMux);
+}
+
+void initPWM() {
+  ledcSetup(PWM_CHANNEL, PWM_FREQUENCY, PWM_RESOLUTION);
+  ledcAttachPin(FAN_PIN, PWM_CHANNEL);
+  Serial.printf("[PWM] Initialized: Channel=%d, Freq=%dHz, Resolution=%dbit\n",
+                PWM_CHANNEL, PWM_FREQUENCY, PWM_RESOLUTION);
+}
+
+// Reads a string setting straight into `out`. A missing key, or a value
+// longer than `out` holds, gives `defaultValue`.
+template <size_t N>
+void loadString(const char *key, FixedString<N> &out, const char *defaultValue) {
+  char buffer[N + 1];
+  if (preferences.getString(key, buffer, sizeof(buffer)) > 0)
+    out = buffer;
+  else
+    out = defaultValue;
+}
+
+void loadSettings() {
+  loadNvsWear();
+  preferences.begin("growtower", true);
+
+  fanMinPercent = preferences.getInt("fanMin", 0);
+  fanMaxPercent = preferences.getInt("fanMax", 100);
+  currentFanSpeed = preferences.getInt("fanSpeed", 30);
+  lightOnHour = preferences.getInt("onHour", 10);
+  lightDuration = preferences.getInt("duration", 12);
+  timerEnabled = preferences.getBool("timerEnabled", true);
+  currentTzMode = (TimezoneMode)preferences.getInt("tzMode", (int)TZ_AUTO);
+
+  loadString("hostname", currentHostname, DEFAULT_HOSTNAME);
+  loadString("ssid", wifiSSID, "");
+  loadString("pass", wifiPass, "");
+
+  preferences.end();
+
+  loadPhaseData();
+  loadLogbook();
+
+  Serial.printf("[CONFIG] Loaded: FanMin=%d%%, FanMax=%d%%, FanSpeed=%d%%, "
+                "LightOn=%d:00, Duration=%dh, "
+                "Hostname=%s, TzMode=%d\n",
+                fanMinPercent, fanMaxPercent, currentFanSpeed, lightOnHour,
+                lightDuration, currentHostname.c_str(), (int)currentTzMode);
+}
+
+void commitPreferences(WearPreferences &prefs) {
+  nvsWearCommit(prefs);
+  prefs.end();
+  nvsCommitCount++;
+}
+
+// The save* setters expect input already validated against the command
+// registry ranges (commands.h). They change RAM at once and leave the
+// write to the next flush (persist.h).
+void saveFanSpeed(int percent) {
+  currentFanSpeed = percent;
+  persistMark(CFG_FAN_SPEED);
+
+  LOGI("CONFIG", "Fan Speed saved: %d%%", currentFanSpeed);
+  bumpStateVersion();
+  setFan(currentFanSpeed);
+}
+
+void saveFanMin(int minVal) {
+  fanMinPercent = minVal;
+  persistMark(CFG_FAN_MIN);
+
+  LOGI("CONFIG", "Fan Min saved: %d%%", fanMinPercent);
+  bumpStateVersion();
+  setFan(currentFanSpeed);
+}
+
+void saveFanMax(int maxVal) {
+  fanMaxPercent = maxVal;
+  persistMark(CFG_FAN_MAX);
+
+  LOGI("CONFIG", "Fan Max saved: %d%%", fanMaxPercent);
+  bumpStateVersion();
+  setFan(currentFanSpeed);
+}
+
+void saveLightOnHour(int hour) {
+  lightOnHour = hour;
+  persistMark(CFG_LIGHT_ON);
+
+  LOGI("CONFIG", "Light On Hour saved: %d:00", lightOnHour);
+  bumpStateVersion();
+  checkTimer();
+}
+
+void saveLightDuration(int hours) {
+  lightDuration = hours;
+  persistMark(CFG_LIGHT_DURATION);
+
+  LOGI("CONFIG", "Light Duration saved: %dh", lightDuration);
+  bumpStateVersion();
+  checkTimer();
+}
+
+void saveTimerEnabled(bool enabled) {
+  timerEnabled = enabled;
+  persistMark(CFG_TIMER_ENABLED);
+
+  LOGI("CONFIG", "Timer enabled: %s", timerEnabled ? "true" : "false");
+  bumpStateVersion();
+  checkTimer();
+}
+
+void saveTzMode(TimezoneMode mode) {
+  currentTzMode = mode;
+  persistMark(CFG_TZ_MODE);
+
+  LOGI("CONFIG", "Timezone mode saved: %d", (int)currentTzMode);
+  bumpStateVersion();
+  applyTimezone();
+}
+
+// Applies a pre-validated batch of settings, persisted by one flush, and
+// runs each side effect (fan, timezone, timer) at most once.
+void applyConfig(const ConfigUpdate &update) {
+  uint16_t changed = 0;
+
+  if ((update.fields & CFG_FAN_SPEED) && update.fanSpeed != currentFanSpeed) {
+    currentFanSpeed = update.fanSpeed;
+    changed |= CFG_FAN_SPEED;
+  }
+  if ((update.fields & CFG_FAN_MIN) && update.fanMin != fanMinPercent) {
+    fanMinPercent = update.fanMin;
+    changed |= CFG_FAN_MIN;
+  }
+  if ((update.fields & CFG_FAN_MAX) && update.fanMax != fanMaxPercent) {
+    fanMaxPercent = update.fanMax;
+    changed |= CFG_FAN_MAX;
+  }
+  if ((update.fields & CFG_LIGHT_ON) && update.lightOnHour != lightOnHour) {
+    lightOnHour = update.lightOnHour;
+    changed |= CFG_LIGHT_ON;
+  }
+  if ((update.fields & CFG_LIGHT_DURATION) &&
+      update.lightDuration != lightDuration) {
+    lightDuration = update.lightDuration;
+    changed |= CFG_LIGHT_DURATION;
+  }
+  if ((update.fields & CFG_TIMER_ENABLED) &&
+      update.timerEnabled != timerEnabled) {
+    timerEnabled = update.timerEnabled;
+    changed |= CFG_TIMER_ENABLED;
+  }
+  bool tzChanged = (update.fields & CFG_TZ_MODE) && update.tzMode != currentTzMode;
+  if (tzChanged) {
+    currentTzMode = update.tzMode;
+    changed |= CFG_TZ_MODE;
+  }
+
+  if (changed != 0) {
+    persistMark(changed);
+    bumpStateVersion();
+  }
+
+  LOGI("CONFIG", "Batch applied: %d of %d fields changed",
+       __builtin_popcount(changed), __builtin_popcount(update.fields));
+
+  if (update.fields & (CFG_FAN_SPEED | CFG_FAN_MIN | CFG_FAN_MAX)) {
+    setFan(currentFanSpeed);
+  }
+  if (tzChanged) {
+    applyTimezone();
+  }
+  if (update.fields & (CFG_LIGHT_ON | CFG_LIGHT_DURATION | CFG_TIMER_ENABLED)) {
+    checkTimer();
+  }
+}
+
+// Runs on the persistence task (persistRequestRestart()).
+void resetAllSettings() {
+  Serial.println("[SYS] Resetting all settings to defaults...");
+  // Nothing pending or in flight may write the cleared settings back before
+  // the restart; this also keeps the flush lock, and with it persistPrefs,
+  // until then.
+  persistDiscard();
+  persistPrefs.begin("growtower", false);
+  persistPrefs.clear();
+  commitPreferences(persistPrefs);
+  persistRemove(phaseRecord);
+  persistRemove(logbookRecord);
+
+  Serial.println("[SYS] Settings cleared. Rebooting...");
+  delay(1000);
+  ESP.restart();
+}
+
+void saveHostname(const char *hostname) {
+  {
+    PersistStateLock lock;
+    currentHostname = hostname;
+  }
+  persistMark(PERSIST_HOSTNAME);
+
+  LOGI("CONFIG", "Hostname saved: %s", currentHostname.c_str());
+  bumpStateVersion();
+}
+
+void saveWiFiCredentials(const char *ssid, const char *pass) {
+  {
+    PersistStateLock lock;
+    wifiSSID = ssid;
+    wifiPass = pass;
+  }
+  persistMark(PERSIST_WIFI);
+
+  Serial.println("[CONFIG] WiFi credentials saved. Restarting...");
+  persistRequestRestart(PERSIST_RESTART_FLUSH);
+}
+
+void setLight(bool on) {
+  unsigned long now = millis();
+  if (on && !isLightOn) {
+    lightOnSince = now;
+    lightSwitchCount++;
+  } else if (!on && isLightOn) {
+    lightOnAccumMillis += now - lightOnSince;
+    lightSwitchCount++;
+  }
+  if (on != isLightOn) {
+    usageOnLightSwitch();
+    bumpStateVersion();
+  }
+
+  if (on) {
+    digitalWrite(LIGHT_PIN, HIGH);
+    LOGI("LIGHT", "State: ON");
+  } else {
+    digitalWrite(LIGHT_PIN, LOW);
+    LOGI("LIGHT", "State: OFF");
+  }
+  isLightOn = on;
+}
+
+uint64_t getLightOnMillis() {
+  if (isLightOn) {
+    return lightOnAccumMillis + (millis() - lightOnSince);
+  }
+  return lightOnAccumMillis;
+}
+
+void setFan(int percent) {
+  if (percent < 0)
+    percent = 0;
+  if (percent > 100)
+    percent = 100;
+
+  bool changed = percent != currentFanSpeed;
+  currentFanSpeed = percent;
+  int dutyCycle = 0;
+
+  if (percent == 0) {
+    dutyCycle = 0;
+  } else {
+    int effectiveMin = fanMinPercent;
+    int effectiveMax = fanMaxPercent;
+    if (effectiveMin > effectiveMax) {
+      effectiveMin = effectiveMax;
+    }
+
+    long mappedPercent = map(percent, 1, 100, effectiveMin, effectiveMax);
+    dutyCycle =
+        map(mappedPercent, 0, 100, HARDWARE_FAN_MIN_DUTY, MAX_DUTY_CYCLE);
+  }
+
+  ledcWrite(PWM_CHANNEL, dutyCycle);
+  if (dutyCycle != currentFanDuty) {
+    usageSettle();
+  }
+  if (changed || dutyCycle != currentFanDuty) {
+    bumpStateVersion();
+  }
+  currentFanDuty = dutyCycle;
+
+  LOGI("FAN", "Speed: %d%% (Effective Range: %d%%-%d%%, Duty: %d/255)",
+       percent, fanMinPercent, fanMaxPercent, dutyCycle);
+}
+
+void checkTimer() {
+  if (!timerEnabled) {
+    return;
+  }
+
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo, 0)) {
+    return;
+  }
+
+  int currentHour = timeinfo.tm_hour;
+  bool shouldBeOn = false;
+
+  int lightOffHour = lightOnHour + lightDuration;
+  if (lightOffHour >= 24)
+    lightOffHour -= 24;
+
+  if (lightOnHour > lightOffHour) {
+    shouldBeOn = (currentHour >= lightOnHour || currentHour < lightOffHour);
+  } else {
+    shouldBeOn = (currentHour >= lightOnHour && currentHour < lightOffHour);
+  }
+
+  if (shouldBeOn != isLightOn) {
+    LOGI("TIMER",
+         "Time: %02d:%02d | Light: %02d:00-%02d:00 | Auto-switching light %s",
+         currentHour, timeinfo.tm_min, lightOnHour, lightOffHour,
+         shouldBeOn ? "ON" : "OFF");
+    setLight(shouldBeOn);
+  }
+}
+
+void loadPhaseData() {
+  persistPrefs.begin("growtower", true);
+  bool loaded = persistLoad(phaseRecord);
+  persistPrefs.end();
+
+  if (!loaded) {
+    preferences.begin("growtower", true);
+    if (preferences.isKey("seedlingActive")) {
+      phases[PHASE_SEEDLING].startTime = preferences.getLong("seedlingStart", 0);
+      phases[PHASE_VEG].startTime = preferences.getLong("vegStart", 0);
+      phases[PHASE_FLOWER].startTime = preferences.getLong("flowerStart", 0);
+
+      phases[PHASE_SEEDLING].active = preferences.getBool("seedlingActive", false);
+      phases[PHASE_VEG].active = preferences.getBool("vegActive", false);
+      phases[PHASE_FLOWER].active = preferences.getBool("flowerActive", false);
+
+      persistLegacy |= PERSIST_PHASES;
+      persistMark(PERSIST_PHASES);
+    }
+    preferences.end();
+  }
+
+  currentPhase = PHASE_NONE;
+  if (phases[PHASE_SEEDLING].active)
+    currentPhase = PHASE_SEEDLING;
+  else if (phases[PHASE_VEG].active)
+    currentPhase = PHASE_VEG;
+  else if (phases[PHASE_FLOWER].active)
+    currentPhase = PHASE_FLOWER;
+
+  Serial.printf("[PHASE] Loaded: Seedling=%d, Veg=%d, Flower=%d, Current=%d\n",
+                phases[PHASE_SEEDLING].active ? 1 : 0,
+                phases[PHASE_VEG].active ? 1 : 0,
+                phases[PHASE_FLOWER].active ? 1 : 0, currentPhase);
+}
+
+void savePhaseData() { persistMark(PERSIST_PHASES); }
+
+// Writes what persistMark() collected: the logbook file first, then the
+// settings, strings, counters and phase data in one NVS session, and last
+// the pre-record keys of anything just migrated. Called by persistFlush()
+// only.
+void savePending(uint16_t what) {
+  // Scripts may drive the fan continuously; over budget the speed applies
+  // but is not persisted. The time cache is only a fallback for power cuts.
+  if ((what & CFG_FAN_SPEED) && !nvsWearAllow("fan speed"))
+    what &= ~CFG_FAN_SPEED;
+  if ((what & PERSIST_TIME_CACHE) && !nvsWearAllow("time cache"))
+    what &= ~PERSIST_TIME_CACHE;
+
+  bool logbookSaved = (what & PERSIST_LOGBOOK) && saveLogbook();
+  if (!(what & ~PERSIST_LOGBOOK) &&
+      !(logbookSaved && (persistLegacy & PERSIST_LOGBOOK)))
+    return;
+
+  persistPrefs.begin("growtower", false);
+  if (what & CFG_FAN_SPEED)
+    persistPrefs.putInt("fanSpeed", currentFanSpeed);
+  if (what & CFG_FAN_MIN)
+    persistPrefs.putInt("fanMin", fanMinPercent);
+  if (what & CFG_FAN_MAX)
+    persistPrefs.putInt("fanMax", fanMaxPercent);
+  if (what & CFG_LIGHT_ON)
+    persistPrefs.putInt("onHour", lightOnHour);
+  if (what & CFG_LIGHT_DURATION)
+    persistPrefs.putInt("duration", lightDuration);
+  if (what & CFG_TIMER_ENABLED)
+    persistPrefs.putBool("timerEnabled", timerEnabled);
+  if (what & CFG_TZ_MODE)
+    persistPrefs.putInt("tzMode", (int)currentTzMode);
+  if (what & (PERSIST_HOSTNAME | PERSIST_WIFI)) {
+    FixedString<31> hostname, ssid;
+    FixedString<63> pass;
+    {
+      PersistStateLock lock;
+      hostname = currentHostname;
+      ssid = wifiSSID;
+      pass = wifiPass;
+    }
+    if (what & PERSIST_HOSTNAME)
+      persistPrefs.putString("hostname", hostname.c_str());
+    if (what & PERSIST_WIFI) {
+      persistPrefs.putString("ssid", ssid.c_str());
+      persistPrefs.putString("pass", pass.c_str());
+    }
+  }
+  if (what & PERSIST_USAGE)
+    persistUsage(persistPrefs);
+  persistTimeCache(persistPrefs, what);
+
+  if ((what & PERSIST_PHASES) && persistStore(phaseRecord) &&
+      (persistLegacy & PERSIST_PHASES)) {
+    for (size_t i = 0; i < sizeof(legacyPhaseKeys) / sizeof(legacyPhaseKeys[0]); i++)
+      persistPrefs.remove(legacyPhaseKeys[i]);
+    persistLegacy &= ~PERSIST_PHASES;
+  }
+  if (logbookSaved && (persistLegacy & PERSIST_LOGBOOK)) {
+    persistPrefs.remove("logbook");
+    persistLegacy &= ~PERSIST_LOGBOOK;
+  }
+  commitPreferences(persistPrefs);
+}
+
+void setPhase(PlantPhase phase) {
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo, 0)) {
+    LOGW("PHASE", "Cannot set phase: NTP time not available");
+    return;
+  }
+
+  time_t now = mktime(&timeinfo);
+  usageSettle();
+
+  {
+    PersistStateLock lock;
+    if (phase == PHASE_NONE) {
+      phases[PHASE_SEEDLING].active = false;
+      phases[PHASE_VEG].active = false;
+      phases[PHASE_FLOWER].active = false;
+      currentPhase = PHASE_NONE;
+      LOGI("PHASE", "All phases reset");
+    } else {
+      phases[PHASE_SEEDLING].active = (phase == PHASE_SEEDLING);
+      phases[PHASE_VEG].active = (phase == PHASE_VEG);
+      phases[PHASE_FLOWER].active = (phase == PHASE_FLOWER);
+
+      if (phase == PHASE_SEEDLING && phases[PHASE_SEEDLING].startTime == 0) {
+        phases[PHASE_SEEDLING].startTime = now;
+      } else if (phase == PHASE_VEG && phases[PHASE_VEG].startTime == 0) {
+        phases[PHASE_VEG].startTime = now;
+      } else if (phase == PHASE_FLOWER && phases[PHASE_FLOWER].startTime == 0) {
+        phases[PHASE_FLOWER].startTime = now;
+      }
+
+      currentPhase = phase;
+
+      const char *phaseNames[] = {"None", "Seedling", "Veg", "Flower"};
+      LOGI("PHASE", "Set to: %s", phaseNames[phase]);
+    }
+  }
+
+  savePhaseData();
+  saveUsage();
+  refreshPhaseDays();
+  bumpStateVersion();
+}
+
+// Recomputes the cached day counters and the time at which the next one
+// rolls over. Called on phase changes and from checkDayRollover().
+void refreshPhaseDays() {
+  time_t now = time(nullptr);
+  if (now <= MIN_VALID_EPOCH)
+    return;
+
+  int days[4] = {0, 0, 0, 0};
+  int total = 0;
+  time_t validUntil = now + 86400;
+  for (int p = PHASE_SEEDLING; p <= PHASE_FLOWER; p++) {
+    time_t start = phases[p].startTime;
+    if (start != 0 && now > start) {
+      days[p] = (now - start) / 86400;
+      time_t next = start + (time_t)(days[p] + 1) * 86400;
+      if (next < validUntil)
+        validUntil = next;
+    }
+    total += days[p];
+  }
+
+  bool changed = total != totalDays;
+  for (int p = PHASE_SEEDLING; p <= PHASE_FLOWER; p++) {
+    changed |= days[p] != phaseDays[p];
+    phaseDays[p] = days[p];
+  }
+  totalDays = total;
+  phaseDaysComputedAt = now;
+  phaseDaysValidUntil = validUntil;
+  if (changed) {
+    bumpStateVersion();
+  }
+}
+
+int getPhaseDays(PlantPhase phase) { return phaseDays[phase]; }
+
+int getTotalDays() { return totalDays; }
+
+void resetPhase(PlantPhase phase) {
+  {
+    PersistStateLock lock;
+    phases[phase].startTime = 0;
+    phases[phase].active = false;
+  }
+
+  usageResetPhase(phase);
+  if (currentPhase == phase) {
+    currentPhase = PHASE_NONE;
+  }
+
+  savePhaseData();
+  saveUsage();
+  refreshPhaseDays();
+  bumpStateVersion();
+
+  const char *phaseNames[] = {"All", "Seedling", "Veg", "Flower"};
+  LOGI("PHASE", "Reset: %s", phaseNames[phase]);
+}
+
+String getPhaseJSON() {
+  const char *phaseNames[] = {"none", "seedling", "veg", "flower"};
+
+  String json = "\"phase\":\"" + String(phaseNames[currentPhase]) + "\",";
+  json += "\"currentPhase\":" + String(currentPhase) + ",";
+  json += "\"totalDays\":" + String(getTotalDays()) + ",";
+  json += "\"seedling\":{\"active\":" +
+          String(phases[PHASE_SEEDLING].active ? "true" : "false") +
+          ",\"days\":" + String(getPhaseDays(PHASE_SEEDLING)) + "," +
+          getPhaseUsageJSON(PHASE_SEEDLING) + "},";
+  json += "\"veg\":{\"active\":" +
+          String(phases[PHASE_VEG].active ? "true" : "false") +
+          ",\"days\":" + String(getPhaseDays(PHASE_VEG)) + "," +
+          getPhaseUsageJSON(PHASE_VEG) + "},";
+  json += "\"flower\":{\"active\":" +
+          String(phases[PHASE_FLOWER].active ? "true" : "false") +
+          ",\"days\":" + String(getPhaseDays(PHASE_FLOWER)) + "," +
+          getPhaseUsageJSON(PHASE_FLOWER) + "},";
+  json += getUsageJSON();
+
+  return json;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef CONTROLQUEUE_H
+#define CONTROLQUEUE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "config.h"
+
+// State changes from the other tasks (HTTP handlers in the AsyncTCP task,
+// the serial console in the network task, BLE callbacks) are handed to the
+// control task (tasks.h) through controlQueue and run there, so the
+// settings and the actuators only ever change on one task. NVS and LittleFS
+// writes are not made there: after setup() they all go through persistFlush()
+// (persist.h), serialised by its lock whichever task calls it.
+//
+// controlRun() blocks its caller until the call has run: the control task has
+// the higher priority, so that is the handler's own run time, and pointers
+// into the caller's stack stay valid. controlPost() is for callers that must
+// not wait on the control task at all (the Bluedroid task): it copies its
+// argument into the queue entry and returns at once.
+
+struct ControlCall {
+  void (*fn)(void *arg);
+  SemaphoreHandle_t done; // given once fn has returned, NULL when posted
+  union {
+    void *arg;                      // controlRun()
+    uint8_t data[CONTROL_POST_MAX]; // controlPost(), pointer-aligned
+  };
+};
+
+struct ControlQueueStats {
+  uint32_t calls;
+  uint32_t maxWaitUs; // queueing plus run time, seen by the caller
+  uint32_t posts;
+  uint32_t postsDropped; // queue full, the caller answered "busy"
+};
+
+QueueHandle_t controlQueue = NULL;
+TaskHandle_t controlTask = NULL;
+volatile bool controlTaskRunning = false;
+ControlQueueStats controlQueueStats;
+
+// Runs fn(arg) on the control task and waits for it. Before that task runs
+// (setup(), host builds) and on the control task itself, runs it directly.
+void controlRun(void (*fn)(void *arg), void *arg) {
+  if (!controlTaskRunning || xTaskGetCurrentTaskHandle() == controlTask) {
+    fn(arg);
+    return;
+  }
+  unsigned long start = micros();
+  StaticSemaphore_t doneBuffer;
+  ControlCall call;
+  call.fn = fn;
+  call.done = xSemaphoreCreateBinaryStatic(&doneBuffer);
+  call.arg = arg;
+  xQueueSend(controlQueue, &call, portMAX_DELAY);
+  xSemaphoreTake(call.done, portMAX_DELAY);
+  vSemaphoreDelete(call.done);
+
+  uint32_t waited = micros() - start;
+  controlQueueStats.calls++;
+  if (waited > controlQueueStats.maxWaitUs)
+    controlQueueStats.maxWaitUs = waited;
+}
+
+// Queues fn() with a copy of the `len` bytes at `data` and returns without
+// waiting; fn gets a pointer to the copy. False if the queue is full. Before
+// the control task runs and on the control task itself, runs it directly.
+bool controlPost(void (*fn)(void *arg), const void *data, size_t len) {
+  if (len > CONTROL_POST_MAX)
+    return false;
+  ControlCall call;
+  call.fn = fn;
+  call.done = NULL;
+  memcpy(call.data, data, len);
+  if (!controlTaskRunning || xTaskGetCurrentTaskHandle() == controlTask) {
+    fn(call.data);
+    return true;
+  }
+  if (xQueueSend(controlQueue, &call, 0) != pdTRUE) {
+    controlQueueStats.postsDropped++;
+    return false;
+  }
+  controlQueueStats.posts++;
+  return true;
+}
+
+// Control task side: waits up to `ticks` for one call and runs it. False if
+// none arrived.
+bool controlServe(TickType_t ticks) {
+  ControlCall call;
+  if (xQueueReceive(controlQueue, &call, ticks) != pdTRUE)
+    return false;
+  if (call.done != NULL) {
+    call.fn(call.arg);
+    xSemaphoreGive(call.done);
+  } else {
+    call.fn(call.data);
+  }
+  return true;
+}
+
+#endif
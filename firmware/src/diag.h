@@ -0,0 +1,271 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "allocstats.h"
+#include "config.h"
+#include "controlqueue.h"
+
+// Control task jitter histogram: deviation of its period from
+// CONTROL_INTERVAL (tasks.h).
+#define DIAG_JITTER_BUCKETS 10
+const uint32_t diagJitterBoundsMs[DIAG_JITTER_BUCKETS - 1] = {
+    1, 2, 5, 10, 50, 100, 500, 1000, 5000};
+
+#define DIAG_MAX_TASKS 24
+
+enum DiagSectionId { DIAG_CHECK_TIMER, DIAG_CHECK_WIFI, DIAG_SECTION_COUNT };
+
+struct DiagSection {
+  const char *name;
+  uint32_t count;
+  uint64_t totalUs;
+  uint32_t maxUs;
+  uint32_t lastUs;
+};
+
+DiagSection diagSections[DIAG_SECTION_COUNT] = {
+    {"checkTimer", 0, 0, 0, 0},
+    {"checkWiFi", 0, 0, 0, 0},
+};
+
+uint32_t diagJitterHist[DIAG_JITTER_BUCKETS] = {0};
+uint32_t diagLoopCount = 0;
+uint32_t diagLoopMinUs = UINT32_MAX;
+uint32_t diagLoopMaxUs = 0;
+uint64_t diagLoopTotalUs = 0;
+unsigned long diagLastLoopUs = 0;
+TaskHandle_t diagLoopTask = NULL;
+
+void diagLoopTick() {
+  unsigned long now = micros();
+  if (diagLoopTask == NULL) {
+    diagLoopTask = xTaskGetCurrentTaskHandle();
+  }
+  if (diagLastLoopUs != 0) {
+    uint32_t period = now - diagLastLoopUs;
+    uint32_t nominal = CONTROL_INTERVAL * 1000UL;
+    uint32_t jitterMs = (period > nominal ? period - nominal : nominal - period) / 1000;
+
+    int bucket = 0;
+    while (bucket < DIAG_JITTER_BUCKETS - 1 &&
+           jitterMs >= diagJitterBoundsMs[bucket]) {
+      bucket++;
+    }
+    diagJitterHist[bucket]++;
+
+    diagLoopCount++;
+    diagLoopTotalUs += period;
+    if (period < diagLoopMinUs)
+      diagLoopMinUs = period;
+    if (period > diagLoopMaxUs)
+      diagLoopMaxUs = period;
+  }
+  diagLastLoopUs = now;
+}
+
+void diagRecordSection(DiagSectionId id, uint32_t us) {
+  DiagSection &s = diagSections[id];
+  s.count++;
+  s.totalUs += us;
+  s.lastUs = us;
+  if (us > s.maxUs)
+    s.maxUs = us;
+}
+
+void diagReset() {
+  for (int i = 0; i < DIAG_SECTION_COUNT; i++) {
+    diagSections[i].count = 0;
+    diagSections[i].totalUs = 0;
+    diagSections[i].maxUs = 0;
+    diagSections[i].lastUs = 0;
+  }
+  for (int i = 0; i < DIAG_JITTER_BUCKETS; i++) {
+    diagJitterHist[i] = 0;
+  }
+  diagLoopCount = 0;
+  diagLoopMinUs = UINT32_MAX;
+  diagLoopMaxUs = 0;
+  diagLoopTotalUs = 0;
+  diagLastLoopUs = 0;
+  memset(&controlQueueStats, 0, sizeof(controlQueueStats));
+#ifdef ALLOC_TRACKING
+  allocReset();
+#endif
+}
+
+// Fills `out` with a snapshot of all tasks. Returns the number of entries and
+// the total run time (0 when run-time stats are not compiled into FreeRTOS).
+int diagTaskSnapshot(TaskStatus_t *out, int maxTasks, uint32_t *totalRunTime) {
+  *totalRunTime = 0;
+#if configUSE_TRACE_FACILITY
+  return uxTaskGetSystemState(out, maxTasks, totalRunTime);
+#else
+  int n = 0;
+  if (diagLoopTask != NULL && maxTasks > 0) {
+    memset(&out[0], 0, sizeof(TaskStatus_t));
+    out[0].xHandle = diagLoopTask;
+    out[0].pcTaskName = pcTaskGetName(diagLoopTask);
+    out[0].usStackHighWaterMark = uxTaskGetStackHighWaterMark(diagLoopTask);
+    n = 1;
+  }
+  return n;
+#endif
+}
+
+static const char *diagTaskStateName(eTaskState state) {
+  switch (state) {
+  case eRunning:
+    return "running";
+  case eReady:
+    return "ready";
+  case eBlocked:
+    return "blocked";
+  case eSuspended:
+    return "suspended";
+  case eDeleted:
+    return "deleted";
+  default:
+    return "invalid";
+  }
+}
+
+String getDiagJSON() {
+  TaskStatus_t *tasks =
+      (TaskStatus_t *)malloc(sizeof(TaskStatus_t) * DIAG_MAX_TASKS);
+  uint32_t totalRunTime = 0;
+  int taskCount = 0;
+  if (tasks != NULL) {
+    taskCount = diagTaskSnapshot(tasks, DIAG_MAX_TASKS, &totalRunTime);
+  }
+
+  String json = "{";
+  json += "\"uptime\":" + String(millis() / 1000) + ",";
+  json += "\"freeHeap\":" + String(ESP.getFreeHeap()) + ",";
+  json += "\"minFreeHeap\":" + String(ESP.getMinFreeHeap()) + ",";
+  json += "\"runtimeStats\":" + String(totalRunTime > 0 ? "true" : "false") + ",";
+
+  json += "\"tasks\":[";
+  for (int i = 0; i < taskCount; i++) {
+    if (i > 0)
+      json += ",";
+    uint32_t percent = 0;
+    if (totalRunTime > 0) {
+      percent = (uint32_t)((uint64_t)tasks[i].ulRunTimeCounter * 100 / totalRunTime);
+    }
+    json += "{\"name\":\"" + String(tasks[i].pcTaskName) + "\"";
+    json += ",\"prio\":" + String((unsigned)tasks[i].uxCurrentPriority);
+    json += ",\"state\":\"" + String(diagTaskStateName(tasks[i].eCurrentState)) + "\"";
+    json += ",\"stackFree\":" + String((unsigned)tasks[i].usStackHighWaterMark);
+    json += ",\"runtime\":" + String((unsigned long)tasks[i].ulRunTimeCounter);
+    json += ",\"cpu\":" + String(percent) + "}";
+  }
+  json += "],";
+  free(tasks);
+
+  json += "\"control\":{";
+  json += "\"count\":" + String(diagLoopCount);
+  json += ",\"minUs\":" + String(diagLoopCount ? diagLoopMinUs : 0);
+  json += ",\"maxUs\":" + String(diagLoopMaxUs);
+  json += ",\"avgUs\":" +
+          String(diagLoopCount ? (uint32_t)(diagLoopTotalUs / diagLoopCount) : 0);
+  json += ",\"jitterMs\":[";
+  for (int i = 0; i < DIAG_JITTER_BUCKETS; i++) {
+    if (i > 0)
+      json += ",";
+    json += "{\"le\":";
+    json += i < DIAG_JITTER_BUCKETS - 1 ? String(diagJitterBoundsMs[i]) : String("null");
+    json += ",\"count\":" + String(diagJitterHist[i]) + "}";
+  }
+  json += "]},";
+  json += "\"controlQueue\":{\"calls\":" + String(controlQueueStats.calls) +
+          ",\"maxWaitUs\":" + String(controlQueueStats.maxWaitUs) +
+          ",\"posts\":" + String(controlQueueStats.posts) +
+          ",\"postsDropped\":" + String(controlQueueStats.postsDropped) + "},";
+
+  json += "\"sections\":{";
+  for (int i = 0; i < DIAG_SECTION_COUNT; i++) {
+    const DiagSection &s = diagSections[i];
+    if (i > 0)
+      json += ",";
+    json += "\"" + String(s.name) + "\":{";
+    json += "\"count\":" + String(s.count);
+    json += ",\"avgUs\":" + String(s.count ? (uint32_t)(s.totalUs / s.count) : 0);
+    json += ",\"maxUs\":" + String(s.maxUs);
+    json += ",\"lastUs\":" + String(s.lastUs) + "}";
+  }
+  json += "}";
+#ifdef ALLOC_TRACKING
+  json += "," + getAllocJSON();
+#endif
+  json += "}";
+  return json;
+}
+
+void printDiag() {
+  TaskStatus_t *tasks =
+      (TaskStatus_t *)malloc(sizeof(TaskStatus_t) * DIAG_MAX_TASKS);
+  uint32_t totalRunTime = 0;
+  int taskCount = 0;
+  if (tasks != NULL) {
+    taskCount = diagTaskSnapshot(tasks, DIAG_MAX_TASKS, &totalRunTime);
+  }
+
+  Serial.println("\n═══════════════ DIAGNOSTICS ═══════════════");
+  Serial.printf("  Uptime:       %lus\n", millis() / 1000);
+  Serial.printf("  Free Heap:    %lu (min %lu)\n",
+                (unsigned long)ESP.getFreeHeap(),
+                (unsigned long)ESP.getMinFreeHeap());
+  Serial.println("  Task              Prio  State      Stack   CPU");
+  for (int i = 0; i < taskCount; i++) {
+    uint32_t percent = 0;
+    if (totalRunTime > 0) {
+      percent = (uint32_t)((uint64_t)tasks[i].ulRunTimeCounter * 100 / totalRunTime);
+    }
+    Serial.printf("  %-16s  %4u  %-9s  %5u  %3u%%\n", tasks[i].pcTaskName,
+                  (unsigned)tasks[i].uxCurrentPriority,
+                  diagTaskStateName(tasks[i].eCurrentState),
+                  (unsigned)tasks[i].usStackHighWaterMark, (unsigned)percent);
+  }
+  if (totalRunTime == 0) {
+    Serial.println("  (FreeRTOS run-time stats not enabled in this build)");
+  }
+  free(tasks);
+
+  Serial.printf("  Control:      avg %luus, min %luus, max %luus (%lu samples)\n",
+                (unsigned long)(diagLoopCount ? diagLoopTotalUs / diagLoopCount : 0),
+                (unsigned long)(diagLoopCount ? diagLoopMinUs : 0),
+                (unsigned long)diagLoopMaxUs, (unsigned long)diagLoopCount);
+  Serial.print("  Jitter (ms):  ");
+  for (int i = 0; i < DIAG_JITTER_BUCKETS; i++) {
+    if (i < DIAG_JITTER_BUCKETS - 1) {
+      Serial.printf("<%lu:%lu ", (unsigned long)diagJitterBoundsMs[i],
+                    (unsigned long)diagJitterHist[i]);
+    } else {
+      Serial.printf(">=%lu:%lu\n", (unsigned long)diagJitterBoundsMs[i - 1],
+                    (unsigned long)diagJitterHist[i]);
+    }
+  }
+  Serial.printf("  Queued calls: %lu, max wait %luus; posted %lu, dropped %lu\n",
+                (unsigned long)controlQueueStats.calls,
+                (unsigned long)controlQueueStats.maxWaitUs,
+                (unsigned long)controlQueueStats.posts,
+                (unsigned long)controlQueueStats.postsDropped);
+  for (int i = 0; i < DIAG_SECTION_COUNT; i++) {
+    const DiagSection &s = diagSections[i];
+    Serial.printf("  %-12s  avg %luus, max %luus, last %luus (%lu calls)\n",
+                  s.name,
+                  (unsigned long)(s.count ? s.totalUs / s.count : 0),
+                  (unsigned long)s.maxUs, (unsigned long)s.lastUs,
+                  (unsigned long)s.count);
+  }
+#ifdef ALLOC_TRACKING
+  printAllocStats();
+#endif
+  Serial.println("═══════════════════════════════════════════════\n");
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef FIXEDSTRING_H
+#define FIXEDSTRING_H
+
+#include <Arduino.h>
+#include <ctype.h>
+#include <string.h>
+
+// Heap-free strings for state that lives as long as the firmware: the
+// logbook, hostname and WiFi credentials. Arduino-ESP32 2.x builds as
+// C++11, so StrView stands in for std::string_view.
+
+// Non-owning view of `length` chars at `data`, not NUL-terminated. Accepts a
+// literal, a char buffer or a String without copying; the viewed text must
+// outlive the view.
+struct StrView {
+  const char *data;
+  size_t length;
+
+  StrView() : data(""), length(0) {}
+  StrView(const char *s) : data(s ? s : ""), length(s ? strlen(s) : 0) {}
+  StrView(const char *s, size_t n) : data(s), length(n) {}
+  StrView(const String &s) : data(s.c_str()), length(s.length()) {}
+
+  bool empty() const { return length == 0; }
+  char operator[](size_t i) const { return data[i]; }
+
+  bool equals(StrView other) const {
+    return length == other.length && memcmp(data, other.data, length) == 0;
+  }
+
+  // Position of `needle` at or after `from`, -1 if absent.
+  int indexOf(StrView needle, size_t from = 0) const {
+    if (needle.length > length)
+      return -1;
+    for (size_t i = from; i + needle.length <= length; i++) {
+      if (memcmp(data + i, needle.data, needle.length) == 0)
+        return (int)i;
+    }
+    return -1;
+  }
+
+  int indexOf(char c, size_t from = 0) const {
+    for (size_t i = from; i < length; i++) {
+      if (data[i] == c)
+        return (int)i;
+    }
+    return -1;
+  }
+
+  StrView substr(size_t pos, size_t n) const {
+    if (pos > length)
+      pos = length;
+    if (n > length - pos)
+      n = length - pos;
+    return StrView(data + pos, n);
+  }
+
+  StrView trim() const {
+    size_t start = 0;
+    size_t end = length;
+    while (start < end && isspace((unsigned char)data[start]))
+      start++;
+    while (end > start && isspace((unsigned char)data[end - 1]))
+      end--;
+    return StrView(data + start, end - start);
+  }
+
+  // Leading decimal integer, like String::toInt(). 0 if there is none.
+  long toInt() const {
+    size_t i = 0;
+    while (i < length && isspace((unsigned char)data[i]))
+      i++;
+    bool negative = i < length && data[i] == '-';
+    if (negative || (i < length && data[i] == '+'))
+      i++;
+    long value = 0;
+    for (; i < length && data[i] >= '0' && data[i] <= '9'; i++)
+      value = value * 10 + (data[i] - '0');
+    return negative ? -value : value;
+  }
+};
+
+// Up to N chars stored inline, always NUL-terminated. Text past the capacity
+// is cut off; append() returns false when that happens.
+template <size_t N> class FixedString {
+public:
+  FixedString() : length_(0) { buffer_[0] = '\0'; }
+  FixedString(StrView s) : length_(0) { assign(s); }
+
+  FixedString &operator=(StrView s) {
+    assign(s);
+    return *this;
+  }
+
+  void clear() {
+    length_ = 0;
+    buffer_[0] = '\0';
+  }
+
+  bool assign(StrView s) {
+    clear();
+    return append(s);
+  }
+
+  bool append(StrView s) {
+    size_t n = s.length;
+    bool fits = n <= N - length_;
+    if (!fits)
+      n = N - length_;
+    memmove(buffer_ + length_, s.data, n);
+    length_ += n;
+    buffer_[length_] = '\0';
+    return fits;
+  }
+
+  bool append(char c) {
+    if (length_ >= N)
+      return false;
+    buffer_[length_++] = c;
+    buffer_[length_] = '\0';
+    return true;
+  }
+
+  const char *c_str() const { return buffer_; }
+  size_t length() const { return length_; }
+  bool empty() const { return length_ == 0; }
+  static size_t capacity() { return N; }
+  char operator[](size_t i) const { return buffer_[i]; }
+  operator StrView() const { return StrView(buffer_, length_); }
+
+private:
+  static_assert(N < 65535, "FixedString length must fit in 16 bits");
+  uint16_t length_;
+  char buffer_[N + 1];
+};
+
+#endif
@@ -86,7 +86,7 @@ const char index_html[] PROGMEM = R"rawliteral(
         <h1>🌱 GrowTower Controller</h1>
         <div id="timeWarning" class="status-card" style="display: none; background: rgba(248, 113, 113, 0.2); border-color: #f87171;">
             <div class="section-title" style="color: #f87171;">⚠️ No Time Sync</div>
-            <p style="margin-bottom: 15px; color: #cbd5e1;">The controller has no valid time. The light timer will not work and the light is currently blinking.</p>
+            <p id="timeWarningText" style="margin-bottom: 15px; color: #cbd5e1;">The controller has no valid time. The light timer is paused until the time is set.</p>
             <button class="save-btn" style="background: #f87171; margin-top: 0;" onclick="setManualTime()">Sync Time from Browser</button>
         </div>
         <div class="status-card">
@@ -140,6 +140,7 @@ const char index_html[] PROGMEM = R"rawliteral(
                 </select>
             </div>
             <button class="save-btn" onclick="setTzMode()">Save Timezone</button>
+            <button class="save-btn" style="background: linear-gradient(135deg, #4ade80 0%, #22c55e 100%);" onclick="saveSettings()">Save All Settings</button>
         </div>
         <div class="status-card">
             <div class="section-title">Plant Tracker</div>
@@ -150,11 +151,11 @@ const char index_html[] PROGMEM = R"rawliteral(
                     <button id="btnFlower" onclick="setPhase('flower')" style="flex:1; padding:12px; background:rgba(245,158,11,0.3); border:2px solid rgba(245,158,11,0.5); border-radius:8px; color:white; cursor:pointer; font-weight:600;">Flower</button>
                 </div>
                 <div style="display: grid; grid-template-columns: repeat(3, 1fr); gap: 10px; margin-bottom: 15px;">
-                    <div style="background:rgba(139,92,246,0.2); padding:15px; border-radius:10px; text-align:center;"><div style="font-size:0.8rem; color:#94a3b8;">Seedling</div><div id="seedlingDays" style="font-size:1.5rem; font-weight:bold; color:#8b5cf6;">0</div><div style="font-size:0.75rem; color:#94a3b8;">days</div></div>
-                    <div style="background:rgba(16,185,129,0.2); padding:15px; border-radius:10px; text-align:center;"><div style="font-size:0.8rem; color:#94a3b8;">Veg</div><div id="vegDays" style="font-size:1.5rem; font-weight:bold; color:#10b981;">0</div><div style="font-size:0.75rem; color:#94a3b8;">days</div></div>
-                    <div style="background:rgba(245,158,11,0.2); padding:15px; border-radius:10px; text-align:center;"><div style="font-size:0.8rem; color:#94a3b8;">Flower</div><div id="flowerDays" style="font-size:1.5rem; font-weight:bold; color:#f59e0b;">0</div><div style="font-size:0.75rem; color:#94a3b8;">days</div></div>
+                    <div style="background:rgba(139,92,246,0.2); padding:15px; border-radius:10px; text-align:center;"><div style="font-size:0.8rem; color:#94a3b8;">Seedling</div><div id="seedlingDays" style="font-size:1.5rem; font-weight:bold; color:#8b5cf6;">0</div><div style="font-size:0.75rem; color:#94a3b8;">days</div><div id="seedlingUsage" style="font-size:0.7rem; color:#94a3b8; margin-top:4px;"></div></div>
+                    <div style="background:rgba(16,185,129,0.2); padding:15px; border-radius:10px; text-align:center;"><div style="font-size:0.8rem; color:#94a3b8;">Veg</div><div id="vegDays" style="font-size:1.5rem; font-weight:bold; color:#10b981;">0</div><div style="font-size:0.75rem; color:#94a3b8;">days</div><div id="vegUsage" style="font-size:0.7rem; color:#94a3b8; margin-top:4px;"></div></div>
+                    <div style="background:rgba(245,158,11,0.2); padding:15px; border-radius:10px; text-align:center;"><div style="font-size:0.8rem; color:#94a3b8;">Flower</div><div id="flowerDays" style="font-size:1.5rem; font-weight:bold; color:#f59e0b;">0</div><div style="font-size:0.75rem; color:#94a3b8;">days</div><div id="flowerUsage" style="font-size:0.7rem; color:#94a3b8; margin-top:4px;"></div></div>
                 </div>
-                <div style="background:rgba(74,222,128,0.2); padding:15px; border-radius:10px; text-align:center; margin-bottom:15px;"><div style="font-size:0.9rem; color:#94a3b8;">Total Days</div><div id="totalDays" style="font-size:2rem; font-weight:bold; color:#4ade80;">0</div><div style="font-size:0.8rem; color:#94a3b8;">days old</div></div>
+                <div style="background:rgba(74,222,128,0.2); padding:15px; border-radius:10px; text-align:center; margin-bottom:15px;"><div style="font-size:0.9rem; color:#94a3b8;">Total Days</div><div id="totalDays" style="font-size:2rem; font-weight:bold; color:#4ade80;">0</div><div style="font-size:0.8rem; color:#94a3b8;">days old</div><div id="usageToday" style="font-size:0.8rem; color:#94a3b8; margin-top:6px;"></div></div>
                 <div style="display:flex; gap: 10px;"><select id="resetPhaseSelect" style="flex:1; padding:10px; background:rgba(255,255,255,0.1); border:1px solid rgba(255,255,255,0.2); border-radius:8px; color:white;"><option value="seedling">Seedling</option><option value="veg">Veg</option><option value="flower">Flower</option><option value="all">All</option></select><button onclick="resetPhase()" style="padding:10px 20px; background:#ef4444; border:none; border-radius:8px; color:white; cursor:pointer; font-weight:600;">Reset</button></div>
             </div>
         </div>
@@ -203,7 +204,8 @@ const char index_html[] PROGMEM = R"rawliteral(
         function updateLightDuration() { const onHour = parseInt(document.getElementById('onHour').value) || 0; const duration = parseInt(document.getElementById('durationHours').value) || 1; let offHour = onHour + duration; if (offHour >= 24) offHour -= 24; document.getElementById('lightOnCalc').textContent = String(onHour).padStart(2, '0'); document.getElementById('lightOffCalc').textContent = String(offHour).padStart(2, '0'); document.getElementById('lightDuration').textContent = duration; }
         function updateUI(status) {
             currentStatus = status;
-            document.getElementById('timeWarning').style.display = status.hasTime ? 'none' : 'block';
+            document.getElementById('timeWarning').style.display = (status.hasTime && !status.timeEstimated) ? 'none' : 'block';
+            document.getElementById('timeWarningText').textContent = status.hasTime ? 'The controller is running on an estimated time restored after a reboot. The light timer uses it until NTP or the browser confirms the time.' : 'The controller has no valid time. The light timer is paused until the time is set.';
             const lightStatus = document.getElementById('lightStatus'); const lightText = document.getElementById('lightText');
             if (status.light) { lightStatus.className = 'status-indicator on'; lightText.textContent = 'ON'; } else { lightStatus.className = 'status-indicator off'; lightText.textContent = 'OFF'; }
             document.getElementById('fanValue').textContent = status.fan;
@@ -248,13 +250,15 @@ const char index_html[] PROGMEM = R"rawliteral(
                 if (result.success) { showMessage('WiFi saved. Rebooting...'); }
             } catch (error) { showMessage('Error saving WiFi', 'error'); }
         }
-        async function fetchStatus() { try { const response = await fetch('/api/status'); const status = await response.json(); updateUI(status); } catch (error) { console.error('Error fetching status:', error); } }
-        async function setTzMode() { const mode = document.getElementById('tzModeSelect').value; try { const response = await fetch(`/api/tz?mode=${mode}`); const result = await response.json(); if (result.success) { showMessage('Timezone mode saved'); fetchStatus(); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving timezone', 'error'); } }
+        async function fetchStatus() { try { const response = await fetch('/api/status', { cache: 'no-cache' }); const status = await response.json(); updateUI(status); } catch (error) { console.error('Error fetching status:', error); } }
+        async function postConfig(fields) { const response = await fetch('/api/config', { method: 'POST', headers: { 'Content-Type': 'application/x-www-form-urlencoded' }, body: new URLSearchParams(fields).toString() }); const result = await response.json(); if (result.success) { updateUI(result.status); } return result; }
+        async function saveSettings() { const fields = { fanMin: document.getElementById('fanMinSlider').value, fanMax: document.getElementById('fanMaxSlider').value, lightOn: document.getElementById('onHour').value, lightDuration: document.getElementById('durationHours').value, timerEnabled: document.getElementById('timerToggle').checked ? 1 : 0, tzMode: document.getElementById('tzModeSelect').value }; try { const result = await postConfig(fields); if (result.success) { showMessage('Settings saved'); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving', 'error'); } }
+        async function setTzMode() { const mode = document.getElementById('tzModeSelect').value; try { const result = await postConfig({ tzMode: mode }); if (result.success) { showMessage('Timezone mode saved'); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving timezone', 'error'); } }
         async function setLight(on) { try { const response = await fetch(`/api/light?state=${on ? 1 : 0}`); const result = await response.json(); if (result.success) { showMessage(on ? 'Light turned on' : 'Light turned off'); fetchStatus(); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error switching light', 'error'); } }
         async function setFan() { const value = document.getElementById('fanSlider').value; try { const response = await fetch(`/api/fan?speed=${value}`); const result = await response.json(); if (result.success) { showMessage(`Fan set to ${value}%`); fetchStatus(); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error setting fan', 'error'); } }
-        async function setFanRange() { const min = document.getElementById('fanMinSlider').value; const max = document.getElementById('fanMaxSlider').value; try { const response = await fetch(`/api/fanrange?min=${min}&max=${max}`); const result = await response.json(); if (result.success) { showMessage(`Fan range: ${min}%-${max}%`); fetchStatus(); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving', 'error'); } }
-        async function setLightTimer() { const on = document.getElementById('onHour').value; const duration = document.getElementById('durationHours').value; try { const response = await fetch(`/api/timer?on=${on}&duration=${duration}`); const result = await response.json(); if (result.success) { showMessage(`Timer: ${String(on).padStart(2, '0')}:00 - ${result.offHour}:00 (${duration}h)`); fetchStatus(); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving', 'error'); } }
-        async function toggleTimer() { const enabled = document.getElementById('timerToggle').checked; try { const response = await fetch(`/api/timerenable?enabled=${enabled ? 1 : 0}`); const result = await response.json(); if (result.success) { showMessage(enabled ? 'Timer enabled' : 'Timer disabled'); fetchStatus(); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error toggling timer', 'error'); } }
+        async function setFanRange() { const min = document.getElementById('fanMinSlider').value; const max = document.getElementById('fanMaxSlider').value; try { const result = await postConfig({ fanMin: min, fanMax: max }); if (result.success) { showMessage(`Fan range: ${min}%-${max}%`); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving', 'error'); } }
+        async function setLightTimer() { const on = document.getElementById('onHour').value; const duration = document.getElementById('durationHours').value; try { const result = await postConfig({ lightOn: on, lightDuration: duration }); if (result.success) { let offHour = result.status.lightOn + result.status.lightDuration; if (offHour >= 24) offHour -= 24; showMessage(`Timer: ${String(on).padStart(2, '0')}:00 - ${offHour}:00 (${duration}h)`); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving', 'error'); } }
+        async function toggleTimer() { const enabled = document.getElementById('timerToggle').checked; try { const result = await postConfig({ timerEnabled: enabled ? 1 : 0 }); if (result.success) { showMessage(enabled ? 'Timer enabled' : 'Timer disabled'); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error toggling timer', 'error'); } }
         async function resetToDefaults() { if (!confirm('Reset all settings to factory defaults? The device will restart.')) { return; } try { const response = await fetch('/api/reset'); const result = await response.json(); if (result.success) { showMessage('Resetting to factory defaults...'); setTimeout(() => { window.location.href = 'http://growtower.local'; }, 5000); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error resetting', 'error'); } }
         async function setHostname() { const hostname = document.getElementById('hostnameInput').value.trim(); if (!hostname) { showMessage('Please enter a name', 'error'); return; } if (!/^[a-zA-Z0-9-]+$/.test(hostname)) { showMessage('Only letters, numbers and hyphens allowed', 'error'); return; } try { const response = await fetch(`/api/hostname?name=${encodeURIComponent(hostname)}`); const result = await response.json(); if (result.success) { showMessage('Device restarting...'); setTimeout(() => { window.location.href = `http://${hostname}.local`; }, 5000); } else { showMessage('Error: ' + result.error, 'error'); } } catch (error) { showMessage('Error saving', 'error'); } }
         let currentPhaseStatus = { seedling: {active:false}, veg: {active:false}, flower: {active:false} };
@@ -273,6 +277,8 @@ const char index_html[] PROGMEM = R"rawliteral(
             if (status.veg !== undefined) { document.getElementById('vegDays').textContent = status.veg.days || 0; currentPhaseStatus.veg = { active: status.veg.active }; var btnV = document.getElementById('btnVeg'); if (status.veg.active) { btnV.style.background = '#10b981'; btnV.style.borderColor = '#34d399'; btnV.style.boxShadow = '0 0 15px rgba(16,185,129,0.6)'; } else { btnV.style.background = 'rgba(16,185,129,0.3)'; btnV.style.borderColor = 'rgba(16,185,129,0.5)'; btnV.style.boxShadow = 'none'; } }
             if (status.flower !== undefined) { document.getElementById('flowerDays').textContent = status.flower.days || 0; currentPhaseStatus.flower = { active: status.flower.active }; var btnF = document.getElementById('btnFlower'); if (status.flower.active) { btnF.style.background = '#f59e0b'; btnF.style.borderColor = '#fbbf24'; btnF.style.boxShadow = '0 0 15px rgba(245,158,11,0.6)'; } else { btnF.style.background = 'rgba(245,158,11,0.3)'; btnF.style.borderColor = 'rgba(245,158,11,0.5)'; btnF.style.boxShadow = 'none'; } }
             if (status.totalDays !== undefined) { document.getElementById('totalDays').textContent = status.totalDays || 0; }
+            ['seedling', 'veg', 'flower'].forEach(function (p) { if (status[p] && status[p].lightHours !== undefined) { document.getElementById(p + 'Usage').textContent = `${status[p].lightHours} h light · ${status[p].fanHours} h fan`; } });
+            if (status.usage) { document.getElementById('usageToday').textContent = `Today: ${status.usage.today.lightHours} h light, ${status.usage.today.fanHours} h fan · Yesterday: ${status.usage.yesterday.lightHours} h light`; }
         }
         fetchStatus(); fetchLogbook(); setInterval(fetchStatus, 2000);
     </script>
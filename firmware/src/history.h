@@ -0,0 +1,339 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "chunkwriter.h"
+#include "config.h"
+#include "state.h"
+
+// Round-robin actuator history in fixed RAM, RRD style. Every second the
+// light state and fan output are folded into a minute accumulator; finished
+// minutes go into the raw ring and roll up into hourly and daily averages.
+// Each tier is a ring with an implicit time axis (slot i is `resolution`
+// seconds before slot i+1), so appending is a single slot write. After a
+// power gap the missing slots are written as invalid, at most one lap of the
+// ring.
+//
+// Tiers are aligned to UTC minute/hour/day boundaries. The history lives in
+// RAM only and starts empty after a reboot.
+
+#define HISTORY_TIERS 3
+#define HISTORY_TIER_MINUTE 0
+#define HISTORY_TIER_HOUR 1
+#define HISTORY_TIER_DAY 2
+
+#define HISTORY_VALID 0x01
+#define HISTORY_SWITCHED 0x02 // light changed state during the slot
+
+struct HistorySample {
+  uint8_t light;    // fraction of the slot with the light on (0-255)
+  uint8_t fanDuty;  // average PWM duty (0-255)
+  uint8_t fanSpeed; // average fan setting (%)
+  uint8_t flags;
+};
+
+struct HistoryTier {
+  HistorySample *slots;
+  uint16_t size;
+  uint32_t resolution;
+  uint16_t head;     // newest slot
+  uint16_t count;
+  uint32_t headTime; // start time of the newest slot
+};
+
+struct HistoryAccum {
+  uint32_t start;
+  uint32_t samples;
+  uint32_t light;
+  uint32_t fanDuty;
+  uint32_t fanSpeed;
+  uint8_t flags;
+};
+
+HistorySample historyMinutes[HISTORY_MINUTE_SLOTS];
+HistorySample historyHours[HISTORY_HOUR_SLOTS];
+HistorySample historyDays[HISTORY_DAY_SLOTS];
+
+HistoryTier historyTiers[HISTORY_TIERS] = {
+    {historyMinutes, HISTORY_MINUTE_SLOTS, 60, 0, 0, 0},
+    {historyHours, HISTORY_HOUR_SLOTS, 3600, 0, 0, 0},
+    {historyDays, HISTORY_DAY_SLOTS, 86400, 0, 0, 0},
+};
+
+// Guards the rings against the HTTP readers (AsyncTCP task); the control task
+// is the only writer.
+portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// historyAccums[t] collects the samples that make up the next slot of tier t.
+HistoryAccum historyAccums[HISTORY_TIERS];
+
+// Long-term flash store (telemetry.h) receives every finished minute.
+void telemetryAppend(uint32_t t, const HistorySample &s);
+
+time_t historyLastTick = 0;
+uint32_t historyLastSwitchCount = 0;
+
+void historyPush(HistoryTier &tier, uint32_t t, const HistorySample &s) {
+  if (tier.count == 0) {
+    tier.head = 0;
+    tier.count = 1;
+    tier.headTime = t;
+    tier.slots[0] = s;
+    return;
+  }
+  if (t < tier.headTime) {
+    // Clock stepped back (NTP corrected an estimate): keep what we have.
+    return;
+  }
+  if (t == tier.headTime) {
+    tier.slots[tier.head] = s;
+    return;
+  }
+
+  uint32_t steps = (t - tier.headTime) / tier.resolution;
+  if (steps > tier.size)
+    steps = tier.size;
+  for (uint32_t i = 1; i < steps; i++) {
+    tier.head = (tier.head + 1) % tier.size;
+    memset(&tier.slots[tier.head], 0, sizeof(HistorySample));
+  }
+  tier.head = (tier.head + 1) % tier.size;
+  tier.slots[tier.head] = s;
+  tier.headTime = t;
+  tier.count = tier.count + steps > tier.size ? tier.size : tier.count + steps;
+}
+
+static HistorySample historyAverage(const HistoryAccum &acc) {
+  HistorySample s;
+  s.light = acc.light / acc.samples;
+  s.fanDuty = acc.fanDuty / acc.samples;
+  s.fanSpeed = acc.fanSpeed / acc.samples;
+  s.flags = acc.flags | HISTORY_VALID;
+  return s;
+}
+
+static void historyAccumulate(HistoryAccum &acc, uint32_t slot,
+                              const HistorySample &s) {
+  if (acc.samples == 0 || acc.start != slot) {
+    memset(&acc, 0, sizeof(HistoryAccum));
+    acc.start = slot;
+  }
+  acc.samples++;
+  acc.light += s.light;
+  acc.fanDuty += s.fanDuty;
+  acc.fanSpeed += s.fanSpeed;
+  acc.flags |= s.flags & HISTORY_SWITCHED;
+}
+
+// Closes the accumulator of `tier` if `t` belongs to a later slot, pushes the
+// result and hands it on to the next coarser tier.
+static void historyAdvance(int tier, uint32_t t) {
+  HistoryAccum &acc = historyAccums[tier];
+  uint32_t slot = t - t % historyTiers[tier].resolution;
+  if (acc.samples == 0 || acc.start == slot)
+    return;
+
+  HistorySample s = historyAverage(acc);
+  portENTER_CRITICAL(&historyMux);
+  historyPush(historyTiers[tier], acc.start, s);
+  portEXIT_CRITICAL(&historyMux);
+  acc.samples = 0;
+  if (tier == HISTORY_TIER_MINUTE)
+    telemetryAppend(acc.start, s);
+
+  if (tier + 1 < HISTORY_TIERS) {
+    uint32_t next = acc.start - acc.start % historyTiers[tier + 1].resolution;
+    historyAdvance(tier + 1, acc.start);
+    historyAccumulate(historyAccums[tier + 1], next, s);
+  }
+}
+
+// Called from the control task once time is valid; does work at most once per second.
+void historyTick(time_t now) {
+  if (now == historyLastTick)
+    return;
+  historyLastTick = now;
+
+  historyAdvance(HISTORY_TIER_MINUTE, (uint32_t)now);
+
+  HistorySample s;
+  s.light = isLightOn ? 255 : 0;
+  s.fanDuty = (uint8_t)currentFanDuty;
+  s.fanSpeed = (uint8_t)currentFanSpeed;
+  s.flags = lightSwitchCount != historyLastSwitchCount ? HISTORY_SWITCHED : 0;
+  historyLastSwitchCount = lightSwitchCount;
+
+  uint32_t minute = (uint32_t)now - (uint32_t)now % 60;
+  historyAccumulate(historyAccums[HISTORY_TIER_MINUTE], minute, s);
+}
+
+// Accepts "minute"/"hour"/"day" or the resolution in seconds. Returns -1 if
+// `res` is not a known resolution.
+int historyTierFor(const String &res) {
+  if (res == "minute" || res == "60")
+    return HISTORY_TIER_MINUTE;
+  if (res == "hour" || res == "3600")
+    return HISTORY_TIER_HOUR;
+  if (res == "day" || res == "86400")
+    return HISTORY_TIER_DAY;
+  return -1;
+}
+
+// Finest tier that still reaches back to `from`.
+int historyAutoTier(uint32_t from) {
+  for (int t = 0; t < HISTORY_TIERS; t++) {
+    const HistoryTier &tier = historyTiers[t];
+    portENTER_CRITICAL(&historyMux);
+    uint16_t count = tier.count;
+    uint32_t headTime = tier.headTime;
+    portEXIT_CRITICAL(&historyMux);
+    if (count < tier.size)
+      return t; // not wrapped yet, coarser tiers hold nothing older
+    uint32_t oldest = headTime - (uint32_t)(count - 1) * tier.resolution;
+    if (oldest <= from)
+      return t;
+  }
+  return HISTORY_TIER_DAY;
+}
+
+// Position of a streaming query. A minute closing while the response is sent
+// moves every slot of the ring, so chunks resume after the last timestamp
+// sent rather than at an index.
+struct HistoryCursor {
+  uint8_t tier;
+  uint32_t from;
+  uint32_t to;
+  uint32_t lastT;
+  bool started;
+  bool first;
+  bool done;
+};
+
+#define HISTORY_COPY_SAMPLES 32
+
+// Copies up to HISTORY_COPY_SAMPLES valid samples of the query that come
+// after the last one sent. Returns how many.
+static int historyCopy(const HistoryCursor &c, uint32_t *times,
+                       HistorySample *samples) {
+  const HistoryTier &tier = historyTiers[c.tier];
+  int n = 0;
+  portENTER_CRITICAL(&historyMux);
+  uint16_t head = tier.head;
+  uint16_t count = tier.count;
+  uint32_t headTime = tier.headTime;
+  if (count > 0) {
+    uint32_t oldest = headTime - (uint32_t)(count - 1) * tier.resolution;
+    uint32_t start = c.first ? c.from : c.lastT + 1;
+    uint16_t i = 0;
+    if (start > oldest) {
+      uint32_t skip = (start - oldest + tier.resolution - 1) / tier.resolution;
+      i = skip < count ? skip : count;
+    }
+    for (; i < count && n < HISTORY_COPY_SAMPLES; i++) {
+      uint16_t age = count - 1 - i;
+      uint32_t t = headTime - (uint32_t)age * tier.resolution;
+      if (t > c.to)
+        break;
+      const HistorySample &s = tier.slots[(head + tier.size - age) % tier.size];
+      if (!(s.flags & HISTORY_VALID))
+        continue;
+      times[n] = t;
+      samples[n] = s;
+      n++;
+    }
+  }
+  portEXIT_CRITICAL(&historyMux);
+  return n;
+}
+
+// Fills one chunk. Returns the bytes written; 0 once the query is finished.
+size_t historyFill(HistoryCursor &c, uint8_t *buffer, size_t maxLen) {
+  ChunkWriter w = {(char *)buffer, maxLen, 0, 0, 0, false};
+  if (c.done)
+    return 0;
+
+  if (!c.started) {
+    chunkPrintf(w,
+                "{\"res\":%lu,\"from\":%lu,\"to\":%lu,"
+                "\"fields\":[\"t\",\"light\",\"fanDuty\",\"fan\",\"switched\"],"
+                "\"samples\":[",
+                (unsigned long)historyTiers[c.tier].resolution,
+                (unsigned long)c.from, (unsigned long)c.to);
+    if (w.full)
+      return 0;
+    c.started = true;
+  }
+
+  // AsyncTCP task only, one chunk at a time
+  static uint32_t times[HISTORY_COPY_SAMPLES];
+  static HistorySample samples[HISTORY_COPY_SAMPLES];
+  int n;
+  while ((n = historyCopy(c, times, samples)) > 0) {
+    for (int i = 0; i < n; i++) {
+      const HistorySample &s = samples[i];
+      chunkPrintf(w, "%s[%lu,%u,%u,%u,%u]", c.first ? "" : ",",
+                  (unsigned long)times[i],
+                  (unsigned)((s.light * 100 + 127) / 255), (unsigned)s.fanDuty,
+                  (unsigned)s.fanSpeed, (s.flags & HISTORY_SWITCHED) ? 1 : 0);
+      if (w.full)
+        return w.len;
+      c.lastT = times[i];
+      c.first = false;
+    }
+  }
+
+  chunkPrintf(w, "]}");
+  if (w.full)
+    return w.len;
+  c.done = true;
+  return w.len;
+}
+
+// GET /api/history?from=&to=&res= -- from/to are unix seconds (default: the
+// last 24 h), res is minute|hour|day (default: finest tier covering `from`).
+void handleHistory(AsyncWebServerRequest *request) {
+  time_t now = time(nullptr);
+  if (now <= MIN_VALID_EPOCH) {
+    request->send(503, "application/json", "{\"error\":\"no time\"}");
+    return;
+  }
+
+  HistoryCursor c;
+  memset(&c, 0, sizeof(c));
+  c.first = true;
+  c.to = request->hasParam("to") ? request->getParam("to")->value().toInt()
+                                 : (uint32_t)now;
+  c.from = request->hasParam("from")
+               ? request->getParam("from")->value().toInt()
+               : c.to - 86400;
+  if (c.from > c.to) {
+    request->send(400, "application/json",
+                  "{\"error\":\"from must not be after to\"}");
+    return;
+  }
+  if (request->hasParam("res")) {
+    int tier = historyTierFor(request->getParam("res")->value());
+    if (tier < 0) {
+      request->send(400, "application/json",
+                    "{\"error\":\"res must be minute, hour or day\"}");
+      return;
+    }
+    c.tier = tier;
+  } else {
+    c.tier = historyAutoTier(c.from);
+  }
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [c](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+        size_t len = historyFill(c, buffer, maxLen);
+        if (len == 0 && !c.done)
+          return RESPONSE_TRY_AGAIN;
+        return len;
+      });
+  request->send(response);
+}
+
+#endif
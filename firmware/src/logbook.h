@@ -0,0 +1,248 @@
+#ifndef LOGBOOK_H
+#define LOGBOOK_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <time.h>
+
+#include "allocstats.h"
+#include "fixedstring.h"
+#include "logger.h"
+#include "persist.h"
+#include "state.h"
+
+// Grow logbook: up to MAX_LOG_ENTRIES dated notes, newest first, stored as a
+// two-slot record on LittleFS (persist.h). Entries keep their text inline,
+// so the logbook takes a fixed ~10 KB of RAM and never touches the heap
+// between reboots. Firmware before the record format kept it as one JSON
+// string under the NVS key "logbook"; that is read once and then removed.
+
+#define MAX_LOG_ENTRIES 50
+#define MAX_LOG_TEXT_LENGTH 200
+
+struct LogEntry {
+  time_t timestamp;
+  FixedString<MAX_LOG_TEXT_LENGTH> text;
+};
+
+LogEntry logEntries[MAX_LOG_ENTRIES];
+int logEntryCount = 0;
+
+// Record body: per entry a 32-bit timestamp, the text length and the text.
+static void saveLogbookRecord(PersistOut &out) {
+  for (int i = 0; i < logEntryCount; i++) {
+    uint32_t timestamp = (uint32_t)logEntries[i].timestamp;
+    uint8_t length = logEntries[i].text.length();
+    out.write(&timestamp, sizeof(timestamp));
+    out.write(&length, sizeof(length));
+    out.write(logEntries[i].text.c_str(), length);
+  }
+}
+
+static bool loadLogbookRecord(PersistIn &in, size_t length) {
+  static_assert(MAX_LOG_TEXT_LENGTH <= 255, "entry length is stored in a byte");
+  logEntryCount = 0;
+  while (length > 0) {
+    uint32_t timestamp;
+    uint8_t textLength;
+    char text[MAX_LOG_TEXT_LENGTH];
+    if (logEntryCount >= MAX_LOG_ENTRIES || length < 5 ||
+        !in.read(&timestamp, sizeof(timestamp)) ||
+        !in.read(&textLength, sizeof(textLength)) ||
+        textLength > MAX_LOG_TEXT_LENGTH || textLength > length - 5 ||
+        !in.read(text, textLength)) {
+      logEntryCount = 0;
+      return false;
+    }
+    logEntries[logEntryCount].timestamp = timestamp;
+    logEntries[logEntryCount].text = StrView(text, textLength);
+    logEntryCount++;
+    length -= 5 + textLength;
+  }
+  return true;
+}
+
+PersistRecord logbookRecord = {{"/logbook0", "/logbook1"}, true,
+                               saveLogbookRecord, loadLogbookRecord, 0, 1};
+
+// Parses the pre-record JSON logbook.
+static void loadLegacyLogbook(const String &stored) {
+  StrView logJson(stored);
+  int jsonLen = logJson.length;
+  if (jsonLen < 2)
+    return;
+
+  int entryStart = -1;
+  int braceCount = 0;
+  for (int i = 0; i < jsonLen; i++) {
+    if (logJson[i] == '{') {
+      if (braceCount == 0)
+        entryStart = i;
+      braceCount++;
+    } else if (logJson[i] == '}') {
+      braceCount--;
+      if (braceCount == 0 && entryStart >= 0) {
+        StrView entryStr = logJson.substr(entryStart, i + 1 - entryStart);
+        int tsIndex = entryStr.indexOf("\"ts\":");
+        int txtIndex = entryStr.indexOf("\"text\":\"");
+        if (tsIndex >= 0 && txtIndex >= 0) {
+          tsIndex += 5;
+          int tsEnd = entryStr.indexOf(',', tsIndex);
+          if (tsEnd < 0)
+            tsEnd = entryStr.indexOf('}', tsIndex);
+          if (tsEnd > tsIndex) {
+            logEntries[logEntryCount].timestamp =
+                entryStr.substr(tsIndex, tsEnd - tsIndex).toInt();
+
+            txtIndex += 8;
+            int txtEnd = entryStr.indexOf('"', txtIndex);
+            if (txtEnd > txtIndex) {
+              logEntries[logEntryCount].text =
+                  entryStr.substr(txtIndex, txtEnd - txtIndex);
+              logEntryCount++;
+              if (logEntryCount >= MAX_LOG_ENTRIES)
+                break;
+            }
+          }
+        }
+        entryStart = -1;
+      }
+    }
+  }
+}
+
+// Needs LittleFS mounted (initTelemetry()).
+void loadLogbook() {
+  ALLOC_SCOPE("loadLogbook");
+  logEntryCount = 0;
+  if (!persistLoad(logbookRecord)) {
+    preferences.begin("growtower", true);
+    if (preferences.isKey("logbook")) {
+      loadLegacyLogbook(preferences.getString("logbook", "[]"));
+      persistLegacy |= PERSIST_LOGBOOK;
+      persistMark(PERSIST_LOGBOOK);
+    }
+    preferences.end();
+  }
+
+  Serial.printf("[LOG] Loaded %d log entries\n", logEntryCount);
+}
+
+// Called from savePending().
+bool saveLogbook() {
+  if (!persistStore(logbookRecord))
+    return false;
+  LOGI("LOG", "Saved %d log entries", logEntryCount);
+  return true;
+}
+
+void addLogEntry(StrView text) {
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo, 0)) {
+    LOGW("LOG", "Cannot add entry: NTP time not available");
+    return;
+  }
+
+  text = text.trim();
+  if (text.empty())
+    return;
+  if (text.length > MAX_LOG_TEXT_LENGTH)
+    text.length = MAX_LOG_TEXT_LENGTH;
+
+  LogEntry &entry = logEntries[0];
+  {
+    PersistStateLock lock;
+    for (int i = MAX_LOG_ENTRIES - 1; i > 0; i--) {
+      logEntries[i] = logEntries[i - 1];
+    }
+
+    entry.timestamp = mktime(&timeinfo);
+    entry.text = text;
+
+    if (logEntryCount < MAX_LOG_ENTRIES) {
+      logEntryCount++;
+    }
+  }
+
+  persistMark(PERSIST_LOGBOOK);
+  LOGI("LOG", "Added entry: %s", entry.text.c_str());
+}
+
+void deleteLogEntry(int index) {
+  if (index < 0 || index >= logEntryCount)
+    return;
+
+  {
+    PersistStateLock lock;
+    for (int i = index; i < logEntryCount - 1; i++) {
+      logEntries[i] = logEntries[i + 1];
+    }
+    logEntryCount--;
+  }
+
+  persistMark(PERSIST_LOGBOOK);
+  LOGI("LOG", "Deleted entry at index %d", index);
+}
+
+void clearLogbook() {
+  {
+    PersistStateLock lock;
+    logEntryCount = 0;
+  }
+  persistMark(PERSIST_LOGBOOK);
+  LOGI("LOG", "Logbook cleared");
+}
+
+String getLogbookJSON() {
+  ALLOC_SCOPE("logbookJSON");
+  size_t size = 32;
+  for (int i = 0; i < logEntryCount; i++)
+    size += logEntries[i].text.length() + 72;
+  String json;
+  json.reserve(size);
+  json += "{\"entries\":[";
+  for (int i = 0; i < logEntryCount; i++) {
+    char timeStr[20];
+    struct tm *timeinfo = localtime(&logEntries[i].timestamp);
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M", timeinfo);
+
+    char text[MAX_LOG_TEXT_LENGTH * 2 + 1];
+    size_t n = 0;
+    for (const char *c = logEntries[i].text.c_str(); *c; c++) {
+      switch (*c) {
+      case '"':
+      case '\\':
+        text[n++] = '\\';
+        text[n++] = *c;
+        break;
+      case '\n':
+        text[n++] = '\\';
+        text[n++] = 'n';
+        break;
+      case '\r':
+        text[n++] = '\\';
+        text[n++] = 'r';
+        break;
+      case '\t':
+        text[n++] = '\\';
+        text[n++] = 't';
+        break;
+      default:
+        text[n++] = *c;
+      }
+    }
+    text[n] = '\0';
+
+    char head[80];
+    snprintf(head, sizeof(head),
+             "%s{\"index\":%d,\"ts\":%ld,\"time\":\"%s\",\"text\":\"",
+             i > 0 ? "," : "", i, (long)logEntries[i].timestamp, timeStr);
+    json += head;
+    json += text;
+    json += "\"}";
+  }
+  json += "],\"count\":" + String(logEntryCount) + "}";
+  return json;
+}
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include <stdarg.h>
+
+#include "allocstats.h"
+#include "chunkwriter.h"
+#include "config.h"
+
+// Asynchronous logger. LOGE/LOGW/LOGI/LOGD format the line into a slot of a
+// fixed ring and return; a low-priority task writes the ring to Serial, so a
+// slow UART no longer blocks the control loop, AsyncTCP or the BLE task.
+//
+// A producer claims a slot with one atomic increment of logHead and
+// publishes it by storing the slot's sequence number last. Readers (the
+// drain task and /api/logs) copy a slot and re-check the sequence, seqlock
+// style, so a slot that is overwritten mid-copy is skipped rather than
+// printed torn. When producers lap the drain task the oldest lines are lost
+// and counted in logDropped.
+//
+// Levels above LOG_LEVEL compile to nothing. Override it from platformio.ini,
+// e.g. build_flags = -DLOG_LEVEL=LOG_LEVEL_DEBUG.
+//
+// Interactive console output (HELP, STATUS, DIAG) and the boot banner still
+// go to Serial directly.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_TAG_MAX 8
+#define LOG_TEXT_MAX 96
+
+#define LOGE(tag, ...) LOG_AT(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#define LOGW(tag, ...) LOG_AT(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define LOGI(tag, ...) LOG_AT(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define LOGD(tag, ...) LOG_AT(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+
+// The constant condition removes filtered calls at compile time while the
+// format string is still type-checked.
+#define LOG_AT(level, tag, ...)                                                \
+  do {                                                                         \
+    if (LOG_LEVEL >= (level))                                                  \
+      logWrite((level), (tag), __VA_ARGS__);                                   \
+  } while (0)
+
+struct LogRecord {
+  std::atomic<uint32_t> seq; // ticket + 1 once published, 0 while written
+  uint32_t ms;
+  uint8_t level;
+  char tag[LOG_TAG_MAX];
+  char text[LOG_TEXT_MAX];
+};
+
+// Reader-side copy of a record.
+struct LogLine {
+  uint32_t seq;
+  uint32_t ms;
+  uint8_t level;
+  char tag[LOG_TAG_MAX];
+  char text[LOG_TEXT_MAX];
+};
+
+LogRecord logRing[LOG_RING_SIZE];
+std::atomic<uint32_t> logHead(0); // next ticket to hand out
+uint32_t logDrained = 0;          // next ticket the drain task prints
+uint32_t logDropped = 0;          // lines overwritten before being printed
+TaskHandle_t logTask = NULL;
+
+static const uint32_t LOG_RING_MASK = LOG_RING_SIZE - 1;
+
+void logWrite(uint8_t level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+void logWrite(uint8_t level, const char *tag, const char *fmt, ...) {
+  uint32_t ticket = logHead.fetch_add(1, std::memory_order_relaxed);
+  LogRecord &r = logRing[ticket & LOG_RING_MASK];
+  r.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  r.ms = millis();
+  r.level = level;
+  strncpy(r.tag, tag, LOG_TAG_MAX - 1);
+  r.tag[LOG_TAG_MAX - 1] = '\0';
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(r.text, LOG_TEXT_MAX, fmt, args);
+  va_end(args);
+
+  r.seq.store(ticket + 1, std::memory_order_release);
+}
+
+// Copies record `ticket`. Returns false if it is not published yet or has
+// been overwritten.
+bool logRead(uint32_t ticket, LogLine &out) {
+  const LogRecord &r = logRing[ticket & LOG_RING_MASK];
+  if (r.seq.load(std::memory_order_acquire) != ticket + 1)
+    return false;
+  out.seq = ticket;
+  out.ms = r.ms;
+  out.level = r.level;
+  memcpy(out.tag, r.tag, LOG_TAG_MAX);
+  memcpy(out.text, r.text, LOG_TEXT_MAX);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (r.seq.load(std::memory_order_relaxed) != ticket + 1)
+    return false;
+  out.tag[LOG_TAG_MAX - 1] = '\0';
+  out.text[LOG_TEXT_MAX - 1] = '\0';
+  return true;
+}
+
+// Oldest ticket still held by the ring.
+uint32_t logOldest() {
+  uint32_t head = logHead.load(std::memory_order_acquire);
+  return head > LOG_RING_SIZE ? head - LOG_RING_SIZE : 0;
+}
+
+const char *logLevelName(uint8_t level) {
+  switch (level) {
+  case LOG_LEVEL_ERROR:
+    return "error";
+  case LOG_LEVEL_WARN:
+    return "warn";
+  case LOG_LEVEL_INFO:
+    return "info";
+  default:
+    return "debug";
+  }
+}
+
+// Prints everything published since the last call. Runs only in the drain
+// task.
+void logDrain() {
+  ALLOC_SCOPE("logDrain");
+  uint32_t head = logHead.load(std::memory_order_acquire);
+  if (head - logDrained > LOG_RING_SIZE) {
+    logDropped += head - logDrained - LOG_RING_SIZE;
+    logDrained = head - LOG_RING_SIZE;
+  }
+  while (logDrained != head) {
+    LogLine line;
+    if (!logRead(logDrained, line))
+      break; // still being written; the next pass picks it up
+    // Piecewise: Print::printf() allocates for output over 64 bytes.
+    Serial.print('[');
+    Serial.print(line.tag);
+    Serial.print("] ");
+    if (line.level <= LOG_LEVEL_WARN)
+      Serial.print(line.level == LOG_LEVEL_ERROR ? "ERROR: " : "WARNING: ");
+    Serial.print(line.text);
+    Serial.print('\n');
+    logDrained++;
+  }
+}
+
+static void logDrainTask(void *arg) {
+  for (;;) {
+    logDrain();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL));
+  }
+}
+
+// Starts the drain task. Lines logged before this are printed once it runs.
+void initLogger() {
+  xTaskCreate(logDrainTask, "log", 3072, NULL, tskIDLE_PRIORITY + 1, &logTask);
+}
+
+// Position of a /api/logs query. Lines are rendered whole into each chunk,
+// so a line that is overwritten between chunks is simply left out.
+struct LogCursor {
+  uint32_t next;
+  uint32_t to;
+  uint8_t level;
+  bool started;
+  bool first;
+  bool done;
+};
+
+static void logEscape(char *out, size_t len, const char *text) {
+  size_t n = 0;
+  for (; *text && n + 2 < len; text++) {
+    char c = *text;
+    if (c == '"' || c == '\\') {
+      out[n++] = '\\';
+      out[n++] = c;
+    } else if ((uint8_t)c >= 0x20) {
+      out[n++] = c;
+    }
+  }
+  out[n] = '\0';
+}
+
+// Fills one chunk. Returns the bytes written; 0 once the query is finished.
+size_t logFill(LogCursor &c, uint8_t *buffer, size_t maxLen) {
+  ChunkWriter w = {(char *)buffer, maxLen, 0, 0, 0, false};
+  if (c.done)
+    return 0;
+
+  if (!c.started) {
+    chunkPrintf(w, "{\"head\":%lu,\"dropped\":%lu,\"entries\":[",
+                (unsigned long)c.to, (unsigned long)logDropped);
+    if (w.full)
+      return 0;
+    c.started = true;
+  }
+
+  char text[LOG_TEXT_MAX * 2];
+  for (; c.next != c.to; c.next++) {
+    LogLine line;
+    if (!logRead(c.next, line) || line.level > c.level)
+      continue;
+    logEscape(text, sizeof(text), line.text);
+    chunkPrintf(w,
+                "%s{\"seq\":%lu,\"ms\":%lu,\"level\":\"%s\",\"tag\":\"%s\","
+                "\"msg\":\"%s\"}",
+                c.first ? "" : ",", (unsigned long)line.seq,
+                (unsigned long)line.ms, logLevelName(line.level), line.tag,
+                text);
+    if (w.full)
+      return w.len;
+    c.first = false;
+  }
+
+  chunkPrintf(w, "]}");
+  if (!w.full)
+    c.done = true;
+  return w.len;
+}
+
+// GET /api/logs?since=<seq>&level=<error|warn|info|debug> -- lines still in
+// the ring from `since` on (default: all of them). Poll again with
+// since=<head> to follow the log.
+void handleLogs(AsyncWebServerRequest *request) {
+  LogCursor c;
+  memset(&c, 0, sizeof(c));
+  c.to = logHead.load(std::memory_order_acquire);
+  c.next = logOldest();
+  if (request->hasParam("since")) {
+    uint32_t since = request->getParam("since")->value().toInt();
+    if (since > c.to) {
+      since = c.to;
+    }
+    if (since > c.next) {
+      c.next = since;
+    }
+  }
+  c.level = LOG_LEVEL_DEBUG;
+  if (request->hasParam("level")) {
+    String level = request->getParam("level")->value();
+    for (uint8_t l = LOG_LEVEL_ERROR; l <= LOG_LEVEL_DEBUG; l++) {
+      if (level == logLevelName(l))
+        c.level = l;
+    }
+  }
+  c.first = true;
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [c](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+        bool pending = !c.done;
+        size_t len = logFill(c, buffer, maxLen);
+        if (len == 0 && pending && !c.done)
+          return RESPONSE_TRY_AGAIN;
+        return len;
+      });
+  request->send(response);
+}
+
+#endif
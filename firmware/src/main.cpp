@@ -7,77 +7,101 @@
 #include <WiFi.h>
 #include <time.h>
 
+#include "cli.h"
 #include "config.h"
+#include "control.h"
+#include "diag.h"
 #include "frontend.h"
+#include "history.h"
+#include "logbook.h"
+#include "logger.h"
+#include "metrics.h"
+#include "persist.h"
+#include "power.h"
 #include "state.h"
+#include "status.h"
+#include "tasks.h"
+#include "telemetry.h"
+#include "timecache.h"
+#include "usage.h"
 #include "webserver.h"
 
+#ifdef ENABLE_BLE
+#include <GrowTowerBLE.h>
 
-Preferences preferences;
-char currentHostname[32] = "growtower";
+#include "blecommand.h"
 
-int fanMinPercent = 0;
-int fanMaxPercent = 100;
-int lightOnHour = 10;   // One Bud Method only Flower
-int lightDuration = 12; // One Bud Method only Flower
-bool timerEnabled = true;
+// BLE characteristic writes go through the same registry as serial and HTTP.
+// They arrive in the Bluedroid task, which only validates and queues them.
+static growtower_ble_result_t bleResult(CommandStatus status) {
+  if (status == CMD_OK)
+    return GROWTOWER_BLE_OK;
+  return status == CMD_BUSY ? GROWTOWER_BLE_BUSY : GROWTOWER_BLE_REJECTED;
+}
 
-bool isLightOn = false;
-int currentFanSpeed = 30;
-TimezoneMode currentTzMode = TZ_AUTO;
+static growtower_ble_result_t bleCommand(const char *command, int value) {
+  CommandStatus status = runCommandValue(CMD_SRC_BLE, command, value);
+  if (status == CMD_OK) {
+    LOGI("BLE", "WRITE %s: %d", command, value);
+  } else {
+    LOGW("BLE", "WRITE %s: %d rejected (%s)", command, value,
+         commandStatusText(status));
+  }
+  return bleResult(status);
+}
 
-bool isAPMode = false;
-unsigned long lastBlinkTime = 0;
-char wifiSSID[32] = "";
-char wifiPass[64] = "";
+static growtower_ble_result_t bleBatch(const uint8_t *pairs, int count) {
+  CommandStatus status = runBleBatch(pairs, count);
+  if (status == CMD_OK) {
+    LOGI("BLE", "BATCH %d commands", count);
+  } else {
+    LOGW("BLE", "BATCH %d commands rejected (%s)", count,
+         commandStatusText(status));
+  }
+  return bleResult(status);
+}
+
+// The library's own messages, mostly from the Bluedroid task
+static void bleLog(bool warning, const char *message) {
+  if (warning) {
+    LOGW("BLE", "%s", message);
+  } else {
+    LOGI("BLE", "%s", message);
+  }
+}
+
+uint32_t bleStateVersion = 0;
+
+// Called by the control task once per tick (tasks.h). Everything that
+// changed during the tick goes out as one notification per characteristic.
+void bleTick() {
+  if (stateVersion == bleStateVersion)
+    return;
+  bleStateVersion = stateVersion;
+  growtower_ble_update_light(isLightOn);
+  growtower_ble_update_fan(currentFanSpeed);
+  growtower_ble_update_fan_min(fanMinPercent);
+  growtower_ble_update_fan_max(fanMaxPercent);
+  growtower_ble_update_light_on_hour(lightOnHour);
+  growtower_ble_update_light_off_hour((lightOnHour + lightDuration) % 24);
+  uint8_t status[STATUS_BIN_SIZE];
+  growtower_ble_update_status(status, encodeStatusBinary(status));
+  growtower_ble_notify_changes();
+}
+#endif
 
-PhaseData phases[3] = {{0, false}, {0, false}, {0, false}};
-PlantPhase currentPhase = PHASE_NONE;
+bool isAPMode = false;
 
 unsigned long lastWiFiCheck = 0;
 bool wasConnected = true;
 
-void loadLogbook();
-void saveLogbook();
-void addLogEntry(String text);
-void deleteLogEntry(int index);
-void clearLogbook();
-String getLogbookJSON();
 void checkWiFi();
-void setSystemTime(long epoch);
-
-void setSystemTime(long epoch) {
-  struct timeval tv;
-  tv.tv_sec = epoch;
-  tv.tv_usec = 0;
-  settimeofday(&tv, NULL);
-  Serial.printf("[TIME] System time set manually to: %ld\n", epoch);
-}
-
-void applyTimezone() {
-  const char *tz;
-  switch (currentTzMode) {
-  case TZ_WINTER:
-    tz = "CET-1";
-    Serial.println("[TIME] Mode: Winter (CET-1)");
-    break;
-  case TZ_SUMMER:
-    tz = "CEST-2";
-    Serial.println("[TIME] Mode: Summer (CEST-2)");
-    break;
-  case TZ_AUTO:
-  default:
-    tz = TZ_INFO;
-    Serial.println("[TIME] Mode: Auto (Europe/Berlin)");
-    break;
-  }
-  configTzTime(tz, NTP_SERVER);
-}
 
 AsyncWebServer server(80);
 
 void setup() {
   Serial.begin(115200);
+  initLogger();
   delay(1000);
 
   Serial.println("\n");
@@ -90,9 +114,20 @@ void setup() {
   Serial.println(
       "╚══════════════════════════════════════════════════════════════╝");
   Serial.println("\n[SYS] System initializing...\n");
+  bootId = esp_random();
+  if (esp_reset_reason() == ESP_RST_BROWNOUT) {
+    LOGW("SYS", "Last reset was a brownout; changes from the last %lu ms "
+                "may be lost", PERSIST_DELAY);
+  }
+
+  // The logbook is stored on LittleFS, so mount it before loading.
+  Serial.println("[SYS] Mounting flash storage...");
+  initTelemetry();
 
   Serial.println("[SYS] Loading configuration from flash...");
   loadSettings();
+  loadUsage();
+  initPersist();
 
   Serial.println("[SYS] Initializing light control...");
   pinMode(LIGHT_PIN, OUTPUT);
@@ -101,6 +136,19 @@ void setup() {
   Serial.println("[SYS] Initializing fan PWM...");
   initPWM();
   setFan(currentFanSpeed);
+#ifdef POWER_SAVE
+  Serial.println("[SYS] Enabling power management...");
+  initPowerSave();
+#endif
+
+#ifdef STATUS_LED_PIN
+  pinMode(STATUS_LED_PIN, OUTPUT);
+  digitalWrite(STATUS_LED_PIN, LOW);
+#endif
+
+  Serial.println("[SYS] Restoring last known time...");
+  restoreTimeCache();
+  checkTimer();
 
   Serial.println("[SYS] Initializing WiFi...");
   initWiFi();
@@ -112,83 +160,76 @@ void setup() {
   Serial.println("[SYS] Initializing Web Server...");
   initWebServer();
 
+#ifdef ENABLE_BLE
+  Serial.println("[SYS] Initializing BLE...");
+  growtower_ble_set_log_callback(bleLog);
+  growtower_ble_init(bleCommand, bleBatch, isLightOn, currentFanSpeed,
+                     fanMinPercent, fanMaxPercent, lightOnHour,
+                     (lightOnHour + lightDuration) % 24);
+#endif
+
+  Serial.println("[SYS] Starting tasks...");
+  startTasks();
+
   Serial.println("\n[SYS] Initialization complete!");
   printStatus();
-  Serial.println("\n[SYS] Ready. Access the controller at: http://" +
-                 String(currentHostname) + ".local\n");
+  Serial.printf("\n[SYS] Ready. Access the controller at: http://%s.local\n\n",
+                currentHostname.c_str());
 }
 
-void loop() {
-  ArduinoOTA.handle();
-
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    // No time available -> Blink!
-    unsigned long now = millis();
-    if (now - lastBlinkTime >= 1000) {
-      lastBlinkTime = now;
-      setLight(!isLightOn);
-      Serial.println("[SYS] WARNING: No time sync! Blinking...");
-    }
-  } else {
-    checkTimer();
-  }
+// Everything runs in the tasks started by setup() (tasks.h); this frees the
+// loop task's stack.
+void loop() { vTaskDelete(NULL); }
 
+// One cycle of the network task.
+void networkTick() {
+  ArduinoOTA.handle();
+  unsigned long sectionStart = micros();
   checkWiFi();
-
-  if (Serial.available() > 0) {
-    String input = Serial.readStringUntil('\n');
-    input.trim();
-    if (input.length() > 0) {
-      processCommand(input);
-    }
-  }
-
-  delay(100);
+  diagRecordSection(DIAG_CHECK_WIFI, micros() - sectionStart);
+  cliPoll();
 }
 
+// The timezone is applied on the control task, which owns local time.
+static void applyTimezoneCall(void *arg) { applyTimezone(); }
+
 void checkWiFi() {
   if (isAPMode)
     return;
 
   if (WiFi.status() != WL_CONNECTED) {
     if (wasConnected) {
-      Serial.println("[WIFI] Connection lost!");
+      LOGW("WIFI", "Connection lost!");
       wasConnected = false;
+      bumpStateVersion();
       lastWiFiCheck = millis();
     }
 
     unsigned long now = millis();
     if (now - lastWiFiCheck >= WIFI_RECONNECT_INTERVAL) {
       lastWiFiCheck = now;
-      Serial.println("[WIFI] Attempting to reconnect...");
+      LOGI("WIFI", "Attempting to reconnect...");
       initWiFi();
     }
   } else {
     if (!wasConnected) {
-      Serial.printf("[WIFI] Connection restored! IP: %s\n",
-                    WiFi.localIP().toString().c_str());
+      LOGI("WIFI", "Connection restored! IP: %s",
+           WiFi.localIP().toString().c_str());
       wasConnected = true;
+      bumpStateVersion();
 
       // Re-initialize NTP on reconnection
-      Serial.println("[NTP] Re-synchronizing time...");
-      applyTimezone();
+      LOGI("NTP", "Re-synchronizing time...");
+      controlRun(applyTimezoneCall, NULL);
     }
   }
 }
 
-void initPWM() {
-  ledcSetup(PWM_CHANNEL, PWM_FREQUENCY, PWM_RESOLUTION);
-  ledcAttachPin(FAN_PIN, PWM_CHANNEL);
-  Serial.printf("[PWM] Initialized: Channel=%d, Freq=%dHz, Resolution=%dbit\n",
-                PWM_CHANNEL, PWM_FREQUENCY, PWM_RESOLUTION);
-}
-
 void initWiFi() {
-  String ssid = String(wifiSSID);
-  String pass = String(wifiPass);
+  const char *ssid = wifiSSID.c_str();
+  const char *pass = wifiPass.c_str();
 
-  if (ssid == "") {
+  if (ssid[0] == '\0') {
 #ifdef WIFI_SSID
     ssid = WIFI_SSID;
 #ifdef WIFI_PASS
@@ -197,17 +238,18 @@ void initWiFi() {
 #endif
   }
 
-  if (ssid != "") {
-    Serial.printf("[WIFI] Connecting to: %s\n", ssid.c_str());
+  if (ssid[0] != '\0') {
+    Serial.printf("[WIFI] Connecting to: %s\n", ssid);
     WiFi.mode(WIFI_STA);
-    if (pass != "") {
-      WiFi.begin(ssid.c_str(), pass.c_str());
+    if (pass[0] != '\0') {
+      WiFi.begin(ssid, pass);
     } else {
-      WiFi.begin(ssid.c_str());
+      WiFi.begin(ssid);
     }
 
     int retries = 0;
     while (WiFi.status() != WL_CONNECTED && retries < 20) {
+      esp_task_wdt_reset();
       delay(500);
       Serial.print(".");
       retries++;
@@ -220,8 +262,16 @@ void initWiFi() {
                   WiFi.localIP().toString().c_str());
     isAPMode = false;
     wasConnected = true;
+    bumpStateVersion();
+#ifdef POWER_SAVE
+    // Listen interval left at the driver default (POWER_LISTEN_INTERVAL).
+    WiFi.setSleep(WIFI_PS_MAX_MODEM);
+    powerSetRadio(POWER_RADIO_MAX);
+#else
+    powerSetRadio(POWER_RADIO_DTIM); // Arduino default, WIFI_PS_MIN_MODEM
+#endif
     Serial.println("[NTP] Initializing time synchronization...");
-    applyTimezone();
+    controlRun(applyTimezoneCall, NULL);
     printLocalTime();
   } else {
     Serial.println("[WIFI] Connection failed! Starting Fallback AP...");
@@ -231,6 +281,7 @@ void initWiFi() {
                   WiFi.softAPIP().toString().c_str());
     isAPMode = true;
     wasConnected = false;
+    powerSetRadio(POWER_RADIO_ON);
   }
 }
 
@@ -240,26 +291,39 @@ void initOTA() {
     return;
   }
 
-  if (!MDNS.begin(currentHostname)) {
+  if (!MDNS.begin(currentHostname.c_str())) {
     Serial.println("[OTA] Error setting up mDNS responder!");
     return;
   }
-  Serial.printf("[OTA] mDNS responder started: %s.local\n", currentHostname);
+  Serial.printf("[OTA] mDNS responder started: %s.local\n", currentHostname.c_str());
 
   MDNS.addService("http", "tcp", 80);
 
-  ArduinoOTA.setHostname(currentHostname);
+  ArduinoOTA.setHostname(currentHostname.c_str());
   ArduinoOTA.setPort(OTA_PORT);
   ArduinoOTA.setPassword("growtower123");
 
   ArduinoOTA.onStart([]() {
     String type = ArduinoOTA.getCommand() == U_FLASH ? "sketch" : "filesystem";
     Serial.printf("[OTA] Start updating %s\n", type.c_str());
+    controlRun(
+        [](void *arg) {
+          saveUsage();
+          if (ArduinoOTA.getCommand() == U_FLASH) {
+            telemetrySeal(); // keep the current hour of telemetry
+          }
+        },
+        NULL);
+    // Writes what the control task just handed over.
+    persistFlush();
+    telemetryWriteSealed();
   });
 
   ArduinoOTA.onEnd([]() { Serial.println("[OTA] Update complete"); });
 
+  // The transfer runs inside ArduinoOTA.handle() on the network task.
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
+    esp_task_wdt_reset();
     Serial.printf("[OTA] Progress: %u%%\r", (progress / (total / 100)));
   });
 
@@ -281,281 +345,6 @@ void initOTA() {
   Serial.printf("[OTA] Ready on port %d\n", OTA_PORT);
 }
 
-String getStatusJSON() {
-  struct tm timeinfo;
-  bool hasTime = getLocalTime(&timeinfo);
-
-  String json = "{";
-  json += "\"light\":" + String(isLightOn ? "true" : "false") + ",";
-  json += "\"fan\":" + String(currentFanSpeed) + ",";
-  json += "\"fanMin\":" + String(fanMinPercent) + ",";
-  json += "\"fanMax\":" + String(fanMaxPercent) + ",";
-  json += "\"lightOn\":" + String(lightOnHour) + ",";
-  json += "\"lightDuration\":" + String(lightDuration) + ",";
-  json += "\"timerEnabled\":" + String(timerEnabled ? "true" : "false") + ",";
-  json += "\"tzMode\":" + String((int)currentTzMode) + ",";
-  json += "\"hostname\":\"" + String(currentHostname) + "\",";
-  json += "\"ip\":\"" + WiFi.localIP().toString() + "\",";
-  json += "\"wifiConnected\":" +
-          String(WiFi.status() == WL_CONNECTED ? "true" : "false") + ",";
-  json += "\"hasTime\":" + String(hasTime ? "true" : "false");
-  if (hasTime) {
-    char timeStr[25];
-    strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
-    json += ",\"currentTime\":\"" + String(timeStr) + "\"";
-  }
-  json += "," + getPhaseJSON();
-  json += "}";
-  return json;
-}
-
-void loadSettings() {
-  preferences.begin("growtower", true);
-
-  fanMinPercent = preferences.getInt("fanMin", 0);
-  fanMaxPercent = preferences.getInt("fanMax", 100);
-  currentFanSpeed = preferences.getInt("fanSpeed", 30);
-  lightOnHour = preferences.getInt("onHour", 10);
-  lightDuration = preferences.getInt("duration", 12);
-  timerEnabled = preferences.getBool("timerEnabled", true);
-  currentTzMode = (TimezoneMode)preferences.getInt("tzMode", (int)TZ_AUTO);
-
-  String savedHostname = preferences.getString("hostname", DEFAULT_HOSTNAME);
-  strncpy(currentHostname, savedHostname.c_str(), sizeof(currentHostname) - 1);
-  currentHostname[sizeof(currentHostname) - 1] = '\0';
-
-  String savedSSID = preferences.getString("ssid", "");
-  String savedPass = preferences.getString("pass", "");
-  strncpy(wifiSSID, savedSSID.c_str(), sizeof(wifiSSID) - 1);
-  strncpy(wifiPass, savedPass.c_str(), sizeof(wifiPass) - 1);
-
-  preferences.end();
-
-  loadPhaseData();
-  loadLogbook();
-
-  Serial.printf("[CONFIG] Loaded: FanMin=%d%%, FanMax=%d%%, FanSpeed=%d%%, "
-                "LightOn=%d:00, Duration=%dh, "
-                "Hostname=%s, TzMode=%d\n",
-                fanMinPercent, fanMaxPercent, currentFanSpeed, lightOnHour,
-                lightDuration, currentHostname, (int)currentTzMode);
-}
-
-void saveWiFiCredentials(const char *ssid, const char *pass) {
-  preferences.begin("growtower", false);
-  preferences.putString("ssid", ssid);
-  preferences.putString("pass", pass);
-  preferences.end();
-
-  strncpy(wifiSSID, ssid, sizeof(wifiSSID) - 1);
-  strncpy(wifiPass, pass, sizeof(wifiPass) - 1);
-
-  Serial.println("[CONFIG] WiFi credentials saved. Restarting...");
-  delay(1000);
-  ESP.restart();
-}
-
-void saveFanSpeed(int percent) {
-  if (percent < 0)
-    percent = 0;
-  if (percent > 100)
-    percent = 100;
-
-  currentFanSpeed = percent;
-  preferences.begin("growtower", false);
-  preferences.putInt("fanSpeed", currentFanSpeed);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Fan Speed saved: %d%%\n", currentFanSpeed);
-  setFan(currentFanSpeed);
-}
-
-void saveFanMin(int minVal) {
-  if (minVal < 0)
-    minVal = 0;
-  if (minVal > 100)
-    minVal = 100;
-
-  fanMinPercent = minVal;
-  preferences.begin("growtower", false);
-  preferences.putInt("fanMin", fanMinPercent);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Fan Min saved: %d%%\n", fanMinPercent);
-  setFan(currentFanSpeed);
-}
-
-void saveFanMax(int maxVal) {
-  if (maxVal < 0)
-    maxVal = 0;
-  if (maxVal > 100)
-    maxVal = 100;
-
-  fanMaxPercent = maxVal;
-  preferences.begin("growtower", false);
-  preferences.putInt("fanMax", fanMaxPercent);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Fan Max saved: %d%%\n", fanMaxPercent);
-  setFan(currentFanSpeed);
-}
-
-void saveLightOnHour(int hour) {
-  if (hour < 0)
-    hour = 0;
-  if (hour > 23)
-    hour = 23;
-
-  lightOnHour = hour;
-  preferences.begin("growtower", false);
-  preferences.putInt("onHour", lightOnHour);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Light On Hour saved: %d:00\n", lightOnHour);
-  checkTimer();
-}
-
-void saveLightDuration(int hours) {
-  if (hours < 1)
-    hours = 1;
-  if (hours > 24)
-    hours = 24;
-
-  lightDuration = hours;
-  preferences.begin("growtower", false);
-  preferences.putInt("duration", lightDuration);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Light Duration saved: %dh\n", lightDuration);
-  checkTimer();
-}
-
-void saveTimerEnabled(bool enabled) {
-  timerEnabled = enabled;
-  preferences.begin("growtower", false);
-  preferences.putBool("timerEnabled", timerEnabled);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Timer enabled: %s\n",
-                timerEnabled ? "true" : "false");
-  checkTimer();
-}
-
-void saveTzMode(TimezoneMode mode) {
-  currentTzMode = mode;
-  preferences.begin("growtower", false);
-  preferences.putInt("tzMode", (int)currentTzMode);
-  preferences.end();
-
-  Serial.printf("[CONFIG] Timezone mode saved: %d\n", (int)currentTzMode);
-  applyTimezone();
-}
-
-void resetAllSettings() {
-  Serial.println("[SYS] Resetting all settings to defaults...");
-  preferences.begin("growtower", false);
-  preferences.clear();
-  preferences.end();
-
-  phases[PHASE_SEEDLING].startTime = 0;
-  phases[PHASE_SEEDLING].active = false;
-  phases[PHASE_VEG].startTime = 0;
-  phases[PHASE_VEG].active = false;
-  phases[PHASE_FLOWER].startTime = 0;
-  phases[PHASE_FLOWER].active = false;
-  currentPhase = PHASE_NONE;
-  savePhaseData();
-  clearLogbook();
-
-  Serial.println("[SYS] Settings cleared. Rebooting...");
-  delay(1000);
-  ESP.restart();
-}
-
-void saveHostname(const char *hostname) {
-  preferences.begin("growtower", false);
-  preferences.putString("hostname", hostname);
-  preferences.end();
-
-  strncpy(currentHostname, hostname, sizeof(currentHostname) - 1);
-  currentHostname[sizeof(currentHostname) - 1] = '\0';
-
-  Serial.printf("[CONFIG] Hostname saved: %s\n", currentHostname);
-}
-
-void setLight(bool on) {
-  if (on) {
-    digitalWrite(LIGHT_PIN, HIGH);
-    Serial.println("[LIGHT] State: ON");
-  } else {
-    digitalWrite(LIGHT_PIN, LOW);
-    Serial.println("[LIGHT] State: OFF");
-  }
-  isLightOn = on;
-}
-
-void setFan(int percent) {
-  if (percent < 0)
-    percent = 0;
-  if (percent > 100)
-    percent = 100;
-
-  currentFanSpeed = percent;
-  int dutyCycle = 0;
-
-  if (percent == 0) {
-    dutyCycle = 0;
-  } else {
-    int effectiveMin = fanMinPercent;
-    int effectiveMax = fanMaxPercent;
-    if (effectiveMin > effectiveMax) {
-      effectiveMin = effectiveMax;
-    }
-
-    long mappedPercent = map(percent, 1, 100, effectiveMin, effectiveMax);
-    dutyCycle =
-        map(mappedPercent, 0, 100, HARDWARE_FAN_MIN_DUTY, MAX_DUTY_CYCLE);
-  }
-
-  ledcWrite(PWM_CHANNEL, dutyCycle);
-
-  Serial.printf(
-      "[FAN] Speed: %d%% (Effective Range: %d%%-%d%%, Duty: %d/255)\n", percent,
-      fanMinPercent, fanMaxPercent, dutyCycle);
-}
-
-void checkTimer() {
-  if (!timerEnabled) {
-    return;
-  }
-
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    return;
-  }
-
-  int currentHour = timeinfo.tm_hour;
-  bool shouldBeOn = false;
-
-  int lightOffHour = lightOnHour + lightDuration;
-  if (lightOffHour >= 24)
-    lightOffHour -= 24;
-
-  if (lightOnHour > lightOffHour) {
-    shouldBeOn = (currentHour >= lightOnHour || currentHour < lightOffHour);
-  } else {
-    shouldBeOn = (currentHour >= lightOnHour && currentHour < lightOffHour);
-  }
-
-  if (shouldBeOn != isLightOn) {
-    Serial.printf("[TIMER] Time: %02d:%02d | Light: %02d:00-%02d:00 | "
-                  "Auto-switching light %s\n",
-                  currentHour, timeinfo.tm_min, lightOnHour, lightOffHour,
-                  shouldBeOn ? "ON" : "OFF");
-    setLight(shouldBeOn);
-  }
-}
-
 void printLocalTime() {
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo)) {
@@ -578,380 +367,10 @@ void printStatus() {
   Serial.printf("  Fan Range:    %d%% - %d%%\n", fanMinPercent, fanMaxPercent);
   Serial.printf("  Light Timer:  %02d:00 - %02d:00 (%dh)\n", lightOnHour,
                 lightOffHour, lightDuration);
-  Serial.printf("  Hostname:     %s.local\n", currentHostname);
+  Serial.printf("  Hostname:     %s.local\n", currentHostname.c_str());
   Serial.printf("  IP Address:   %s\n", WiFi.localIP().toString().c_str());
   Serial.printf("  Web Server:   %s\n",
                 WiFi.status() == WL_CONNECTED ? "Running ✓" : "Disabled ✗");
   Serial.println("═══════════════════════════════════════════════\n");
 }
 
-void processCommand(String command) {
-  command.trim();
-  command.toUpperCase();
-
-  Serial.printf("[CMD] Received: '%s'\n", command.c_str());
-
-  if (command == "HELP" || command == "?") {
-    Serial.println("\n╔════════════════════════════════════════════════╗");
-    Serial.println("║              AVAILABLE COMMANDS                ║");
-    Serial.println("╠════════════════════════════════════════════════╣");
-    Serial.println("║  ON              - Turn light ON               ║");
-    Serial.println("║  OFF             - Turn light OFF              ║");
-    Serial.println("║  FAN <0-100>     - Set fan speed (percent)    ║");
-    Serial.println("║  FANMIN <0-100>  - Set fan minimum speed      ║");
-    Serial.println("║  FANMAX <0-100>  - Set fan maximum speed      ║");
-    Serial.println("║  LIGHTON <0-23>  - Set light ON hour           ║");
-    Serial.println("║  LIGHTTIME <1-24>- Set light duration (hours) ║");
-    Serial.println("║  HOST <name>     - Set hostname               ║");
-    Serial.println("║  TIME            - Show current time          ║");
-    Serial.println("║  STATUS          - Show system status         ║");
-    Serial.println("║  RESET           - Reset all settings         ║");
-    Serial.println("║  HELP            - Show this help             ║");
-    Serial.println("╚════════════════════════════════════════════════╝\n");
-  } else if (command == "ON") {
-    setLight(true);
-  } else if (command == "OFF") {
-    setLight(false);
-  } else if (command.startsWith("FAN ")) {
-    String valueStr = command.substring(4);
-    valueStr.trim();
-    int value = valueStr.toInt();
-    saveFanSpeed(value);
-  } else if (command.startsWith("FANMIN ")) {
-    String valueStr = command.substring(7);
-    valueStr.trim();
-    int value = valueStr.toInt();
-    saveFanMin(value);
-  } else if (command.startsWith("FANMAX ")) {
-    String valueStr = command.substring(7);
-    valueStr.trim();
-    int value = valueStr.toInt();
-    saveFanMax(value);
-  } else if (command.startsWith("LIGHTON ")) {
-    String valueStr = command.substring(8);
-    valueStr.trim();
-    int value = valueStr.toInt();
-    saveLightOnHour(value);
-  } else if (command.startsWith("LIGHTTIME ")) {
-    String valueStr = command.substring(10);
-    valueStr.trim();
-    int value = valueStr.toInt();
-    saveLightDuration(value);
-  } else if (command.startsWith("HOST ")) {
-    String valueStr = command.substring(5);
-    valueStr.trim();
-    valueStr.toLowerCase();
-    if (valueStr.length() > 0 && valueStr.length() < 32) {
-      saveHostname(valueStr.c_str());
-      Serial.println("[CMD] Hostname saved. Restart to apply changes.");
-    } else {
-      Serial.println("[CMD] Invalid hostname (1-31 chars)");
-    }
-  } else if (command == "TIME") {
-    printLocalTime();
-  } else if (command == "STATUS") {
-    printStatus();
-  } else if (command == "RESET") {
-    resetAllSettings();
-  } else {
-    Serial.printf("[CMD] Unknown command: '%s'\n", command.c_str());
-    Serial.println("[CMD] Type 'HELP' for available commands");
-  }
-}
-
-void loadPhaseData() {
-  preferences.begin("growtower", true);
-
-  phases[PHASE_SEEDLING].startTime = preferences.getLong("seedlingStart", 0);
-  phases[PHASE_VEG].startTime = preferences.getLong("vegStart", 0);
-  phases[PHASE_FLOWER].startTime = preferences.getLong("flowerStart", 0);
-
-  phases[PHASE_SEEDLING].active = preferences.getBool("seedlingActive", false);
-  phases[PHASE_VEG].active = preferences.getBool("vegActive", false);
-  phases[PHASE_FLOWER].active = preferences.getBool("flowerActive", false);
-
-  preferences.end();
-
-  currentPhase = PHASE_NONE;
-  if (phases[PHASE_SEEDLING].active)
-    currentPhase = PHASE_SEEDLING;
-  else if (phases[PHASE_VEG].active)
-    currentPhase = PHASE_VEG;
-  else if (phases[PHASE_FLOWER].active)
-    currentPhase = PHASE_FLOWER;
-
-  Serial.printf("[PHASE] Loaded: Seedling=%d, Veg=%d, Flower=%d, Current=%d\n",
-                phases[PHASE_SEEDLING].active ? 1 : 0,
-                phases[PHASE_VEG].active ? 1 : 0,
-                phases[PHASE_FLOWER].active ? 1 : 0, currentPhase);
-}
-
-void savePhaseData() {
-  preferences.begin("growtower", false);
-
-  preferences.putLong("seedlingStart", phases[PHASE_SEEDLING].startTime);
-  preferences.putLong("vegStart", phases[PHASE_VEG].startTime);
-  preferences.putLong("flowerStart", phases[PHASE_FLOWER].startTime);
-
-  preferences.putBool("seedlingActive", phases[PHASE_SEEDLING].active);
-  preferences.putBool("vegActive", phases[PHASE_VEG].active);
-  preferences.putBool("flowerActive", phases[PHASE_FLOWER].active);
-
-  preferences.end();
-}
-
-void setPhase(PlantPhase phase) {
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    Serial.println("[PHASE] Cannot set phase: NTP time not available");
-    return;
-  }
-
-  time_t now = mktime(&timeinfo);
-
-  if (phase == PHASE_NONE) {
-    phases[PHASE_SEEDLING].active = false;
-    phases[PHASE_VEG].active = false;
-    phases[PHASE_FLOWER].active = false;
-    currentPhase = PHASE_NONE;
-    Serial.println("[PHASE] All phases reset");
-  } else {
-    phases[PHASE_SEEDLING].active = (phase == PHASE_SEEDLING);
-    phases[PHASE_VEG].active = (phase == PHASE_VEG);
-    phases[PHASE_FLOWER].active = (phase == PHASE_FLOWER);
-
-    if (phase == PHASE_SEEDLING && phases[PHASE_SEEDLING].startTime == 0) {
-      phases[PHASE_SEEDLING].startTime = now;
-    } else if (phase == PHASE_VEG && phases[PHASE_VEG].startTime == 0) {
-      phases[PHASE_VEG].startTime = now;
-    } else if (phase == PHASE_FLOWER && phases[PHASE_FLOWER].startTime == 0) {
-      phases[PHASE_FLOWER].startTime = now;
-    }
-
-    currentPhase = phase;
-
-    const char *phaseNames[] = {"None", "Seedling", "Veg", "Flower"};
-    Serial.printf("[PHASE] Set to: %s\n", phaseNames[phase]);
-  }
-
-  savePhaseData();
-}
-
-int getPhaseDays(PlantPhase phase) {
-  if (phases[phase].startTime == 0)
-    return 0;
-
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo))
-    return 0;
-
-  time_t now = mktime(&timeinfo);
-  double diffSeconds = difftime(now, phases[phase].startTime);
-  return (int)(diffSeconds / 86400.0);
-}
-
-int getTotalDays() {
-  int total = 0;
-  if (phases[PHASE_SEEDLING].active || phases[PHASE_SEEDLING].startTime > 0) {
-    total += getPhaseDays(PHASE_SEEDLING);
-  }
-  if (phases[PHASE_VEG].active || phases[PHASE_VEG].startTime > 0) {
-    total += getPhaseDays(PHASE_VEG);
-  }
-  if (phases[PHASE_FLOWER].active || phases[PHASE_FLOWER].startTime > 0) {
-    total += getPhaseDays(PHASE_FLOWER);
-  }
-  return total;
-}
-
-void resetPhase(PlantPhase phase) {
-  phases[phase].startTime = 0;
-  phases[phase].active = false;
-
-  if (currentPhase == phase) {
-    currentPhase = PHASE_NONE;
-  }
-
-  savePhaseData();
-
-  const char *phaseNames[] = {"All", "Seedling", "Veg", "Flower"};
-  Serial.printf("[PHASE] Reset: %s\n", phaseNames[phase]);
-}
-
-String getPhaseJSON() {
-  const char *phaseNames[] = {"none", "seedling", "veg", "flower"};
-
-  String json = "\"phase\":\"" + String(phaseNames[currentPhase]) + "\",";
-  json += "\"currentPhase\":" + String(currentPhase) + ",";
-  json += "\"totalDays\":" + String(getTotalDays()) + ",";
-  json += "\"seedling\":{\"active\":" +
-          String(phases[PHASE_SEEDLING].active ? "true" : "false") +
-          ",\"days\":" + String(getPhaseDays(PHASE_SEEDLING)) + "},";
-  json += "\"veg\":{\"active\":" +
-          String(phases[PHASE_VEG].active ? "true" : "false") +
-          ",\"days\":" + String(getPhaseDays(PHASE_VEG)) + "},";
-  json += "\"flower\":{\"active\":" +
-          String(phases[PHASE_FLOWER].active ? "true" : "false") +
-          ",\"days\":" + String(getPhaseDays(PHASE_FLOWER)) + "}";
-
-  return json;
-}
-
-#define MAX_LOG_ENTRIES 50
-#define MAX_LOG_TEXT_LENGTH 200
-
-struct LogEntry {
-  time_t timestamp;
-  String text;
-};
-
-LogEntry logEntries[MAX_LOG_ENTRIES];
-int logEntryCount = 0;
-
-void loadLogbook() {
-  preferences.begin("growtower", true);
-  String logJson = preferences.getString("logbook", "[]");
-  preferences.end();
-
-  logEntryCount = 0;
-
-  int jsonLen = logJson.length();
-  if (jsonLen < 2)
-    return;
-
-  int entryStart = -1;
-  int braceCount = 0;
-  for (int i = 0; i < jsonLen; i++) {
-    if (logJson[i] == '{') {
-      if (braceCount == 0)
-        entryStart = i;
-      braceCount++;
-    } else if (logJson[i] == '}') {
-      braceCount--;
-      if (braceCount == 0 && entryStart >= 0) {
-        String entryStr = logJson.substring(entryStart, i + 1);
-        int tsIndex = entryStr.indexOf("\"ts\":");
-        int txtIndex = entryStr.indexOf("\"text\":\"");
-        if (tsIndex >= 0 && txtIndex >= 0) {
-          tsIndex += 5;
-          int tsEnd = entryStr.indexOf(",", tsIndex);
-          if (tsEnd < 0)
-            tsEnd = entryStr.indexOf("}", tsIndex);
-          if (tsEnd > tsIndex) {
-            String tsStr = entryStr.substring(tsIndex, tsEnd);
-            logEntries[logEntryCount].timestamp = tsStr.toInt();
-
-            txtIndex += 8;
-            int txtEnd = entryStr.indexOf("\"", txtIndex);
-            if (txtEnd > txtIndex) {
-              logEntries[logEntryCount].text =
-                  entryStr.substring(txtIndex, txtEnd);
-              logEntryCount++;
-              if (logEntryCount >= MAX_LOG_ENTRIES)
-                break;
-            }
-          }
-        }
-        entryStart = -1;
-      }
-    }
-  }
-
-  Serial.printf("[LOG] Loaded %d log entries\n", logEntryCount);
-}
-
-void saveLogbook() {
-  preferences.begin("growtower", false);
-
-  String logJson = "[";
-  for (int i = 0; i < logEntryCount; i++) {
-    if (i > 0)
-      logJson += ",";
-    logJson += "{\"ts\":" + String(logEntries[i].timestamp) + ",\"text\":\"" +
-               logEntries[i].text + "\"}";
-  }
-  logJson += "]";
-
-  preferences.putString("logbook", logJson);
-  preferences.end();
-
-  Serial.printf("[LOG] Saved %d log entries\n", logEntryCount);
-}
-
-void addLogEntry(String text) {
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    Serial.println("[LOG] Cannot add entry: NTP time not available");
-    return;
-  }
-
-  text.trim();
-  if (text.length() == 0)
-    return;
-  if (text.length() > MAX_LOG_TEXT_LENGTH) {
-    text = text.substring(0, MAX_LOG_TEXT_LENGTH);
-  }
-
-  text.replace("\"", "'");
-  text.replace("\\", "/");
-
-  for (int i = MAX_LOG_ENTRIES - 1; i > 0; i--) {
-    logEntries[i] = logEntries[i - 1];
-  }
-
-  logEntries[0].timestamp = mktime(&timeinfo);
-  logEntries[0].text = text;
-
-  if (logEntryCount < MAX_LOG_ENTRIES) {
-    logEntryCount++;
-  }
-
-  saveLogbook();
-  Serial.printf("[LOG] Added entry: %s\n", text.c_str());
-}
-
-void deleteLogEntry(int index) {
-  if (index < 0 || index >= logEntryCount)
-    return;
-
-  for (int i = index; i < logEntryCount - 1; i++) {
-    logEntries[i] = logEntries[i + 1];
-  }
-  logEntryCount--;
-
-  saveLogbook();
-  Serial.printf("[LOG] Deleted entry at index %d\n", index);
-}
-
-void clearLogbook() {
-  logEntryCount = 0;
-  preferences.begin("growtower", false);
-  preferences.remove("logbook");
-  preferences.end();
-  Serial.println("[LOG] Logbook cleared");
-}
-
-String getLogbookJSON() {
-  String json = "{\"entries\":[";
-  for (int i = 0; i < logEntryCount; i++) {
-    if (i > 0)
-      json += ",";
-
-    char timeStr[20];
-    struct tm *timeinfo = localtime(&logEntries[i].timestamp);
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M", timeinfo);
-
-    String escapedText = logEntries[i].text;
-    escapedText.replace("\\", "\\\\");
-    escapedText.replace("\"", "\\\"");
-    escapedText.replace("\n", "\\n");
-    escapedText.replace("\r", "\\r");
-    escapedText.replace("\t", "\\t");
-
-    json += "{\"index\":" + String(i) +
-            ",\"ts\":" + String(logEntries[i].timestamp) + ",\"time\":\"" +
-            String(timeStr) + "\",\"text\":\"" + escapedText + "\"}";
-  }
-  json += "],\"count\":" + String(logEntryCount) + "}";
-  return json;
-}
@@ -0,0 +1,287 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+
+#include "chunkwriter.h"
+#include "nvswear.h"
+#include "power.h"
+#include "routestats.h"
+#include "state.h"
+
+// Prometheus text exposition for /metrics, rendered through ChunkWriter so a
+// scrape needs no String. ChunkWriter re-runs the renderer for every chunk
+// and skips the items already sent, so the renderer reads only a snapshot
+// taken once when the request arrives: all chunks of a scrape show the same
+// moment. There is one static snapshot (about 2 KB), so a scrape needs no heap
+// besides the response; it is held until the scrape's connection closes, and
+// a second scrape arriving meanwhile gets 503 with Retry-After.
+
+struct MetricsRoute {
+  uint64_t totalUs;
+  uint64_t totalHeap;
+  const char *path;
+  WebRequestMethodComposite method;
+  uint32_t count;
+  uint32_t buckets[ROUTE_LATENCY_BUCKETS];
+};
+
+struct MetricsSnapshot {
+  uint64_t uptimeS;
+  uint32_t heapFree;
+  uint32_t heapMinFree;
+  uint32_t heapLargest;
+  bool wifiConnected;
+  int rssi;
+  float cpuBusy;
+  float powerMa;
+  bool lightOn;
+  uint64_t lightOnS;
+  uint32_t lightSwitches;
+  int fanSpeed;
+  int fanDuty;
+  uint32_t nvsCommits;
+  NvsWearStore wear;
+  uint32_t scrapes;
+  uint32_t lastRenderUs;
+  uint32_t lastBytes;
+  uint16_t lastChunks;
+  int routeCount;
+  MetricsRoute routes[MAX_ROUTES];
+};
+
+struct MetricsScrape {
+  uint16_t resume;
+  bool done;
+  uint32_t renderUs;
+  uint32_t bytes;
+  uint16_t chunks;
+};
+
+uint32_t metricsScrapeCount = 0;
+uint32_t metricsLastRenderUs = 0;
+uint32_t metricsLastBytes = 0;
+uint16_t metricsLastChunks = 0;
+
+// Runs in the AsyncTCP task, which is also the one updating routeStats.
+void metricsSnapshot(MetricsSnapshot &s) {
+  s.uptimeS = esp_timer_get_time() / 1000000;
+  s.heapFree = ESP.getFreeHeap();
+  s.heapMinFree = ESP.getMinFreeHeap();
+  s.heapLargest = ESP.getMaxAllocHeap();
+  s.wifiConnected = WiFi.status() == WL_CONNECTED;
+  s.rssi = s.wifiConnected ? (int)WiFi.RSSI() : 0;
+  s.cpuBusy = powerStats.busy;
+  s.powerMa = powerStats.last.totalMa;
+  s.lightOn = isLightOn;
+  s.lightOnS = getLightOnMillis() / 1000;
+  s.lightSwitches = lightSwitchCount;
+  s.fanSpeed = currentFanSpeed;
+  s.fanDuty = currentFanDuty;
+  s.nvsCommits = nvsCommitCount;
+  nvsWearSnapshot(s.wear);
+  s.scrapes = metricsScrapeCount;
+  s.lastRenderUs = metricsLastRenderUs;
+  s.lastBytes = metricsLastBytes;
+  s.lastChunks = metricsLastChunks;
+  s.routeCount = routeCount;
+  for (int i = 0; i < routeCount; i++) {
+    const RouteStats &r = routeStats[i];
+    MetricsRoute &m = s.routes[i];
+    m.path = r.path;
+    m.method = r.method;
+    m.count = r.count;
+    m.totalUs = r.totalUs;
+    m.totalHeap = r.totalHeap;
+    memcpy(m.buckets, r.buckets, sizeof(m.buckets));
+  }
+}
+
+void metricsHeader(ChunkWriter &w, const char *name, const char *type,
+                   const char *help) {
+  chunkPrintf(w, "# HELP %s %s\n", name, help);
+  chunkPrintf(w, "# TYPE %s %s\n", name, type);
+}
+
+void renderMetrics(ChunkWriter &w, const MetricsSnapshot &s) {
+  metricsHeader(w, "growtower_uptime_seconds", "gauge",
+                "Time since boot");
+  chunkPrintf(w, "growtower_uptime_seconds %llu\n",
+              (unsigned long long)s.uptimeS);
+
+  metricsHeader(w, "growtower_heap_free_bytes", "gauge", "Free heap");
+  chunkPrintf(w, "growtower_heap_free_bytes %lu\n",
+              (unsigned long)s.heapFree);
+  metricsHeader(w, "growtower_heap_min_free_bytes", "gauge",
+                "Lowest free heap since boot");
+  chunkPrintf(w, "growtower_heap_min_free_bytes %lu\n",
+              (unsigned long)s.heapMinFree);
+  metricsHeader(w, "growtower_heap_largest_free_block_bytes", "gauge",
+                "Largest allocatable heap block");
+  chunkPrintf(w, "growtower_heap_largest_free_block_bytes %lu\n",
+              (unsigned long)s.heapLargest);
+
+  metricsHeader(w, "growtower_wifi_rssi_dbm", "gauge", "WiFi signal strength");
+  if (s.wifiConnected) {
+    chunkPrintf(w, "growtower_wifi_rssi_dbm %d\n", s.rssi);
+  } else {
+    chunkPrintf(w, "growtower_wifi_rssi_dbm NaN\n");
+  }
+
+  metricsHeader(w, "growtower_cpu_busy_ratio", "gauge",
+                "Share of the last power sample the CPU was not idle");
+  chunkPrintf(w, "growtower_cpu_busy_ratio %.4f\n", s.cpuBusy);
+  metricsHeader(w, "growtower_power_estimated_milliamps", "gauge",
+                "Modelled controller supply current (power.h)");
+  chunkPrintf(w, "growtower_power_estimated_milliamps %.2f\n", s.powerMa);
+
+  metricsHeader(w, "growtower_light_on", "gauge", "Grow light state");
+  chunkPrintf(w, "growtower_light_on %d\n", s.lightOn ? 1 : 0);
+  metricsHeader(w, "growtower_light_on_seconds_total", "counter",
+                "Grow light on-time since boot");
+  chunkPrintf(w, "growtower_light_on_seconds_total %llu\n",
+              (unsigned long long)s.lightOnS);
+  metricsHeader(w, "growtower_light_switches_total", "counter",
+                "Grow light relay switches since boot");
+  chunkPrintf(w, "growtower_light_switches_total %lu\n",
+              (unsigned long)s.lightSwitches);
+
+  metricsHeader(w, "growtower_fan_speed_percent", "gauge",
+                "Requested fan speed");
+  chunkPrintf(w, "growtower_fan_speed_percent %d\n", s.fanSpeed);
+  metricsHeader(w, "growtower_fan_duty", "gauge", "Fan PWM duty (0-255)");
+  chunkPrintf(w, "growtower_fan_duty %d\n", s.fanDuty);
+
+  metricsHeader(w, "growtower_nvs_commits_total", "counter",
+                "NVS write transactions since boot");
+  chunkPrintf(w, "growtower_nvs_commits_total %lu\n",
+              (unsigned long)s.nvsCommits);
+  metricsHeader(w, "growtower_nvs_written_bytes_total", "counter",
+                "Estimated NVS flash bytes written per key");
+  for (int i = 0; i < NVS_WEAR_KEYS; i++) {
+    chunkPrintf(w, "growtower_nvs_written_bytes_total{key=\"%s\"} %lu\n",
+                nvsWearKeyNames[i], (unsigned long)s.wear.keyBytes[i]);
+  }
+  metricsHeader(w, "growtower_nvs_today_bytes", "gauge",
+                "Estimated NVS flash bytes written today");
+  chunkPrintf(w, "growtower_nvs_today_bytes %lu\n",
+              (unsigned long)s.wear.todayBytes);
+  metricsHeader(w, "growtower_nvs_lifetime_days", "gauge",
+                "Projected days until the NVS partition wears out");
+  chunkPrintf(w, "growtower_nvs_lifetime_days %lu\n",
+              (unsigned long)nvsWearLifetimeDays(s.wear));
+
+  metricsHeader(w, "growtower_http_requests_total", "counter",
+                "HTTP requests per route");
+  for (int i = 0; i < s.routeCount; i++) {
+    chunkPrintf(w,
+                "growtower_http_requests_total{route=\"%s\",method=\"%s\"} "
+                "%lu\n",
+                s.routes[i].path, routeMethodName(s.routes[i].method),
+                (unsigned long)s.routes[i].count);
+  }
+
+  metricsHeader(w, "growtower_http_request_duration_seconds", "histogram",
+                "Handler service time per route");
+  for (int i = 0; i < s.routeCount; i++) {
+    const MetricsRoute &r = s.routes[i];
+    uint32_t cumulative = 0;
+    for (int b = 0; b < ROUTE_LATENCY_BUCKETS - 1; b++) {
+      cumulative += r.buckets[b];
+      chunkPrintf(w,
+                  "growtower_http_request_duration_seconds_bucket{route=\"%s\","
+                  "le=\"%lu.%06lu\"} %lu\n",
+                  r.path, (unsigned long)(routeLatencyBoundsUs[b] / 1000000),
+                  (unsigned long)(routeLatencyBoundsUs[b] % 1000000),
+                  (unsigned long)cumulative);
+    }
+    chunkPrintf(w,
+                "growtower_http_request_duration_seconds_bucket{route=\"%s\","
+                "le=\"+Inf\"} %lu\n",
+                r.path, (unsigned long)r.count);
+    chunkPrintf(w,
+                "growtower_http_request_duration_seconds_sum{route=\"%s\"} "
+                "%llu.%06llu\n",
+                r.path, (unsigned long long)(r.totalUs / 1000000),
+                (unsigned long long)(r.totalUs % 1000000));
+    chunkPrintf(w,
+                "growtower_http_request_duration_seconds_count{route=\"%s\"} "
+                "%lu\n",
+                r.path, (unsigned long)r.count);
+  }
+
+  metricsHeader(w, "growtower_http_request_heap_bytes_total", "counter",
+                "Heap consumed by handlers per route");
+  for (int i = 0; i < s.routeCount; i++) {
+    chunkPrintf(w, "growtower_http_request_heap_bytes_total{route=\"%s\"} %llu\n",
+                s.routes[i].path, (unsigned long long)s.routes[i].totalHeap);
+  }
+
+  metricsHeader(w, "growtower_metrics_scrapes_total", "counter",
+                "Completed /metrics scrapes");
+  chunkPrintf(w, "growtower_metrics_scrapes_total %lu\n",
+              (unsigned long)s.scrapes);
+  metricsHeader(w, "growtower_metrics_render_seconds", "gauge",
+                "CPU time spent rendering the previous scrape");
+  chunkPrintf(w, "growtower_metrics_render_seconds %lu.%06lu\n",
+              (unsigned long)(s.lastRenderUs / 1000000),
+              (unsigned long)(s.lastRenderUs % 1000000));
+  metricsHeader(w, "growtower_metrics_bytes", "gauge",
+                "Size of the previous scrape");
+  chunkPrintf(w, "growtower_metrics_bytes %lu\n", (unsigned long)s.lastBytes);
+  metricsHeader(w, "growtower_metrics_chunks", "gauge",
+                "Chunks used by the previous scrape");
+  chunkPrintf(w, "growtower_metrics_chunks %u\n", s.lastChunks);
+}
+
+// Handlers and fillers all run on the AsyncTCP task, so a plain flag will do.
+MetricsSnapshot metricsSnap;
+bool metricsSnapInUse = false;
+
+void handleMetrics(AsyncWebServerRequest *request) {
+  if (metricsSnapInUse) {
+    AsyncWebServerResponse *response =
+        request->beginResponse(503, "text/plain", "scrape in progress\n");
+    response->addHeader("Retry-After", "1");
+    request->send(response);
+    return;
+  }
+  metricsSnapInUse = true;
+  request->onDisconnect([]() { metricsSnapInUse = false; });
+  metricsSnapshot(metricsSnap);
+  MetricsScrape scrape = {0, false, 0, 0, 0};
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "text/plain; version=0.0.4",
+      [scrape](uint8_t *buffer, size_t maxLen,
+               size_t index) mutable -> size_t {
+        if (scrape.done) {
+          metricsScrapeCount++;
+          metricsLastRenderUs = scrape.renderUs;
+          metricsLastBytes = scrape.bytes;
+          metricsLastChunks = scrape.chunks;
+          return 0;
+        }
+
+        unsigned long start = micros();
+        ChunkWriter w = {(char *)buffer, maxLen, 0, 0, scrape.resume, false};
+        renderMetrics(w, metricsSnap);
+        scrape.renderUs += micros() - start;
+
+        if (w.full) {
+          if (w.len == 0)
+            return RESPONSE_TRY_AGAIN;
+          scrape.resume = w.resume;
+        } else {
+          scrape.done = true;
+        }
+        scrape.bytes += w.len;
+        scrape.chunks++;
+        return w.len;
+      });
+  request->send(response);
+}
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef NVSWEAR_H
+#define NVSWEAR_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+
+#include "config.h"
+#include "logger.h"
+#include "state.h"
+
+// NVS wear accounting. The global `preferences` is a WearPreferences
+// (state.h), so every put in the firmware is booked to its key and to the
+// current local day as the flash NVS spends on it: one 32-byte entry for an
+// integer, a header entry plus one per 32 bytes of data for a string, one
+// more for a blob's index. Puts of an unchanged value are booked too, so the
+// figures are an upper bound.
+//
+// The counters are saved as one blob, but only inside a commit that happens
+// anyway, once NVS_WEAR_SAVE_BYTES have been booked since the last save and
+// at most every NVS_WEAR_SAVE_INTERVAL, so the accounting never opens a
+// write of its own and costs a few percent of what it counts. A power cut
+// loses the bookings since the last save, so the totals lean low by at most
+// about NVS_WEAR_SAVE_BYTES.
+//
+// Puts are booked by whichever task flushes (persist.h) while the control
+// task rolls the day over and HTTP handlers read the figures, so the
+// counters are only touched under nvsWearMux.
+//
+// Writers that can lose a save without harm (time cache, periodic usage
+// save, fan speed, which scripts may drive continuously) ask nvsWearAllow()
+// first and are skipped once today's bytes pass NVS_DAILY_BUDGET, until the
+// next local day. Other settings and phase data are always written; the
+// logbook lives on LittleFS (persist.h).
+
+#define NVS_WEAR_VERSION 1
+#define NVS_WEAR_DAYS 7
+#define NVS_ENTRY_SIZE 32
+#define NVS_PAGE_SIZE 4096
+#define NVS_PAGE_ENTRIES 126
+
+// Keys booked individually; anything else counts as "other". The blob
+// layout depends on this list, so changing it discards saved counters.
+const char *const nvsWearKeyNames[] = {
+    "other",    "fanSpeed",  "fanMin",       "fanMax",
+    "onHour",   "duration",  "timerEnabled", "tzMode",
+    "hostname", "ssid",      "pass",         "phases0",
+    "phases1",  "lastEpoch", "timeDrift",    "usage",
+    "wear"};
+const int NVS_WEAR_KEYS = sizeof(nvsWearKeyNames) / sizeof(nvsWearKeyNames[0]);
+
+struct NvsWearStore {
+  uint8_t version;
+  uint8_t keyCount;
+  uint8_t reserved[2];
+  int32_t day;         // local day number of the today* counters, 0 if unknown
+  uint64_t bytes;      // flash bytes written since accounting started
+  uint32_t commits;
+  uint32_t throttled;  // bookkeeping writes skipped over budget
+  uint32_t daysTracked; // completed days in dayBytes, up to NVS_WEAR_DAYS
+  uint32_t todayBytes;
+  uint32_t todayCommits;
+  uint32_t dayBytes[NVS_WEAR_DAYS]; // [0] = yesterday
+  uint32_t keyPuts[NVS_WEAR_KEYS];
+  uint32_t keyBytes[NVS_WEAR_KEYS];
+};
+
+NvsWearStore nvsWear;
+unsigned long lastNvsWearSave = 0;
+uint32_t nvsWearUnsaved = 0; // bytes booked since the last save
+bool nvsWearThrottleLogged = false;
+portMUX_TYPE nvsWearMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int nvsWearKeyIndex(const char *key) {
+  for (int i = 1; i < NVS_WEAR_KEYS; i++) {
+    if (strcmp(key, nvsWearKeyNames[i]) == 0)
+      return i;
+  }
+  return 0;
+}
+
+// Flash bytes NVS uses for a value; `len` is the data length of a string or
+// blob, 0 for an integer.
+static uint32_t nvsEntryBytes(size_t len, bool blob) {
+  uint32_t entries = 1 + (len + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+  if (blob)
+    entries++;
+  return entries * NVS_ENTRY_SIZE;
+}
+
+void nvsWearBook(const char *key, size_t len, bool blob) {
+  uint32_t bytes = nvsEntryBytes(len, blob);
+  int i = nvsWearKeyIndex(key);
+  portENTER_CRITICAL(&nvsWearMux);
+  nvsWear.keyPuts[i]++;
+  nvsWear.keyBytes[i] += bytes;
+  nvsWear.bytes += bytes;
+  nvsWear.todayBytes += bytes;
+  nvsWearUnsaved += bytes;
+  portEXIT_CRITICAL(&nvsWearMux);
+}
+
+// Consistent copy of the counters, for readers in other tasks.
+void nvsWearSnapshot(NvsWearStore &out) {
+  portENTER_CRITICAL(&nvsWearMux);
+  out = nvsWear;
+  portEXIT_CRITICAL(&nvsWearMux);
+}
+
+void loadNvsWear() {
+  memset(&nvsWear, 0, sizeof(nvsWear));
+  preferences.begin("growtower", true);
+  if (preferences.getBytesLength("wear") == sizeof(nvsWear)) {
+    preferences.getBytes("wear", &nvsWear, sizeof(nvsWear));
+  }
+  preferences.end();
+  if (nvsWear.version != NVS_WEAR_VERSION ||
+      nvsWear.keyCount != NVS_WEAR_KEYS) {
+    memset(&nvsWear, 0, sizeof(nvsWear));
+    nvsWear.version = NVS_WEAR_VERSION;
+    nvsWear.keyCount = NVS_WEAR_KEYS;
+  }
+  lastNvsWearSave = millis();
+}
+
+// Called by commitPreferences() while the read-write session of `prefs` is
+// still open.
+void nvsWearCommit(WearPreferences &prefs) {
+  portENTER_CRITICAL(&nvsWearMux);
+  nvsWear.commits++;
+  nvsWear.todayCommits++;
+  bool save = nvsWearUnsaved >= NVS_WEAR_SAVE_BYTES &&
+              millis() - lastNvsWearSave >= NVS_WEAR_SAVE_INTERVAL;
+  portEXIT_CRITICAL(&nvsWearMux);
+  if (!save)
+    return;
+
+  NvsWearStore copy;
+  nvsWearSnapshot(copy);
+  lastNvsWearSave = millis();
+  prefs.putBytes("wear", &copy, sizeof(copy));
+  portENTER_CRITICAL(&nvsWearMux);
+  nvsWearUnsaved = 0;
+  portEXIT_CRITICAL(&nvsWearMux);
+}
+
+// Moves today into the per-day history when the local day changes.
+void nvsWearCheckDay(int32_t day) {
+  portENTER_CRITICAL(&nvsWearMux);
+  if (day == nvsWear.day) {
+    portEXIT_CRITICAL(&nvsWearMux);
+    return;
+  }
+  if (nvsWear.day != 0 && day > nvsWear.day) {
+    int32_t shift = day - nvsWear.day;
+    for (int i = NVS_WEAR_DAYS - 1; i >= 0; i--) {
+      int32_t from = i - shift;
+      nvsWear.dayBytes[i] = from >= 0 ? nvsWear.dayBytes[from] : 0;
+    }
+    if (shift <= NVS_WEAR_DAYS)
+      nvsWear.dayBytes[shift - 1] = nvsWear.todayBytes;
+    nvsWear.daysTracked += shift;
+    if (nvsWear.daysTracked > NVS_WEAR_DAYS)
+      nvsWear.daysTracked = NVS_WEAR_DAYS;
+  }
+  nvsWear.day = day;
+  nvsWear.todayBytes = 0;
+  nvsWear.todayCommits = 0;
+  nvsWearThrottleLogged = false;
+  portEXIT_CRITICAL(&nvsWearMux);
+}
+
+// For writers that can skip a save. False once today's writes are over
+// NVS_DAILY_BUDGET.
+bool nvsWearAllow(const char *what) {
+  portENTER_CRITICAL(&nvsWearMux);
+  bool allow = nvsWear.todayBytes < NVS_DAILY_BUDGET;
+  bool log = false;
+  if (!allow) {
+    nvsWear.throttled++;
+    log = !nvsWearThrottleLogged;
+    nvsWearThrottleLogged = true;
+  }
+  portEXIT_CRITICAL(&nvsWearMux);
+  if (allow)
+    return true;
+  if (log) {
+    LOGW("NVS", "Daily write budget (%lu bytes) used up, skipping %s saves",
+         (unsigned long)NVS_DAILY_BUDGET, what);
+  }
+  return false;
+}
+
+// Average over the completed days kept, today so far if there are none.
+uint32_t nvsWearBytesPerDay(const NvsWearStore &w) {
+  if (w.daysTracked == 0)
+    return w.todayBytes;
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < w.daysTracked; i++)
+    sum += w.dayBytes[i];
+  return sum / w.daysTracked;
+}
+
+// NVS writes entries round-robin over all pages, so each page is erased
+// once per this many bytes written.
+static uint64_t nvsWearBytesPerCycle() {
+  return (uint64_t)(NVS_PARTITION_SIZE / NVS_PAGE_SIZE) * NVS_PAGE_ENTRIES *
+         NVS_ENTRY_SIZE;
+}
+
+// Days until the partition reaches NVS_FLASH_ENDURANCE erase cycles at the
+// current rate; 0 if nothing is being written.
+uint32_t nvsWearLifetimeDays(const NvsWearStore &w) {
+  uint32_t perDay = nvsWearBytesPerDay(w);
+  if (perDay == 0)
+    return 0;
+  uint64_t total = nvsWearBytesPerCycle() * NVS_FLASH_ENDURANCE;
+  uint64_t left = total > w.bytes ? total - w.bytes : 0;
+  uint64_t days = left / perDay;
+  return days > UINT32_MAX ? UINT32_MAX : (uint32_t)days;
+}
+
+String getNvsWearJSON() {
+  NvsWearStore w;
+  nvsWearSnapshot(w);
+  String json = "{";
+  json += "\"bytes\":" + String((unsigned long)w.bytes) + ",";
+  json += "\"commits\":" + String(w.commits) + ",";
+  json += "\"today\":{\"bytes\":" + String(w.todayBytes) +
+          ",\"commits\":" + String(w.todayCommits) + "},";
+  json += "\"days\":[";
+  for (uint32_t i = 0; i < w.daysTracked; i++) {
+    if (i > 0)
+      json += ",";
+    json += String(w.dayBytes[i]);
+  }
+  json += "],";
+  json += "\"bytesPerDay\":" + String(nvsWearBytesPerDay(w)) + ",";
+  json += "\"budget\":" + String((unsigned long)NVS_DAILY_BUDGET) + ",";
+  json += "\"overBudget\":" +
+          String(w.todayBytes >= NVS_DAILY_BUDGET ? "true" : "false") + ",";
+  json += "\"throttled\":" + String(w.throttled) + ",";
+  json += "\"eraseCycles\":" +
+          String((float)w.bytes / nvsWearBytesPerCycle(), 3) + ",";
+  json += "\"endurance\":" + String((unsigned long)NVS_FLASH_ENDURANCE) + ",";
+  json += "\"lifetimeDays\":" + String(nvsWearLifetimeDays(w)) + ",";
+  json += "\"keys\":[";
+  bool first = true;
+  for (int i = 0; i < NVS_WEAR_KEYS; i++) {
+    if (w.keyPuts[i] == 0)
+      continue;
+    if (!first)
+      json += ",";
+    first = false;
+    json += "{\"key\":\"" + String(nvsWearKeyNames[i]) + "\"";
+    json += ",\"puts\":" + String(w.keyPuts[i]);
+    json += ",\"bytes\":" + String(w.keyBytes[i]) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+#endif
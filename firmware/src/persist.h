@@ -0,0 +1,496 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "config.h"
+#include "logger.h"
+#include "nvswear.h"
+#include "state.h"
+
+// Deferred persistence. Setters change RAM and call persistMark(); the
+// persistence task (tasks.h), woken through persistQueue by the first mark,
+// hands everything marked to savePending() (control.h) once PERSIST_DELAY
+// has passed since the first unsaved change, so a slider drag or a burst of
+// commands costs one flash write. persistFlush() writes at
+// once. It runs before every intentional restart and, with POWER_FAIL_PIN
+// wired to a supply-sense divider, from a high-priority task woken by the
+// pin's falling edge while the bulk capacitor still holds the rail up.
+//
+// The ESP32-C3 brownout detector resets the chip from its own interrupt and
+// offers no hook, so it cannot start a flush; setup() only reports brownout
+// resets. Without POWER_FAIL_PIN a power cut loses at most PERSIST_DELAY of
+// changes.
+//
+// phases[] and the logbook are records written to two slots in turn, each
+// with a header holding a sequence number and a CRC32 of the body. A write
+// only ever replaces the older slot, so one torn by a power cut leaves the
+// previous record intact, and loading takes the newest slot whose CRC checks
+// out. Phase data uses NVS blobs; the logbook uses LittleFS files, as two
+// copies of a full logbook would not fit the 20 KB NVS partition.
+
+#define PERSIST_MAGIC 0x31505447 // "GTP1"
+#define PERSIST_NVS_RECORD_MAX 64
+
+// Record bodies are read in pieces straight into their RAM state. A write
+// copies the body once into a buffer (persistStore()).
+class PersistOut {
+public:
+  virtual void write(const void *data, size_t len) = 0;
+};
+
+class PersistIn {
+public:
+  virtual bool read(void *data, size_t len) = 0;
+};
+
+struct PersistRecord {
+  const char *slots[2]; // NVS keys, or LittleFS paths with inFile
+  bool inFile;
+  void (*save)(PersistOut &out);
+  bool (*load)(PersistIn &in, size_t length);
+  uint32_t seq;   // sequence number of the newest valid slot, 0 if none
+  uint8_t newest; // that slot
+};
+
+struct PersistHeader {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t length; // body bytes after the header
+  uint32_t crc;    // CRC32 of the body, then seq and length
+};
+
+struct PersistStats {
+  uint32_t flushes;
+  uint32_t powerFails;
+  uint32_t failures;  // records or settings that could not be written
+  uint32_t badSlots;  // torn or corrupt slots skipped while loading
+  uint32_t lastFlushMs;
+  uint32_t maxFlushMs;
+};
+
+// Used only by savePending() and resetAllSettings(), under persistMutex.
+// savePending() runs in whichever task calls persistFlush(): the
+// persistence task, the power-fail task, or the network task before an OTA
+// restart.
+WearPreferences persistPrefs;
+PersistStats persistStats;
+volatile uint16_t persistPending = 0;
+unsigned long persistSince = 0; // millis() of the oldest pending change
+uint16_t persistLegacy = 0;     // items still in the pre-record NVS keys
+QueueHandle_t persistQueue = NULL; // created by startTasks() (tasks.h)
+portMUX_TYPE persistMux = portMUX_INITIALIZER_UNLOCKED;
+SemaphoreHandle_t persistMutex = NULL;
+// Held by the control task while it changes what a record or a pending
+// string setting holds, and by persistStore()/savePending() while copying
+// it out. Taken after persistMutex, never the other way round.
+SemaphoreHandle_t persistStateMutex = NULL;
+
+// No-op before initPersist(), while setup() is the only task.
+class PersistStateLock {
+public:
+  PersistStateLock() {
+    if (persistStateMutex != NULL)
+      xSemaphoreTake(persistStateMutex, portMAX_DELAY);
+  }
+  ~PersistStateLock() {
+    if (persistStateMutex != NULL)
+      xSemaphoreGive(persistStateMutex);
+  }
+};
+
+// CRC-32 (IEEE 802.3), four bits at a time. Chains: pass the previous
+// result as `crc`, starting from 0.
+uint32_t persistCrc(uint32_t crc, const void *data, size_t len) {
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+class PersistCrcOut : public PersistOut {
+public:
+  PersistCrcOut() : crc(0), length(0) {}
+  void write(const void *data, size_t len) {
+    crc = persistCrc(crc, data, len);
+    length += len;
+  }
+  uint32_t crc;
+  size_t length;
+};
+
+class PersistBufferOut : public PersistOut {
+public:
+  PersistBufferOut(uint8_t *buf, size_t cap)
+      : buf(buf), cap(cap), length(0), ok(true) {}
+  void write(const void *data, size_t len) {
+    if (len > cap - length) {
+      ok = false;
+      return;
+    }
+    memcpy(buf + length, data, len);
+    length += len;
+  }
+  uint8_t *buf;
+  size_t cap;
+  size_t length;
+  bool ok;
+};
+
+class PersistBufferIn : public PersistIn {
+public:
+  PersistBufferIn(const uint8_t *buf, size_t len) : buf(buf), left(len) {}
+  bool read(void *data, size_t len) {
+    if (len > left)
+      return false;
+    memcpy(data, buf, len);
+    buf += len;
+    left -= len;
+    return true;
+  }
+  const uint8_t *buf;
+  size_t left;
+};
+
+class PersistFileIn : public PersistIn {
+public:
+  explicit PersistFileIn(File &file) : file(file) {}
+  bool read(void *data, size_t len) {
+    return file.read((uint8_t *)data, len) == len;
+  }
+  File &file;
+};
+
+static uint32_t persistHeaderCrc(uint32_t bodyCrc, const PersistHeader &h) {
+  bodyCrc = persistCrc(bodyCrc, &h.seq, sizeof(h.seq));
+  return persistCrc(bodyCrc, &h.length, sizeof(h.length));
+}
+
+// Reads slot `i` of an NVS record, header and body. Needs a persistPrefs
+// session.
+static bool persistReadBlob(const PersistRecord &r, int i, uint8_t *buf,
+                            PersistHeader &h) {
+  size_t n = persistPrefs.getBytes(r.slots[i], buf, PERSIST_NVS_RECORD_MAX);
+  if (n < sizeof(h))
+    return false;
+  memcpy(&h, buf, sizeof(h));
+  return h.magic == PERSIST_MAGIC && n == sizeof(h) + h.length;
+}
+
+// 1 with a valid header in `h`, 0 for a slot holding something unreadable,
+// -1 for an empty slot.
+static int persistReadHeader(const PersistRecord &r, int i, PersistHeader &h) {
+  if (!r.inFile) {
+    uint8_t buf[PERSIST_NVS_RECORD_MAX];
+    if (!persistPrefs.isKey(r.slots[i]))
+      return -1;
+    return persistReadBlob(r, i, buf, h) ? 1 : 0;
+  }
+  if (!LittleFS.exists(r.slots[i]))
+    return -1;
+  File file = LittleFS.open(r.slots[i], "r");
+  bool ok = file && file.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+            h.magic == PERSIST_MAGIC && file.size() == sizeof(h) + h.length;
+  file.close();
+  return ok ? 1 : 0;
+}
+
+// Checks the body of slot `i` against its CRC and hands it to r.load().
+static bool persistLoadSlot(PersistRecord &r, int i, const PersistHeader &h) {
+  if (!r.inFile) {
+    uint8_t buf[PERSIST_NVS_RECORD_MAX];
+    PersistHeader check;
+    if (!persistReadBlob(r, i, buf, check))
+      return false;
+    const uint8_t *body = buf + sizeof(check);
+    if (persistHeaderCrc(persistCrc(0, body, check.length), check) != check.crc)
+      return false;
+    PersistBufferIn in(body, check.length);
+    return r.load(in, check.length);
+  }
+
+  File file = LittleFS.open(r.slots[i], "r");
+  if (!file)
+    return false;
+  // First pass: CRC only, so a bad slot never reaches r.load().
+  uint8_t chunk[64];
+  uint32_t crc = 0;
+  size_t left = h.length;
+  file.seek(sizeof(h));
+  while (left > 0) {
+    size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+    if (file.read(chunk, n) != n)
+      break;
+    crc = persistCrc(crc, chunk, n);
+    left -= n;
+  }
+  bool ok = left == 0 && persistHeaderCrc(crc, h) == h.crc;
+  if (ok) {
+    file.seek(sizeof(h));
+    PersistFileIn in(file);
+    ok = r.load(in, h.length);
+  }
+  file.close();
+  return ok;
+}
+
+// Loads the newest valid slot of `r`. False if neither slot holds one; RAM
+// is then left to the caller's defaults. NVS records need a persistPrefs
+// session.
+bool persistLoad(PersistRecord &r) {
+  PersistHeader headers[2];
+  int state[2];
+  for (int i = 0; i < 2; i++) {
+    state[i] = persistReadHeader(r, i, headers[i]);
+    if (state[i] == 0) {
+      persistStats.badSlots++;
+      LOGW("PERSIST", "%s: unreadable, ignored", r.slots[i]);
+    }
+  }
+
+  r.seq = 0;
+  r.newest = 1; // so the first write goes to slot 0
+  int first = state[1] == 1 && (state[0] != 1 || headers[1].seq > headers[0].seq)
+                  ? 1
+                  : 0;
+  for (int k = 0; k < 2; k++) {
+    int i = first ^ k;
+    if (state[i] != 1)
+      continue;
+    if (!persistLoadSlot(r, i, headers[i])) {
+      persistStats.badSlots++;
+      LOGW("PERSIST", "%s: CRC mismatch, torn write skipped", r.slots[i]);
+      continue;
+    }
+    r.seq = headers[i].seq;
+    r.newest = i;
+    return true;
+  }
+  return false;
+}
+
+// Writes `r` into its older slot. The body is serialised once, under the
+// state lock, into a buffer that the CRC and the write then both use, so a
+// change made by the control task meanwhile cannot leave a slot whose body
+// does not match its CRC. NVS records are written in the caller's
+// persistPrefs session, so they commit with it.
+bool persistStore(PersistRecord &r) {
+  uint8_t nvsBuf[PERSIST_NVS_RECORD_MAX];
+  uint8_t *buf = nvsBuf; // header, then body
+  size_t length = 0;
+  bool ok = false;
+  {
+    PersistStateLock lock;
+    PersistCrcOut measure;
+    r.save(measure);
+    length = measure.length;
+    size_t cap = r.inFile ? sizeof(PersistHeader) + length : sizeof(nvsBuf);
+    if (r.inFile)
+      buf = (uint8_t *)malloc(cap);
+    if (buf != NULL && sizeof(PersistHeader) + length <= cap) {
+      PersistBufferOut out(buf + sizeof(PersistHeader), length);
+      r.save(out);
+      ok = out.ok;
+    }
+  }
+
+  int target = r.newest ^ 1;
+  if (ok) {
+    PersistHeader h = {PERSIST_MAGIC, r.seq + 1, (uint32_t)length, 0};
+    h.crc = persistHeaderCrc(persistCrc(0, buf + sizeof(h), length), h);
+    memcpy(buf, &h, sizeof(h));
+    size_t total = sizeof(h) + length;
+    if (r.inFile) {
+      File file = LittleFS.open(r.slots[target], "w");
+      ok = file && file.write(buf, total) == total;
+      file.close();
+    } else {
+      ok = persistPrefs.putBytes(r.slots[target], buf, total) == total;
+    }
+  }
+  if (r.inFile)
+    free(buf);
+
+  if (!ok) {
+    persistStats.failures++;
+    LOGE("PERSIST", "Writing %s failed", r.slots[target]);
+    return false;
+  }
+  r.seq++;
+  r.newest = target;
+  return true;
+}
+
+// Deletes both slots, for a factory reset. NVS records go with the
+// namespace instead.
+void persistRemove(PersistRecord &r) {
+  if (r.inFile) {
+    for (int i = 0; i < 2; i++) {
+      if (LittleFS.exists(r.slots[i]))
+        LittleFS.remove(r.slots[i]);
+    }
+  }
+  r.seq = 0;
+  r.newest = 1;
+}
+
+// Schedules `what` (PersistItem / ConfigField bits) for the next flush.
+void persistMark(uint16_t what) {
+  unsigned long now = millis();
+  portENTER_CRITICAL(&persistMux);
+  bool first = persistPending == 0;
+  if (first)
+    persistSince = now;
+  persistPending |= what;
+  portEXIT_CRITICAL(&persistMux);
+  if (first && persistQueue != NULL)
+    xQueueSend(persistQueue, &what, 0);
+}
+
+// Wakes the persistence task for work handed over outside persistPending
+// (the sealed telemetry block, a restart request).
+void persistWake() {
+  uint16_t none = 0;
+  if (persistQueue != NULL)
+    xQueueSend(persistQueue, &none, 0);
+}
+
+// Drops pending changes, for a factory reset. Waits for a flush in
+// progress and keeps the flush lock, so nothing written from here to the
+// restart can bring the cleared settings back.
+void persistDiscard() {
+  if (persistMutex != NULL)
+    xSemaphoreTake(persistMutex, portMAX_DELAY);
+  portENTER_CRITICAL(&persistMux);
+  persistPending = 0;
+  portEXIT_CRITICAL(&persistMux);
+  persistLegacy = 0;
+}
+
+// Writes everything pending now. Safe from any task; a second caller waits
+// for the flush in progress.
+void persistFlush() {
+  if (persistMutex != NULL)
+    xSemaphoreTake(persistMutex, portMAX_DELAY);
+  portENTER_CRITICAL(&persistMux);
+  uint16_t what = persistPending;
+  persistPending = 0;
+  portEXIT_CRITICAL(&persistMux);
+
+  if (what != 0) {
+    unsigned long start = millis();
+    savePending(what);
+    uint32_t took = millis() - start;
+    persistStats.flushes++;
+    persistStats.lastFlushMs = took;
+    if (took > persistStats.maxFlushMs)
+      persistStats.maxFlushMs = took;
+  }
+  if (persistMutex != NULL)
+    xSemaphoreGive(persistMutex);
+}
+
+void persistTick() {
+  if (persistPending != 0 && millis() - persistSince >= PERSIST_DELAY)
+    persistFlush();
+}
+
+enum PersistRestart {
+  PERSIST_RESTART_NONE,
+  PERSIST_RESTART_FLUSH, // write everything pending, then restart
+  PERSIST_RESTART_RESET  // factory reset (resetAllSettings()), then restart
+};
+
+volatile uint8_t persistRestart = PERSIST_RESTART_NONE;
+
+void persistRestartTick() {
+  if (persistRestart == PERSIST_RESTART_RESET) {
+    resetAllSettings();
+  } else if (persistRestart == PERSIST_RESTART_FLUSH) {
+    persistFlush();
+    Serial.println("[SYS] Restarting...");
+    delay(1000);
+    ESP.restart();
+  }
+}
+
+// Restarts from the persistence task, so the control task and HTTP
+// handlers neither write flash nor sit out the restart delay. Before
+// startTasks() it runs in the caller.
+void persistRequestRestart(PersistRestart kind) {
+  persistRestart = kind;
+  if (persistQueue != NULL)
+    persistWake();
+  else
+    persistRestartTick();
+}
+
+#ifdef POWER_FAIL_PIN
+TaskHandle_t powerFailTask = NULL;
+
+void IRAM_ATTR onPowerFail() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(powerFailTask, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void powerFailTaskMain(void *arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    persistStats.powerFails++;
+    persistFlush();
+    LOGW("PERSIST", "Supply dropping, pending changes flushed");
+  }
+}
+#endif
+
+// Creates the flush and state locks and, with POWER_FAIL_PIN, the
+// power-fail task and its interrupt. Flushes before this run unlocked, which
+// is fine while setup() is the only task writing.
+void initPersist() {
+  persistMutex = xSemaphoreCreateMutex();
+  persistStateMutex = xSemaphoreCreateMutex();
+#ifdef POWER_FAIL_PIN
+  xTaskCreate(powerFailTaskMain, "powerfail", 4096, NULL,
+              configMAX_PRIORITIES - 1, &powerFailTask);
+  pinMode(POWER_FAIL_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(POWER_FAIL_PIN), onPowerFail, FALLING);
+  LOGI("PERSIST", "Power-fail flush armed on pin %d", (int)POWER_FAIL_PIN);
+#endif
+}
+
+String getPersistJSON() {
+  String json = "{";
+  json += "\"pending\":" + String((unsigned)persistPending) + ",";
+  json += "\"pendingMs\":" +
+          String(persistPending != 0 ? millis() - persistSince : 0UL) + ",";
+  json += "\"delayMs\":" + String(PERSIST_DELAY) + ",";
+  json += "\"flushes\":" + String(persistStats.flushes) + ",";
+  json += "\"lastFlushMs\":" + String(persistStats.lastFlushMs) + ",";
+  json += "\"maxFlushMs\":" + String(persistStats.maxFlushMs) + ",";
+  json += "\"failures\":" + String(persistStats.failures) + ",";
+  json += "\"badSlots\":" + String(persistStats.badSlots) + ",";
+#ifdef POWER_FAIL_PIN
+  json += "\"powerFailPin\":" + String((int)POWER_FAIL_PIN) + ",";
+#else
+  json += "\"powerFailPin\":null,";
+#endif
+  json += "\"powerFails\":" + String(persistStats.powerFails) + "}";
+  return json;
+}
+
+#endif
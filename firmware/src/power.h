@@ -0,0 +1,268 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "config.h"
+#include "logger.h"
+#include "routestats.h"
+
+#ifdef POWER_SAVE
+#include <driver/ledc.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#endif
+
+// Power management and an estimate of the average supply current.
+//
+// Power-save builds (env:main_lowpower, -DPOWER_SAVE) let the power
+// management driver scale the CPU clock between POWER_CPU_MIN_MHZ and
+// POWER_CPU_MAX_MHZ and enter light sleep whenever every task is blocked,
+// keep the radio asleep between DTIM beacons (WIFI_PS_MAX_MODEM) and run the
+// control and network tasks every second instead of every 100 ms. The fan
+// PWM timer is moved to the internal 8 MHz RC oscillator, which stays
+// powered in light sleep, so the fan keeps its duty and the frequency does
+// not follow the CPU clock. Incoming packets wake the chip at the next
+// beacon; the control task wakes it for the timer.
+//
+// There is no current sensor, so the draw is modelled: measured residency
+// (share of time the CPU was not idle), the clock and sleep modes in use,
+// the radio power-save mode and the HTTP request rate, combined with the
+// typical ESP32-C3 currents in config.h (POWER_MA_*). Residency comes from
+// the FreeRTOS idle task when run-time stats are compiled in; otherwise only
+// the cycles of the firmware's own tasks are timed, which makes the estimate
+// a lower bound. The relay, fan and grow light are supplied separately and
+// not included.
+
+enum PowerRadioMode {
+  POWER_RADIO_ON,   // softAP or power save off: receiver always on
+  POWER_RADIO_DTIM, // WIFI_PS_MIN_MODEM: wakes for every DTIM beacon
+  POWER_RADIO_MAX,  // WIFI_PS_MAX_MODEM: wakes every listen interval
+  POWER_RADIO_OFF,
+};
+
+struct PowerMode {
+  bool dfs;        // CPU clock scaled by the power management driver
+  bool lightSleep; // idle time spent in automatic light sleep
+  uint8_t radio;   // PowerRadioMode
+};
+
+struct PowerEstimate {
+  float cpuMa;
+  float radioMa;
+  float totalMa;
+};
+
+struct PowerStats {
+  uint32_t samples;
+  float busy;         // share of the last interval the CPU was not idle
+  float requestsPerS; // HTTP requests over the last interval
+  PowerEstimate last;
+  double chargeMas;   // estimated charge since boot, mA * s
+  uint32_t accountedMs;
+};
+
+PowerMode powerMode = {false, false, POWER_RADIO_OFF};
+PowerStats powerStats;
+uint64_t powerBusyUs = 0;
+unsigned long powerSampleAt = 0;
+portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+uint32_t powerRequestsAt = 0;
+#if configGENERATE_RUN_TIME_STATS
+uint32_t powerIdleAt = 0;
+uint32_t powerRunTimeAt = 0;
+#endif
+
+static const char *powerRadioName(uint8_t radio) {
+  switch (radio) {
+  case POWER_RADIO_ON:
+    return "on";
+  case POWER_RADIO_DTIM:
+    return "dtim";
+  case POWER_RADIO_MAX:
+    return "max";
+  default:
+    return "off";
+  }
+}
+
+// Average current of `mode` with the CPU busy for `busy` of the time and
+// `requestsPerS` HTTP requests per second.
+PowerEstimate powerEstimate(const PowerMode &mode, float busy,
+                            float requestsPerS) {
+  float radioDuty;
+  switch (mode.radio) {
+  case POWER_RADIO_ON:
+    radioDuty = 1.0f;
+    break;
+  case POWER_RADIO_DTIM:
+    radioDuty = POWER_RADIO_WAKE_MS / POWER_BEACON_MS;
+    break;
+  case POWER_RADIO_MAX:
+    radioDuty = POWER_RADIO_WAKE_MS / (POWER_BEACON_MS * POWER_LISTEN_INTERVAL);
+    break;
+  default:
+    radioDuty = 0.0f;
+  }
+  if (mode.radio != POWER_RADIO_OFF)
+    radioDuty += requestsPerS * POWER_RADIO_MS_PER_REQUEST / 1000.0f;
+  if (radioDuty > 1.0f)
+    radioDuty = 1.0f;
+  if (busy > 1.0f)
+    busy = 1.0f;
+
+  // While the radio is awake the CPU cannot sleep, only idle.
+  float idle = 1.0f - busy;
+  float awake = idle;
+  if (mode.lightSleep)
+    awake = radioDuty < idle ? radioDuty : idle;
+  float idleMa = mode.dfs ? POWER_MA_IDLE_MIN : POWER_MA_IDLE_MAX;
+
+  PowerEstimate e;
+  e.cpuMa = busy * POWER_MA_RUN + awake * idleMa +
+            (idle - awake) * POWER_MA_LIGHT_SLEEP;
+  e.radioMa = radioDuty * POWER_MA_RADIO;
+  e.totalMa = e.cpuMa + e.radioMa;
+  return e;
+}
+
+static uint32_t powerRequestCount() {
+  uint32_t n = 0;
+  for (int i = 0; i < routeCount; i++)
+    n += routeStats[i].count;
+  return n;
+}
+
+void powerSetRadio(PowerRadioMode radio) { powerMode.radio = radio; }
+
+static void powerSample(uint32_t intervalMs, uint64_t busyUs) {
+  uint32_t requests = powerRequestCount();
+  // Route stats can be reset from /api/routes.
+  uint32_t newRequests = requests >= powerRequestsAt ? requests - powerRequestsAt
+                                                     : requests;
+  float busy;
+#if configGENERATE_RUN_TIME_STATS
+  uint32_t idle = ulTaskGetIdleRunTimeCounter();
+  uint32_t total = portGET_RUN_TIME_COUNTER_VALUE();
+  uint32_t totalDelta = total - powerRunTimeAt;
+  busy = totalDelta ? 1.0f - (float)(idle - powerIdleAt) / totalDelta : 0.0f;
+  if (busy < 0.0f)
+    busy = 0.0f;
+  powerIdleAt = idle;
+  powerRunTimeAt = total;
+#else
+  busy = (float)busyUs / (intervalMs * 1000.0f);
+#endif
+  powerStats.busy = busy > 1.0f ? 1.0f : busy;
+  powerStats.requestsPerS = newRequests * 1000.0f / intervalMs;
+  powerStats.last = powerEstimate(powerMode, powerStats.busy,
+                                  powerStats.requestsPerS);
+  powerStats.chargeMas += powerStats.last.totalMa * intervalMs / 1000.0;
+  powerStats.accountedMs += intervalMs;
+  powerStats.samples++;
+
+  powerRequestsAt = requests;
+}
+
+// Called by each task (tasks.h) once per cycle with the time it worked.
+void powerTick(uint32_t busyUs) {
+  unsigned long now = millis();
+  uint32_t intervalMs = 0;
+  uint64_t busy = 0;
+  portENTER_CRITICAL(&powerMux);
+  powerBusyUs += busyUs;
+  if (now - powerSampleAt >= POWER_SAMPLE_INTERVAL) {
+    intervalMs = now - powerSampleAt;
+    busy = powerBusyUs;
+    powerBusyUs = 0;
+    powerSampleAt = now;
+  }
+  portEXIT_CRITICAL(&powerMux);
+  if (intervalMs != 0)
+    powerSample(intervalMs, busy);
+}
+
+// Since boot, over the sampled intervals.
+float powerAverageMa() {
+  if (powerStats.accountedMs == 0)
+    return 0.0f;
+  return powerStats.chargeMas * 1000.0 / powerStats.accountedMs;
+}
+
+#ifdef POWER_SAVE
+// Runs the fan PWM timer from the 8 MHz RC oscillator and keeps that
+// oscillator on in light sleep. ledcSetup() picks the APB clock, which
+// scales with the CPU and stops in light sleep.
+static bool powerMoveFanClock() {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)PWM_RESOLUTION;
+  timer.timer_num = (ledc_timer_t)((PWM_CHANNEL / 2) % 4);
+  timer.freq_hz = PWM_FREQUENCY;
+  timer.clk_cfg = LEDC_USE_RTC8M_CLK;
+  if (ledc_timer_config(&timer) != ESP_OK)
+    return false;
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+  return true;
+}
+
+// After initPWM(). Light sleep needs tickless idle in the FreeRTOS build;
+// without it only the clock is scaled.
+void initPowerSave() {
+  bool fanClock = powerMoveFanClock();
+  if (!fanClock)
+    LOGW("POWER", "Fan PWM could not use the RC clock, light sleep disabled");
+
+  esp_pm_config_esp32c3_t pm = {};
+  pm.max_freq_mhz = POWER_CPU_MAX_MHZ;
+  pm.min_freq_mhz = POWER_CPU_MIN_MHZ;
+  pm.light_sleep_enable = fanClock;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err == ESP_ERR_NOT_SUPPORTED && pm.light_sleep_enable) {
+    pm.light_sleep_enable = false;
+    err = esp_pm_configure(&pm);
+  }
+  if (err != ESP_OK) {
+    LOGW("POWER", "Power management unavailable (%s)", esp_err_to_name(err));
+    return;
+  }
+  powerMode.dfs = true;
+  powerMode.lightSleep = pm.light_sleep_enable;
+  LOGI("POWER", "CPU %d-%d MHz, light sleep %s", POWER_CPU_MIN_MHZ,
+       POWER_CPU_MAX_MHZ, powerMode.lightSleep ? "on" : "unavailable");
+}
+#endif
+
+String getPowerJSON() {
+  PowerEstimate now = powerEstimate(powerMode, powerStats.busy,
+                                    powerStats.requestsPerS);
+  String json = "{";
+#ifdef POWER_SAVE
+  json += "\"mode\":\"powersave\",";
+#else
+  json += "\"mode\":\"normal\",";
+#endif
+  json += "\"cpuMhz\":" + String(getCpuFrequencyMhz()) + ",";
+  json += "\"dfs\":" + String(powerMode.dfs ? "true" : "false") + ",";
+  json += "\"lightSleep\":" + String(powerMode.lightSleep ? "true" : "false") +
+          ",";
+  json += "\"radio\":\"" + String(powerRadioName(powerMode.radio)) + "\",";
+#if configGENERATE_RUN_TIME_STATS
+  json += "\"busySource\":\"idle\",";
+#else
+  json += "\"busySource\":\"tasks\",";
+#endif
+  json += "\"busyPercent\":" + String(powerStats.busy * 100.0f, 2) + ",";
+  json += "\"requestsPerMin\":" + String(powerStats.requestsPerS * 60.0f, 1) +
+          ",";
+  json += "\"samples\":" + String(powerStats.samples) + ",";
+  json += "\"estimate\":{\"cpuMa\":" + String(now.cpuMa, 2) +
+          ",\"radioMa\":" + String(now.radioMa, 2) +
+          ",\"totalMa\":" + String(now.totalMa, 2) + "},";
+  json += "\"averageMa\":" + String(powerAverageMa(), 2) + "}";
+  return json;
+}
+
+#endif
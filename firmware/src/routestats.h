@@ -0,0 +1,194 @@
+#ifndef ROUTESTATS_H
+#define ROUTESTATS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "allocstats.h"
+
+// Per-route request counters, service-time and heap histograms. Handlers are
+// registered through onRoute() instead of server.on() so every route is
+// measured the same way.
+//
+// Heap usage is the drop in free heap across the handler, which includes the
+// queued response. Other tasks can allocate at the same time, so treat it as
+// an estimate.
+
+#define MAX_ROUTES 32
+#define ROUTE_LATENCY_BUCKETS 9
+const uint32_t routeLatencyBoundsUs[ROUTE_LATENCY_BUCKETS - 1] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 50000};
+#define ROUTE_HEAP_BUCKETS 9
+const uint32_t routeHeapBounds[ROUTE_HEAP_BUCKETS - 1] = {
+    0, 256, 512, 1024, 2048, 4096, 8192, 16384};
+
+struct RouteStats {
+  const char *path;
+  WebRequestMethodComposite method;
+  uint32_t count;
+  uint64_t totalUs;
+  uint32_t maxUs;
+  uint32_t buckets[ROUTE_LATENCY_BUCKETS];
+  uint64_t totalHeap;
+  uint32_t maxHeap;
+  uint32_t heapBuckets[ROUTE_HEAP_BUCKETS];
+#ifdef ALLOC_TRACKING
+  uint8_t allocSite;
+#endif
+};
+
+RouteStats routeStats[MAX_ROUTES];
+int routeCount = 0;
+
+extern AsyncWebServer server;
+
+RouteStats *registerRouteStats(const char *path,
+                               WebRequestMethodComposite method) {
+  if (routeCount >= MAX_ROUTES) {
+    Serial.printf("[WEB] Route table full, %s not measured\n", path);
+    return NULL;
+  }
+  RouteStats *stats = &routeStats[routeCount++];
+  memset(stats, 0, sizeof(RouteStats));
+  stats->path = path;
+  stats->method = method;
+#ifdef ALLOC_TRACKING
+  stats->allocSite = allocSiteIndex(path);
+#endif
+  return stats;
+}
+
+static int routeBucket(const uint32_t *bounds, int buckets, uint32_t value) {
+  int bucket = 0;
+  while (bucket < buckets - 1 && value > bounds[bucket]) {
+    bucket++;
+  }
+  return bucket;
+}
+
+void recordRouteStats(RouteStats *stats, uint32_t us, uint32_t heapBytes) {
+  if (stats == NULL)
+    return;
+  stats->buckets[routeBucket(routeLatencyBoundsUs, ROUTE_LATENCY_BUCKETS, us)]++;
+  stats->heapBuckets[routeBucket(routeHeapBounds, ROUTE_HEAP_BUCKETS,
+                                 heapBytes)]++;
+  stats->count++;
+  stats->totalUs += us;
+  stats->totalHeap += heapBytes;
+  if (us > stats->maxUs)
+    stats->maxUs = us;
+  if (heapBytes > stats->maxHeap)
+    stats->maxHeap = heapBytes;
+}
+
+// Estimates a percentile from a fixed-bucket histogram by interpolating
+// inside the bucket that contains it. The open last bucket ends at `max`.
+uint32_t histogramPercentile(const uint32_t *hist, const uint32_t *bounds,
+                             int buckets, uint32_t count, uint32_t max,
+                             uint8_t percent) {
+  if (count == 0)
+    return 0;
+  uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+  if (rank == 0)
+    rank = 1;
+
+  uint32_t cumulative = 0;
+  for (int b = 0; b < buckets; b++) {
+    if (hist[b] == 0)
+      continue;
+    if (cumulative + hist[b] >= rank) {
+      uint32_t lower = b > 0 ? bounds[b - 1] : 0;
+      uint32_t upper = b < buckets - 1 ? bounds[b] : max;
+      if (upper > max)
+        upper = max;
+      if (upper < lower)
+        return upper;
+      return lower + (uint64_t)(upper - lower) * (rank - cumulative) / hist[b];
+    }
+    cumulative += hist[b];
+  }
+  return max;
+}
+
+void resetRouteStats() {
+  for (int i = 0; i < routeCount; i++) {
+    const char *path = routeStats[i].path;
+    WebRequestMethodComposite method = routeStats[i].method;
+#ifdef ALLOC_TRACKING
+    uint8_t allocSite = routeStats[i].allocSite;
+#endif
+    memset(&routeStats[i], 0, sizeof(RouteStats));
+    routeStats[i].path = path;
+    routeStats[i].method = method;
+#ifdef ALLOC_TRACKING
+    routeStats[i].allocSite = allocSite;
+#endif
+  }
+}
+
+AsyncCallbackWebHandler &onRoute(const char *path,
+                                 WebRequestMethodComposite method,
+                                 ArRequestHandlerFunction handler) {
+  RouteStats *stats = registerRouteStats(path, method);
+  return server.on(path, method,
+                   [stats, handler](AsyncWebServerRequest *request) {
+                     ALLOC_SCOPE_SITE(stats != NULL ? stats->allocSite : 0);
+                     uint32_t heapBefore = ESP.getFreeHeap();
+                     unsigned long start = micros();
+                     handler(request);
+                     uint32_t us = micros() - start;
+                     uint32_t heapAfter = ESP.getFreeHeap();
+                     recordRouteStats(stats, us,
+                                      heapBefore > heapAfter
+                                          ? heapBefore - heapAfter
+                                          : 0);
+                   });
+}
+
+const char *routeMethodName(WebRequestMethodComposite method) {
+  switch (method) {
+  case HTTP_GET:
+    return "GET";
+  case HTTP_POST:
+    return "POST";
+  default:
+    return "ANY";
+  }
+}
+
+String getRouteStatsJSON() {
+  String json = "{\"routes\":[";
+  for (int i = 0; i < routeCount; i++) {
+    const RouteStats &r = routeStats[i];
+    if (i > 0)
+      json += ",";
+    json += "{\"path\":\"" + String(r.path) + "\"";
+    json += ",\"method\":\"" + String(routeMethodName(r.method)) + "\"";
+    json += ",\"count\":" + String(r.count);
+    json += ",\"avgUs\":" + String(r.count ? (uint32_t)(r.totalUs / r.count) : 0);
+    json += ",\"p50Us\":" +
+            String(histogramPercentile(r.buckets, routeLatencyBoundsUs,
+                                       ROUTE_LATENCY_BUCKETS, r.count, r.maxUs,
+                                       50));
+    json += ",\"p99Us\":" +
+            String(histogramPercentile(r.buckets, routeLatencyBoundsUs,
+                                       ROUTE_LATENCY_BUCKETS, r.count, r.maxUs,
+                                       99));
+    json += ",\"maxUs\":" + String(r.maxUs);
+    json += ",\"avgHeap\":" +
+            String(r.count ? (uint32_t)(r.totalHeap / r.count) : 0);
+    json += ",\"p50Heap\":" +
+            String(histogramPercentile(r.heapBuckets, routeHeapBounds,
+                                       ROUTE_HEAP_BUCKETS, r.count, r.maxHeap,
+                                       50));
+    json += ",\"p99Heap\":" +
+            String(histogramPercentile(r.heapBuckets, routeHeapBounds,
+                                       ROUTE_HEAP_BUCKETS, r.count, r.maxHeap,
+                                       99));
+    json += ",\"maxHeap\":" + String(r.maxHeap) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+#endif
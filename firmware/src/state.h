@@ -3,9 +3,40 @@
 
 #include <Preferences.h>
 #include "config.h"
+#include "fixedstring.h"
 
-extern Preferences preferences;
-extern char currentHostname[32];
+// Preferences that books every put to the NVS wear counters (nvswear.h).
+void nvsWearBook(const char *key, size_t len, bool blob);
+
+class WearPreferences : public Preferences {
+public:
+    size_t putInt(const char *key, int32_t value) {
+        nvsWearBook(key, 0, false);
+        return Preferences::putInt(key, value);
+    }
+    size_t putLong(const char *key, int32_t value) {
+        nvsWearBook(key, 0, false);
+        return Preferences::putLong(key, value);
+    }
+    size_t putBool(const char *key, bool value) {
+        nvsWearBook(key, 0, false);
+        return Preferences::putBool(key, value);
+    }
+    size_t putString(const char *key, const char *value) {
+        nvsWearBook(key, strlen(value) + 1, false);
+        return Preferences::putString(key, value);
+    }
+    size_t putString(const char *key, const String &value) {
+        return putString(key, value.c_str());
+    }
+    size_t putBytes(const char *key, const void *value, size_t len) {
+        nvsWearBook(key, len, true);
+        return Preferences::putBytes(key, value, len);
+    }
+};
+
+extern WearPreferences preferences;
+extern FixedString<31> currentHostname;
 
 extern int fanMinPercent;
 extern int fanMaxPercent;
@@ -15,24 +46,71 @@ extern bool timerEnabled;
 
 extern bool isLightOn;
 extern int currentFanSpeed;
+extern int currentFanDuty;
+extern uint32_t lightSwitchCount;
+extern uint32_t nvsCommitCount;
+extern volatile uint32_t stateVersion;
 
 extern bool isAPMode;
-extern char wifiSSID[32];
-extern char wifiPass[64];
+extern FixedString<31> wifiSSID;
+extern FixedString<63> wifiPass;
 
 enum PlantPhase { PHASE_NONE, PHASE_SEEDLING, PHASE_VEG, PHASE_FLOWER };
 enum TimezoneMode { TZ_AUTO, TZ_WINTER, TZ_SUMMER };
+enum TimeSource { TIME_NONE, TIME_ESTIMATED, TIME_SYNCED };
 
 struct PhaseData {
     time_t startTime;
     bool active;
 };
 
-extern PhaseData phases[3];
+// Fields of a batched configuration update (POST /api/config).
+enum ConfigField {
+    CFG_FAN_SPEED = 1 << 0,
+    CFG_FAN_MIN = 1 << 1,
+    CFG_FAN_MAX = 1 << 2,
+    CFG_LIGHT_ON = 1 << 3,
+    CFG_LIGHT_DURATION = 1 << 4,
+    CFG_TIMER_ENABLED = 1 << 5,
+    CFG_TZ_MODE = 1 << 6
+};
+
+// Deferred writes (persist.h): the ConfigField bits for single settings,
+// plus these.
+enum PersistItem {
+    PERSIST_SETTINGS = 0x7F,
+    PERSIST_PHASES = 1 << 8,
+    PERSIST_LOGBOOK = 1 << 9,
+    PERSIST_USAGE = 1 << 10,
+    PERSIST_TIME_CACHE = 1 << 11,
+    PERSIST_TIME_DRIFT = 1 << 12,
+    PERSIST_HOSTNAME = 1 << 13,
+    PERSIST_WIFI = 1 << 14
+};
+
+struct ConfigUpdate {
+    uint8_t fields;
+    int fanSpeed;
+    int fanMin;
+    int fanMax;
+    int lightOnHour;
+    int lightDuration;
+    bool timerEnabled;
+    TimezoneMode tzMode;
+};
+
+extern PhaseData phases[4];
 extern PlantPhase currentPhase;
 extern TimezoneMode currentTzMode;
+extern TimeSource timeSource;
 
 void loadSettings();
+void commitPreferences(WearPreferences &prefs = preferences);
+void savePending(uint16_t what);
+void bumpStateVersion();
+String getStatusETag(bool binary = false);
+String getStatusETag(uint32_t version, bool binary);
+uint64_t getLightOnMillis();
 void saveFanMin(int minVal);
 void saveFanMax(int maxVal);
 void saveLightOnHour(int hour);
@@ -41,13 +119,22 @@ void saveTimerEnabled(bool enabled);
 void saveHostname(const char *hostname);
 void saveWiFiCredentials(const char *ssid, const char *pass);
 void saveTzMode(TimezoneMode mode);
+void applyConfig(const ConfigUpdate &update);
 void applyTimezone();
+const char *getTimezoneString();
+void restoreTimeCache();
+void updateTimeCache();
+void markTimeSynced();
 void setLight(bool on);
 void setFan(int percent);
 void setSystemTime(long epoch);
 void checkTimer();
+void checkDayRollover(const struct tm &timeinfo);
+void refreshPhaseDays();
+int getPhaseDays(PlantPhase phase);
+int getTotalDays();
 void checkWiFi();
-void processCommand(String command);
+void processCommand(char *line);
 void initWiFi();
 void initPWM();
 void printStatus();
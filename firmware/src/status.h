@@ -0,0 +1,79 @@
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <time.h>
+
+#include "allocstats.h"
+#include "config.h"
+#include "control.h"
+#include "state.h"
+
+// JSON status document and its ETag, shared by /api/status, long-poll and
+// POST /api/config. Kept out of main.cpp so the native build serves the
+// same document.
+
+uint32_t bootId = 0; // random per boot, part of the ETag
+
+String getStatusETag(uint32_t version, bool binary) {
+  char etag[28];
+  snprintf(etag, sizeof(etag), "\"%08lx-%lu%s\"", (unsigned long)bootId,
+           (unsigned long)version, binary ? "-b" : "");
+  return String(etag);
+}
+
+String getStatusETag(bool binary) { return getStatusETag(stateVersion, binary); }
+
+// Everything in the document is covered by stateVersion, so one ETag is one
+// body. The clock is not in it; GET /api/time serves that.
+String getStatusJSON() {
+  ALLOC_SCOPE("statusJSON");
+  // time() instead of getLocalTime(): the latter waits up to 5 s without NTP.
+  time_t now = time(nullptr);
+  bool hasTime = now > MIN_VALID_EPOCH;
+
+  String json = "{";
+  json += "\"version\":" + String(stateVersion) + ",";
+  json += "\"light\":" + String(isLightOn ? "true" : "false") + ",";
+  json += "\"fan\":" + String(currentFanSpeed) + ",";
+  json += "\"fanMin\":" + String(fanMinPercent) + ",";
+  json += "\"fanMax\":" + String(fanMaxPercent) + ",";
+  json += "\"lightOn\":" + String(lightOnHour) + ",";
+  json += "\"lightDuration\":" + String(lightDuration) + ",";
+  json += "\"timerEnabled\":" + String(timerEnabled ? "true" : "false") + ",";
+  json += "\"tzMode\":" + String((int)currentTzMode) + ",";
+  json += "\"hostname\":\"" + String(currentHostname.c_str()) + "\",";
+  json += "\"ip\":\"" + WiFi.localIP().toString() + "\",";
+  json += "\"wifiConnected\":" +
+          String(WiFi.status() == WL_CONNECTED ? "true" : "false") + ",";
+  json += "\"hasTime\":" + String(hasTime ? "true" : "false") + ",";
+  json += "\"timeEstimated\":" +
+          String(timeSource == TIME_ESTIMATED ? "true" : "false");
+  json += "," + getPhaseJSON();
+  json += "}";
+  return json;
+}
+
+// GET /api/time without a parameter: the controller clock, never cached.
+String getTimeJSON() {
+  time_t now = time(nullptr);
+  bool hasTime = now > MIN_VALID_EPOCH;
+  char json[96];
+  if (hasTime) {
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    char timeStr[10];
+    strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
+    snprintf(json, sizeof(json),
+             "{\"hasTime\":true,\"timeEstimated\":%s,\"epoch\":%lu,"
+             "\"currentTime\":\"%s\"}",
+             timeSource == TIME_ESTIMATED ? "true" : "false",
+             (unsigned long)now, timeStr);
+  } else {
+    snprintf(json, sizeof(json), "{\"hasTime\":false}");
+  }
+  return String(json);
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef STATUSBIN_H
+#define STATUSBIN_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+
+#include "state.h"
+
+// Fixed-layout binary status for machine pollers (GET /api/status.bin or
+// /api/status with "Accept: application/octet-stream"). All multi-byte
+// fields are little-endian. New fields are only ever appended and bump
+// STATUS_BIN_VERSION; decoders should ignore trailing bytes they don't know.
+//
+//  off size field
+//    0    1 format version (STATUS_BIN_VERSION)
+//    1    1 flags: bit0 light, bit1 timer enabled, bit2 WiFi connected,
+//           bit3 has time, bit4 time estimated, bit5 AP mode
+//    2    1 fan speed (%)
+//    3    1 fan min (%)
+//    4    1 fan max (%)
+//    5    1 light on hour (0-23)
+//    6    1 light duration (h, 1-24)
+//    7    1 timezone mode (0 auto, 1 winter, 2 summer)
+//    8    1 current phase (0 none, 1 seedling, 2 veg, 3 flower)
+//    9    1 phase active bits: bit0 seedling, bit1 veg, bit2 flower
+//   10    2 total days
+//   12    2 seedling days
+//   14    2 veg days
+//   16    2 flower days
+//   18    4 state version (same as "version" in the JSON status)
+//   22    4 unix time (0 when no time is available)
+//   26    4 IPv4 address (a.b.c.d in wire order)
+//   30    1 fan PWM duty (0-255)
+//   31    1 reserved (0)
+
+#define STATUS_BIN_VERSION 1
+#define STATUS_BIN_SIZE 32
+
+static void statusBinPut16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void statusBinPut32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
+
+size_t encodeStatusBinary(uint8_t *buf) {
+  time_t now = time(nullptr);
+  bool hasTime = now > MIN_VALID_EPOCH;
+  bool connected = WiFi.status() == WL_CONNECTED;
+
+  uint8_t flags = 0;
+  if (isLightOn)
+    flags |= 1 << 0;
+  if (timerEnabled)
+    flags |= 1 << 1;
+  if (connected)
+    flags |= 1 << 2;
+  if (hasTime)
+    flags |= 1 << 3;
+  if (timeSource == TIME_ESTIMATED)
+    flags |= 1 << 4;
+  if (isAPMode)
+    flags |= 1 << 5;
+
+  uint8_t active = 0;
+  if (phases[PHASE_SEEDLING].active)
+    active |= 1 << 0;
+  if (phases[PHASE_VEG].active)
+    active |= 1 << 1;
+  if (phases[PHASE_FLOWER].active)
+    active |= 1 << 2;
+
+  buf[0] = STATUS_BIN_VERSION;
+  buf[1] = flags;
+  buf[2] = (uint8_t)currentFanSpeed;
+  buf[3] = (uint8_t)fanMinPercent;
+  buf[4] = (uint8_t)fanMaxPercent;
+  buf[5] = (uint8_t)lightOnHour;
+  buf[6] = (uint8_t)lightDuration;
+  buf[7] = (uint8_t)currentTzMode;
+  buf[8] = (uint8_t)currentPhase;
+  buf[9] = active;
+  statusBinPut16(buf + 10, (uint16_t)getTotalDays());
+  statusBinPut16(buf + 12, (uint16_t)getPhaseDays(PHASE_SEEDLING));
+  statusBinPut16(buf + 14, (uint16_t)getPhaseDays(PHASE_VEG));
+  statusBinPut16(buf + 16, (uint16_t)getPhaseDays(PHASE_FLOWER));
+  statusBinPut32(buf + 18, stateVersion);
+  statusBinPut32(buf + 22, hasTime ? (uint32_t)now : 0);
+
+  IPAddress ip = connected ? WiFi.localIP() : WiFi.softAPIP();
+  for (int i = 0; i < 4; i++) {
+    buf[26 + i] = ip[i];
+  }
+  buf[30] = (uint8_t)currentFanDuty;
+  buf[31] = 0;
+  return STATUS_BIN_SIZE;
+}
+
+bool wantsStatusBinary(AsyncWebServerRequest *request) {
+  if (!request->hasHeader("Accept"))
+    return false;
+  return request->getHeader("Accept")->value().indexOf(
+             "application/octet-stream") >= 0;
+}
+
+static uint32_t statusBinGet32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Encoded once up front, so the ETag carries the state version of the bytes
+// actually sent even if the control task changes the state meanwhile.
+void sendStatusBinary(AsyncWebServerRequest *request) {
+  uint8_t payload[STATUS_BIN_SIZE];
+  encodeStatusBinary(payload);
+  String etag = getStatusETag(statusBinGet32(payload + 18), true);
+  if (request->hasHeader("If-None-Match") &&
+      request->getHeader("If-None-Match")->value() == etag) {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    request->send(response);
+    return;
+  }
+
+  AsyncWebServerResponse *response = request->beginResponse(
+      "application/octet-stream", STATUS_BIN_SIZE,
+      [payload](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        if (index >= STATUS_BIN_SIZE)
+          return 0;
+        size_t len = STATUS_BIN_SIZE - index;
+        if (len > maxLen)
+          len = maxLen;
+        memcpy(buffer, payload + index, len);
+        return len;
+      });
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache");
+  response->addHeader("Vary", "Accept");
+  request->send(response);
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include "allocstats.h"
+#include "config.h"
+#include "control.h"
+#include "controlqueue.h"
+#include "diag.h"
+#include "history.h"
+#include "logger.h"
+#include "persist.h"
+#include "power.h"
+#include "telemetry.h"
+#include "timecache.h"
+
+// Task layout after setup(); loop() is not used.
+//
+//   control  CONTROL_TASK_PRIORITY  light timer, day rollover, time cache,
+//            history every CONTROL_INTERVAL; in between it runs the state
+//            changes queued by other tasks (controlqueue.h)
+//   net      NET_TASK_PRIORITY      OTA, WiFi reconnect, serial console
+//   persist  PERSIST_TASK_PRIORITY  all flash writes after setup: deferred
+//            flushes (persist.h), telemetry blocks, factory reset and
+//            restarts; woken through persistQueue; power sampling
+//
+// HTTP handlers run in the AsyncTCP task and the logger drains in its own.
+// Control preempts everything of ours and does no flash I/O itself, so a
+// blocking WiFi reconnect, an OTA transfer or a slow flush delays it by at
+// most a flash write in progress (which stalls the whole single-core chip).
+// DIAG shows its period; STALL (DIAG_COMMANDS builds) busy-waits the network
+// task to check. Each task feeds the task watchdog once per cycle; anything
+// stuck for TASK_WDT_TIMEOUT panics and reboots.
+//
+// The stack sizes in config.h are estimates. DIAG lists each task's unused
+// stack (stackFree), and taskStackCheck() logs when one drops below
+// TASK_STACK_WARN, so they can be checked on hardware under load.
+
+TaskHandle_t netTask = NULL;
+TaskHandle_t persistTask = NULL;
+unsigned long lastBlinkTime = 0;
+unsigned long lastTimeWarning = 0;
+
+// The time-dependent part of the control task. The host programs in
+// native/ call it, and persistTaskTick(), in place of the tasks.
+void controlTick() {
+  diagLoopTick();
+#ifdef ALLOC_TRACKING
+  allocTrendTick();
+#endif
+
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo, 0)) {
+    // No time available -> keep the light as it is, signal on the status LED
+    unsigned long now = millis();
+#ifdef STATUS_LED_PIN
+    if (now - lastBlinkTime >= 1000) {
+      lastBlinkTime = now;
+      digitalWrite(STATUS_LED_PIN, !digitalRead(STATUS_LED_PIN));
+    }
+#endif
+    if (now - lastTimeWarning >= TIME_WARNING_INTERVAL) {
+      lastTimeWarning = now;
+      LOGW("SYS", "No time sync! Light timer paused.");
+    }
+    return;
+  }
+#ifdef STATUS_LED_PIN
+  digitalWrite(STATUS_LED_PIN, LOW);
+#endif
+  updateTimeCache();
+  checkDayRollover(timeinfo);
+  unsigned long sectionStart = micros();
+  checkTimer();
+  diagRecordSection(DIAG_CHECK_TIMER, micros() - sectionStart);
+  historyTick(time(nullptr));
+}
+
+#ifdef ENABLE_BLE
+// BLE notifications of the tick's state changes (main.cpp).
+void bleTick();
+#endif
+
+void controlTaskMain(void *arg) {
+  ALLOC_SCOPE("control");
+  esp_task_wdt_add(NULL);
+  const TickType_t period = pdMS_TO_TICKS(CONTROL_INTERVAL);
+  TickType_t next = xTaskGetTickCount();
+  for (;;) {
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(next - now) > 0) {
+      controlServe(next - now);
+      continue;
+    }
+    // After an overrun, keep the period instead of catching up in a burst.
+    next = (int32_t)(now - next) >= (int32_t)period ? now + period
+                                                    : next + period;
+    unsigned long start = micros();
+    controlTick();
+#ifdef ENABLE_BLE
+    bleTick();
+#endif
+    powerTick(micros() - start);
+    esp_task_wdt_reset();
+  }
+}
+
+// OTA, WiFi and console (main.cpp).
+void networkTick();
+
+void netTaskMain(void *arg) {
+  ALLOC_SCOPE("net");
+  esp_task_wdt_add(NULL);
+  for (;;) {
+    unsigned long start = micros();
+    networkTick();
+    powerTick(micros() - start);
+    esp_task_wdt_reset();
+    vTaskDelay(pdMS_TO_TICKS(NET_INTERVAL));
+  }
+}
+
+// Warns once per task whose stack high-water mark gets close to the end.
+void taskStackCheck() {
+  static bool warned[3] = {false, false, false};
+  TaskHandle_t tasks[3] = {controlTask, netTask, persistTask};
+  for (int i = 0; i < 3; i++) {
+    if (tasks[i] == NULL || warned[i])
+      continue;
+    UBaseType_t free = uxTaskGetStackHighWaterMark(tasks[i]);
+    if (free < TASK_STACK_WARN) {
+      warned[i] = true;
+      LOGW("TASK", "%s: only %u bytes of stack never used",
+           pcTaskGetName(tasks[i]), (unsigned)free);
+    }
+  }
+}
+
+// One cycle of the persistence task.
+void persistTaskTick() {
+  persistRestartTick();
+  persistTick();
+  telemetryWriteSealed();
+  taskStackCheck();
+}
+
+void persistTaskMain(void *arg) {
+  esp_task_wdt_add(NULL);
+  for (;;) {
+    unsigned long wait = PERSIST_TASK_INTERVAL;
+    if (persistPending != 0) {
+      unsigned long age = millis() - persistSince;
+      if (age >= PERSIST_DELAY)
+        wait = 0;
+      else if (PERSIST_DELAY - age < wait)
+        wait = PERSIST_DELAY - age;
+    }
+    // A mark only needs to shorten the wait; persistPending is the state.
+    uint16_t marked;
+    xQueueReceive(persistQueue, &marked, pdMS_TO_TICKS(wait));
+    unsigned long start = micros();
+    persistTaskTick();
+    powerTick(micros() - start);
+    esp_task_wdt_reset();
+  }
+}
+
+// Last step of setup(). The watchdog is already running for the idle task;
+// this sets its timeout and lets it panic.
+void startTasks() {
+  esp_task_wdt_init(TASK_WDT_TIMEOUT, true);
+  controlQueue = xQueueCreate(CONTROL_QUEUE_LENGTH, sizeof(ControlCall));
+  persistQueue = xQueueCreate(PERSIST_QUEUE_LENGTH, sizeof(uint16_t));
+  if (controlQueue == NULL || persistQueue == NULL) {
+    LOGE("TASK", "Queue allocation failed, restarting");
+    delay(1000);
+    ESP.restart();
+  }
+  xTaskCreate(controlTaskMain, "control", CONTROL_TASK_STACK, NULL,
+              CONTROL_TASK_PRIORITY, &controlTask);
+  controlTaskRunning = true;
+  xTaskCreate(netTaskMain, "net", NET_TASK_STACK, NULL, NET_TASK_PRIORITY,
+              &netTask);
+  xTaskCreate(persistTaskMain, "persist", PERSIST_TASK_STACK, NULL,
+              PERSIST_TASK_PRIORITY, &persistTask);
+  LOGI("TASK", "control/net/persist started, watchdog %lu s",
+       (unsigned long)TASK_WDT_TIMEOUT);
+}
+
+#endif
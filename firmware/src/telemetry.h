@@ -0,0 +1,614 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <LittleFS.h>
+
+#include "chunkwriter.h"
+#include "config.h"
+#include "history.h"
+#include "logger.h"
+#include "persist.h"
+
+// Long-term telemetry on the LittleFS ("spiffs") partition. Finished minute
+// samples from the history are compressed into blocks of up to one hour:
+//
+//   timestamps  delta-of-delta against the previous interval (nominal 60 s)
+//                 '0'                  dod == 0
+//                 '10'   + 7 bits      dod in [-63, 64]
+//                 '110'  + 9 bits      dod in [-255, 256]
+//                 '1110' + 12 bits     dod in [-2047, 2048]
+//                 '1111' + 32 bits     anything else
+//   values      sample packed as light<<24 | fanDuty<<16 | fan<<8 | flags,
+//               XOR with the previous value (Gorilla style)
+//                 '0'                  unchanged
+//                 '10'   + bits        fits the previous leading/trailing window
+//                 '11'   + 5 bits leading zeros + 5 bits (length - 1) + bits
+//
+// Bits are written MSB first. Each block has a 16-byte little-endian header:
+//   magic u16 'TB', count u16, payload bytes u16, CRC-16/CCITT of payload u16,
+//   first time u32, first value u32
+//
+// Blocks are appended to one file per UTC day (/tlm/<day>, day = time/86400),
+// so a day costs 24 small appends. LittleFS spreads the writes over the
+// partition; when the store exceeds TELEMETRY_MAX_BYTES the oldest day is
+// deleted. A block with a bad header or CRC (power lost mid-write) ends the
+// day file for readers. The block being filled lives in RAM, so queries lag
+// by up to an hour and a reboot loses that hour -- /api/history covers it.
+//
+// The control task only encodes. A finished block is sealed into
+// telemetrySealed and appended by the persistence task (tasks.h), so the
+// LittleFS writes and budget deletions never delay the light timer.
+//
+// scripts/telemetry_codec.py implements the same format for offline decoding.
+
+#define TELEMETRY_DIR "/tlm"
+#define TELEMETRY_MAGIC 0x4254 // "TB"
+#define TELEMETRY_HEADER_SIZE 16
+#define TELEMETRY_BLOCK_BYTES 512
+#define TELEMETRY_MAX_SAMPLE_BITS 80 // worst case: 4+32 time, 2+10+32 value
+
+struct TelemetryCodec {
+  uint32_t prevTime;
+  int32_t prevDelta;
+  uint32_t prevValue;
+  uint8_t prevLeading;
+  uint8_t prevTrailing;
+};
+
+struct TelemetryBlock {
+  uint32_t firstTime;
+  uint32_t firstValue;
+  uint16_t count;
+  uint16_t bits;
+  TelemetryCodec codec;
+  uint8_t payload[TELEMETRY_BLOCK_BYTES];
+};
+
+struct TelemetryStats {
+  bool mounted;
+  uint32_t samples;     // stored on flash
+  uint32_t bytes;       // stored on flash, headers included
+  uint32_t blocks;
+  uint32_t oldestDay;   // 0 when empty
+  uint32_t newestDay;
+  uint32_t writeErrors;
+};
+
+enum TelemetrySealState { TLM_SEAL_EMPTY, TLM_SEAL_FULL, TLM_SEAL_WRITING };
+
+TelemetryBlock telemetryBlock;
+TelemetryBlock telemetrySealed; // finished block waiting for its append
+volatile uint8_t telemetrySealState = TLM_SEAL_EMPTY;
+portMUX_TYPE telemetryMux = portMUX_INITIALIZER_UNLOCKED;
+TelemetryStats telemetryStats = {false, 0, 0, 0, 0, 0, 0};
+
+// ---- bit stream ------------------------------------------------------------
+
+static void tlmPutBits(uint8_t *buf, uint16_t &pos, uint32_t value,
+                       uint8_t n) {
+  for (int i = n - 1; i >= 0; i--) {
+    uint8_t mask = 0x80 >> (pos & 7);
+    if ((value >> i) & 1)
+      buf[pos >> 3] |= mask;
+    else
+      buf[pos >> 3] &= ~mask;
+    pos++;
+  }
+}
+
+static uint32_t tlmGetBits(const uint8_t *buf, uint16_t &pos, uint8_t n) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    value = (value << 1) | ((buf[pos >> 3] >> (7 - (pos & 7))) & 1);
+    pos++;
+  }
+  return value;
+}
+
+static uint8_t tlmLeadingZeros(uint32_t x) { return x ? __builtin_clz(x) : 32; }
+static uint8_t tlmTrailingZeros(uint32_t x) { return x ? __builtin_ctz(x) : 32; }
+
+uint16_t telemetryCRC16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// ---- codec -----------------------------------------------------------------
+
+uint32_t telemetryPack(const HistorySample &s) {
+  return (uint32_t)s.light << 24 | (uint32_t)s.fanDuty << 16 |
+         (uint32_t)s.fanSpeed << 8 | s.flags;
+}
+
+HistorySample telemetryUnpack(uint32_t v) {
+  HistorySample s;
+  s.light = v >> 24;
+  s.fanDuty = (v >> 16) & 0xFF;
+  s.fanSpeed = (v >> 8) & 0xFF;
+  s.flags = v & 0xFF;
+  return s;
+}
+
+void telemetryCodecStart(TelemetryCodec &c, uint32_t t, uint32_t v) {
+  c.prevTime = t;
+  c.prevDelta = 60;
+  c.prevValue = v;
+  c.prevLeading = 0xFF; // no window yet
+  c.prevTrailing = 0;
+}
+
+void telemetryEncode(TelemetryCodec &c, uint8_t *buf, uint16_t &pos,
+                     uint32_t t, uint32_t v) {
+  int32_t delta = (int32_t)(t - c.prevTime);
+  int32_t dod = delta - c.prevDelta;
+  if (dod == 0) {
+    tlmPutBits(buf, pos, 0b0, 1);
+  } else if (dod >= -63 && dod <= 64) {
+    tlmPutBits(buf, pos, 0b10, 2);
+    tlmPutBits(buf, pos, dod + 63, 7);
+  } else if (dod >= -255 && dod <= 256) {
+    tlmPutBits(buf, pos, 0b110, 3);
+    tlmPutBits(buf, pos, dod + 255, 9);
+  } else if (dod >= -2047 && dod <= 2048) {
+    tlmPutBits(buf, pos, 0b1110, 4);
+    tlmPutBits(buf, pos, dod + 2047, 12);
+  } else {
+    tlmPutBits(buf, pos, 0b1111, 4);
+    tlmPutBits(buf, pos, (uint32_t)dod, 32);
+  }
+  c.prevTime = t;
+  c.prevDelta = delta;
+
+  uint32_t x = v ^ c.prevValue;
+  c.prevValue = v;
+  if (x == 0) {
+    tlmPutBits(buf, pos, 0b0, 1);
+    return;
+  }
+  uint8_t leading = tlmLeadingZeros(x);
+  uint8_t trailing = tlmTrailingZeros(x);
+  if (leading > 31)
+    leading = 31;
+  if (c.prevLeading != 0xFF && leading >= c.prevLeading &&
+      trailing >= c.prevTrailing) {
+    tlmPutBits(buf, pos, 0b10, 2);
+    tlmPutBits(buf, pos, x >> c.prevTrailing,
+               32 - c.prevLeading - c.prevTrailing);
+    return;
+  }
+  uint8_t length = 32 - leading - trailing;
+  tlmPutBits(buf, pos, 0b11, 2);
+  tlmPutBits(buf, pos, leading, 5);
+  tlmPutBits(buf, pos, length - 1, 5);
+  tlmPutBits(buf, pos, x >> trailing, length);
+  c.prevLeading = leading;
+  c.prevTrailing = trailing;
+}
+
+void telemetryDecode(TelemetryCodec &c, const uint8_t *buf, uint16_t &pos,
+                     uint32_t &t, uint32_t &v) {
+  int32_t dod;
+  if (tlmGetBits(buf, pos, 1) == 0) {
+    dod = 0;
+  } else if (tlmGetBits(buf, pos, 1) == 0) {
+    dod = (int32_t)tlmGetBits(buf, pos, 7) - 63;
+  } else if (tlmGetBits(buf, pos, 1) == 0) {
+    dod = (int32_t)tlmGetBits(buf, pos, 9) - 255;
+  } else if (tlmGetBits(buf, pos, 1) == 0) {
+    dod = (int32_t)tlmGetBits(buf, pos, 12) - 2047;
+  } else {
+    dod = (int32_t)tlmGetBits(buf, pos, 32);
+  }
+  c.prevDelta += dod;
+  c.prevTime += c.prevDelta;
+  t = c.prevTime;
+
+  if (tlmGetBits(buf, pos, 1) == 1) {
+    uint32_t x;
+    if (tlmGetBits(buf, pos, 1) == 0) {
+      x = tlmGetBits(buf, pos, 32 - c.prevLeading - c.prevTrailing)
+          << c.prevTrailing;
+    } else {
+      uint8_t leading = tlmGetBits(buf, pos, 5);
+      uint8_t length = tlmGetBits(buf, pos, 5) + 1;
+      uint8_t trailing = 32 - leading - length;
+      x = tlmGetBits(buf, pos, length) << trailing;
+      c.prevLeading = leading;
+      c.prevTrailing = trailing;
+    }
+    c.prevValue ^= x;
+  }
+  v = c.prevValue;
+}
+
+// ---- store -----------------------------------------------------------------
+
+static void telemetryDayPath(char *path, size_t len, uint32_t day) {
+  snprintf(path, len, TELEMETRY_DIR "/%lu", (unsigned long)day);
+}
+
+static void tlmPut16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void tlmPut32(uint8_t *p, uint32_t v) {
+  tlmPut16(p, v & 0xFFFF);
+  tlmPut16(p + 2, v >> 16);
+}
+
+static uint16_t tlmGet16(const uint8_t *p) { return p[0] | (uint16_t)p[1] << 8; }
+static uint32_t tlmGet32(const uint8_t *p) {
+  return tlmGet16(p) | (uint32_t)tlmGet16(p + 2) << 16;
+}
+
+// Reads the block at `offset` into `header`/`payload`. Returns false at the
+// end of the file or on a damaged block.
+bool telemetryReadBlock(File &file, uint32_t offset, uint8_t *header,
+                        uint8_t *payload) {
+  if (!file.seek(offset) ||
+      file.read(header, TELEMETRY_HEADER_SIZE) != TELEMETRY_HEADER_SIZE)
+    return false;
+  uint16_t bytes = tlmGet16(header + 4);
+  if (tlmGet16(header) != TELEMETRY_MAGIC || tlmGet16(header + 2) == 0 ||
+      bytes > TELEMETRY_BLOCK_BYTES)
+    return false;
+  if (payload == NULL)
+    return true;
+  if (file.read(payload, bytes) != bytes)
+    return false;
+  return telemetryCRC16(payload, bytes) == tlmGet16(header + 6);
+}
+
+// Deletes whole days, oldest first, until the store fits its budget.
+void telemetryEnforceBudget() {
+  char path[24];
+  while (telemetryStats.bytes > TELEMETRY_MAX_BYTES &&
+         telemetryStats.oldestDay != 0 &&
+         telemetryStats.oldestDay < telemetryStats.newestDay) {
+    telemetryDayPath(path, sizeof(path), telemetryStats.oldestDay);
+    if (LittleFS.exists(path)) {
+      File file = LittleFS.open(path, "r");
+      uint8_t header[TELEMETRY_HEADER_SIZE];
+      uint32_t offset = 0;
+      while (telemetryReadBlock(file, offset, header, NULL)) {
+        telemetryStats.samples -= tlmGet16(header + 2);
+        telemetryStats.blocks--;
+        offset += TELEMETRY_HEADER_SIZE + tlmGet16(header + 4);
+      }
+      telemetryStats.bytes -= file.size();
+      file.close();
+      LittleFS.remove(path);
+      LOGI("TLM", "Dropped day %lu to stay within budget",
+           (unsigned long)telemetryStats.oldestDay);
+    }
+    telemetryStats.oldestDay++;
+  }
+}
+
+static void telemetryWriteBlock(const TelemetryBlock &b) {
+  uint16_t bytes = (b.bits + 7) / 8;
+  uint8_t header[TELEMETRY_HEADER_SIZE];
+  tlmPut16(header, TELEMETRY_MAGIC);
+  tlmPut16(header + 2, b.count);
+  tlmPut16(header + 4, bytes);
+  tlmPut16(header + 6, telemetryCRC16(b.payload, bytes));
+  tlmPut32(header + 8, b.firstTime);
+  tlmPut32(header + 12, b.firstValue);
+
+  uint32_t day = b.firstTime / 86400;
+  char path[24];
+  telemetryDayPath(path, sizeof(path), day);
+  File file = LittleFS.open(path, "a");
+  bool ok = file && file.write(header, TELEMETRY_HEADER_SIZE) ==
+                        TELEMETRY_HEADER_SIZE &&
+            file.write(b.payload, bytes) == bytes;
+  if (file)
+    file.close();
+
+  if (ok) {
+    telemetryStats.samples += b.count;
+    telemetryStats.bytes += TELEMETRY_HEADER_SIZE + bytes;
+    telemetryStats.blocks++;
+    if (telemetryStats.oldestDay == 0)
+      telemetryStats.oldestDay = day;
+    telemetryStats.newestDay = day;
+    telemetryEnforceBudget();
+  } else {
+    telemetryStats.writeErrors++;
+    LOGE("TLM", "Failed to append block to %s", path);
+  }
+}
+
+// Hands the block being filled to the persistence task. Control task only.
+// A block sealed while the previous one is still unwritten is dropped;
+// with one block per hour and a write within seconds that takes a stalled
+// persistence task.
+void telemetrySeal() {
+  TelemetryBlock &b = telemetryBlock;
+  if (b.count == 0 || !telemetryStats.mounted)
+    return;
+  if (telemetrySealState != TLM_SEAL_EMPTY) {
+    telemetryStats.writeErrors++;
+    LOGW("TLM", "Previous block not written yet, dropped %u samples",
+         (unsigned)b.count);
+  } else {
+    telemetrySealed = b;
+    telemetrySealState = TLM_SEAL_FULL;
+    persistWake();
+  }
+  b.count = 0;
+}
+
+// Appends the sealed block, if there is one. Persistence task, and the
+// network task before an OTA restart.
+void telemetryWriteSealed() {
+  portENTER_CRITICAL(&telemetryMux);
+  bool full = telemetrySealState == TLM_SEAL_FULL;
+  if (full)
+    telemetrySealState = TLM_SEAL_WRITING;
+  portEXIT_CRITICAL(&telemetryMux);
+  if (!full)
+    return;
+  telemetryWriteBlock(telemetrySealed);
+  telemetrySealState = TLM_SEAL_EMPTY;
+}
+
+// Called for every finished history minute.
+void telemetryAppend(uint32_t t, const HistorySample &s) {
+  TelemetryBlock &b = telemetryBlock;
+  uint32_t v = telemetryPack(s);
+
+  if (b.count > 0) {
+    if (t <= b.codec.prevTime)
+      return; // clock stepped back
+    if (t / 3600 != b.firstTime / 3600 ||
+        b.bits + TELEMETRY_MAX_SAMPLE_BITS > TELEMETRY_BLOCK_BYTES * 8)
+      telemetrySeal();
+  }
+
+  if (b.count == 0) {
+    b.firstTime = t;
+    b.firstValue = v;
+    b.bits = 0;
+    telemetryCodecStart(b.codec, t, v);
+  } else {
+    telemetryEncode(b.codec, b.payload, b.bits, t, v);
+  }
+  b.count++;
+}
+
+void initTelemetry() {
+  if (!LittleFS.begin(true)) {
+    Serial.println("[TLM] LittleFS mount failed, telemetry disabled");
+    return;
+  }
+  telemetryStats.mounted = true;
+  if (!LittleFS.exists(TELEMETRY_DIR))
+    LittleFS.mkdir(TELEMETRY_DIR);
+
+  // Rebuild the counters from the block headers.
+  File dir = LittleFS.open(TELEMETRY_DIR);
+  File file = dir.openNextFile();
+  while (file) {
+    uint32_t day = strtoul(file.name(), NULL, 10);
+    uint8_t header[TELEMETRY_HEADER_SIZE];
+    uint32_t offset = 0;
+    while (telemetryReadBlock(file, offset, header, NULL)) {
+      telemetryStats.samples += tlmGet16(header + 2);
+      telemetryStats.blocks++;
+      offset += TELEMETRY_HEADER_SIZE + tlmGet16(header + 4);
+    }
+    telemetryStats.bytes += file.size();
+    if (day > 0 && (telemetryStats.oldestDay == 0 || day < telemetryStats.oldestDay))
+      telemetryStats.oldestDay = day;
+    if (day > telemetryStats.newestDay)
+      telemetryStats.newestDay = day;
+    file.close();
+    file = dir.openNextFile();
+  }
+  dir.close();
+
+  Serial.printf("[TLM] %lu samples in %lu bytes (%lu blocks)\n",
+                (unsigned long)telemetryStats.samples,
+                (unsigned long)telemetryStats.bytes,
+                (unsigned long)telemetryStats.blocks);
+}
+
+String getTelemetryStatsJSON() {
+  const TelemetryStats &s = telemetryStats;
+  uint32_t days =
+      s.oldestDay ? s.newestDay - s.oldestDay + 1 : 0;
+  uint32_t raw = s.samples * 8; // 4-byte time + 4-byte value
+  String json = "{";
+  json += "\"mounted\":" + String(s.mounted ? "true" : "false") + ",";
+  json += "\"samples\":" + String(s.samples) + ",";
+  json += "\"blocks\":" + String(s.blocks) + ",";
+  json += "\"bytes\":" + String(s.bytes) + ",";
+  json += "\"rawBytes\":" + String(raw) + ",";
+  json += "\"ratio\":" + String(s.bytes ? (float)raw / s.bytes : 0.0f, 2) + ",";
+  json += "\"days\":" + String(days) + ",";
+  json += "\"bytesPerDay\":" + String(days ? s.bytes / days : 0) + ",";
+  json += "\"oldest\":" + String(s.oldestDay * 86400UL) + ",";
+  json += "\"newest\":" + String(s.oldestDay ? s.newestDay * 86400UL + 86399 : 0) + ",";
+  json += "\"pending\":" + String(telemetryBlock.count) + ",";
+  json += "\"budget\":" + String((unsigned long)TELEMETRY_MAX_BYTES) + ",";
+  json += "\"fsTotal\":" + String(s.mounted ? (unsigned long)LittleFS.totalBytes() : 0UL) + ",";
+  json += "\"fsUsed\":" + String(s.mounted ? (unsigned long)LittleFS.usedBytes() : 0UL) + ",";
+  json += "\"writeErrors\":" + String(s.writeErrors);
+  json += "}";
+  return json;
+}
+
+// ---- range query -----------------------------------------------------------
+
+// Position of a streaming query. Each chunk re-reads one block and skips the
+// samples already sent, so memory stays at one block however long the range.
+struct TelemetryCursor {
+  uint32_t from;
+  uint32_t to;
+  uint32_t day;
+  uint32_t lastDay;
+  uint32_t offset;
+  uint16_t sample;
+  bool csv;
+  bool started;
+  bool first;
+  bool done;
+};
+
+static void telemetryWriteRow(ChunkWriter &w, const TelemetryCursor &c,
+                              uint32_t t, const HistorySample &s) {
+  unsigned light = (s.light * 100 + 127) / 255;
+  unsigned switched = (s.flags & HISTORY_SWITCHED) ? 1 : 0;
+  if (c.csv) {
+    chunkPrintf(w, "%lu,%u,%u,%u,%u\n", (unsigned long)t, light,
+                (unsigned)s.fanDuty, (unsigned)s.fanSpeed, switched);
+  } else {
+    chunkPrintf(w, "%s[%lu,%u,%u,%u,%u]", c.first ? "" : ",",
+                (unsigned long)t, light, (unsigned)s.fanDuty,
+                (unsigned)s.fanSpeed, switched);
+  }
+}
+
+// Fills one chunk. Returns the bytes written; 0 once the query is finished.
+size_t telemetryFill(TelemetryCursor &c, uint8_t *buffer, size_t maxLen) {
+  ChunkWriter w = {(char *)buffer, maxLen, 0, 0, 0, false};
+  if (c.done)
+    return 0;
+
+  if (!c.started) {
+    if (c.csv) {
+      chunkPrintf(w, "time,light,fanDuty,fan,switched\n");
+    } else {
+      chunkPrintf(w,
+                  "{\"from\":%lu,\"to\":%lu,"
+                  "\"fields\":[\"t\",\"light\",\"fanDuty\",\"fan\",\"switched\"],"
+                  "\"samples\":[",
+                  (unsigned long)c.from, (unsigned long)c.to);
+    }
+    if (w.full)
+      return 0;
+    c.started = true;
+  }
+
+  static uint8_t payload[TELEMETRY_BLOCK_BYTES];
+  uint8_t header[TELEMETRY_HEADER_SIZE];
+  char path[24];
+  while (c.day <= c.lastDay) {
+    telemetryDayPath(path, sizeof(path), c.day);
+    File file = LittleFS.exists(path) ? LittleFS.open(path, "r") : File();
+    if (!file || !telemetryReadBlock(file, c.offset, header, payload)) {
+      if (file)
+        file.close();
+      c.day++;
+      c.offset = 0;
+      c.sample = 0;
+      continue;
+    }
+    file.close();
+
+    uint16_t count = tlmGet16(header + 2);
+    uint32_t t = tlmGet32(header + 8);
+    uint32_t v = tlmGet32(header + 12);
+    TelemetryCodec codec;
+    telemetryCodecStart(codec, t, v);
+    uint16_t pos = 0;
+    for (uint16_t i = 0; i < count; i++) {
+      if (i > 0)
+        telemetryDecode(codec, payload, pos, t, v);
+      if (i < c.sample || t < c.from || t > c.to)
+        continue;
+      telemetryWriteRow(w, c, t, telemetryUnpack(v));
+      if (w.full) {
+        c.sample = i;
+        return w.len;
+      }
+      c.first = false;
+    }
+    c.offset += TELEMETRY_HEADER_SIZE + tlmGet16(header + 4);
+    c.sample = 0;
+  }
+
+  if (!c.csv) {
+    chunkPrintf(w, "]}");
+    if (w.full)
+      return w.len;
+  }
+  c.done = true;
+  return w.len;
+}
+
+// Starts a query of [from, to], clamped to the days on flash so the fill only
+// opens files that can exist: a from=0 query would otherwise probe tens of
+// thousands of missing days. An empty store yields no samples.
+void telemetryCursorStart(TelemetryCursor &c, uint32_t from, uint32_t to) {
+  memset(&c, 0, sizeof(c));
+  const TelemetryStats &s = telemetryStats;
+  if (s.oldestDay != 0) {
+    if (from < s.oldestDay * 86400UL)
+      from = s.oldestDay * 86400UL;
+    if (to > s.newestDay * 86400UL + 86399)
+      to = s.newestDay * 86400UL + 86399;
+  }
+  c.from = from;
+  c.to = to;
+  if (s.oldestDay != 0 && from <= to) {
+    c.day = from / 86400;
+    c.lastDay = to / 86400;
+  } else {
+    c.day = 1; // nothing to read
+    c.lastDay = 0;
+  }
+  c.first = true;
+}
+
+// GET /api/telemetry?from=&to=&format=json|csv -- defaults to the last 7 days.
+void handleTelemetry(AsyncWebServerRequest *request) {
+  if (!telemetryStats.mounted) {
+    request->send(503, "application/json", "{\"error\":\"storage unavailable\"}");
+    return;
+  }
+  time_t now = time(nullptr);
+
+  uint32_t to = request->hasParam("to")
+                   ? request->getParam("to")->value().toInt()
+                   : (uint32_t)now;
+  uint32_t from = request->hasParam("from")
+                      ? request->getParam("from")->value().toInt()
+                      : to - 7 * 86400UL;
+  if (from > to) {
+    request->send(400, "application/json",
+                  "{\"error\":\"from must not be after to\"}");
+    return;
+  }
+  TelemetryCursor c;
+  telemetryCursorStart(c, from, to);
+  c.csv = request->hasParam("format") &&
+          request->getParam("format")->value() == "csv";
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      c.csv ? "text/csv" : "application/json",
+      [c](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+        bool pending = !c.done;
+        size_t len = telemetryFill(c, buffer, maxLen);
+        if (len == 0 && pending && !c.done)
+          return RESPONSE_TRY_AGAIN;
+        return len;
+      });
+  if (c.csv) {
+    response->addHeader("Content-Disposition",
+                        "attachment; filename=\"growtower-telemetry.csv\"");
+  }
+  request->send(response);
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef TIMECACHE_H
+#define TIMECACHE_H
+
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "logger.h"
+#include "nvswear.h"
+#include "persist.h"
+#include "state.h"
+
+#define TIME_CACHE_MAGIC 0x47544331 // "GTC1"
+
+// Survives soft resets (OTA, watchdog, ESP.restart) but not a power cycle.
+struct TimeCacheRTC {
+  uint32_t magic;
+  int32_t epoch;
+  uint32_t check;
+};
+
+RTC_NOINIT_ATTR TimeCacheRTC rtcTimeCache;
+
+TimeSource timeSource = TIME_NONE;
+long timeDriftSeconds = 0; // learned offset added to the NVS epoch at boot
+
+time_t restoredEpoch = 0;
+unsigned long restoredAtMillis = 0;
+bool restoredFromNVS = false;
+
+unsigned long lastTimeCacheRTC = 0;
+unsigned long lastTimeCacheNVS = 0;
+volatile int32_t timeCacheEpoch = 0; // written by the next flush (persist.h)
+volatile bool ntpSyncPending = false;
+
+static uint32_t timeCacheCheck(int32_t epoch) {
+  return TIME_CACHE_MAGIC ^ (uint32_t)epoch ^ 0xA5A5A5A5;
+}
+
+static void onNtpSync(struct timeval *tv) {
+  // Runs in the SNTP/lwIP task: only flag it, the control task does the work.
+  ntpSyncPending = true;
+}
+
+// Schedules `now` for the next flush; savePending() skips it while the NVS
+// write budget is used up.
+void saveTimeCacheNVS(time_t now) {
+  lastTimeCacheNVS = millis();
+  timeCacheEpoch = (int32_t)now;
+  persistMark(PERSIST_TIME_CACHE);
+}
+
+// Called from savePending() in its NVS session.
+void persistTimeCache(WearPreferences &prefs, uint16_t what) {
+  if (what & PERSIST_TIME_CACHE)
+    prefs.putLong("lastEpoch", timeCacheEpoch);
+  if (what & PERSIST_TIME_DRIFT)
+    prefs.putLong("timeDrift", timeDriftSeconds);
+}
+
+void restoreTimeCache() {
+  sntp_set_time_sync_notification_cb(onNtpSync);
+
+  // Apply the timezone now so localtime() is right before NTP is configured.
+  setenv("TZ", getTimezoneString(), 1);
+  tzset();
+
+  if (time(nullptr) > MIN_VALID_EPOCH) {
+    // ESP-IDF keeps the system clock across soft resets.
+    timeSource = TIME_ESTIMATED;
+    Serial.println("[TIME] System clock survived reset");
+    return;
+  }
+
+  preferences.begin("growtower", true);
+  time_t nvsEpoch = preferences.getLong("lastEpoch", 0);
+  timeDriftSeconds = preferences.getLong("timeDrift", 0);
+  preferences.end();
+
+  bool rtcValid = rtcTimeCache.magic == TIME_CACHE_MAGIC &&
+                  rtcTimeCache.check == timeCacheCheck(rtcTimeCache.epoch) &&
+                  rtcTimeCache.epoch > MIN_VALID_EPOCH;
+
+  time_t estimate;
+  if (rtcValid && rtcTimeCache.epoch >= nvsEpoch) {
+    // Refreshed every second, so the only gap is the reboot itself.
+    estimate = rtcTimeCache.epoch + millis() / 1000;
+    restoredFromNVS = false;
+  } else if (nvsEpoch > MIN_VALID_EPOCH) {
+    // Power was lost: assume the usual offline gap learned from past boots.
+    estimate = nvsEpoch + timeDriftSeconds + millis() / 1000;
+    restoredFromNVS = true;
+  } else {
+    Serial.println("[TIME] No cached time available");
+    return;
+  }
+
+  struct timeval tv;
+  tv.tv_sec = estimate;
+  tv.tv_usec = 0;
+  settimeofday(&tv, NULL);
+
+  restoredEpoch = estimate;
+  restoredAtMillis = millis();
+  timeSource = TIME_ESTIMATED;
+  bumpStateVersion();
+
+  Serial.printf("[TIME] Restored from %s cache: %ld (drift %lds)\n",
+                restoredFromNVS ? "NVS" : "RTC", (long)estimate,
+                restoredFromNVS ? timeDriftSeconds : 0L);
+}
+
+void markTimeSynced() {
+  time_t now = time(nullptr);
+
+  if (restoredFromNVS && restoredEpoch > 0) {
+    // Learn how far off the estimate was and fold it into the drift.
+    time_t expected =
+        restoredEpoch + (time_t)((millis() - restoredAtMillis) / 1000);
+    long error = (long)(now - expected);
+    long drift = timeDriftSeconds + error / 4;
+    if (drift < 0)
+      drift = 0;
+    if (drift > MAX_TIME_DRIFT)
+      drift = MAX_TIME_DRIFT;
+    timeDriftSeconds = drift;
+    persistMark(PERSIST_TIME_DRIFT);
+
+    LOGI("TIME", "Estimate was off by %lds, drift now %lds", error,
+         timeDriftSeconds);
+  }
+
+  restoredFromNVS = false;
+  restoredEpoch = 0;
+  timeSource = TIME_SYNCED;
+  saveTimeCacheNVS(now);
+  bumpStateVersion();
+}
+
+// Time set from the browser (/api/time); trusted like an NTP reply.
+void setSystemTime(long epoch) {
+  struct timeval tv;
+  tv.tv_sec = epoch;
+  tv.tv_usec = 0;
+  settimeofday(&tv, NULL);
+  LOGI("TIME", "System time set manually to: %ld", epoch);
+  markTimeSynced();
+}
+
+void updateTimeCache() {
+  if (ntpSyncPending) {
+    ntpSyncPending = false;
+    LOGI("NTP", "Time synchronized");
+    markTimeSynced();
+  }
+
+  time_t now = time(nullptr);
+  if (now <= MIN_VALID_EPOCH)
+    return;
+
+  unsigned long ms = millis();
+  if (ms - lastTimeCacheRTC >= TIME_CACHE_RTC_INTERVAL) {
+    lastTimeCacheRTC = ms;
+    rtcTimeCache.magic = TIME_CACHE_MAGIC;
+    rtcTimeCache.epoch = (int32_t)now;
+    rtcTimeCache.check = timeCacheCheck(rtcTimeCache.epoch);
+  }
+
+  if (ms - lastTimeCacheNVS >= TIME_CACHE_NVS_INTERVAL) {
+    saveTimeCacheNVS(now);
+  }
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "config.h"
+#include "nvswear.h"
+#include "persist.h"
+#include "state.h"
+
+// Light and fan usage, accumulated per phase and per local day. Nothing is
+// sampled: the elapsed time is settled into the counters only when the
+// light, fan duty or phase changes, at day rollover and before saving, so
+// readers add the still-open interval on the fly.
+//
+// Counters are saved as one NVS blob at day rollover, on phase changes and
+// every USAGE_SAVE_INTERVAL (skipped while the NVS write budget is used up,
+// nvswear.h); a power cut loses at most that interval. saveUsage() copies
+// them into usageSaved and leaves the write to the next flush (persist.h).
+
+#define USAGE_VERSION 1
+
+struct UsageCounters {
+  uint64_t lightMs;   // light on time
+  uint64_t fanDutyMs; // fan run time weighted by duty (x255)
+  uint32_t switches;  // light relay transitions
+  uint32_t reserved;
+};
+
+struct UsageStore {
+  uint8_t version;
+  uint8_t reserved[3];
+  int32_t day; // local day number of `today`, 0 if unknown
+  UsageCounters phase[4]; // indexed by PlantPhase, [0] = no phase
+  UsageCounters today;
+  UsageCounters yesterday;
+};
+
+UsageStore usage;
+UsageStore usageSaved; // copy for the next flush, under PersistStateLock
+uint64_t usageSettledMs = 0;
+unsigned long lastUsageSave = 0;
+
+static uint64_t usageNowMs() { return esp_timer_get_time() / 1000; }
+
+// Days since 1970-01-01 for a local calendar date (Howard Hinnant's
+// days_from_civil), so consecutive days differ by one across year ends.
+int32_t usageDayNumber(const struct tm &timeinfo) {
+  int y = timeinfo.tm_year + 1900;
+  int m = timeinfo.tm_mon + 1;
+  int d = timeinfo.tm_mday;
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static void usageAdd(UsageCounters &c, uint64_t ms) {
+  if (isLightOn)
+    c.lightMs += ms;
+  c.fanDutyMs += ms * (uint64_t)currentFanDuty;
+}
+
+// Books the time since the last settle against the current state. Must run
+// before the light, fan duty or phase changes.
+void usageSettle() {
+  uint64_t now = usageNowMs();
+  uint64_t elapsed = now - usageSettledMs;
+  usageSettledMs = now;
+  usageAdd(usage.phase[currentPhase], elapsed);
+  usageAdd(usage.today, elapsed);
+}
+
+// Counter value including the interval that has not been settled yet.
+UsageCounters usageCurrent(const UsageCounters &c, bool open) {
+  UsageCounters out = c;
+  if (open)
+    usageAdd(out, usageNowMs() - usageSettledMs);
+  return out;
+}
+
+void saveUsage() {
+  usageSettle();
+  usage.version = USAGE_VERSION;
+  {
+    PersistStateLock lock;
+    usageSaved = usage;
+  }
+  persistMark(PERSIST_USAGE);
+  lastUsageSave = millis();
+}
+
+// Called from savePending() in its NVS session.
+void persistUsage(WearPreferences &prefs) {
+  UsageStore copy;
+  {
+    PersistStateLock lock;
+    copy = usageSaved;
+  }
+  prefs.putBytes("usage", &copy, sizeof(copy));
+}
+
+void loadUsage() {
+  memset(&usage, 0, sizeof(usage));
+  preferences.begin("growtower", true);
+  if (preferences.getBytesLength("usage") == sizeof(usage)) {
+    preferences.getBytes("usage", &usage, sizeof(usage));
+  }
+  preferences.end();
+  if (usage.version != USAGE_VERSION) {
+    memset(&usage, 0, sizeof(usage));
+  }
+  usageSettledMs = usageNowMs();
+  lastUsageSave = millis();
+}
+
+void usageOnLightSwitch() {
+  usageSettle();
+  usage.phase[currentPhase].switches++;
+  usage.today.switches++;
+}
+
+void usageResetPhase(PlantPhase phase) {
+  usageSettle();
+  memset(&usage.phase[phase], 0, sizeof(UsageCounters));
+}
+
+// Rolls today into yesterday at local midnight and saves periodically.
+void checkUsage(const struct tm &timeinfo) {
+  int32_t day = usageDayNumber(timeinfo);
+  if (day != usage.day) {
+    usageSettle();
+    if (usage.day != 0) {
+      // The open interval straddles midnight; it is booked to the old day.
+      usage.yesterday = usage.day == day - 1 ? usage.today : UsageCounters();
+      memset(&usage.today, 0, sizeof(UsageCounters));
+    }
+    usage.day = day;
+    saveUsage();
+    return;
+  }
+  if (millis() - lastUsageSave >= USAGE_SAVE_INTERVAL) {
+    if (nvsWearAllow("usage"))
+      saveUsage();
+    else
+      lastUsageSave = millis();
+  }
+}
+
+static float usageLightHours(const UsageCounters &c) {
+  return c.lightMs / 3600000.0f;
+}
+
+static float usageFanHours(const UsageCounters &c) {
+  return c.fanDutyMs / (3600000.0f * MAX_DUTY_CYCLE);
+}
+
+// Changes whenever a value shown with one decimal changes.
+int usageSignature() {
+  UsageCounters today = usageCurrent(usage.today, true);
+  return (int)(usageLightHours(today) * 10) * 1000000 +
+         (int)(usageFanHours(today) * 10) * 1000 + today.switches % 1000;
+}
+
+String usageCountersJSON(const UsageCounters &c) {
+  return "\"lightHours\":" + String(usageLightHours(c), 1) +
+         ",\"fanHours\":" + String(usageFanHours(c), 1) +
+         ",\"switches\":" + String(c.switches);
+}
+
+// Fields appended to a phase object in getPhaseJSON().
+String getPhaseUsageJSON(PlantPhase phase) {
+  return usageCountersJSON(usageCurrent(usage.phase[phase], phase == currentPhase));
+}
+
+String getUsageJSON() {
+  String json = "\"usage\":{";
+  json += "\"today\":{" + usageCountersJSON(usageCurrent(usage.today, true)) + "},";
+  json += "\"yesterday\":{" + usageCountersJSON(usage.yesterday) + "}";
+  json += "}";
+  return json;
+}
+
+#endif
@@ -2,196 +2,371 @@
 #define WEBSERVER_ROUTES_H
 
 #include <ESPAsyncWebServer.h>
+#include "commands.h"
+#include "controlqueue.h"
 #include "frontend.h"
+#include "logger.h"
+#include "history.h"
+#include "metrics.h"
+#include "nvswear.h"
+#include "persist.h"
+#include "power.h"
+#include "routestats.h"
 #include "state.h"
+#include "statusbin.h"
+#include "telemetry.h"
 
 extern AsyncWebServer server;
 
-extern void addLogEntry(String text);
+extern void addLogEntry(StrView text);
 extern void deleteLogEntry(int index);
 extern void clearLogbook();
 extern String getLogbookJSON();
-extern void saveFanSpeed(int percent);
+extern String getDiagJSON();
 
+static String commandError(const char *param, const char *command, CommandStatus status) {
+    char usage[48];
+    const CommandSpec *spec = findCommand(command);
+    if (spec) commandUsage(*spec, usage, sizeof(usage));
+    return String(param) + ": " + commandStatusText(status) + (spec ? " (" + String(usage) + ")" : "");
+}
+
+static void sendCommandError(AsyncWebServerRequest *request, const String &error) {
+    request->send(400, "application/json", "{\"success\":false,\"error\":\"" + error + "\"}");
+}
+
+// Validates query parameter `param` against registry command `command`.
+// Sends a 400 and returns false if it is missing or invalid.
+static bool checkCommandParam(AsyncWebServerRequest *request, const char *command, const char *param) {
+    if (!request->hasParam(param)) {
+        sendCommandError(request, "Missing " + String(param) + " param");
+        return false;
+    }
+    CommandStatus status = validateCommand(CMD_SRC_HTTP, command, request->getParam(param)->value().c_str());
+    if (status != CMD_OK) {
+        sendCommandError(request, commandError(param, command, status));
+        return false;
+    }
+    return true;
+}
+
+// Runs a registry command with the value of a previously checked parameter.
+static void runCommandParam(AsyncWebServerRequest *request, const char *command, const char *param) {
+    runCommand(CMD_SRC_HTTP, command, request->getParam(param)->value().c_str());
+}
+
+// Reads an optional integer form field for POST /api/config, validated with
+// the range of registry command `command`. Returns false (with `error` set)
+// if the field is present but invalid.
+static bool readConfigInt(AsyncWebServerRequest *request, const char *name,
+                          const char *command, uint8_t field, int &out,
+                          uint8_t &fields, String &error) {
+    if (!request->hasParam(name, true)) return true;
+    String value = request->getParam(name, true)->value();
+    value.trim();
+    const CommandSpec *spec = findCommand(command);
+    CommandArgs args;
+    CommandStatus status = commandParse(*spec, value.c_str(), args);
+    if (status != CMD_OK) {
+        error = commandError(name, command, status);
+        return false;
+    }
+    out = args.value;
+    fields |= field;
+    return true;
+}
+
+int statusLongPollActive = 0;
+
+// Holds /api/status?since=<version> open until the state version moves on or
+// STATUS_LONGPOLL_TIMEOUT expires. The chunked filler keeps returning
+// RESPONSE_TRY_AGAIN, so the wait happens in AsyncTCP's poll callback without
+// blocking the task.
+static void beginStatusLongPoll(AsyncWebServerRequest *request, uint32_t since) {
+    statusLongPollActive++;
+    request->onDisconnect([]() { statusLongPollActive--; });
+
+    unsigned long start = millis();
+    String body;
+    size_t sent = 0;
+    bool ready = false;
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "application/json",
+        [since, start, body, sent, ready](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+            if (!ready) {
+                if (stateVersion == since && millis() - start < STATUS_LONGPOLL_TIMEOUT) {
+                    return RESPONSE_TRY_AGAIN;
+                }
+                body = getStatusJSON();
+                ready = true;
+            }
+            size_t len = body.length() - sent;
+            if (len > maxLen) len = maxLen;
+            memcpy(buffer, body.c_str() + sent, len);
+            sent += len;
+            return len;
+        });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+static void handleStatus(AsyncWebServerRequest *request) {
+    if (request->hasParam("since")) {
+        uint32_t since = strtoul(request->getParam("since")->value().c_str(), NULL, 10);
+        if (since == stateVersion && statusLongPollActive < STATUS_LONGPOLL_MAX) {
+            beginStatusLongPoll(request, since);
+            return;
+        }
+    }
+
+    if (wantsStatusBinary(request)) {
+        sendStatusBinary(request);
+        return;
+    }
+
+    String etag = getStatusETag();
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == etag) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", etag);
+        request->send(response);
+        return;
+    }
+
+    AsyncWebServerResponse *response = request->beginResponse(200, "application/json", getStatusJSON());
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("Vary", "Accept");
+    request->send(response);
+}
+
+// Handlers run in the AsyncTCP task. Anything that changes state goes
+// through a registry command or controlRun(), which run it on the control
+// task (controlqueue.h).
 void initWebServer() {
     if (WiFi.status() != WL_CONNECTED && !isAPMode) {
         Serial.println("[WEB] WiFi not connected and not in AP mode, Web Server disabled");
         return;
     }
 
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+    onRoute("/", HTTP_GET, [](AsyncWebServerRequest *request) {
         request->send_P(200, "text/html", index_html);
     });
 
-    server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(200, "application/json", getStatusJSON());
+    onRoute("/api/status", HTTP_GET, handleStatus);
+
+    onRoute("/api/status.bin", HTTP_GET, sendStatusBinary);
+
+    onRoute("/metrics", HTTP_GET, handleMetrics);
+
+    onRoute("/api/history", HTTP_GET, handleHistory);
+
+    onRoute("/api/telemetry", HTTP_GET, handleTelemetry);
+
+    onRoute("/api/telemetry/stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", getTelemetryStatsJSON());
+    });
+
+    onRoute("/api/nvs", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", getNvsWearJSON());
+    });
+
+    onRoute("/api/persist", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", getPersistJSON());
+    });
+
+    onRoute("/api/power", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", getPowerJSON());
+    });
+
+    onRoute("/api/logs", HTTP_GET, handleLogs);
+
+    onRoute("/api/routes", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (request->hasParam("reset")) {
+            resetRouteStats();
+        }
+        request->send(200, "application/json", getRouteStatsJSON());
+    });
+
+    onRoute("/api/diag", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (request->hasParam("reset")) {
+            diagReset();
+        }
+        request->send(200, "application/json", getDiagJSON());
     });
 
-    server.on("/api/time", HTTP_GET, [](AsyncWebServerRequest *request) {
+    onRoute("/api/time", HTTP_GET, [](AsyncWebServerRequest *request) {
         if (request->hasParam("epoch")) {
             long epoch = request->getParam("epoch")->value().toInt();
-            setSystemTime(epoch);
+            controlRun([](void *arg) { setSystemTime(*(long *)arg); }, &epoch);
             request->send(200, "application/json", "{\"success\":true}");
         } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing epoch param\"}");
+            AsyncWebServerResponse *response = request->beginResponse(200, "application/json", getTimeJSON());
+            response->addHeader("Cache-Control", "no-store");
+            request->send(response);
         }
     });
 
-    server.on("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *request) {
+    onRoute("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *request) {
         if (request->hasParam("ssid", true) && request->hasParam("pass", true)) {
             String ssid = request->getParam("ssid", true)->value();
             String pass = request->getParam("pass", true)->value();
             request->send(200, "application/json", "{\"success\":true,\"message\":\"Saving credentials and rebooting...\"}");
-            delay(500);
-            saveWiFiCredentials(ssid.c_str(), pass.c_str());
+            String *credentials[] = {&ssid, &pass};
+            controlRun([](void *arg) {
+                String **c = (String **)arg;
+                saveWiFiCredentials(c[0]->c_str(), c[1]->c_str());
+            }, credentials);
         } else {
             request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing ssid or pass param\"}");
         }
     });
 
-    server.on("/api/light", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("state")) {
-            int state = request->getParam("state")->value().toInt();
-            setLight(state == 1);
-            request->send(200, "application/json", "{\"success\":true}");
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing state param\"}");
-        }
+    // Single-purpose routes below map their parameters onto registry
+    // commands (commands.h), which own parsing, ranges and the action.
+    onRoute("/api/light", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "LIGHT", "state")) return;
+        runCommandParam(request, "LIGHT", "state");
+        request->send(200, "application/json", "{\"success\":true}");
     });
 
-    server.on("/api/fan", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("speed")) {
-            int speed = request->getParam("speed")->value().toInt();
-            saveFanSpeed(speed);
-            request->send(200, "application/json", "{\"success\":true}");
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing speed param\"}");
-        }
+    onRoute("/api/fan", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "FAN", "speed")) return;
+        runCommandParam(request, "FAN", "speed");
+        request->send(200, "application/json", "{\"success\":true}");
     });
 
-    server.on("/api/fanrange", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("min") && request->hasParam("max")) {
-            int min = request->getParam("min")->value().toInt();
-            int max = request->getParam("max")->value().toInt();
-            saveFanMin(min);
-            saveFanMax(max);
-            request->send(200, "application/json", "{\"success\":true}");
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing params\"}");
-        }
+    onRoute("/api/fanrange", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "FANMIN", "min") || !checkCommandParam(request, "FANMAX", "max")) return;
+        runCommandParam(request, "FANMIN", "min");
+        runCommandParam(request, "FANMAX", "max");
+        request->send(200, "application/json", "{\"success\":true}");
     });
 
-    server.on("/api/timer", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("on") && request->hasParam("duration")) {
-            int on = request->getParam("on")->value().toInt();
-            int duration = request->getParam("duration")->value().toInt();
-            saveLightOnHour(on);
-            saveLightDuration(duration);
-            int offHour = on + duration;
-            if (offHour >= 24) offHour -= 24;
-            request->send(200, "application/json", "{\"success\":true,\"offHour\":" + String(offHour) + "}");
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing params\"}");
-        }
+    onRoute("/api/timer", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "LIGHTON", "on") || !checkCommandParam(request, "LIGHTTIME", "duration")) return;
+        runCommandParam(request, "LIGHTON", "on");
+        runCommandParam(request, "LIGHTTIME", "duration");
+        int offHour = lightOnHour + lightDuration;
+        if (offHour >= 24) offHour -= 24;
+        request->send(200, "application/json", "{\"success\":true,\"offHour\":" + String(offHour) + "}");
     });
 
-    server.on("/api/timerenable", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("enabled")) {
-            int enabled = request->getParam("enabled")->value().toInt();
-            saveTimerEnabled(enabled == 1);
-            request->send(200, "application/json", "{\"success\":true,\"enabled\":" + String(timerEnabled ? "true" : "false") + "}");
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing enabled param\"}");
+    onRoute("/api/timerenable", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "TIMER", "enabled")) return;
+        runCommandParam(request, "TIMER", "enabled");
+        request->send(200, "application/json", "{\"success\":true,\"enabled\":" + String(timerEnabled ? "true" : "false") + "}");
+    });
+
+    onRoute("/api/tz", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "TZ", "mode")) return;
+        runCommandParam(request, "TZ", "mode");
+        request->send(200, "application/json", "{\"success\":true}");
+    });
+
+    // Generic entry point: any non-console registry command.
+    onRoute("/api/command", HTTP_ANY, [](AsyncWebServerRequest *request) {
+        if (!request->hasParam("name")) {
+            sendCommandError(request, "Missing name param");
+            return;
+        }
+        String name = request->getParam("name")->value();
+        const char *value = request->hasParam("value") ? request->getParam("value")->value().c_str() : "";
+        CommandStatus status = validateCommand(CMD_SRC_HTTP, name.c_str(), value);
+        if (status != CMD_OK) {
+            sendCommandError(request, status == CMD_UNKNOWN ? "Unknown command" : commandError("value", name.c_str(), status));
+            return;
         }
+        runCommand(CMD_SRC_HTTP, name.c_str(), value);
+        request->send(200, "application/json", "{\"success\":true}");
     });
 
-    server.on("/api/tz", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("mode")) {
-            int mode = request->getParam("mode")->value().toInt();
-            saveTzMode((TimezoneMode)mode);
-            request->send(200, "application/json", "{\"success\":true}");
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing mode param\"}");
+    onRoute("/api/commands", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", getCommandsJSON());
+    });
+
+    onRoute("/api/config", HTTP_POST, [](AsyncWebServerRequest *request) {
+        ConfigUpdate update = {};
+        int timerEnabledValue = 0;
+        int tzModeValue = 0;
+        String error;
+        bool valid =
+            readConfigInt(request, "fanSpeed", "FAN", CFG_FAN_SPEED, update.fanSpeed, update.fields, error) &&
+            readConfigInt(request, "fanMin", "FANMIN", CFG_FAN_MIN, update.fanMin, update.fields, error) &&
+            readConfigInt(request, "fanMax", "FANMAX", CFG_FAN_MAX, update.fanMax, update.fields, error) &&
+            readConfigInt(request, "lightOn", "LIGHTON", CFG_LIGHT_ON, update.lightOnHour, update.fields, error) &&
+            readConfigInt(request, "lightDuration", "LIGHTTIME", CFG_LIGHT_DURATION, update.lightDuration, update.fields, error) &&
+            readConfigInt(request, "timerEnabled", "TIMER", CFG_TIMER_ENABLED, timerEnabledValue, update.fields, error) &&
+            readConfigInt(request, "tzMode", "TZ", CFG_TZ_MODE, tzModeValue, update.fields, error);
+        if (!valid) {
+            request->send(400, "application/json", "{\"success\":false,\"error\":\"" + error + "\"}");
+            return;
+        }
+        if (update.fields == 0) {
+            request->send(400, "application/json", "{\"success\":false,\"error\":\"No config fields\"}");
+            return;
         }
+        update.timerEnabled = timerEnabledValue == 1;
+        update.tzMode = (TimezoneMode)tzModeValue;
+        controlRun([](void *arg) { applyConfig(*(ConfigUpdate *)arg); }, &update);
+        request->send(200, "application/json", "{\"success\":true,\"status\":" + getStatusJSON() + "}");
     });
 
-    server.on("/api/reset", HTTP_GET, [](AsyncWebServerRequest *request) {
+    onRoute("/api/reset", HTTP_GET, [](AsyncWebServerRequest *request) {
         request->send(200, "application/json", "{\"success\":true,\"message\":\"Resetting to factory defaults...\"}");
-        delay(500);
-        resetAllSettings();
+        persistRequestRestart(PERSIST_RESTART_RESET);
     });
 
-    server.on("/api/hostname", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("name")) {
-            String name = request->getParam("name")->value();
-            saveHostname(name.c_str());
-            request->send(200, "application/json", "{\"success\":true,\"message\":\"Rebooting...\"}");
-            delay(1000);
-            ESP.restart();
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing name param\"}");
-        }
+    onRoute("/api/hostname", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "HOST", "name")) return;
+        runCommandParam(request, "HOST", "name");
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Rebooting...\"}");
+        persistRequestRestart(PERSIST_RESTART_FLUSH);
     });
 
-    server.on("/api/phase", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("phase")) {
-            String phaseStr = request->getParam("phase")->value();
-            phaseStr.toLowerCase();
-            if (phaseStr == "seedling") { setPhase(PHASE_SEEDLING); request->send(200, "application/json", "{\"success\":true,\"phase\":\"seedling\"}"); }
-            else if (phaseStr == "veg") { setPhase(PHASE_VEG); request->send(200, "application/json", "{\"success\":true,\"phase\":\"veg\"}"); }
-            else if (phaseStr == "flower") { setPhase(PHASE_FLOWER); request->send(200, "application/json", "{\"success\":true,\"phase\":\"flower\"}"); }
-            else if (phaseStr == "none" || phaseStr == "reset") { setPhase(PHASE_NONE); request->send(200, "application/json", "{\"success\":true,\"phase\":\"none\"}"); }
-            else { request->send(400, "application/json", "{\"success\":false,\"error\":\"Invalid phase\"}"); }
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing phase param\"}");
-        }
+    onRoute("/api/phase", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "PHASE", "phase")) return;
+        runCommandParam(request, "PHASE", "phase");
+        const char *phaseNames[] = {"none", "seedling", "veg", "flower"};
+        request->send(200, "application/json", "{\"success\":true,\"phase\":\"" + String(phaseNames[currentPhase]) + "\"}");
     });
 
-    server.on("/api/phaseinfo", HTTP_GET, [](AsyncWebServerRequest *request) {
+    onRoute("/api/phaseinfo", HTTP_GET, [](AsyncWebServerRequest *request) {
         String json = "{" + getPhaseJSON() + "}";
         request->send(200, "application/json", json);
     });
 
-    server.on("/api/phasereset", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("phase")) {
-            String phaseStr = request->getParam("phase")->value();
-            phaseStr.toLowerCase();
-            if (phaseStr == "seedling") { resetPhase(PHASE_SEEDLING); request->send(200, "application/json", "{\"success\":true}"); }
-            else if (phaseStr == "veg") { resetPhase(PHASE_VEG); request->send(200, "application/json", "{\"success\":true}"); }
-            else if (phaseStr == "flower") { resetPhase(PHASE_FLOWER); request->send(200, "application/json", "{\"success\":true}"); }
-            else if (phaseStr == "all") { resetPhase(PHASE_SEEDLING); resetPhase(PHASE_VEG); resetPhase(PHASE_FLOWER); request->send(200, "application/json", "{\"success\":true}"); }
-            else { request->send(400, "application/json", "{\"success\":false,\"error\":\"Invalid phase\"}"); }
-        } else {
-            request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing phase param\"}");
-        }
+    onRoute("/api/phasereset", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!checkCommandParam(request, "PHASERESET", "phase")) return;
+        runCommandParam(request, "PHASERESET", "phase");
+        request->send(200, "application/json", "{\"success\":true}");
     });
 
-    server.on("/api/logbook", HTTP_GET, [](AsyncWebServerRequest *request) {
+    onRoute("/api/logbook", HTTP_GET, [](AsyncWebServerRequest *request) {
         request->send(200, "application/json", getLogbookJSON());
     });
 
-    server.on("/api/logbook/add", HTTP_POST, [](AsyncWebServerRequest *request) {
+    onRoute("/api/logbook/add", HTTP_POST, [](AsyncWebServerRequest *request) {
         if (request->hasParam("text", true)) {
             String text = request->getParam("text", true)->value();
-            addLogEntry(text);
+            controlRun([](void *arg) { addLogEntry(*(String *)arg); }, &text);
             request->send(200, "application/json", "{\"success\":true}");
         } else {
             request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing text param\"}");
         }
     });
 
-    server.on("/api/logbook/delete", HTTP_POST, [](AsyncWebServerRequest *request) {
+    onRoute("/api/logbook/delete", HTTP_POST, [](AsyncWebServerRequest *request) {
         if (request->hasParam("index", true)) {
             int index = request->getParam("index", true)->value().toInt();
-            deleteLogEntry(index);
+            controlRun([](void *arg) { deleteLogEntry(*(int *)arg); }, &index);
             request->send(200, "application/json", "{\"success\":true}");
         } else {
             request->send(400, "application/json", "{\"success\":false,\"error\":\"Missing index param\"}");
         }
     });
 
-    server.on("/api/logbook/clear", HTTP_POST, [](AsyncWebServerRequest *request) {
-        clearLogbook();
+    onRoute("/api/logbook/clear", HTTP_POST, [](AsyncWebServerRequest *request) {
+        controlRun([](void *arg) { clearLogbook(); }, NULL);
         request->send(200, "application/json", "{\"success\":true}");
     });
 
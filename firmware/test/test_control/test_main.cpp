@@ -0,0 +1,255 @@
+// control.h against the shims: the fan percent to PWM duty mapping, the light
+// timer across midnight, and setPhase() with the cached day counters.
+//
+//   pio test -e native -f test_control
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "control.h"
+#include "hal_native.h"
+#include "telemetry.h"
+
+static const time_t EPOCH = 1767225600; // 2026-01-01 00:00 UTC
+static const time_t HOUR = 3600;
+static const time_t DAY = 86400;
+
+// What setFan() has to write, worked out independently of map()
+static int expectedDuty(int percent, int minPercent, int maxPercent) {
+  if (percent <= 0)
+    return 0;
+  if (minPercent > maxPercent)
+    minPercent = maxPercent;
+  int mapped = minPercent + (percent - 1) * (maxPercent - minPercent) / 99;
+  return HARDWARE_FAN_MIN_DUTY +
+         mapped * (MAX_DUTY_CYCLE - HARDWARE_FAN_MIN_DUTY) / 100;
+}
+
+void setUp(void) {
+  halSetEpoch(EPOCH);
+  fanMinPercent = 0;
+  fanMaxPercent = 100;
+  currentFanSpeed = 30;
+  currentFanDuty = 0;
+  timerEnabled = true;
+  isLightOn = false;
+  lightOnHour = 10;
+  lightDuration = 12;
+  currentTzMode = TZ_WINTER; // CET-1 all year, no DST step in the way
+  applyTimezone();
+  memset(phases, 0, sizeof(phases));
+  currentPhase = PHASE_NONE;
+  memset(phaseDays, 0, sizeof(phaseDays));
+  totalDays = 0;
+  phaseDaysComputedAt = 0;
+  phaseDaysValidUntil = 0;
+  persistFlush();
+}
+
+void tearDown(void) {}
+
+void test_fan_off_and_full_range(void) {
+  setFan(0);
+  TEST_ASSERT_EQUAL(0, currentFanDuty);
+  TEST_ASSERT_EQUAL_UINT32(0, halLedcDuty(PWM_CHANNEL));
+
+  // 1% is the bottom of the range, not off
+  setFan(1);
+  TEST_ASSERT_EQUAL(HARDWARE_FAN_MIN_DUTY, currentFanDuty);
+  TEST_ASSERT_EQUAL_UINT32(HARDWARE_FAN_MIN_DUTY, halLedcDuty(PWM_CHANNEL));
+
+  setFan(100);
+  TEST_ASSERT_EQUAL(MAX_DUTY_CYCLE, currentFanDuty);
+  TEST_ASSERT_EQUAL_UINT32(MAX_DUTY_CYCLE, halLedcDuty(PWM_CHANNEL));
+
+  for (int p = 0; p <= 100; p++) {
+    setFan(p);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expectedDuty(p, 0, 100), currentFanDuty,
+                                  "percent");
+    TEST_ASSERT_EQUAL_UINT32(currentFanDuty, halLedcDuty(PWM_CHANNEL));
+  }
+}
+
+void test_fan_clamps_out_of_range_percent(void) {
+  setFan(-5);
+  TEST_ASSERT_EQUAL(0, currentFanSpeed);
+  TEST_ASSERT_EQUAL(0, currentFanDuty);
+  setFan(150);
+  TEST_ASSERT_EQUAL(100, currentFanSpeed);
+  TEST_ASSERT_EQUAL(MAX_DUTY_CYCLE, currentFanDuty);
+}
+
+void test_fan_min_max_range(void) {
+  fanMinPercent = 20;
+  fanMaxPercent = 80;
+  setFan(1);
+  TEST_ASSERT_EQUAL(expectedDuty(1, 20, 80), currentFanDuty);
+  setFan(100);
+  TEST_ASSERT_EQUAL(expectedDuty(100, 20, 80), currentFanDuty);
+  int last = 0;
+  for (int p = 1; p <= 100; p++) {
+    setFan(p);
+    TEST_ASSERT_EQUAL(expectedDuty(p, 20, 80), currentFanDuty);
+    TEST_ASSERT_TRUE(currentFanDuty >= last); // monotonic
+    last = currentFanDuty;
+  }
+
+  // A minimum above the maximum collapses to the maximum
+  fanMinPercent = 70;
+  fanMaxPercent = 40;
+  setFan(1);
+  TEST_ASSERT_EQUAL(expectedDuty(1, 40, 40), currentFanDuty);
+  setFan(100);
+  TEST_ASSERT_EQUAL(expectedDuty(100, 40, 40), currentFanDuty);
+}
+
+// Steps the clock an hour at a time from local 12:00 on 1 January and checks
+// the light against the schedule, through midnight into the next day.
+static void runDay(int onHour, int duration) {
+  lightOnHour = onHour;
+  lightDuration = duration;
+  halSetEpoch(EPOCH + 11 * HOUR); // 12:00 CET
+  for (int h = 0; h < 36; h++) {
+    checkTimer();
+    struct tm tm;
+    TEST_ASSERT_TRUE(getLocalTime(&tm, 0));
+    int sinceOn = (tm.tm_hour - onHour + 24) % 24;
+    bool expected = sinceOn < duration;
+    char msg[48];
+    snprintf(msg, sizeof(msg), "%02d:00 on %d for %dh", tm.tm_hour, onHour,
+             duration);
+    TEST_ASSERT_EQUAL_MESSAGE(expected, isLightOn, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(expected ? HIGH : LOW, halPinLevel(LIGHT_PIN),
+                              msg);
+    halAdvanceMs(HOUR * 1000);
+  }
+}
+
+void test_timer_across_midnight(void) {
+  runDay(20, 8); // 20:00 - 04:00
+  runDay(18, 12); // 18:00 - 06:00
+  runDay(23, 1); // 23:00 - 00:00
+}
+
+void test_timer_within_day(void) {
+  runDay(6, 18); // 06:00 - 24:00
+  runDay(0, 12); // 00:00 - 12:00
+}
+
+void test_timer_disabled_leaves_light(void) {
+  lightOnHour = 20;
+  lightDuration = 8;
+  timerEnabled = false;
+  halSetEpoch(EPOCH); // 01:00 CET, inside the on period
+  checkTimer();
+  TEST_ASSERT_FALSE(isLightOn);
+}
+
+void test_timer_needs_time(void) {
+  halSetEpoch(0);
+  lightOnHour = 0;
+  lightDuration = 23;
+  checkTimer();
+  TEST_ASSERT_FALSE(isLightOn);
+}
+
+void test_set_phase_keeps_start(void) {
+  setPhase(PHASE_SEEDLING);
+  TEST_ASSERT_EQUAL(PHASE_SEEDLING, currentPhase);
+  TEST_ASSERT_TRUE(phases[PHASE_SEEDLING].active);
+  TEST_ASSERT_EQUAL(EPOCH, phases[PHASE_SEEDLING].startTime);
+
+  halAdvanceMs(3 * DAY * 1000);
+  setPhase(PHASE_VEG);
+  TEST_ASSERT_EQUAL(PHASE_VEG, currentPhase);
+  TEST_ASSERT_FALSE(phases[PHASE_SEEDLING].active);
+  TEST_ASSERT_TRUE(phases[PHASE_VEG].active);
+  TEST_ASSERT_EQUAL(EPOCH + 3 * DAY, phases[PHASE_VEG].startTime);
+
+  // Going back does not restart the seedling count
+  halAdvanceMs(DAY * 1000);
+  setPhase(PHASE_SEEDLING);
+  TEST_ASSERT_EQUAL(EPOCH, phases[PHASE_SEEDLING].startTime);
+  TEST_ASSERT_EQUAL(EPOCH + 3 * DAY, phases[PHASE_VEG].startTime);
+  TEST_ASSERT_EQUAL(4, phaseDays[PHASE_SEEDLING]);
+  TEST_ASSERT_EQUAL(1, phaseDays[PHASE_VEG]);
+  TEST_ASSERT_EQUAL(5, totalDays);
+
+  setPhase(PHASE_NONE);
+  TEST_ASSERT_EQUAL(PHASE_NONE, currentPhase);
+  for (int p = PHASE_SEEDLING; p <= PHASE_FLOWER; p++)
+    TEST_ASSERT_FALSE(phases[p].active);
+  TEST_ASSERT_EQUAL(EPOCH, phases[PHASE_SEEDLING].startTime);
+}
+
+void test_set_phase_needs_time(void) {
+  halSetEpoch(0);
+  setPhase(PHASE_VEG);
+  TEST_ASSERT_EQUAL(PHASE_NONE, currentPhase);
+  TEST_ASSERT_EQUAL(0, phases[PHASE_VEG].startTime);
+}
+
+void test_phase_days_cache(void) {
+  setPhase(PHASE_VEG);
+  TEST_ASSERT_EQUAL(0, phaseDays[PHASE_VEG]);
+  TEST_ASSERT_EQUAL(EPOCH, phaseDaysComputedAt);
+  TEST_ASSERT_EQUAL(EPOCH + DAY, phaseDaysValidUntil);
+
+  // The cache is not recomputed before it expires...
+  struct tm tm;
+  halAdvanceMs((DAY - 1) * 1000);
+  TEST_ASSERT_TRUE(getLocalTime(&tm, 0));
+  uint32_t version = stateVersion;
+  checkDayRollover(tm);
+  TEST_ASSERT_EQUAL(0, phaseDays[PHASE_VEG]);
+  TEST_ASSERT_EQUAL(EPOCH, phaseDaysComputedAt);
+
+  // ...and rolls over on the second the day completes
+  halAdvanceMs(1000);
+  TEST_ASSERT_TRUE(getLocalTime(&tm, 0));
+  checkDayRollover(tm);
+  TEST_ASSERT_EQUAL(1, phaseDays[PHASE_VEG]);
+  TEST_ASSERT_EQUAL(1, totalDays);
+  TEST_ASSERT_EQUAL(EPOCH + 2 * DAY, phaseDaysValidUntil);
+  TEST_ASSERT_TRUE(stateVersion != version); // the ETag moves
+
+  // The earliest boundary of several running counts wins
+  halAdvanceMs(6 * HOUR * 1000);
+  setPhase(PHASE_FLOWER);
+  TEST_ASSERT_EQUAL(EPOCH + DAY + 6 * HOUR, phases[PHASE_FLOWER].startTime);
+  TEST_ASSERT_EQUAL(EPOCH + 2 * DAY, phaseDaysValidUntil);
+  halAdvanceMs(DAY * 1000);
+  refreshPhaseDays();
+  TEST_ASSERT_EQUAL(2, phaseDays[PHASE_VEG]);
+  TEST_ASSERT_EQUAL(1, phaseDays[PHASE_FLOWER]);
+  TEST_ASSERT_EQUAL(3, totalDays);
+  TEST_ASSERT_EQUAL(EPOCH + 3 * DAY, phaseDaysValidUntil);
+
+  // A clock set back recomputes at once
+  halSetEpoch(EPOCH + DAY);
+  TEST_ASSERT_TRUE(getLocalTime(&tm, 0));
+  checkDayRollover(tm);
+  TEST_ASSERT_EQUAL(1, phaseDays[PHASE_VEG]);
+  TEST_ASSERT_EQUAL(0, phaseDays[PHASE_FLOWER]);
+  TEST_ASSERT_EQUAL(EPOCH + DAY, phaseDaysComputedAt);
+}
+
+int main(int argc, char **argv) {
+  halSerialQuiet(true);
+  initLogger();
+  initTelemetry();
+  pinMode(LIGHT_PIN, OUTPUT);
+  initPWM();
+  UNITY_BEGIN();
+  RUN_TEST(test_fan_off_and_full_range);
+  RUN_TEST(test_fan_clamps_out_of_range_percent);
+  RUN_TEST(test_fan_min_max_range);
+  RUN_TEST(test_timer_across_midnight);
+  RUN_TEST(test_timer_within_day);
+  RUN_TEST(test_timer_disabled_leaves_light);
+  RUN_TEST(test_timer_needs_time);
+  RUN_TEST(test_set_phase_keeps_start);
+  RUN_TEST(test_set_phase_needs_time);
+  RUN_TEST(test_phase_days_cache);
+  return UNITY_END();
+}
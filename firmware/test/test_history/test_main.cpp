@@ -0,0 +1,158 @@
+// /api/history streaming (history.h): a query sent in small chunks has to
+// return every slot once, also when minutes close while it is being sent.
+//
+//   pio test -e native -f test_history
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <string>
+
+#include "control.h"
+#include "hal_native.h"
+#include "history.h"
+#include "telemetry.h"
+
+static const uint32_t EPOCH = 1767225600; // 2026-01-01 00:00 UTC
+
+// Runs historyTick() once a second up to `until`, the fan setting following
+// the minute so every slot is recognisable.
+static uint32_t clock_ = EPOCH;
+
+static void runUntil(uint32_t until) {
+  for (; clock_ < until; clock_++) {
+    currentFanSpeed = (clock_ / 60) % 100;
+    historyTick(clock_);
+  }
+}
+
+static HistoryCursor cursor(uint32_t from, uint32_t to) {
+  HistoryCursor c;
+  memset(&c, 0, sizeof(c));
+  c.tier = HISTORY_TIER_MINUTE;
+  c.from = from;
+  c.to = to;
+  c.first = true;
+  return c;
+}
+
+// Times of the rows in a rendered document, checked to be strictly rising.
+static int rowTimes(const std::string &json, uint32_t *times, int max) {
+  int n = 0;
+  size_t pos = json.find("\"samples\":[");
+  TEST_ASSERT_TRUE(pos != std::string::npos);
+  pos += 10; // at the '[' of the array
+  while ((pos = json.find('[', pos + 1)) != std::string::npos && n < max) {
+    times[n] = strtoul(json.c_str() + pos + 1, NULL, 10);
+    if (n > 0)
+      TEST_ASSERT_TRUE(times[n] > times[n - 1]);
+    n++;
+  }
+  return n;
+}
+
+void setUp(void) {
+  clock_ = EPOCH;
+  for (int t = 0; t < HISTORY_TIERS; t++) {
+    historyTiers[t].head = 0;
+    historyTiers[t].count = 0;
+    historyTiers[t].headTime = 0;
+  }
+  memset(historyAccums, 0, sizeof(historyAccums));
+  historyLastTick = 0;
+}
+
+void tearDown(void) {}
+
+void test_full_ring_in_small_chunks(void) {
+  runUntil(EPOCH + (HISTORY_MINUTE_SLOTS + 10) * 60 + 1);
+  TEST_ASSERT_EQUAL(HISTORY_MINUTE_SLOTS,
+                    historyTiers[HISTORY_TIER_MINUTE].count);
+
+  HistoryCursor c = cursor(0, 0xFFFFFFFF);
+  std::string json;
+  uint8_t chunk[160]; // the header only just fits
+  for (int guard = 0; guard < 100000 && !c.done; guard++) {
+    size_t len = historyFill(c, chunk, sizeof(chunk));
+    json.append((const char *)chunk, len);
+  }
+  TEST_ASSERT_TRUE(c.done);
+  TEST_ASSERT_EQUAL_STRING("]}", json.c_str() + json.size() - 2);
+
+  static uint32_t times[HISTORY_MINUTE_SLOTS + 1];
+  int n = rowTimes(json, times, HISTORY_MINUTE_SLOTS + 1);
+  TEST_ASSERT_EQUAL(HISTORY_MINUTE_SLOTS, n);
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + 10 * 60, times[0]);
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + (HISTORY_MINUTE_SLOTS + 9) * 60,
+                           times[n - 1]);
+}
+
+// The ring wraps between chunks: the rows already sent stay sent, the
+// following ones come out without a gap, and the new minutes are appended.
+void test_minutes_closing_during_response(void) {
+  runUntil(EPOCH + (HISTORY_MINUTE_SLOTS + 10) * 60 + 1);
+
+  HistoryCursor c = cursor(0, 0xFFFFFFFF);
+  std::string json;
+  uint8_t chunk[200];
+  for (int guard = 0; guard < 100000 && !c.done; guard++) {
+    size_t len = historyFill(c, chunk, sizeof(chunk));
+    json.append((const char *)chunk, len);
+    if (guard % 20 == 5)
+      runUntil(clock_ + 60); // one more minute closes
+  }
+  TEST_ASSERT_TRUE(c.done);
+
+  static uint32_t times[2 * HISTORY_MINUTE_SLOTS];
+  int n = rowTimes(json, times, 2 * HISTORY_MINUTE_SLOTS);
+  TEST_ASSERT_TRUE(n > HISTORY_MINUTE_SLOTS);
+  for (int i = 1; i < n; i++) {
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(times[i - 1] + 60, times[i], "gap");
+  }
+  const HistoryTier &tier = historyTiers[HISTORY_TIER_MINUTE];
+  TEST_ASSERT_EQUAL_UINT32(tier.headTime, times[n - 1]);
+}
+
+void test_window_and_invalid_slots(void) {
+  runUntil(EPOCH + 30 * 60 + 1);
+  clock_ += 10 * 60; // power gap: minutes 31-39 stay invalid
+  runUntil(clock_ + 20 * 60 + 1);
+
+  HistoryCursor c = cursor(EPOCH + 25 * 60, EPOCH + 45 * 60);
+  std::string json;
+  uint8_t chunk[200];
+  for (int guard = 0; guard < 1000 && !c.done; guard++) {
+    size_t len = historyFill(c, chunk, sizeof(chunk));
+    json.append((const char *)chunk, len);
+  }
+  uint32_t times[32];
+  int n = rowTimes(json, times, 32);
+  // 25..30 before the gap, 40..45 after it
+  TEST_ASSERT_EQUAL(6 + 6, n);
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + 25 * 60, times[0]);
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + 30 * 60, times[5]);
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + 40 * 60, times[6]);
+  TEST_ASSERT_EQUAL_UINT32(EPOCH + 45 * 60, times[n - 1]);
+}
+
+void test_empty_ring(void) {
+  HistoryCursor c = cursor(0, 0xFFFFFFFF);
+  uint8_t chunk[200];
+  size_t len = historyFill(c, chunk, sizeof(chunk));
+  TEST_ASSERT_TRUE(c.done);
+  std::string json((const char *)chunk, len);
+  TEST_ASSERT_EQUAL_STRING("[]}", json.c_str() + json.size() - 3);
+  TEST_ASSERT_EQUAL(0, historyFill(c, chunk, sizeof(chunk)));
+}
+
+int main(int argc, char **argv) {
+  halSerialQuiet(true);
+  initLogger();
+  initTelemetry();
+  UNITY_BEGIN();
+  RUN_TEST(test_full_ring_in_small_chunks);
+  RUN_TEST(test_minutes_closing_during_response);
+  RUN_TEST(test_window_and_invalid_slots);
+  RUN_TEST(test_empty_ring);
+  return UNITY_END();
+}
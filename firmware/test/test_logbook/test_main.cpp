@@ -0,0 +1,167 @@
+// Logbook save/load through the two-slot LittleFS record (persist.h): what
+// saveLogbook() writes, loadLogbook() has to give back entry for entry.
+//
+//   pio test -e native -f test_logbook
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "control.h"
+#include "hal_native.h"
+#include "logbook.h"
+#include "telemetry.h"
+
+static const time_t EPOCH = 1767225600; // 2026-01-01 00:00 UTC
+
+struct SavedEntry {
+  time_t timestamp;
+  char text[MAX_LOG_TEXT_LENGTH + 1];
+};
+
+static SavedEntry saved[MAX_LOG_ENTRIES];
+static int savedCount;
+
+static void remember() {
+  savedCount = logEntryCount;
+  for (int i = 0; i < logEntryCount; i++) {
+    saved[i].timestamp = logEntries[i].timestamp;
+    strcpy(saved[i].text, logEntries[i].text.c_str());
+  }
+}
+
+// Writes the logbook, forgets it like a reboot does and reads it back.
+static void saveAndReload() {
+  persistFlush();
+  remember();
+  for (int i = 0; i < MAX_LOG_ENTRIES; i++) {
+    logEntries[i].timestamp = 0;
+    logEntries[i].text = "";
+  }
+  logEntryCount = 0;
+  loadLogbook();
+}
+
+static void assertReloaded() {
+  TEST_ASSERT_EQUAL(savedCount, logEntryCount);
+  for (int i = 0; i < savedCount; i++) {
+    TEST_ASSERT_EQUAL(saved[i].timestamp, logEntries[i].timestamp);
+    TEST_ASSERT_EQUAL_STRING(saved[i].text, logEntries[i].text.c_str());
+  }
+}
+
+void setUp(void) {
+  halSetEpoch(EPOCH);
+  logEntryCount = 0;
+  clearLogbook();
+  persistFlush();
+}
+
+void tearDown(void) {}
+
+void test_empty_round_trip(void) {
+  saveAndReload();
+  TEST_ASSERT_EQUAL(0, logEntryCount);
+}
+
+void test_entries_round_trip_newest_first(void) {
+  addLogEntry("Germinated");
+  halAdvanceMs(3600 * 1000);
+  addLogEntry("  Repotted, 1.5 l  "); // trimmed
+  halAdvanceMs(86400 * 1000);
+  addLogEntry("pH 6.2 \"tap\" water; EC 0.8");
+  TEST_ASSERT_EQUAL(3, logEntryCount);
+  TEST_ASSERT_EQUAL_STRING("Repotted, 1.5 l", logEntries[1].text.c_str());
+
+  saveAndReload();
+  assertReloaded();
+  TEST_ASSERT_EQUAL_STRING("pH 6.2 \"tap\" water; EC 0.8",
+                           logEntries[0].text.c_str());
+  TEST_ASSERT_EQUAL(EPOCH + 3600 + 86400, logEntries[0].timestamp);
+  TEST_ASSERT_EQUAL_STRING("Germinated", logEntries[2].text.c_str());
+  TEST_ASSERT_EQUAL(EPOCH, logEntries[2].timestamp);
+}
+
+void test_long_text_truncated(void) {
+  char text[MAX_LOG_TEXT_LENGTH + 51];
+  for (int i = 0; i < (int)sizeof(text) - 1; i++)
+    text[i] = 'a' + i % 26;
+  text[sizeof(text) - 1] = '\0';
+  addLogEntry(text);
+  TEST_ASSERT_EQUAL(MAX_LOG_TEXT_LENGTH, logEntries[0].text.length());
+
+  saveAndReload();
+  assertReloaded();
+  TEST_ASSERT_EQUAL(MAX_LOG_TEXT_LENGTH, logEntries[0].text.length());
+  TEST_ASSERT_EQUAL(0, strncmp(text, logEntries[0].text.c_str(),
+                               MAX_LOG_TEXT_LENGTH));
+}
+
+void test_full_logbook_round_trip(void) {
+  char text[32];
+  for (int i = 0; i < MAX_LOG_ENTRIES + 5; i++) {
+    snprintf(text, sizeof(text), "note %d", i);
+    addLogEntry(text);
+    halAdvanceMs(60 * 1000);
+  }
+  TEST_ASSERT_EQUAL(MAX_LOG_ENTRIES, logEntryCount);
+  // The oldest five dropped out
+  snprintf(text, sizeof(text), "note %d", MAX_LOG_ENTRIES + 4);
+  TEST_ASSERT_EQUAL_STRING(text, logEntries[0].text.c_str());
+  TEST_ASSERT_EQUAL_STRING("note 5",
+                           logEntries[MAX_LOG_ENTRIES - 1].text.c_str());
+
+  saveAndReload();
+  assertReloaded();
+}
+
+void test_delete_and_clear_round_trip(void) {
+  addLogEntry("one");
+  addLogEntry("two");
+  addLogEntry("three");
+  deleteLogEntry(1); // "two"
+  deleteLogEntry(7); // out of range, ignored
+  saveAndReload();
+  assertReloaded();
+  TEST_ASSERT_EQUAL(2, logEntryCount);
+  TEST_ASSERT_EQUAL_STRING("three", logEntries[0].text.c_str());
+  TEST_ASSERT_EQUAL_STRING("one", logEntries[1].text.c_str());
+
+  clearLogbook();
+  saveAndReload();
+  TEST_ASSERT_EQUAL(0, logEntryCount);
+}
+
+// Each save goes to the other slot; the newer one has to win on load.
+void test_latest_save_wins(void) {
+  addLogEntry("first");
+  persistFlush();
+  addLogEntry("second");
+  persistFlush();
+  addLogEntry("third");
+  saveAndReload();
+  assertReloaded();
+  TEST_ASSERT_EQUAL(3, logEntryCount);
+}
+
+void test_needs_time(void) {
+  halSetEpoch(0);
+  addLogEntry("no clock");
+  TEST_ASSERT_EQUAL(0, logEntryCount);
+  addLogEntry("   ");
+  TEST_ASSERT_EQUAL(0, logEntryCount);
+}
+
+int main(int argc, char **argv) {
+  halSerialQuiet(true);
+  initLogger();
+  initTelemetry();
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_round_trip);
+  RUN_TEST(test_entries_round_trip_newest_first);
+  RUN_TEST(test_long_text_truncated);
+  RUN_TEST(test_full_logbook_round_trip);
+  RUN_TEST(test_delete_and_clear_round_trip);
+  RUN_TEST(test_latest_save_wins);
+  RUN_TEST(test_needs_time);
+  return UNITY_END();
+}
@@ -0,0 +1,211 @@
+// encodeStatusBinary() against the layout table in statusbin.h and the
+// struct format scripts/decode_status_bin.py unpacks it with.
+//
+//   pio test -e native -f test_statusbin
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "hal_native.h"
+#include "status.h"
+#include "statusbin.h"
+#include "timecache.h"
+
+bool isAPMode = false;
+
+// Relative to the project directory, where `pio test` runs the program
+static const char *DECODER = "../scripts/decode_status_bin.py";
+
+// Offset of every field in the statusbin.h table, in order
+static const int fieldOffsets[] = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,
+                                   10, 12, 14, 16, 18, 22, 26, 30, 31};
+#define FIELD_COUNT (int)(sizeof(fieldOffsets) / sizeof(fieldOffsets[0]))
+
+static uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// A state with a distinct value in every field; veg days above 255 so the
+// high byte of a 16-bit field is exercised.
+static void setKnownState() {
+  halSetEpoch(1767225600); // 2026-01-01 00:00 UTC
+  halWiFiConnected(true);
+  isAPMode = false;
+  timeSource = TIME_SYNCED;
+  isLightOn = true;
+  timerEnabled = true;
+  currentFanSpeed = 42;
+  fanMinPercent = 20;
+  fanMaxPercent = 90;
+  lightOnHour = 6;
+  lightDuration = 18;
+  currentTzMode = TZ_SUMMER;
+  currentPhase = PHASE_VEG;
+  memset(phases, 0, sizeof(phases));
+  phases[PHASE_SEEDLING].active = true;
+  phases[PHASE_VEG].active = true;
+  phaseDays[PHASE_SEEDLING] = 14;
+  phaseDays[PHASE_VEG] = 300;
+  phaseDays[PHASE_FLOWER] = 0;
+  totalDays = 314;
+  stateVersion = 0x01020304;
+  currentFanDuty = 107;
+}
+
+void setUp(void) { setKnownState(); }
+
+void tearDown(void) {}
+
+void test_fields_at_documented_offsets(void) {
+  uint8_t buf[STATUS_BIN_SIZE + 1];
+  memset(buf, 0xAA, sizeof(buf));
+  TEST_ASSERT_EQUAL(32, encodeStatusBinary(buf));
+  TEST_ASSERT_EQUAL_HEX8(0xAA, buf[STATUS_BIN_SIZE]); // no overrun
+
+  TEST_ASSERT_EQUAL(STATUS_BIN_VERSION, buf[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x0F, buf[1]); // light, timer, WiFi, time
+  TEST_ASSERT_EQUAL(42, buf[2]);
+  TEST_ASSERT_EQUAL(20, buf[3]);
+  TEST_ASSERT_EQUAL(90, buf[4]);
+  TEST_ASSERT_EQUAL(6, buf[5]);
+  TEST_ASSERT_EQUAL(18, buf[6]);
+  TEST_ASSERT_EQUAL(TZ_SUMMER, buf[7]);
+  TEST_ASSERT_EQUAL(PHASE_VEG, buf[8]);
+  TEST_ASSERT_EQUAL_HEX8(0x03, buf[9]);
+  TEST_ASSERT_EQUAL(314, get16(buf + 10));
+  TEST_ASSERT_EQUAL(14, get16(buf + 12));
+  TEST_ASSERT_EQUAL(300, get16(buf + 14));
+  TEST_ASSERT_EQUAL(0, get16(buf + 16));
+  TEST_ASSERT_EQUAL_UINT32(0x01020304, get32(buf + 18));
+  TEST_ASSERT_EQUAL_UINT32(1767225600, get32(buf + 22));
+  const uint8_t ip[4] = {192, 168, 1, 50};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(ip, buf + 26, 4);
+  TEST_ASSERT_EQUAL(107, buf[30]);
+  TEST_ASSERT_EQUAL(0, buf[31]);
+}
+
+void test_flags_without_wifi_and_time(void) {
+  halWiFiConnected(false);
+  isAPMode = true;
+  halSetEpoch(0);
+  timeSource = TIME_NONE;
+  isLightOn = false;
+  uint8_t buf[STATUS_BIN_SIZE];
+  encodeStatusBinary(buf);
+  TEST_ASSERT_EQUAL_HEX8(0x22, buf[1]); // timer, AP mode
+  TEST_ASSERT_EQUAL_UINT32(0, get32(buf + 22));
+  const uint8_t ip[4] = {192, 168, 4, 1};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(ip, buf + 26, 4);
+}
+
+// Reads STATUS_BIN_FORMAT out of the decoder, so a change on either side
+// without the other fails here.
+static bool readPythonFormat(char *out, size_t len) {
+  FILE *f = fopen(DECODER, "r");
+  if (f == NULL)
+    return false;
+  char line[160];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), f) != NULL) {
+    found = sscanf(line, "STATUS_BIN_FORMAT = \"%79[^\"]\"", out) == 1;
+  }
+  fclose(f);
+  return found && strlen(out) < len;
+}
+
+void test_python_format_matches_offsets(void) {
+  char format[80];
+  if (!readPythonFormat(format, sizeof(format)))
+    TEST_IGNORE_MESSAGE("scripts/decode_status_bin.py not found");
+  TEST_ASSERT_EQUAL('<', format[0]); // little-endian, no padding
+
+  // struct module rules: a count before B/H/I repeats the field, before s
+  // it is the length of one field
+  int offset = 0;
+  int field = 0;
+  for (const char *p = format + 1; *p;) {
+    int count = 0;
+    while (*p >= '0' && *p <= '9')
+      count = count * 10 + (*p++ - '0');
+    if (count == 0)
+      count = 1;
+    char code = *p++;
+    int size = code == 'B' ? 1 : code == 'H' ? 2 : code == 'I' ? 4 : 0;
+    if (code == 's') {
+      TEST_ASSERT_TRUE(field < FIELD_COUNT);
+      TEST_ASSERT_EQUAL_INT_MESSAGE(fieldOffsets[field], offset, format);
+      field++;
+      offset += count;
+      continue;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(size > 0, format);
+    for (int i = 0; i < count; i++) {
+      TEST_ASSERT_TRUE(field < FIELD_COUNT);
+      TEST_ASSERT_EQUAL_INT_MESSAGE(fieldOffsets[field], offset, format);
+      field++;
+      offset += size;
+    }
+  }
+  TEST_ASSERT_EQUAL(FIELD_COUNT, field);
+  TEST_ASSERT_EQUAL(STATUS_BIN_SIZE, offset);
+}
+
+// Encodes here, decodes with the script.
+void test_python_decodes_payload(void) {
+  FILE *probe = fopen(DECODER, "r");
+  if (probe == NULL)
+    TEST_IGNORE_MESSAGE("scripts/decode_status_bin.py not found");
+  fclose(probe);
+
+  uint8_t buf[STATUS_BIN_SIZE];
+  encodeStatusBinary(buf);
+  char path[] = "/tmp/statusbinXXXXXX";
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  TEST_ASSERT_EQUAL(STATUS_BIN_SIZE, write(fd, buf, sizeof(buf)));
+  close(fd);
+
+  char cmd[160];
+  snprintf(cmd, sizeof(cmd), "python3 %s --file %s 2>&1", DECODER, path);
+  FILE *p = popen(cmd, "r");
+  TEST_ASSERT_NOT_NULL(p);
+  static char out[2048];
+  size_t n = fread(out, 1, sizeof(out) - 1, p);
+  out[n] = '\0';
+  int rc = pclose(p);
+  unlink(path);
+  if (WEXITSTATUS(rc) == 127)
+    TEST_IGNORE_MESSAGE("python3 not available");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(0, WEXITSTATUS(rc), out);
+
+  const char *expected[] = {
+      "\"version\": 16909060", "\"light\": true",
+      "\"timerEnabled\": true", "\"fan\": 42",
+      "\"fanMin\": 20",         "\"fanMax\": 90",
+      "\"fanDuty\": 107",       "\"lightOn\": 6",
+      "\"lightDuration\": 18",  "\"tzMode\": \"summer\"",
+      "\"phase\": \"veg\"",     "\"days\": 300",
+      "\"totalDays\": 314",     "\"epoch\": 1767225600",
+      "\"ip\": \"192.168.1.50\"",
+  };
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    TEST_ASSERT_TRUE_MESSAGE(strstr(out, expected[i]) != NULL, expected[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  halSerialQuiet(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_fields_at_documented_offsets);
+  RUN_TEST(test_flags_without_wifi_and_time);
+  RUN_TEST(test_python_format_matches_offsets);
+  RUN_TEST(test_python_decodes_payload);
+  return UNITY_END();
+}
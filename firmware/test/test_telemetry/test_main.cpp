@@ -0,0 +1,230 @@
+// Telemetry codec and store: C++ round trip, the C++ day file decoded by
+// scripts/telemetry_codec.py, and the query range clamp.
+//
+//   pio test -e native -f test_telemetry
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "control.h"
+#include "hal_native.h"
+#include "telemetry.h"
+
+// Relative to the project directory, where `pio test` runs the program
+static const char *CODEC = "../scripts/telemetry_codec.py";
+
+static const uint32_t DAY = 20454; // 2026-01-01
+static const int TRACE_SAMPLES = 600;
+
+static uint32_t rng = 1;
+
+static uint32_t nextRandom() {
+  rng = rng * 1103515245 + 12345;
+  return rng >> 16;
+}
+
+// Ten hours of one day: minute steps with the odd jittered second, two
+// outages, light switches and fan changes.
+static int makeTrace(uint32_t *times, HistorySample *samples) {
+  rng = 1;
+  uint32_t t = DAY * 86400 + 6 * 3600;
+  uint8_t fan = 40;
+  for (int i = 0; i < TRACE_SAMPLES; i++) {
+    if (i == 200)
+      t += 37 * 60; // outage: 12-bit delta-of-delta
+    if (i == 400)
+      t += 2 * 3600 + 17; // long outage: 32-bit
+    bool on = (i / 90) % 2 == 0;
+    if (nextRandom() % 50 == 0)
+      fan = 20 + nextRandom() % 61;
+    HistorySample &s = samples[i];
+    s.light = on ? 255 : (i % 90 == 0 ? 128 : 0);
+    s.fanSpeed = fan;
+    s.fanDuty = on ? fan * 255 / 100 : fan * 255 / 200;
+    s.flags = i % 90 == 0 ? HISTORY_SWITCHED : 0;
+    times[i] = t;
+    t += 60;
+    if (nextRandom() % 100 == 0)
+      t += nextRandom() % 2 ? 1 : -1;
+  }
+  return TRACE_SAMPLES;
+}
+
+static uint32_t traceTimes[TRACE_SAMPLES];
+static HistorySample traceSamples[TRACE_SAMPLES];
+
+static void storeTrace() {
+  int n = makeTrace(traceTimes, traceSamples);
+  for (int i = 0; i < n; i++) {
+    telemetryAppend(traceTimes[i], traceSamples[i]);
+    telemetryWriteSealed(); // what the persistence task does
+  }
+  telemetrySeal();
+  telemetryWriteSealed();
+}
+
+// Runs a query to the end, like the chunked response with small chunks.
+static std::string query(uint32_t from, uint32_t to, bool csv) {
+  TelemetryCursor c;
+  telemetryCursorStart(c, from, to);
+  c.csv = csv;
+  std::string out;
+  uint8_t chunk[200];
+  for (int guard = 0; guard < 10000; guard++) {
+    size_t len = telemetryFill(c, chunk, sizeof(chunk));
+    if (len == 0 && c.done)
+      break;
+    out.append((const char *)chunk, len);
+  }
+  return out;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_codec_round_trip(void) {
+  // Every delta-of-delta class, both signs, and value changes that reuse
+  // and that widen the leading/trailing window
+  static const int32_t deltas[] = {60,  60,   61,    59,     60,   120,
+                                   400, 60,   2000,  60,     100000,
+                                   60,  -500, 60,    86400,  60};
+  static const uint32_t values[] = {
+      0xFF330D01, 0xFF330D01, 0xFF330E01, 0xFF340E01, 0x00000000, 0x00000000,
+      0xFFFFFFFF, 0x80000001, 0x80000001, 0x12345678, 0x12345679, 0x02000000,
+      0x02000000, 0xFF660D03, 0xFF660D03, 0x00000001};
+  const int n = sizeof(deltas) / sizeof(deltas[0]);
+  uint32_t times[n];
+  uint32_t t = DAY * 86400;
+  for (int i = 0; i < n; i++) {
+    t += deltas[i];
+    times[i] = t;
+  }
+
+  static uint8_t buf[256];
+  TelemetryCodec enc;
+  telemetryCodecStart(enc, times[0], values[0]);
+  uint16_t bits = 0;
+  for (int i = 1; i < n; i++) {
+    telemetryEncode(enc, buf, bits, times[i], values[i]);
+  }
+  TEST_ASSERT_TRUE(bits <= (n - 1) * TELEMETRY_MAX_SAMPLE_BITS);
+
+  TelemetryCodec dec;
+  telemetryCodecStart(dec, times[0], values[0]);
+  uint16_t pos = 0;
+  for (int i = 1; i < n; i++) {
+    uint32_t dt, dv;
+    telemetryDecode(dec, buf, pos, dt, dv);
+    TEST_ASSERT_EQUAL_UINT32(times[i], dt);
+    TEST_ASSERT_EQUAL_UINT32(values[i], dv);
+  }
+  TEST_ASSERT_EQUAL(bits, pos);
+}
+
+void test_empty_store_reads_nothing(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, telemetryStats.oldestDay);
+  TelemetryCursor c;
+  telemetryCursorStart(c, 0, 0xFFFFFFFF);
+  TEST_ASSERT_TRUE(c.day > c.lastDay);
+
+  std::string json = query(0, 0xFFFFFFFF, false);
+  TEST_ASSERT_TRUE_MESSAGE(json.size() > 3 &&
+                               json.compare(json.size() - 3, 3, "[]}") == 0,
+                           json.c_str());
+  TEST_ASSERT_EQUAL_STRING("time,light,fanDuty,fan,switched\n",
+                           query(0, 100, true).c_str());
+}
+
+void test_query_clamped_to_stored_days(void) {
+  storeTrace();
+  TEST_ASSERT_EQUAL_UINT32(DAY, telemetryStats.oldestDay);
+  TEST_ASSERT_EQUAL_UINT32(DAY, telemetryStats.newestDay);
+  TEST_ASSERT_EQUAL_UINT32(TRACE_SAMPLES, telemetryStats.samples);
+
+  TelemetryCursor c;
+  telemetryCursorStart(c, 0, 0xFFFFFFFF);
+  TEST_ASSERT_EQUAL_UINT32(DAY, c.day);
+  TEST_ASSERT_EQUAL_UINT32(DAY, c.lastDay);
+
+  // Entirely before or after the store
+  telemetryCursorStart(c, 86400, 2 * 86400);
+  TEST_ASSERT_TRUE(c.day > c.lastDay);
+  telemetryCursorStart(c, (DAY + 5) * 86400, (DAY + 9) * 86400);
+  TEST_ASSERT_TRUE(c.day > c.lastDay);
+
+  // Everything comes back, once
+  std::string csv = query(0, 0xFFFFFFFF, true);
+  int rows = 0;
+  for (char ch : csv)
+    rows += ch == '\n';
+  TEST_ASSERT_EQUAL(TRACE_SAMPLES + 1, rows);
+
+  // A window inside the day
+  uint32_t from = traceTimes[100];
+  uint32_t to = traceTimes[149];
+  csv = query(from, to, true);
+  rows = 0;
+  for (char ch : csv)
+    rows += ch == '\n';
+  TEST_ASSERT_EQUAL(50 + 1, rows);
+}
+
+// The day file written above, decoded by the script, has to give exactly the
+// CSV telemetryFill() serves.
+void test_python_decodes_day_file(void) {
+  FILE *probe = fopen(CODEC, "r");
+  if (probe == NULL)
+    TEST_IGNORE_MESSAGE("scripts/telemetry_codec.py not found");
+  fclose(probe);
+
+  char tlmPath[24];
+  snprintf(tlmPath, sizeof(tlmPath), TELEMETRY_DIR "/%lu", (unsigned long)DAY);
+  File file = LittleFS.open(tlmPath, "r");
+  TEST_ASSERT_TRUE(file);
+  std::string data(file.size(), '\0');
+  TEST_ASSERT_EQUAL(data.size(), file.read((uint8_t *)&data[0], data.size()));
+  file.close();
+
+  char path[] = "/tmp/telemetryXXXXXX";
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  TEST_ASSERT_EQUAL(data.size(), write(fd, data.data(), data.size()));
+  close(fd);
+
+  char cmd[160];
+  snprintf(cmd, sizeof(cmd), "python3 %s decode %s 2>&1", CODEC, path);
+  FILE *p = popen(cmd, "r");
+  TEST_ASSERT_NOT_NULL(p);
+  std::string decoded;
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), p)) > 0)
+    decoded.append(buf, n);
+  int rc = pclose(p);
+  unlink(path);
+  if (WEXITSTATUS(rc) == 127)
+    TEST_IGNORE_MESSAGE("python3 not available");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(0, WEXITSTATUS(rc), decoded.c_str());
+
+  std::string served = query(0, 0xFFFFFFFF, true);
+  TEST_ASSERT_EQUAL_STRING(served.c_str(), decoded.c_str());
+}
+
+int main(int argc, char **argv) {
+  halSerialQuiet(true);
+  initLogger();
+  initTelemetry();
+  UNITY_BEGIN();
+  RUN_TEST(test_codec_round_trip);
+  RUN_TEST(test_empty_store_reads_nothing);
+  RUN_TEST(test_query_clamped_to_stored_days);
+  RUN_TEST(test_python_decodes_day_file);
+  return UNITY_END();
+}
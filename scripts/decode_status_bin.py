@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Fetch and decode the GrowTower binary status (/api/status.bin).
+
+Usage:
+    python decode_status_bin.py growtower.local
+    python decode_status_bin.py --file status.bin
+
+The layout is documented in firmware/src/statusbin.h.
+"""
+
+import argparse
+import json
+import struct
+import urllib.request
+
+STATUS_BIN_FORMAT = "<10BHHHHII4sBB"
+STATUS_BIN_SIZE = struct.calcsize(STATUS_BIN_FORMAT)
+
+PHASES = ["none", "seedling", "veg", "flower"]
+TZ_MODES = ["auto", "winter", "summer"]
+
+
+def decode(data):
+    if len(data) < STATUS_BIN_SIZE:
+        raise ValueError("payload too short: %d bytes" % len(data))
+    if data[0] != 1:
+        raise ValueError("unsupported format version %d" % data[0])
+
+    (version, flags, fan, fan_min, fan_max, light_on, duration, tz, phase,
+     active, total_days, seedling_days, veg_days, flower_days, state_version,
+     epoch, ip, duty, _reserved) = struct.unpack_from(STATUS_BIN_FORMAT, data)
+
+    return {
+        "format": version,
+        "version": state_version,
+        "light": bool(flags & 0x01),
+        "timerEnabled": bool(flags & 0x02),
+        "wifiConnected": bool(flags & 0x04),
+        "hasTime": bool(flags & 0x08),
+        "timeEstimated": bool(flags & 0x10),
+        "apMode": bool(flags & 0x20),
+        "fan": fan,
+        "fanMin": fan_min,
+        "fanMax": fan_max,
+        "fanDuty": duty,
+        "lightOn": light_on,
+        "lightDuration": duration,
+        "tzMode": TZ_MODES[tz] if tz < len(TZ_MODES) else tz,
+        "phase": PHASES[phase] if phase < len(PHASES) else phase,
+        "seedling": {"active": bool(active & 0x01), "days": seedling_days},
+        "veg": {"active": bool(active & 0x02), "days": veg_days},
+        "flower": {"active": bool(active & 0x04), "days": flower_days},
+        "totalDays": total_days,
+        "epoch": epoch if epoch else None,
+        "ip": ".".join(str(b) for b in ip),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host", nargs="?", default="growtower.local")
+    parser.add_argument("--file", help="decode a saved payload instead")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+    else:
+        with urllib.request.urlopen("http://%s/api/status.bin" % args.host,
+                                    timeout=5) as resp:
+            data = resp.read()
+
+    print(json.dumps(decode(data), indent=2))
+
+
+if __name__ == "__main__":
+    main()
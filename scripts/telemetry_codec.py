@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""Encode/decode the GrowTower compressed telemetry block format.
+
+Usage:
+    python telemetry_codec.py decode /path/to/tlm/19700   # day file -> CSV
+    python telemetry_codec.py selftest --days 120         # synthetic trace
+
+The format is documented in firmware/src/telemetry.h. `selftest` encodes a
+synthetic grow (light schedule, fan changes, jittered timestamps, outages)
+with the same block rules as the firmware, decodes it again, checks the
+round trip and prints the compression ratio and flash bytes per day.
+"""
+
+import argparse
+import random
+import struct
+import sys
+
+MAGIC = 0x4254
+HEADER = "<HHHHII"
+HEADER_SIZE = struct.calcsize(HEADER)
+BLOCK_BYTES = 512
+MAX_SAMPLE_BITS = 80
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+class BitWriter:
+    def __init__(self):
+        self.bits = []
+
+    def put(self, value, n):
+        for i in range(n - 1, -1, -1):
+            self.bits.append((value >> i) & 1)
+
+    def tobytes(self):
+        out = bytearray((len(self.bits) + 7) // 8)
+        for i, bit in enumerate(self.bits):
+            if bit:
+                out[i >> 3] |= 0x80 >> (i & 7)
+        return bytes(out)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def get(self, n):
+        value = 0
+        for _ in range(n):
+            bit = (self.data[self.pos >> 3] >> (7 - (self.pos & 7))) & 1
+            value = (value << 1) | bit
+            self.pos += 1
+        return value
+
+
+def clz32(x):
+    return 32 - x.bit_length()
+
+
+def ctz32(x):
+    return (x & -x).bit_length() - 1
+
+
+class Codec:
+    def __init__(self, t, v):
+        self.time = t
+        self.delta = 60
+        self.value = v
+        self.leading = None
+        self.trailing = 0
+
+    def encode(self, w, t, v):
+        delta = t - self.time
+        dod = delta - self.delta
+        if dod == 0:
+            w.put(0b0, 1)
+        elif -63 <= dod <= 64:
+            w.put(0b10, 2)
+            w.put(dod + 63, 7)
+        elif -255 <= dod <= 256:
+            w.put(0b110, 3)
+            w.put(dod + 255, 9)
+        elif -2047 <= dod <= 2048:
+            w.put(0b1110, 4)
+            w.put(dod + 2047, 12)
+        else:
+            w.put(0b1111, 4)
+            w.put(dod & 0xFFFFFFFF, 32)
+        self.time = t
+        self.delta = delta
+
+        x = v ^ self.value
+        self.value = v
+        if x == 0:
+            w.put(0b0, 1)
+            return
+        leading = min(clz32(x), 31)
+        trailing = ctz32(x)
+        if (self.leading is not None and leading >= self.leading
+                and trailing >= self.trailing):
+            w.put(0b10, 2)
+            w.put(x >> self.trailing, 32 - self.leading - self.trailing)
+            return
+        length = 32 - leading - trailing
+        w.put(0b11, 2)
+        w.put(leading, 5)
+        w.put(length - 1, 5)
+        w.put(x >> trailing, length)
+        self.leading = leading
+        self.trailing = trailing
+
+    def decode(self, r):
+        if r.get(1) == 0:
+            dod = 0
+        elif r.get(1) == 0:
+            dod = r.get(7) - 63
+        elif r.get(1) == 0:
+            dod = r.get(9) - 255
+        elif r.get(1) == 0:
+            dod = r.get(12) - 2047
+        else:
+            dod = r.get(32)
+            if dod & 0x80000000:
+                dod -= 1 << 32
+        self.delta += dod
+        self.time += self.delta
+
+        if r.get(1) == 1:
+            if r.get(1) == 0:
+                x = r.get(32 - self.leading - self.trailing) << self.trailing
+            else:
+                self.leading = r.get(5)
+                length = r.get(5) + 1
+                self.trailing = 32 - self.leading - length
+                x = r.get(length) << self.trailing
+            self.value ^= x
+        return self.time, self.value
+
+
+def encode_blocks(samples):
+    """Splits (time, value) samples into blocks the way the firmware does."""
+    blocks = []
+    i = 0
+    while i < len(samples):
+        t0, v0 = samples[i]
+        codec = Codec(t0, v0)
+        w = BitWriter()
+        count = 1
+        i += 1
+        while i < len(samples):
+            t, v = samples[i]
+            if t // 3600 != t0 // 3600:
+                break
+            if len(w.bits) + MAX_SAMPLE_BITS > BLOCK_BYTES * 8:
+                break
+            if t > codec.time:
+                codec.encode(w, t, v)
+                count += 1
+            i += 1
+        payload = w.tobytes()
+        header = struct.pack(HEADER, MAGIC, count, len(payload),
+                             crc16(payload), t0, v0)
+        blocks.append(header + payload)
+    return blocks
+
+
+def decode_blocks(data):
+    """Yields (time, value) from a day file, stopping at a damaged block."""
+    offset = 0
+    while offset + HEADER_SIZE <= len(data):
+        magic, count, size, crc, t, v = struct.unpack_from(HEADER, data, offset)
+        payload = data[offset + HEADER_SIZE:offset + HEADER_SIZE + size]
+        if (magic != MAGIC or count == 0 or size > BLOCK_BYTES
+                or len(payload) != size or crc16(payload) != crc):
+            print("damaged block at offset %d, stopping" % offset,
+                  file=sys.stderr)
+            return
+        codec = Codec(t, v)
+        reader = BitReader(payload)
+        yield t, v
+        for _ in range(count - 1):
+            yield codec.decode(reader)
+        offset += HEADER_SIZE + size
+
+
+def csv_row(t, v):
+    light = ((v >> 24) * 100 + 127) // 255
+    switched = 1 if v & 0x02 else 0
+    return "%d,%d,%d,%d,%d" % (t, light, (v >> 16) & 0xFF, (v >> 8) & 0xFF,
+                               switched)
+
+
+def synthetic_trace(days, seed):
+    rng = random.Random(seed)
+    t = 1700000000 - 1700000000 % 86400
+    samples = []
+    fan = 40
+    for _ in range(days):
+        for minute in range(1440):
+            if rng.random() < 1 / 5000:
+                t += 60 * rng.randint(1, 300)  # power outage
+            on = 6 * 60 <= minute < 24 * 60
+            if rng.random() < 1 / 2000:
+                fan = rng.randint(20, 80)  # user changes the fan
+            duty = fan * 255 // 100 if on else fan * 255 // 200
+            flags = 0x01 | (0x02 if minute == 6 * 60 else 0)
+            v = (255 if on else 0) << 24 | duty << 16 | fan << 8 | flags
+            samples.append((t, v))
+            t += 60 + (rng.choice([-1, 1]) if rng.random() < 0.01 else 0)
+    return samples
+
+
+def selftest(days, seed):
+    samples = synthetic_trace(days, seed)
+    blocks = encode_blocks(samples)
+    decoded = list(decode_blocks(b"".join(blocks)))
+    if decoded != samples:
+        print("FAIL: round trip mismatch")
+        return 1
+    stored = sum(len(b) for b in blocks)
+    raw = len(samples) * 8
+    print("samples:       %d" % len(samples))
+    print("blocks:        %d" % len(blocks))
+    print("stored bytes:  %d" % stored)
+    print("ratio:         %.1fx" % (raw / stored))
+    print("bytes per day: %d" % (stored // days))
+    print("OK")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+    dec = sub.add_parser("decode", help="decode a day file to CSV")
+    dec.add_argument("file")
+    test = sub.add_parser("selftest", help="round-trip a synthetic trace")
+    test.add_argument("--days", type=int, default=120)
+    test.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    if args.command == "selftest":
+        sys.exit(selftest(args.days, args.seed))
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    print("time,light,fanDuty,fan,switched")
+    for t, v in decode_blocks(data):
+        print(csv_row(t, v))
+
+
+if __name__ == "__main__":
+    main()